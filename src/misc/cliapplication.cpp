@@ -303,7 +303,7 @@ void CliApplication::help() const
     // Output some help
 
     std::cout << "Usage: " << qAppName().toStdString()
-              << " [-a|--about] [-c|--command [<plugin>]::<command> [<argument> ...]] [-e|--exclude <plugins>] [-h|--help] [-i|--include <plugins>] [-p|--plugins] [-r|--reset] [-s|--status] [-v|--version] [<files>]"
+              << " [-j|--jit-cache <directory>] [-a|--about] [-c|--command [<plugin>]::<command> [<argument> ...]] [-e|--exclude <plugins>] [-h|--help] [-i|--include <plugins>] [-p|--plugins] [-r|--reset] [-s|--status] [-v|--version] [<files>]"
               << std::endl;
     std::cout << " -a, --about     Display some information about OpenCOR"
               << std::endl;
@@ -315,6 +315,8 @@ void CliApplication::help() const
               << std::endl;
     std::cout << " -i, --include   Include the given plugin(s)"
               << std::endl;
+    std::cout << " -j, --jit-cache Cache compiled models in the given directory"
+              << std::endl;
     std::cout << " -p, --plugins   Display all the CLI plugins"
               << std::endl;
     std::cout << " -r, --reset     Reset all your settings"
@@ -532,6 +534,30 @@ bool CliApplication::run(int &pRes)
     // Note: we remove the first argument since it corresponds to the full path
     //       to our executable, which we are not interested in...
 
+    // Retrieve the directory where compiled models are to be cached, if any
+    // Note #1: this must be done before anything else since the directory can
+    //          be used with any of our other options...
+    // Note #2: the directory is only meant to be used with the CLI version of
+    //          OpenCOR, so we must have at least one other option...
+
+    static const QString J = "-j"; static const QString JitCache = "--jit-cache";
+
+    while (   !appArguments.isEmpty()
+           && ((appArguments.first() == J) || (appArguments.first() == JitCache))) {
+        appArguments.removeFirst();
+
+        if (appArguments.count() < 2) {
+            pRes = -1;
+
+            help();
+
+            return true;
+        }
+
+        qApp->setProperty("OpenCOR::jitCacheDirName()",
+                          QDir(appArguments.takeFirst()).absolutePath());
+    }
+
     static const QString A = "-a"; static const QString About   = "--about";
     static const QString C = "-c"; static const QString Command = "--command";
     static const QString E = "-e"; static const QString Exclude = "--exclude";
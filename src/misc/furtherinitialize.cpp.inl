@@ -171,9 +171,11 @@ QString Simulation::furtherInitialize() const
         }
     }
 
-    // Customise our graph panel and graphs
+    // Customise our graph panel and graphs, keeping track of the model
+    // parameters that they use, so that we only record those ones
 
     QIntList graphPanelsWidgetSizes;
+    QStringList recordedUris;
 
     for (int i = 0; i < mNbOfGraphPanels; ++i) {
         // Customise our graph panel
@@ -531,6 +533,9 @@ QString Simulation::furtherInitialize() const
                 }
             }
 
+            recordedUris << SimulationSupport::SimulationResults::uri(xParameter)
+                         << SimulationSupport::SimulationResults::uri(yParameter);
+
             graphPanel->addGraph(new GraphPanelWidget::GraphPanelPlotGraph(xParameter, yParameter, graphPanel),
                                  GraphPanelWidget::GraphPanelPlotGraphProperties(selected, title, lineStyle, lineWidth, lineColor, symbolStyle, symbolSize, symbolColor, symbolFilled, symbolFillColor));
         }
@@ -547,6 +552,11 @@ QString Simulation::furtherInitialize() const
 
     graphPanelsWidget->setSizes(graphPanelsWidgetSizes);
 
+    // Only record the model parameters that are used by our graphs, since the
+    // other ones can be computed on demand
+
+    mSimulation->results()->setRecordedVariables(recordedUris);
+
     // Select our first graph panel, now that we are fully initialised
 
     graphPanelsWidget->setActiveGraphPanel(graphPanelsWidget->graphPanels().first());
@@ -0,0 +1,52 @@
+<?xml version="1.0" encoding="utf-8"?>
+<!DOCTYPE TS>
+<TS version="2.1" language="fr_FR" sourcelanguage="en_GB">
+<context>
+    <name>OpenCOR::BinaryDataStore::BinaryDataStoreDialog</name>
+    <message>
+        <source>Export Data</source>
+        <translation>Exporter Données</translation>
+    </message>
+    <message>
+        <source>Compress the data</source>
+        <translation>Compresser les données</translation>
+    </message>
+</context>
+<context>
+    <name>OpenCOR::BinaryDataStore::BinaryDataStoreExporterWorker</name>
+    <message>
+        <source>The data could not be written.</source>
+        <translation>Les données n&apos;ont pas pu être écrites.</translation>
+    </message>
+    <message>
+        <source>The binary file could not be created.</source>
+        <translation>Le fichier binaire n&apos;a pas pu être créé.</translation>
+    </message>
+</context>
+<context>
+    <name>OpenCOR::BinaryDataStore::BinaryDataStoreImporterWorker</name>
+    <message>
+        <source>The data could not be read.</source>
+        <translation>Les données n&apos;ont pas pu être lues.</translation>
+    </message>
+    <message>
+        <source>The file could not be opened.</source>
+        <translation>Le fichier n&apos;a pas pu être ouvert.</translation>
+    </message>
+</context>
+<context>
+    <name>OpenCOR::BinaryDataStore::BinaryDataStorePlugin</name>
+    <message>
+        <source>Binary File</source>
+        <translation>Fichier Binaire</translation>
+    </message>
+    <message>
+        <source>Export To Binary</source>
+        <translation>Exporter Vers Binaire</translation>
+    </message>
+    <message>
+        <source>Data</source>
+        <translation>Données</translation>
+    </message>
+</context>
+</TS>
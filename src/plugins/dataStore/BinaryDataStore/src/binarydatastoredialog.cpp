@@ -0,0 +1,70 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Binary data store dialog
+//==============================================================================
+
+#include "binarydatastoredialog.h"
+
+//==============================================================================
+
+#include <QCheckBox>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace BinaryDataStore {
+
+//==============================================================================
+
+BinaryDataStoreDialog::BinaryDataStoreDialog(DataStore::DataStore *pDataStore,
+                                             const QMap<int, QIcon> &pIcons,
+                                             QWidget *pParent) :
+    DataStore::DataStoreDialog("BinaryDataStore", pDataStore, true,
+                               pIcons, pParent)
+{
+    // Customise our GUI
+
+    setWindowTitle(tr("Export Data"));
+
+    // Add a check box to decide whether our data should be compressed
+
+    mCompressedValue = new QCheckBox(tr("Compress the data"), this);
+
+    addWidget(mCompressedValue);
+}
+
+//==============================================================================
+
+bool BinaryDataStoreDialog::isCompressed() const
+{
+    // Return whether our data should be compressed
+
+    return mCompressedValue->isChecked();
+}
+
+//==============================================================================
+
+} // namespace BinaryDataStore
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -0,0 +1,235 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Binary data store exporter
+//==============================================================================
+
+#include "binarydatastoredata.h"
+#include "binarydatastoreexporter.h"
+#include "binarydatastorefile.h"
+#include "corecliutils.h"
+
+//==============================================================================
+
+#include <QDir>
+#include <QtEndian>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace BinaryDataStore {
+
+//==============================================================================
+
+BinaryDataStoreExporterWorker::BinaryDataStoreExporterWorker(DataStore::DataStoreExportData *pDataStoreData) :
+    DataStore::DataStoreExporterWorker(pDataStoreData)
+{
+}
+
+//==============================================================================
+
+static bool align(QFile &pFile)
+{
+    // Pad the given file with zeros so that its next column is aligned
+
+    int padding = int(quint64(-pFile.pos()) & (BinaryDataStoreAlignment-1));
+
+    return (padding == 0) || (pFile.write(QByteArray(padding, '\0')) == padding);
+}
+
+//==============================================================================
+
+void BinaryDataStoreExporterWorker::run()
+{
+    // Export our data store to a binary file
+    // Note: like for CSV, we first export our data store to a temporary file,
+    //       which we then rename to our final file...
+
+    QFile file(Core::temporaryFileName());
+    QString errorMessage;
+
+    if (file.open(QIODevice::WriteOnly)) {
+        // Determine the variables that we need to export, starting with our
+        // VOI, if it is to be exported
+
+        DataStore::DataStore *dataStore = mDataStoreData->dataStore();
+        DataStore::DataStoreVariables variables = mDataStoreData->variables();
+        DataStore::DataStoreVariable *voi = dataStore->voi();
+
+        if (variables.removeOne(voi)) {
+            variables.prepend(voi);
+        }
+
+        // Determine the number of values to export
+
+        int nbOfRuns = dataStore->runsCount();
+        quint64 nbOfValues = 0;
+
+        for (auto variable : qAsConst(variables)) {
+            for (int i = 0; i < nbOfRuns; ++i) {
+                nbOfValues += variable->size(i);
+            }
+        }
+
+        double oneOverNbOfValues = 1.0/double(qMax(nbOfValues, quint64(1)));
+        quint64 valueNb = 0;
+        int percentage = 0;
+
+        // Write our prelude, using a dummy header offset for now
+
+        QByteArray prelude(BinaryDataStorePreludeSize, '\0');
+
+        memcpy(prelude.data(), BinaryDataStoreMagic.constData(), size_t(BinaryDataStoreMagic.size()));
+
+        qToLittleEndian<quint32>(BinaryDataStoreVersion, prelude.data()+4);
+
+        bool res = file.write(prelude) == BinaryDataStorePreludeSize;
+
+        // Write our columns, i.e. the values of each of our variables for each
+        // of our runs, one chunk at a time and compressing each of those chunks,
+        // if requested
+        // Note: like for CSV, our progress is only reported when it has changed
+        //       by at least 1%...
+
+        bool compressed = static_cast<BinaryDataStoreData *>(mDataStoreData)->isCompressed();
+        BinaryDataStoreColumns columns;
+        QVector<double> values(BinaryDataStoreChunkSize);
+        QByteArray buffer(int(BinaryDataStoreChunkSize*sizeof(double)), '\0');
+
+        for (auto variable : qAsConst(variables)) {
+            for (int i = 0; res && (i < nbOfRuns); ++i) {
+                BinaryDataStoreColumn column;
+
+                res = align(file);
+
+                column.uri = variable->uri();
+                column.unit = variable->unit();
+                column.voi = variable == voi;
+                column.run = i;
+                column.size = variable->size(i);
+                column.offset = quint64(file.pos());
+
+                for (quint64 j = 0; res && (j < column.size); j += BinaryDataStoreChunkSize) {
+                    quint64 chunkSize = qMin(column.size-j, quint64(BinaryDataStoreChunkSize));
+
+                    for (quint64 k = 0; k < chunkSize; ++k) {
+                        values[int(k)] = variable->value(j+k, i);
+                    }
+
+                    qToLittleEndian<double>(values.constData(), qsizetype(chunkSize), buffer.data());
+
+                    QByteArray chunk = QByteArray::fromRawData(buffer.constData(), int(chunkSize*sizeof(double)));
+
+                    // Note: qCompress() prefixes its zlib stream with the size
+                    //       of the uncompressed data, as a big-endian 32-bit
+                    //       integer, which we don't want in our file (see
+                    //       binarydatastorefile.h)...
+
+                    if (compressed) {
+                        chunk = qCompress(chunk).mid(4);
+
+                        column.chunkSizes << quint64(chunk.size());
+                    }
+
+                    res = file.write(chunk) == chunk.size();
+
+                    valueNb += chunkSize;
+
+                    int newPercentage = int(100.0*valueNb*oneOverNbOfValues);
+
+                    if (newPercentage != percentage) {
+                        percentage = newPercentage;
+
+                        emit progress(mDataStoreData, valueNb*oneOverNbOfValues);
+                    }
+                }
+
+                columns << column;
+            }
+        }
+
+        // Write our header and update our prelude with its offset
+
+        if (res) {
+            res = align(file);
+        }
+
+        if (res) {
+            auto headerOffset = quint64(file.pos());
+            QByteArray header = BinaryDataStore::header(dataStore->uri(), columns);
+            QByteArray rawHeaderOffset(sizeof(quint64), '\0');
+
+            qToLittleEndian<quint64>(headerOffset, rawHeaderOffset.data());
+
+            res =    (file.write(header) == header.size())
+                  && file.seek(8)
+                  && (file.write(rawHeaderOffset) == rawHeaderOffset.size());
+        }
+
+        // Close our temporary file and rename it to our final file, if we were
+        // able to output all of our data
+
+        file.close();
+
+        if (res) {
+            QDir dir(QFileInfo(mDataStoreData->fileName()).path());
+
+            res = dir.exists() || dir.mkpath(dir.dirName());
+
+            if (res) {
+                if (QFile::exists(mDataStoreData->fileName())) {
+                    QFile::remove(mDataStoreData->fileName());
+                }
+
+                res = file.rename(mDataStoreData->fileName());
+            }
+        }
+
+        if (!res) {
+            file.remove();
+
+            errorMessage = tr("The data could not be written.");
+        }
+    } else {
+        errorMessage = tr("The binary file could not be created.");
+    }
+
+    // Let people know that our export is done
+
+    emit done(mDataStoreData, errorMessage);
+}
+
+//==============================================================================
+
+DataStore::DataStoreExporterWorker * BinaryDataStoreExporter::workerInstance(DataStore::DataStoreExportData *pDataStoreData)
+{
+    // Return an instance of our worker
+
+    return new BinaryDataStoreExporterWorker(pDataStoreData);
+}
+
+//==============================================================================
+
+} // namespace BinaryDataStore
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -0,0 +1,259 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Binary data store file
+//==============================================================================
+
+#include "binarydatastorefile.h"
+
+//==============================================================================
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace BinaryDataStore {
+
+//==============================================================================
+
+static const auto FormatKey      = QStringLiteral("format");
+static const auto VersionKey     = QStringLiteral("version");
+static const auto DataTypeKey    = QStringLiteral("dtype");
+static const auto UriKey         = QStringLiteral("uri");
+static const auto ChunkSizeKey   = QStringLiteral("chunkSize");
+static const auto ColumnsKey     = QStringLiteral("columns");
+static const auto UnitKey        = QStringLiteral("unit");
+static const auto VoiKey         = QStringLiteral("voi");
+static const auto RunKey         = QStringLiteral("run");
+static const auto SizeKey        = QStringLiteral("size");
+static const auto OffsetKey      = QStringLiteral("offset");
+static const auto CompressionKey = QStringLiteral("compression");
+static const auto ChunksKey      = QStringLiteral("chunks");
+
+static const auto Format          = QStringLiteral("OpenCOR binary data store");
+static const auto DataType        = QStringLiteral("<f8");
+static const auto NoCompression   = QStringLiteral("none");
+static const auto ZlibCompression = QStringLiteral("zlib");
+
+//==============================================================================
+
+QByteArray header(const QString &pUri, const BinaryDataStoreColumns &pColumns)
+{
+    // Return a JSON document that describes the given columns
+    // Note: the JSON document is meant to be human readable and easy to use
+    //       from, say, Python (e.g. to create a numpy.memmap for an
+    //       uncompressed column), hence we use a NumPy-like data type...
+
+    QJsonArray columns;
+
+    for (const auto &column : pColumns) {
+        QJsonArray chunkSizes;
+
+        for (auto chunkSize : column.chunkSizes) {
+            chunkSizes << double(chunkSize);
+        }
+
+        columns << QJsonObject({ { UriKey, column.uri },
+                                 { UnitKey, column.unit },
+                                 { VoiKey, column.voi },
+                                 { RunKey, column.run },
+                                 { SizeKey, double(column.size) },
+                                 { OffsetKey, double(column.offset) },
+                                 { CompressionKey, column.chunkSizes.isEmpty()?
+                                                       NoCompression:
+                                                       ZlibCompression },
+                                 { ChunksKey, chunkSizes } });
+    }
+
+    return QJsonDocument(QJsonObject({ { FormatKey, Format },
+                                       { VersionKey, BinaryDataStoreVersion },
+                                       { DataTypeKey, DataType },
+                                       { UriKey, pUri },
+                                       { ChunkSizeKey, BinaryDataStoreChunkSize },
+                                       { ColumnsKey, columns } })).toJson();
+}
+
+//==============================================================================
+
+static bool unsignedInteger(const QJsonValue &pValue, quint64 &pInteger)
+{
+    // Retrieve the given JSON value as an unsigned integer, making sure that it
+    // is an integral, non-negative number that can be represented exactly as a
+    // double (since JSON numbers are doubles), i.e. that is no bigger than 2^53
+
+    static const double MaximumInteger = 9007199254740992.0;
+
+    if (!pValue.isDouble()) {
+        return false;
+    }
+
+    double value = pValue.toDouble();
+
+    if (   !(value >= 0.0) || (value > MaximumInteger)
+        || (double(quint64(value)) != value)) {
+        return false;
+    }
+
+    pInteger = quint64(value);
+
+    return true;
+}
+
+//==============================================================================
+
+bool readColumns(QFile &pFile, BinaryDataStoreColumns &pColumns)
+{
+    // Read and check our prelude
+
+    pColumns.clear();
+
+    if (!pFile.seek(0)) {
+        return false;
+    }
+
+    QByteArray prelude = pFile.read(BinaryDataStorePreludeSize);
+
+    if (   (prelude.size() != BinaryDataStorePreludeSize)
+        || !prelude.startsWith(BinaryDataStoreMagic)
+        || (qFromLittleEndian<quint32>(prelude.constData()+4) != BinaryDataStoreVersion)) {
+        return false;
+    }
+
+    // Read and check our header
+
+    auto fileSize = quint64(pFile.size());
+    auto headerOffset = qFromLittleEndian<quint64>(prelude.constData()+8);
+
+    if ((headerOffset < BinaryDataStorePreludeSize) || (headerOffset >= fileSize) || !pFile.seek(qint64(headerOffset))) {
+        return false;
+    }
+
+    QJsonParseError error;
+    QJsonObject header = QJsonDocument::fromJson(pFile.readAll(), &error).object();
+
+    if (   (error.error != QJsonParseError::NoError)
+        || (header.value(FormatKey).toString() != Format)
+        || (header.value(DataTypeKey).toString() != DataType)
+        || (header.value(ChunkSizeKey).toInt() != BinaryDataStoreChunkSize)) {
+        return false;
+    }
+
+    // Retrieve our columns, making sure that their data is within our file
+    // Note: our sizes and offsets come from a file that may be corrupted (or
+    //       crafted), so we make sure that they are valid and that we don't
+    //       overflow when checking them...
+
+    const QJsonArray columns = header.value(ColumnsKey).toArray();
+
+    for (const auto &columnValue : columns) {
+        QJsonObject columnObject = columnValue.toObject();
+        BinaryDataStoreColumn column;
+
+        column.uri = columnObject.value(UriKey).toString();
+        column.unit = columnObject.value(UnitKey).toString();
+        column.voi = columnObject.value(VoiKey).toBool();
+        column.run = columnObject.value(RunKey).toInt();
+
+        if (   !unsignedInteger(columnObject.value(SizeKey), column.size)
+            || !unsignedInteger(columnObject.value(OffsetKey), column.offset)
+            || (column.offset < BinaryDataStorePreludeSize)
+            || (column.offset > headerOffset)) {
+            return false;
+        }
+
+        quint64 availableSize = headerOffset-column.offset;
+
+        if (columnObject.value(CompressionKey).toString() == ZlibCompression) {
+            const QJsonArray chunkSizes = columnObject.value(ChunksKey).toArray();
+
+            if (quint64(chunkSizes.count()) != (column.size+BinaryDataStoreChunkSize-1)/BinaryDataStoreChunkSize) {
+                return false;
+            }
+
+            for (const auto &chunkSizeValue : chunkSizes) {
+                quint64 chunkSize;
+
+                if (   !unsignedInteger(chunkSizeValue, chunkSize)
+                    || (chunkSize > availableSize)) {
+                    return false;
+                }
+
+                column.chunkSizes << chunkSize;
+
+                availableSize -= chunkSize;
+            }
+        } else if (   (columnObject.value(CompressionKey).toString() != NoCompression)
+                   || (column.size > availableSize/sizeof(double))) {
+            return false;
+        }
+
+        pColumns << column;
+    }
+
+    return true;
+}
+
+//==============================================================================
+
+BinaryDataStoreColumns importColumns(const BinaryDataStoreColumns &pColumns)
+{
+    // Return the columns that can be imported, i.e. the VOI column of our first
+    // run followed by all the variable columns that have the same number of
+    // values, or nothing if there is no such VOI column
+    // Note: the variable columns of our other runs are only imported if they
+    //       have the same number of values as our first run, since we only
+    //       import one VOI...
+
+    BinaryDataStoreColumns res;
+
+    for (const auto &column : pColumns) {
+        if (column.voi && (column.run == 0)) {
+            res << column;
+
+            break;
+        }
+    }
+
+    if (res.isEmpty()) {
+        return {};
+    }
+
+    for (const auto &column : pColumns) {
+        if (!column.voi && (column.size == res.first().size)) {
+            res << column;
+        }
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+} // namespace BinaryDataStore
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -0,0 +1,95 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Binary data store file
+//==============================================================================
+
+#pragma once
+
+//==============================================================================
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+//==============================================================================
+
+class QFile;
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace BinaryDataStore {
+
+//==============================================================================
+
+// Note: a binary data store file consists of a prelude (our magic number, our
+//       version as a little-endian 32-bit integer and the offset of our header
+//       as a little-endian 64-bit integer), followed by our columns (each of
+//       which is aligned and contains the little-endian double values of a
+//       variable for a given run, possibly compressed in chunks, each of
+//       which is a raw zlib stream) and then our header (a JSON document that
+//       describes our columns). The uncompressed size of a chunk is not stored
+//       with it since it can be derived from the size of its column and our
+//       chunk size...
+
+static const auto BinaryDataStoreMagic = QByteArrayLiteral("OCBD");
+
+enum {
+    BinaryDataStoreVersion = 2,
+    BinaryDataStorePreludeSize = 16,
+    BinaryDataStoreAlignment = 64,
+    BinaryDataStoreChunkSize = 1 << 16
+};
+
+//==============================================================================
+
+struct BinaryDataStoreColumn
+{
+    QString uri;
+    QString unit;
+    bool voi = false;
+    int run = 0;
+    quint64 size = 0;
+    quint64 offset = 0;
+    QVector<quint64> chunkSizes;
+};
+
+//==============================================================================
+
+using BinaryDataStoreColumns = QList<BinaryDataStoreColumn>;
+
+//==============================================================================
+
+QByteArray header(const QString &pUri, const BinaryDataStoreColumns &pColumns);
+
+bool readColumns(QFile &pFile, BinaryDataStoreColumns &pColumns);
+
+BinaryDataStoreColumns importColumns(const BinaryDataStoreColumns &pColumns);
+
+//==============================================================================
+
+} // namespace BinaryDataStore
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -0,0 +1,159 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Binary data store importer
+//==============================================================================
+
+#include "binarydatastorefile.h"
+#include "binarydatastoreimporter.h"
+
+//==============================================================================
+
+#include <QFile>
+#include <QtEndian>
+
+//==============================================================================
+
+#include <cstring>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace BinaryDataStore {
+
+//==============================================================================
+
+BinaryDataStoreImporterWorker::BinaryDataStoreImporterWorker(DataStore::DataStoreImportData *pImportData) :
+    DataStore::DataStoreImporterWorker(pImportData)
+{
+}
+
+//==============================================================================
+
+void BinaryDataStoreImporterWorker::run()
+{
+    // Import our binary file in our data store
+    // Note: we map our binary file to memory and add the values of its
+    //       columns to our data store, one chunk at a time. Each chunk gets
+    //       copied to our values (and byte swapped, if we are on a big-endian
+    //       machine) after having been uncompressed, if needed, so we only
+    //       ever need memory for one chunk at a time...
+
+    QFile file(mImportData->fileName());
+    BinaryDataStoreColumns columns;
+    QString errorMessage;
+
+    if (file.open(QIODevice::ReadOnly) && readColumns(file, columns)) {
+        columns = importColumns(columns);
+
+        const uchar *data = file.map(0, file.size());
+
+        if ((data != nullptr) && (columns.count() == mImportData->nbOfVariables()+1)) {
+            // Add the values of our columns to our data store, making sure that
+            // our VOI values are added last (see DataStore::addValues())
+
+            DataStore::DataStoreVariable *importVoi = mImportData->importDataStore()->voi();
+            DataStore::DataStoreVariables importVariables = mImportData->importVariables();
+            QVector<double> values(BinaryDataStoreChunkSize);
+            QVector<quint64> offsets;
+
+            for (const auto &column : qAsConst(columns)) {
+                offsets << column.offset;
+            }
+
+            for (quint64 i = 0, iMax = columns.first().size; i < iMax; i += BinaryDataStoreChunkSize) {
+                quint64 chunkSize = qMin(iMax-i, quint64(BinaryDataStoreChunkSize));
+                int chunkNb = int(i/BinaryDataStoreChunkSize);
+
+                for (int j = columns.count()-1; j >= 0; --j) {
+                    const BinaryDataStoreColumn &column = columns[j];
+                    const uchar *chunk = data+offsets[j];
+                    QByteArray uncompressedChunk;
+
+                    if (!column.chunkSizes.isEmpty()) {
+                        // Our chunk is a raw zlib stream, so prefix it with its
+                        // uncompressed size, as expected by qUncompress()
+
+                        QByteArray compressedChunk(4+int(column.chunkSizes[chunkNb]), Qt::Uninitialized);
+
+                        qToBigEndian<quint32>(quint32(chunkSize*sizeof(double)), compressedChunk.data());
+
+                        memcpy(compressedChunk.data()+4, chunk, column.chunkSizes[chunkNb]);
+
+                        uncompressedChunk = qUncompress(compressedChunk);
+                        chunk = reinterpret_cast<const uchar *>(uncompressedChunk.constData());
+
+                        offsets[j] += column.chunkSizes[chunkNb];
+
+                        if (quint64(uncompressedChunk.size()) != chunkSize*sizeof(double)) {
+                            errorMessage = tr("The data could not be read.");
+
+                            break;
+                        }
+                    } else {
+                        offsets[j] += chunkSize*sizeof(double);
+                    }
+
+                    qFromLittleEndian<double>(chunk, qsizetype(chunkSize), values.data());
+
+                    if (j == 0) {
+                        importVoi->addValues(values.constData(), chunkSize);
+                    } else {
+                        importVariables[j-1]->addValues(values.constData(), chunkSize);
+                    }
+                }
+
+                if (!errorMessage.isEmpty()) {
+                    break;
+                }
+
+                updateProgress(chunkSize);
+            }
+        } else {
+            errorMessage = tr("The data could not be read.");
+        }
+
+        file.close();
+    } else {
+        errorMessage = tr("The file could not be opened.");
+    }
+
+    // Let people know that our import is done
+
+    emit done(mImportData, errorMessage);
+}
+
+//==============================================================================
+
+DataStore::DataStoreImporterWorker * BinaryDataStoreImporter::workerInstance(DataStore::DataStoreImportData *pImportData)
+{
+    // Return an instance of our worker
+
+    return new BinaryDataStoreImporterWorker(pImportData);
+}
+
+//==============================================================================
+
+} // namespace BinaryDataStore
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
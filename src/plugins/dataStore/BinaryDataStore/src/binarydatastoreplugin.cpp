@@ -0,0 +1,251 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Binary data store plugin
+//==============================================================================
+
+#include "binarydatastoredata.h"
+#include "binarydatastoredialog.h"
+#include "binarydatastoreexporter.h"
+#include "binarydatastorefile.h"
+#include "binarydatastoreimporter.h"
+#include "binarydatastoreplugin.h"
+#include "binaryinterface.h"
+#include "corecliutils.h"
+#include "coreguiutils.h"
+
+//==============================================================================
+
+#include <QFile>
+#include <QMainWindow>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace BinaryDataStore {
+
+//==============================================================================
+
+PLUGININFO_FUNC BinaryDataStorePluginInfo()
+{
+    static const Descriptions descriptions = {
+                                                 { "en", QString::fromUtf8("a binary data store plugin.") },
+                                                 { "fr", QString::fromUtf8("une extension de magasin de données binaire.") }
+                                             };
+
+    return new PluginInfo(PluginInfo::Category::DataStore, true, false,
+                          { "DataStore" },
+                          descriptions);
+}
+
+//==============================================================================
+
+BinaryDataStorePlugin::BinaryDataStorePlugin()
+{
+    // Keep track of our file type interface
+
+    static BinaryInterfaceData data(qobject_cast<FileTypeInterface *>(this));
+
+    Core::globalInstance(BinaryInterfaceDataSignature, &data);
+}
+
+//==============================================================================
+// Data store interface
+//==============================================================================
+
+QString BinaryDataStorePlugin::dataStoreName() const
+{
+    // Return the name of the data store
+
+    return "Binary";
+}
+
+//==============================================================================
+
+DataStore::DataStoreImportData * BinaryDataStorePlugin::getImportData(const QString &pFileName,
+                                                                      DataStore::DataStore *pImportDataStore,
+                                                                      DataStore::DataStore *pResultsDataStore,
+                                                                      const QList<quint64> &pRunSizes) const
+{
+    // Determine the number of variables and data points in our binary file,
+    // straight from its header
+    // Note: we subtract 1 for our number of variables because otherwise it
+    //       would include the VOI, which we don't want...
+
+    DataStore::DataStoreImportData *res = nullptr;
+    QFile file(pFileName);
+
+    if (file.open(QIODevice::ReadOnly)) {
+        BinaryDataStoreColumns columns;
+
+        if (readColumns(file, columns)) {
+            columns = importColumns(columns);
+
+            if (!columns.isEmpty()) {
+                res = new DataStore::DataStoreImportData(pFileName, pImportDataStore,
+                                                         pResultsDataStore,
+                                                         columns.count()-1,
+                                                         columns.first().size,
+                                                         pRunSizes);
+            }
+        }
+
+        file.close();
+    }
+
+    // Return some information about the data we want to import
+
+    return res;
+}
+
+//==============================================================================
+
+DataStore::DataStoreExportData * BinaryDataStorePlugin::getExportData(const QString &pFileName,
+                                                                      DataStore::DataStore *pDataStore,
+                                                                      const QMap<int, QIcon> &pIcons) const
+{
+    // Ask which data should be exported, and whether it should be compressed
+
+    BinaryDataStoreDialog binaryDataStoreDialog(pDataStore, pIcons, Core::mainWindow());
+
+    if (binaryDataStoreDialog.exec() != 0) {
+        // Now that we know which data to export, we can ask for the name of the
+        // binary file where it is to be exported
+
+        QStringList binaryFilters = Core::filters(FileTypeInterfaces() << fileTypeInterface());
+        QString firstBinaryFilter = binaryFilters.first();
+        QString fileName = Core::getSaveFileName(tr("Export To Binary"),
+                                                 Core::newFileName(pFileName, tr("Data"), false, BinaryFileExtension),
+                                                 binaryFilters, &firstBinaryFilter);
+
+        if (!fileName.isEmpty()) {
+            return new BinaryDataStoreData(fileName,
+                                           binaryDataStoreDialog.isCompressed(),
+                                           pDataStore,
+                                           binaryDataStoreDialog.selectedData());
+        }
+    }
+
+    return nullptr;
+}
+
+//==============================================================================
+
+DataStore::DataStoreImporter * BinaryDataStorePlugin::dataStoreImporterInstance() const
+{
+    // Return the 'global' instance of our binary data store importer
+
+    static BinaryDataStoreImporter instance;
+
+    return static_cast<BinaryDataStoreImporter *>(Core::globalInstance("OpenCOR::BinaryDataStore::BinaryDataStoreImporter::instance()",
+                                                                       &instance));
+}
+
+//==============================================================================
+
+DataStore::DataStoreExporter * BinaryDataStorePlugin::dataStoreExporterInstance() const
+{
+    // Return the 'global' instance of our binary data store exporter
+
+    static BinaryDataStoreExporter instance;
+
+    return static_cast<BinaryDataStoreExporter *>(Core::globalInstance("OpenCOR::BinaryDataStore::BinaryDataStoreExporter::instance()",
+                                                                       &instance));
+}
+
+//==============================================================================
+// File interface
+//==============================================================================
+
+bool BinaryDataStorePlugin::isFile(const QString &pFileName) const
+{
+    // Return whether the given file is of the type that we support, i.e. it
+    // starts with our prelude and has a valid header
+
+    QFile file(pFileName);
+    bool res = false;
+
+    if (file.open(QIODevice::ReadOnly)) {
+        BinaryDataStoreColumns columns;
+
+        res = readColumns(file, columns);
+
+        file.close();
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+QString BinaryDataStorePlugin::mimeType() const
+{
+    // Return the MIME type we support
+
+    return BinaryMimeType;
+}
+
+//==============================================================================
+
+QString BinaryDataStorePlugin::fileExtension() const
+{
+    // Return the extension of the type of file we support
+
+    return BinaryFileExtension;
+}
+
+//==============================================================================
+
+QString BinaryDataStorePlugin::fileTypeDescription() const
+{
+    // Return the description of the type of file we support
+
+    return tr("Binary File");
+}
+
+//==============================================================================
+
+QStringList BinaryDataStorePlugin::fileTypeDefaultViews() const
+{
+    // Return the default views to use for the type of file we support
+
+    return {};
+}
+
+//==============================================================================
+// I18n interface
+//==============================================================================
+
+void BinaryDataStorePlugin::retranslateUi()
+{
+    // We don't handle this interface...
+    // Note: even though we don't handle this interface, we still want to
+    //       support it since some other aspects of our plugin are
+    //       multilingual...
+}
+
+//==============================================================================
+
+} // namespace BinaryDataStore
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -65,20 +65,25 @@ void BiosignalmlDataStoreImporterWorker::run()
             *(++variable) = recording->get_signal(signalUri)->read();
         }
 
-        // Add a run to our data store and store the values of our different
-        // variables to it
+        // Add the values of our different variables to our data store, a block
+        // at a time and making sure that our VOI values are added last (see
+        // DataStore::addValues())
+        // Note: we add our values in blocks, rather than all at once, so that
+        //       we can keep people informed of our progress...
 
-        DataStore::DataStore *importDataStore = mImportData->importDataStore();
-        double *importValues = mImportData->importValues();
+        DataStore::DataStoreVariable *importVoi = mImportData->importDataStore()->voi();
+        DataStore::DataStoreVariables importVariables = mImportData->importVariables();
+
+        for (quint64 i = 0, iMax = mImportData->nbOfDataPoints(); i < iMax; i += BlockSize) {
+            quint64 blockSize = qMin(iMax-i, quint64(BlockSize));
 
-        for (quint64 i = 0, iMax = mImportData->nbOfDataPoints(); i < iMax; ++i) {
             for (int j = 0; j < nbOfVariables; ++j) {
-                importValues[j] = variables[j]->data()[i];
+                importVariables[j]->addValues(variables[j]->data().data()+i, blockSize);
             }
 
-            importDataStore->addValues(clockTicks[i]);
+            importVoi->addValues(clockTicks.data()+i, blockSize);
 
-            emit progress(mImportData, mImportData->progress());
+            updateProgress(blockSize);
         }
 
         delete[] variables;
@@ -41,6 +41,11 @@ class BiosignalmlDataStoreImporterWorker : public DataStore::DataStoreImporterWo
 public:
     explicit BiosignalmlDataStoreImporterWorker(DataStore::DataStoreImportData *pImportData);
 
+private:
+    enum {
+        BlockSize = 1 << 20
+    };
+
 public slots:
     void run() override;
 };
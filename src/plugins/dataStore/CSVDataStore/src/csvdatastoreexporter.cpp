@@ -27,7 +27,7 @@ along with this program. If not, see <https://gnu.org/licenses>.
 //==============================================================================
 
 #include <QDir>
-#include <QSet>
+#include <QLocale>
 
 //==============================================================================
 
@@ -52,7 +52,8 @@ void CsvDataStoreExporterWorker::run()
     //       amounts of data to export, this can crash OpenCOR if we really have
     //       a lot of data to write. So, instead, we do what Core::writeFile()
     //       does, but rather than writing one potentially humongous string, we
-    //       first write our header and then our data, one row at a time...
+    //       first write our header and then our data, one block of rows at a
+    //       time...
 
     QFile file(Core::temporaryFileName());
     QString errorMessage;
@@ -67,60 +68,28 @@ void CsvDataStoreExporterWorker::run()
 
         variables.removeOne(voi);
 
-        // Retrieve the different values for our VOI and sets of variables
-        // Note #1: this is needed when we have two runs with different
-        //          starting/ending points and/or point intervals...
-        // Note #2: after our for loop, our list may contain duplicates and may
-        //          not be sorted. When it comes to removing duplicates, we do
-        //          this by converting our list to a set and back. Indeed, this
-        //          is much faster than preventing ourselves from adding
-        //          duplicates in the first place...
-
-        QList<DataStore::DataStoreVariables> variablesRuns;
-
-        for (int i = 0, iMax = variables.count(); i < iMax; ++i) {
-            variablesRuns << DataStore::DataStoreVariables();
-        }
+        // Determine the number of steps to export everything, i.e. one for our
+        // header and then one for each VOI value of each of our runs
+        // Note: our rows are generated by merging the (already sorted) VOI
+        //       values of our different runs, so we don't know in advance how
+        //       many rows we are going to export, but we know how many VOI
+        //       values we are going to consume...
 
         int nbOfRuns = dataStore->runsCount();
-        QList<quint64> runsIndex;
-        QDoubleList voiValues;
+        quint64 nbOfSteps = 1;
 
         for (int i = 0; i < nbOfRuns; ++i) {
-            // Original index for the current run
-
-            runsIndex << 0;
-
-            // VOI values
-
-            for (quint64 j = 0, jMax = dataStore->size(i); j < jMax; ++j) {
-                voiValues << dataStore->voi()->value(j, i);
-            }
-
-            // Variables
-
-            int j = -1;
-
-            for (auto variable : qAsConst(variables)) {
-                variablesRuns[++j] << variable;
-            }
+            nbOfSteps += dataStore->size(i);
         }
 
-        voiValues = voiValues.toSet().toList();
-
-        std::sort(voiValues.begin(), voiValues.end());
-
-        // Determine the number of steps to export everything, i.e. one for our
-        // header and then some for our number of VOI values
-
-        double oneOverNbOfSteps = 1.0/(1+voiValues.count());
-        int stepNb = 0;
+        double oneOverNbOfSteps = 1.0/double(nbOfSteps);
+        quint64 stepNb = 0;
 
         // Output our header
 
         static const QString Header = "%1 (%2)%3";
         static const QString RunNb  = " | Run #%1";
-        static const QString CrLf   = "\r\n";
+        static const QByteArray CrLf = "\r\n";
 
         QString header;
 
@@ -144,67 +113,163 @@ void CsvDataStoreExporterWorker::run()
             }
         }
 
-        header += CrLf;
-
-        bool res = file.write(header.toUtf8()) != -1;
+        bool res = file.write(header.toUtf8()+CrLf) != -1;
 
         // Output our different sets of data, one row at a time, if we were able
         // to output our header
+        // Note #1: our rows are generated by doing a k-way merge of the VOI
+        //          values of our runs (which are sorted), i.e. each row
+        //          corresponds to the smallest VOI value that has yet to be
+        //          exported and contains the data of the runs that have that
+        //          VOI value (this is needed when we have two runs with
+        //          different starting/ending points and/or point intervals)...
+        // Note #2: our rows are written to a buffer, which we write to our file
+        //          whenever it gets big, and our progress is only reported when
+        //          it has changed by at least 1%, so that our export is not
+        //          slowed down by lots of small writes and signals...
+        // Note #3: our values are written using the shortest representation
+        //          that can be read back as the same double value...
+        // Note #4: our values are read a block at a time for each run, rather
+        //          than one at a time, since reading from our data store
+        //          involves some locking...
 
         if (res) {
             emit progress(mDataStoreData, ++stepNb*oneOverNbOfSteps);
 
-            for (int i = 0, iMax = voiValues.count(); i < iMax; ++i) {
-                QString rowData;
-                double voiValue = voiValues[i];
+            static const int BufferSize = 1 << 20;
+            static const quint64 BlockSize = 256;
+
+            DataStore::DataStoreVariable *dataStoreVoi = dataStore->voi();
+            int nbOfVariables = variables.count();
+            QVector<quint64> runsIndex(nbOfRuns);
+            QVector<quint64> runsSize(nbOfRuns);
+            QVector<bool> runsMatch(nbOfRuns);
+            QVector<quint64> runsBlockStart(nbOfRuns);
+            QVector<quint64> runsBlockEnd(nbOfRuns);
+            QVector<double> voiBlocks(int(quint64(nbOfRuns)*BlockSize));
+            QVector<double> variablesBlocks(int(quint64(nbOfVariables)*quint64(nbOfRuns)*BlockSize));
+            QByteArray buffer;
+            int percentage = 0;
+
+            auto blockIndex = [&](int pBlock, int pRun) {
+                return int(quint64(pBlock)*BlockSize+runsIndex[pRun]-runsBlockStart[pRun]);
+            };
 
-                if (voi != nullptr) {
-                    rowData += QString::number(voiValue);
+            for (int i = 0; i < nbOfRuns; ++i) {
+                runsSize[i] = dataStore->size(i);
+            }
+
+            buffer.reserve(BufferSize+BufferSize/4);
+
+            forever {
+                // Read the next block of values of the runs that have consumed
+                // their current one
+
+                for (int i = 0; i < nbOfRuns; ++i) {
+                    if (   (runsIndex[i] < runsSize[i])
+                        && (runsIndex[i] >= runsBlockEnd[i])) {
+                        quint64 count = qMin(BlockSize, runsSize[i]-runsIndex[i]);
+
+                        dataStoreVoi->values(runsIndex[i], count,
+                                             voiBlocks.data()+quint64(i)*BlockSize, i);
+
+                        for (int j = 0; j < nbOfVariables; ++j) {
+                            variables[j]->values(runsIndex[i], count,
+                                                 variablesBlocks.data()+(quint64(j)*quint64(nbOfRuns)+quint64(i))*BlockSize, i);
+                        }
+
+                        runsBlockStart[i] = runsIndex[i];
+                        runsBlockEnd[i] = runsIndex[i]+count;
+                    }
                 }
 
-                bool firstRowData = true;
-                QBoolList updateRunsIndex;
+                // Determine the smallest VOI value that has yet to be exported
+
+                int voiRun = -1;
+                double voiValue = 0.0;
+
+                for (int i = 0; i < nbOfRuns; ++i) {
+                    if (runsIndex[i] < runsSize[i]) {
+                        double runVoiValue = voiBlocks[blockIndex(i, i)];
+
+                        if ((voiRun == -1) || (runVoiValue < voiValue)) {
+                            voiRun = i;
+                            voiValue = runVoiValue;
+                        }
+                    }
+                }
 
-                for (int j = 0; j < nbOfRuns; ++j) {
-                    updateRunsIndex << false;
+                if (voiRun == -1) {
+                    break;
                 }
 
-                for (const auto &variableRuns : qAsConst(variablesRuns)) {
-                    int j = 0;
+                // Determine the runs that have that VOI value
+                // Note: the run from which our VOI value comes always has it,
+                //       even if it is, say, NaN...
+
+                for (int i = 0; i < nbOfRuns; ++i) {
+                    runsMatch[i] =    (i == voiRun)
+                                   || (   (runsIndex[i] < runsSize[i])
+                                       && qFuzzyCompare(voiBlocks[blockIndex(i, i)], voiValue));
+                }
+
+                // Output our row
+
+                bool firstRowData = true;
 
-                    for (auto variableRun : variableRuns) {
-                        if (firstRowData && rowData.isEmpty()) {
+                if (voi != nullptr) {
+                    buffer += QByteArray::number(voiValue, 'g', QLocale::FloatingPointShortest);
+
+                    firstRowData = false;
+                }
+
+                for (int j = 0; j < nbOfVariables; ++j) {
+                    for (int i = 0; i < nbOfRuns; ++i) {
+                        if (firstRowData) {
                             firstRowData = false;
                         } else {
-                            rowData += ',';
+                            buffer += ',';
                         }
 
-                        if (   (runsIndex[j] < dataStore->size(j))
-                            && qFuzzyCompare(dataStore->voi()->value(runsIndex[j], j), voiValue)) {
-                            rowData += QString::number(variableRun->value(runsIndex[j], j));
-
-                            updateRunsIndex[j] = true;
+                        if (runsMatch[i]) {
+                            buffer += QByteArray::number(variablesBlocks[blockIndex(j*nbOfRuns+i, i)], 'g', QLocale::FloatingPointShortest);
                         }
+                    }
+                }
 
-                        ++j;
+                buffer += CrLf;
+
+                for (int i = 0; i < nbOfRuns; ++i) {
+                    if (runsMatch[i]) {
+                        ++runsIndex[i];
+                        ++stepNb;
                     }
                 }
 
-                for (int j = 0; j < nbOfRuns; ++j) {
-                    if (updateRunsIndex[j]) {
-                        ++runsIndex[j];
+                // Write our buffer to our file, if it has become big enough, and
+                // let people know about our progress, if needed
+
+                if (buffer.size() >= BufferSize) {
+                    res = file.write(buffer) != -1;
+
+                    if (!res) {
+                        break;
                     }
+
+                    buffer.resize(0);
                 }
 
-                rowData += CrLf;
+                int newPercentage = int(100.0*stepNb*oneOverNbOfSteps);
 
-                res = file.write(rowData.toUtf8()) != -1;
+                if (newPercentage != percentage) {
+                    percentage = newPercentage;
 
-                if (!res) {
-                    break;
+                    emit progress(mDataStoreData, stepNb*oneOverNbOfSteps);
                 }
+            }
 
-                emit progress(mDataStoreData, ++stepNb*oneOverNbOfSteps);
+            if (res && !buffer.isEmpty()) {
+                res = file.write(buffer) != -1;
             }
         }
 
@@ -26,7 +26,13 @@ along with this program. If not, see <https://gnu.org/licenses>.
 //==============================================================================
 
 #include <QFile>
-#include <QTextStream>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+#include <QtNumeric>
+
+//==============================================================================
+
+#include <cstring>
 
 //==============================================================================
 
@@ -35,6 +41,209 @@ namespace CSVDataStore {
 
 //==============================================================================
 
+static bool isSpace(char pChar)
+{
+    // Return whether the given character is a space, as far as a CSV field is
+    // concerned
+
+    return (pChar == ' ') || (pChar == '\t') || (pChar == '\r');
+}
+
+//==============================================================================
+
+static const double PowersOf10[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                     1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                     1e18, 1e19, 1e20, 1e21, 1e22 };
+
+//==============================================================================
+
+static double fieldValue(const char *pBegin, const char *pEnd)
+{
+    // Return the value of the given (trimmed) field
+    // Note #1: we parse the field ourselves, which is much faster than going
+    //          through a QString. Our result is exact as long as our mantissa
+    //          fits in a double and our exponent is small enough for its power
+    //          of 10 to also be exact (see Clinger's fast path), which is the
+    //          case for virtually all the values found in a CSV file...
+    // Note #2: if our field is not a plain decimal number (e.g. "nan" or
+    //          "inf") or if we can't guarantee that our result would be exact,
+    //          then we fall back to QByteArray::toDouble()...
+
+    static const quint64 MaximumMantissa = quint64(1) << 53;
+    static const int MaximumExponent = 22;
+    static const int MaximumDigits = 19;
+
+    const char *field = pBegin;
+    bool negative = false;
+
+    if ((field != pEnd) && ((*field == '-') || (*field == '+'))) {
+        negative = *field == '-';
+
+        ++field;
+    }
+
+    quint64 mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    bool truncated = false;
+
+    for (; (field != pEnd) && (*field >= '0') && (*field <= '9'); ++field) {
+        hasDigits = true;
+
+        if (digits < MaximumDigits) {
+            mantissa = 10*mantissa+quint64(*field-'0');
+            digits += (mantissa != 0)?1:0;
+        } else {
+            ++exponent;
+
+            truncated = truncated || (*field != '0');
+        }
+    }
+
+    if ((field != pEnd) && (*field == '.')) {
+        for (++field; (field != pEnd) && (*field >= '0') && (*field <= '9'); ++field) {
+            hasDigits = true;
+
+            if (digits < MaximumDigits) {
+                mantissa = 10*mantissa+quint64(*field-'0');
+                digits += (mantissa != 0)?1:0;
+
+                --exponent;
+            } else {
+                truncated = truncated || (*field != '0');
+            }
+        }
+    }
+
+    if (hasDigits && (field != pEnd) && ((*field == 'e') || (*field == 'E'))) {
+        const char *exponentField = field+1;
+        bool negativeExponent = false;
+
+        if ((exponentField != pEnd) && ((*exponentField == '-') || (*exponentField == '+'))) {
+            negativeExponent = *exponentField == '-';
+
+            ++exponentField;
+        }
+
+        int explicitExponent = 0;
+        bool hasExponentDigits = false;
+
+        for (; (exponentField != pEnd) && (*exponentField >= '0') && (*exponentField <= '9'); ++exponentField) {
+            hasExponentDigits = true;
+
+            if (explicitExponent < 10000) {
+                explicitExponent = 10*explicitExponent+(*exponentField-'0');
+            }
+        }
+
+        if (hasExponentDigits) {
+            field = exponentField;
+            exponent += negativeExponent?
+                            -explicitExponent:
+                            explicitExponent;
+        }
+    }
+
+    if (   hasDigits && !truncated && (field == pEnd)
+        && (mantissa <= MaximumMantissa)
+        && (exponent >= -MaximumExponent) && (exponent <= MaximumExponent)) {
+        double res = (exponent < 0)?
+                         double(mantissa)/PowersOf10[-exponent]:
+                         double(mantissa)*PowersOf10[exponent];
+
+        return negative?
+                   -res:
+                   res;
+    }
+
+    return QByteArray::fromRawData(pBegin, int(pEnd-pBegin)).toDouble();
+}
+
+//==============================================================================
+
+static CsvDataStoreImporterChunk parseChunk(const char *pBegin,
+                                            const char *pEnd,
+                                            int pNbOfColumns)
+{
+    // Determine the number of (non-empty) rows in the given chunk, so that we
+    // can allocate all the memory we need in one go
+
+    CsvDataStoreImporterChunk res;
+    bool emptyRow = true;
+
+    for (const char *character = pBegin; character != pEnd; ++character) {
+        if (*character == '\n') {
+            res.nbOfRows += emptyRow?0:1;
+
+            emptyRow = true;
+        } else if (!isSpace(*character)) {
+            emptyRow = false;
+        }
+    }
+
+    res.nbOfRows += emptyRow?0:1;
+
+    // Parse our rows and store their values column by column, so that they
+    // can then be added to our data store one column at a time
+    // Note: a missing field is given a value of NaN...
+
+    res.values.resize(int(res.nbOfRows*quint64(pNbOfColumns)));
+
+    double *values = res.values.data();
+    const char *character = pBegin;
+
+    for (quint64 row = 0; row < res.nbOfRows;) {
+        const char *rowEnd = static_cast<const char *>(memchr(character, '\n', size_t(pEnd-character)));
+
+        if (rowEnd == nullptr) {
+            rowEnd = pEnd;
+        }
+
+        while ((character != rowEnd) && isSpace(*character)) {
+            ++character;
+        }
+
+        if (character != rowEnd) {
+            for (int column = 0; column < pNbOfColumns; ++column) {
+                const char *fieldBegin = character;
+                const char *fieldEnd = static_cast<const char *>(memchr(fieldBegin, ',', size_t(rowEnd-fieldBegin)));
+
+                if (fieldEnd == nullptr) {
+                    fieldEnd = rowEnd;
+                }
+
+                character = (fieldEnd == rowEnd)?
+                                rowEnd:
+                                fieldEnd+1;
+
+                while ((fieldBegin != fieldEnd) && isSpace(*fieldBegin)) {
+                    ++fieldBegin;
+                }
+
+                while ((fieldEnd != fieldBegin) && isSpace(*(fieldEnd-1))) {
+                    --fieldEnd;
+                }
+
+                values[quint64(column)*res.nbOfRows+row] = (fieldBegin != fieldEnd)?
+                                                               fieldValue(fieldBegin, fieldEnd):
+                                                               qQNaN();
+            }
+
+            ++row;
+        }
+
+        character = (rowEnd == pEnd)?
+                        pEnd:
+                        rowEnd+1;
+    }
+
+    return res;
+}
+
+//==============================================================================
+
 CsvDataStoreImporterWorker::CsvDataStoreImporterWorker(DataStore::DataStoreImportData *pImportData) :
     DataStore::DataStoreImporterWorker(pImportData)
 {
@@ -45,30 +254,82 @@ CsvDataStoreImporterWorker::CsvDataStoreImporterWorker(DataStore::DataStoreImpor
 void CsvDataStoreImporterWorker::run()
 {
     // Import our CSV file in our data store
-    // Note: we rely on our CSV file to be well-formed...
+    // Note #1: we rely on our CSV file to be well-formed...
+    // Note #2: we map our CSV file to memory and split it into chunks that are
+    //          parsed in parallel, a few at a time (so that we don't need to
+    //          hold all of our parsed values in memory at once). The values of
+    //          a chunk are then added to our data store, one column at a time,
+    //          and in the same order as in our CSV file...
 
     QFile file(mImportData->fileName());
     QString errorMessage;
 
-    if (file.open(QIODevice::ReadOnly|QIODevice::Text)) {
-        QTextStream in(&file);
-        QString line = in.readLine(); // Header, which we ignore
-        DataStore::DataStore *importDataStore = mImportData->importDataStore();
-        double *importValues = mImportData->importValues();
+    if (file.open(QIODevice::ReadOnly)) {
+        QByteArray contents;
+        qint64 fileSize = file.size();
+        auto begin = reinterpret_cast<const char *>((fileSize != 0)?
+                                                        file.map(0, fileSize):
+                                                        nullptr);
+
+        if (begin == nullptr) {
+            contents = file.readAll();
+            begin = contents.constData();
+            fileSize = contents.size();
+        }
+
+        const char *end = begin+fileSize;
+
+        // Skip our header, which we ignore
+
+        auto chunkBegin = static_cast<const char *>(memchr(begin, '\n', size_t(fileSize)));
+
+        chunkBegin = (chunkBegin == nullptr)?
+                         end:
+                         chunkBegin+1;
+
+        // Parse our chunks and add their values to our data store
+
+        DataStore::DataStoreVariable *importVoi = mImportData->importDataStore()->voi();
+        DataStore::DataStoreVariables importVariables = mImportData->importVariables();
         int nbOfVariables = mImportData->nbOfVariables();
+        quint64 nbOfDataPoints = mImportData->nbOfDataPoints();
+        int threadsCount = qMax(1, QThread::idealThreadCount());
+
+        while ((chunkBegin != end) && (nbOfDataPoints != 0)) {
+            QList<QFuture<CsvDataStoreImporterChunk>> chunks;
 
-        for (quint64 i = 0, iMax = mImportData->nbOfDataPoints(); i < iMax; ++i) {
-            line = in.readLine().trimmed();
+            for (int i = 0; (i < threadsCount) && (chunkBegin != end); ++i) {
+                auto chunkEnd = (end-chunkBegin > ChunkSize)?
+                                    static_cast<const char *>(memchr(chunkBegin+ChunkSize, '\n', size_t(end-chunkBegin-ChunkSize))):
+                                    nullptr;
 
-            QStringList fields = line.split(",");
+                chunkEnd = (chunkEnd == nullptr)?
+                               end:
+                               chunkEnd+1;
 
-            for (int j = 0; j < nbOfVariables; ++j) {
-                importValues[j] = fields[j+1].toDouble();
+                chunks << QtConcurrent::run(parseChunk, chunkBegin, chunkEnd, nbOfVariables+1);
+
+                chunkBegin = chunkEnd;
             }
 
-            importDataStore->addValues(fields[0].toDouble());
+            for (auto &chunk : chunks) {
+                CsvDataStoreImporterChunk parsedChunk = chunk.result();
+                quint64 nbOfRows = qMin(parsedChunk.nbOfRows, nbOfDataPoints);
+                const double *values = parsedChunk.values.constData();
+
+                // Add our values to our data store, making sure that our VOI
+                // values are added last (see DataStore::addValues())
+
+                for (int j = 0; j < nbOfVariables; ++j) {
+                    importVariables[j]->addValues(values+quint64(j+1)*parsedChunk.nbOfRows, nbOfRows);
+                }
 
-            emit progress(mImportData, mImportData->progress());
+                importVoi->addValues(values, nbOfRows);
+
+                nbOfDataPoints -= nbOfRows;
+
+                updateProgress(nbOfRows);
+            }
         }
 
         file.close();
@@ -34,6 +34,14 @@ namespace CSVDataStore {
 
 //==============================================================================
 
+struct CsvDataStoreImporterChunk
+{
+    quint64 nbOfRows = 0;
+    QVector<double> values;
+};
+
+//==============================================================================
+
 class CsvDataStoreImporterWorker : public DataStore::DataStoreImporterWorker
 {
     Q_OBJECT
@@ -41,6 +49,11 @@ class CsvDataStoreImporterWorker : public DataStore::DataStoreImporterWorker
 public:
     explicit CsvDataStoreImporterWorker(DataStore::DataStoreImportData *pImportData);
 
+private:
+    enum {
+        ChunkSize = 1 << 24
+    };
+
 public slots:
     void run() override;
 };
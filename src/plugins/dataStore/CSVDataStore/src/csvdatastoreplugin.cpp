@@ -88,30 +88,54 @@ DataStore::DataStoreImportData * CSVDataStorePlugin::getImportData(const QString
     DataStore::DataStoreImportData *res = nullptr;
     QFile file(pFileName);
 
-    if (file.open(QIODevice::ReadOnly|QIODevice::Text)) {
+    if (file.open(QIODevice::ReadOnly)) {
+        // Map our CSV file to memory, if possible, so that we can quickly go
+        // through it (rather than through a QTextStream, which would be very
+        // slow for a big CSV file)
+
+        QByteArray contents;
+        qint64 fileSize = file.size();
+        auto begin = reinterpret_cast<const char *>((fileSize != 0)?
+                                                        file.map(0, fileSize):
+                                                        nullptr);
+
+        if (begin == nullptr) {
+            contents = file.readAll();
+            begin = contents.constData();
+            fileSize = contents.size();
+        }
+
+        const char *end = begin+fileSize;
+
         // Determine our number of variables and data points
         // Note #1: we subtract 1 for our number of variables because otherwise
         //          it would include the VOI, which we don't want...
         // Note #2: nbOfDataPoints starts at -1 because we are going to count
         //          the header of our CSV file...
 
-        QTextStream in(&file);
-        QString line;
         auto nbOfDataPoints = quint64(-1);
+        bool emptyLine = true;
 
-        while (!in.atEnd()) {
-            line = in.readLine().trimmed();
+        for (const char *character = begin; character != end; ++character) {
+            if (*character == '\n') {
+                nbOfDataPoints += emptyLine?0:1;
 
-            if (!line.isEmpty()) {
-                ++nbOfDataPoints;
+                emptyLine = true;
+            } else if ((*character != ' ') && (*character != '\t') && (*character != '\r')) {
+                emptyLine = false;
             }
         }
 
-        in.seek(0);
+        nbOfDataPoints += emptyLine?0:1;
+
+        auto headerEnd = static_cast<const char *>(memchr(begin, '\n', size_t(fileSize)));
+        QString header = QString::fromUtf8(begin, int(((headerEnd != nullptr)?
+                                                           headerEnd:
+                                                           end)-begin)).trimmed();
 
         res = new DataStore::DataStoreImportData(pFileName, pImportDataStore,
                                                  pResultsDataStore,
-                                                 in.readLine().trimmed().split(",").count()-1,
+                                                 header.split(",").count()-1,
                                                  nbOfDataPoints, pRunSizes);
 
         file.close();
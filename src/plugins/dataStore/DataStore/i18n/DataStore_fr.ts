@@ -25,6 +25,10 @@
 </context>
 <context>
     <name>QObject</name>
+    <message>
+        <source>The data store could not be opened.</source>
+        <translation>Le magasin de données n&apos;a pas pu être ouvert.</translation>
+    </message>
     <message>
         <source>invalid value.</source>
         <translation>valeur invalide.</translation>
@@ -320,12 +320,55 @@ static PyTypeObject DataStoreValuesDict_Type = {
 
 //==============================================================================
 
+static PyObject * openDataStore(PyObject *pSelf, PyObject *pArgs)
+{
+    Q_UNUSED(pSelf)
+
+    // Retrieve the name of the data store file to open
+
+    PyObject *bytes;
+
+    if (PyArg_ParseTuple(pArgs, "O&", PyUnicode_FSConverter, &bytes) == 0) { // NOLINT(cppcoreguidelines-pro-type-vararg)
+#include "pythonbegin.h"
+        Py_RETURN_NONE;
+#include "pythonend.h"
+    }
+
+    char *string;
+    Py_ssize_t len;
+
+    PyBytes_AsStringAndSize(bytes, &string, &len);
+
+    QString fileName = QString::fromUtf8(string, int(len));
+
+#include "pythonbegin.h"
+    Py_DECREF(bytes);
+#include "pythonend.h"
+
+    // Open the data store and return it as a Python object, which Python is
+    // to own
+
+    DataStore *dataStore = DataStore::load(fileName);
+
+    if (dataStore == nullptr) {
+        PyErr_SetString(PyExc_IOError, qPrintable(QObject::tr("The data store could not be opened.")));
+
+        return nullptr;
+    }
+
+    PyObject *res = PythonQtSupport::wrapQObject(dataStore);
+
+    PythonQtSupport::getInstanceWrapper(res)->passOwnershipToPython();
+
+    return res;
+}
+
+//==============================================================================
+
 DataStorePythonWrapper::DataStorePythonWrapper(void *pModule,
                                                QObject *pParent) :
     QObject(pParent)
 {
-    Q_UNUSED(pModule)
-
     // Initialise NumPy
 
     if (OpenCOR_Python_Wrapper_PyArray_API == nullptr) {
@@ -351,6 +394,16 @@ DataStorePythonWrapper::DataStorePythonWrapper(void *pModule,
     PythonQtSupport::registerClass(&DataStoreVariable::staticMetaObject);
 
     PythonQtSupport::addInstanceDecorators(this);
+
+    // Add some Python wrappers
+
+    static std::array<PyMethodDef, 2> PythonDataStoreMethods = {{
+                                                                   { "open_data_store", openDataStore, METH_VARARGS, "Open a data store." },
+                                                                   { nullptr, nullptr, 0, nullptr }
+                                                               }};
+
+    PyModule_AddFunctions(static_cast<PyObject *>(pModule),
+                          PythonDataStoreMethods.data());
 }
 
 //==============================================================================
@@ -415,6 +468,17 @@ PyObject * DataStorePythonWrapper::voi_and_variables(DataStore *pDataStore)
 
 //==============================================================================
 
+bool DataStorePythonWrapper::save(DataStore *pDataStore,
+                                  const QString &pFileName) const
+{
+    // Save the given data store to the given file, so that it can be reopened
+    // later using open_data_store()
+
+    return pDataStore->save(pFileName);
+}
+
+//==============================================================================
+
 double DataStorePythonWrapper::value(DataStoreVariable *pDataStoreVariable,
                                      quint64 pPosition, int pRun) const
 {
@@ -422,7 +486,7 @@ double DataStorePythonWrapper::value(DataStoreVariable *pDataStoreVariable,
     // and for the given run
 
     if (   (pDataStoreVariable != nullptr)
-        && (pDataStoreVariable->array() != nullptr)) {
+        && (pDataStoreVariable->runsCount() != 0)) {
         return pDataStoreVariable->value(pPosition, pRun);
     }
 
@@ -436,10 +500,12 @@ PyObject * DataStorePythonWrapper::values(DataStoreVariable *pDataStoreVariable,
 {
     // Create and return a NumPy array for the given data store variable and run
 
-    DataStoreArray *dataStoreArray = pDataStoreVariable->array(pRun);
+    DataStoreArray *dataStoreArray = (pDataStoreVariable != nullptr)?
+                                         pDataStoreVariable->array(pRun):
+                                         nullptr;
 
-    if ((pDataStoreVariable != nullptr) && (dataStoreArray != nullptr)) {
-        auto numPyArray = new NumPyPythonWrapper(dataStoreArray, pDataStoreVariable->size());
+    if (dataStoreArray != nullptr) {
+        auto numPyArray = new NumPyPythonWrapper(dataStoreArray, pDataStoreVariable->size(pRun));
 
         return numPyArray->numPyArray();
     }
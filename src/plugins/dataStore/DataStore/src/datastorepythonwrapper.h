@@ -61,6 +61,9 @@ public slots:
     PyObject * variables(OpenCOR::DataStore::DataStore *pDataStore);
     PyObject * voi_and_variables(OpenCOR::DataStore::DataStore *pDataStore);
 
+    bool save(OpenCOR::DataStore::DataStore *pDataStore,
+              const QString &pFileName) const;
+
     double value(OpenCOR::DataStore::DataStoreVariable *pDataStoreVariable,
                  quint64 pPosition, int pRun = -1) const;
     PyObject * values(OpenCOR::DataStore::DataStoreVariable *pDataStoreVariable,
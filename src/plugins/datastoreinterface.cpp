@@ -26,10 +26,17 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 //==============================================================================
 
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QTemporaryFile>
 #include <QThread>
 
 //==============================================================================
 
+#include <algorithm>
+
+//==============================================================================
+
 namespace OpenCOR {
 
 //==============================================================================
@@ -38,7 +45,7 @@ extern "C" Q_DECL_EXPORT int dataStoreInterfaceVersion()
 {
     // Version of the data store interface
 
-    return 5;
+    return 7;
 }
 
 //==============================================================================
@@ -47,6 +54,382 @@ namespace DataStore {
 
 //==============================================================================
 
+static QMutex chunkPoolMutex;
+static QVector<double *> chunkPool;
+
+//==============================================================================
+
+double * DataStoreChunkPool::chunk()
+{
+    // Return a chunk from our pool, if any, or a new one otherwise, or nullptr
+    // if we couldn't allocate one
+
+    {
+        QMutexLocker locker(&chunkPoolMutex);
+
+        if (!chunkPool.isEmpty()) {
+            return chunkPool.takeLast();
+        }
+    }
+
+    try {
+        return new double[DataStoreChunkSize];
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+//==============================================================================
+
+void DataStoreChunkPool::release(double *pChunk)
+{
+    // Give the given chunk back to our pool, unless it is full, in which case
+    // we delete it
+
+    {
+        QMutexLocker locker(&chunkPoolMutex);
+
+        if (chunkPool.count() < DataStoreChunkPoolSize) {
+            chunkPool << pChunk;
+
+            return;
+        }
+    }
+
+    delete[] pChunk;
+}
+
+//==============================================================================
+
+static quint64 columnSize(quint64 pSize)
+{
+    // Return the size, in bytes, of a column that can hold the given number of
+    // values, making sure that it is properly aligned for memory mapping
+
+    return (qMax(pSize, quint64(1))*Solver::SizeOfDouble+DataStoreFileAlignment-1)/DataStoreFileAlignment*DataStoreFileAlignment;
+}
+
+//==============================================================================
+
+DataStoreFile::DataStoreFile(const QString &pFileName) :
+    mFile(pFileName.isEmpty()?
+              new QTemporaryFile():
+              new QFile(pFileName))
+{
+}
+
+//==============================================================================
+
+DataStoreFile::~DataStoreFile()
+{
+    // Delete some internal objects
+    // Note: deleting our file will close it and therefore unmap all of our
+    //       columns...
+
+    if (mNextFile != nullptr) {
+        mNextFile->release();
+    }
+
+    delete mFile;
+}
+
+//==============================================================================
+
+QString DataStoreFile::fileName() const
+{
+    // Return our file name
+
+    return mFile->fileName();
+}
+
+//==============================================================================
+
+bool DataStoreFile::writeHeader()
+{
+    // Write our header, i.e. our magic number, our version, the end of our
+    // columns, and the offset and size of our index (or zeros if our index is
+    // not up-to-date)
+
+    QByteArray header;
+    QDataStream stream(&header, QIODevice::WriteOnly);
+
+    stream << quint32(DataStoreFileMagic) << quint32(DataStoreFileVersion)
+           << mSize << mIndexOffset << mIndexSize;
+
+    return    mFile->seek(0)
+           && (mFile->write(header) == header.size());
+}
+
+//==============================================================================
+
+bool DataStoreFile::create(quint64 pCapacity)
+{
+    // Create our file, i.e. a file with just a header and room for columns
+    // that can hold the given number of bytes
+    // Note #1: our header is padded so that our columns are properly aligned
+    //          for memory mapping...
+    // Note #2: this is the only time we resize our file since a file cannot be
+    //          resized while some of it is mapped to memory on Windows. This
+    //          doesn't actually allocate any disk space on most file systems,
+    //          so we only use disk space for the values that actually get
+    //          written...
+
+    auto temporaryFile = qobject_cast<QTemporaryFile *>(mFile);
+
+    mCapacity = DataStoreFileAlignment+(pCapacity+DataStoreFileAlignment-1)/DataStoreFileAlignment*DataStoreFileAlignment;
+
+    if (   !((temporaryFile != nullptr)?
+                 temporaryFile->open():
+                 mFile->open(QIODevice::ReadWrite|QIODevice::Truncate))
+        || !mFile->resize(qint64(mCapacity))) {
+        return false;
+    }
+
+    return writeHeader();
+}
+
+//==============================================================================
+
+bool DataStoreFile::open()
+{
+    // Open our file, for reading only, and check its header
+
+    if (!mFile->open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(mFile);
+    quint32 magic;
+    quint32 version;
+
+    stream >> magic >> version >> mSize >> mIndexOffset >> mIndexSize;
+
+    mCapacity = mSize;
+
+    return    (stream.status() == QDataStream::Ok)
+           && (magic == DataStoreFileMagic) && (version == DataStoreFileVersion)
+           && (mIndexOffset != 0);
+}
+
+//==============================================================================
+
+bool DataStoreFile::isReadOnly() const
+{
+    // Return whether we are read-only
+
+    return !mFile->isWritable();
+}
+
+//==============================================================================
+
+double * DataStoreFile::column(quint64 pSize)
+{
+    // Add a column that can hold the given number of values to the end of our
+    // columns and map it to memory, or get our next file to do it if we don't
+    // have enough room left for it
+    // Note #1: our index, if any, is located after our columns, so it will
+    //          become invalid as soon as we add a column...
+    // Note #2: our next file has room for at least twice as many columns as
+    //          we do, so that we don't end up with too many files...
+
+    QMutexLocker locker(&mMutex);
+
+    if (isReadOnly()) {
+        return nullptr;
+    }
+
+    quint64 size = columnSize(pSize);
+
+    if (mSize+size > mCapacity) {
+        if (mNextFile == nullptr) {
+            mNextFile = new DataStoreFile();
+
+            if (!mNextFile->create(qMax(2*mCapacity, size))) {
+                mNextFile->release();
+
+                mNextFile = nullptr;
+
+                return nullptr;
+            }
+        }
+
+        return mNextFile->column(pSize);
+    }
+
+    if (mIndexOffset != 0) {
+        mIndexOffset = 0;
+        mIndexSize = 0;
+
+        if (!writeHeader()) {
+            return nullptr;
+        }
+    }
+
+    auto res = reinterpret_cast<double *>(mFile->map(qint64(mSize), qint64(size)));
+
+    if (res == nullptr) {
+        return nullptr;
+    }
+
+    mOffsets.insert(res, mSize);
+
+    mSize += size;
+
+    return res;
+}
+
+//==============================================================================
+
+double * DataStoreFile::column(quint64 pOffset, quint64 pSize)
+{
+    // Map the existing column at the given offset to memory
+
+    QMutexLocker locker(&mMutex);
+
+    quint64 size = columnSize(pSize);
+
+    if (   (pOffset < DataStoreFileAlignment) || (pOffset+size > mSize)
+        || ((pOffset % DataStoreFileAlignment) != 0)) {
+        return nullptr;
+    }
+
+    auto res = reinterpret_cast<double *>(mFile->map(qint64(pOffset), qint64(size)));
+
+    if (res != nullptr) {
+        mOffsets.insert(res, pOffset);
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+quint64 DataStoreFile::appendColumn(quint64 pSize)
+{
+    // Append a column that can hold the given number of values to the end of
+    // our file, without mapping it to memory, and return its offset (or zero
+    // if we couldn't append it)
+    // Note: our file gets extended as values (and our index) get written to
+    //       it (see write() and setIndex()), so we don't need to resize it...
+
+    QMutexLocker locker(&mMutex);
+
+    if (isReadOnly()) {
+        return 0;
+    }
+
+    quint64 res = mCapacity;
+
+    mSize = mCapacity = res+columnSize(pSize);
+
+    if (mIndexOffset != 0) {
+        mIndexOffset = 0;
+        mIndexSize = 0;
+
+        if (!writeHeader()) {
+            return 0;
+        }
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+bool DataStoreFile::write(quint64 pOffset, const double *pValues,
+                          quint64 pCount)
+{
+    // Write the given values at the given offset
+
+    QMutexLocker locker(&mMutex);
+
+    qint64 size = qint64(pCount*Solver::SizeOfDouble);
+
+    return    mFile->seek(qint64(pOffset))
+           && (mFile->write(reinterpret_cast<const char *>(pValues), size) == size);
+}
+
+//==============================================================================
+
+quint64 DataStoreFile::offset(const double *pColumn)
+{
+    // Return the offset of the given column, or zero if it is not one of ours
+
+    QMutexLocker locker(&mMutex);
+
+    return mOffsets.value(pColumn);
+}
+
+//==============================================================================
+
+QByteArray DataStoreFile::index()
+{
+    // Return our index, if it is up-to-date
+
+    QMutexLocker locker(&mMutex);
+
+    if ((mIndexOffset == 0) || !mFile->seek(qint64(mIndexOffset))) {
+        return {};
+    }
+
+    return mFile->read(qint64(mIndexSize));
+}
+
+//==============================================================================
+
+bool DataStoreFile::setIndex(const QByteArray &pIndex)
+{
+    // Write the given index after our columns and update our header
+    // accordingly
+    // Note: we don't truncate our file after our index since some of our file
+    //       may be mapped to memory (see create()), hence we keep track of the
+    //       size of our index...
+
+    QMutexLocker locker(&mMutex);
+
+    if (   !mFile->seek(qint64(mSize))
+        || (mFile->write(pIndex) != pIndex.size())) {
+        return false;
+    }
+
+    mIndexOffset = mSize;
+    mIndexSize = quint64(pIndex.size());
+
+    return writeHeader() && mFile->flush();
+}
+
+//==============================================================================
+
+void DataStoreFile::hold()
+{
+    // Increment our reference counter
+
+    QMutexLocker locker(&mMutex);
+
+    ++mReferenceCounter;
+}
+
+//==============================================================================
+
+void DataStoreFile::release()
+{
+    // Decrement our reference counter, and delete ourselves, if needed
+
+    bool deleteFile;
+
+    {
+        QMutexLocker locker(&mMutex);
+
+        deleteFile = (--mReferenceCounter == 0);
+    }
+
+    if (deleteFile) {
+        delete this;
+    }
+}
+
+//==============================================================================
+
 DataStoreArray::DataStoreArray(quint64 pSize) :
     mSize(pSize)
 {
@@ -57,6 +440,21 @@ DataStoreArray::DataStoreArray(quint64 pSize) :
 
 //==============================================================================
 
+DataStoreArray::DataStoreArray(quint64 pSize, double *pData,
+                               DataStoreFile *pFile) :
+    mSize(pSize),
+    mData(pData),
+    mFile(pFile)
+{
+    // Use the given data, which is a column of the given file, so make sure
+    // that the file doesn't get deleted (and our data unmapped) while we are
+    // still around
+
+    mFile->hold();
+}
+
+//==============================================================================
+
 quint64 DataStoreArray::size() const
 {
     // Return our size
@@ -112,7 +510,11 @@ void DataStoreArray::release()
     // needed
 
     if (--mReferenceCounter == 0) {
-        delete[] mData;
+        if (mFile != nullptr) {
+            mFile->release();
+        } else {
+            delete[] mData;
+        }
 
         delete this;
     }
@@ -162,121 +564,613 @@ void DataStoreValue::setValue(double pValue)
 {
     // Set our value
 
-    if (mValue != nullptr) {
-        *mValue = pValue;
+    if (mValue != nullptr) {
+        *mValue = pValue;
+    }
+}
+
+//==============================================================================
+
+DataStoreValues::DataStoreValues(DataStoreArray *pDataStoreArray)
+{
+    // Create a list of DataStoreValue objects
+
+    double *data = pDataStoreArray->data();
+
+    for (quint64 i = 0, iMax = pDataStoreArray->size(); i < iMax; ++i) {
+        *this << new DataStoreValue(data);
+
+        ++data;
+    }
+}
+
+//==============================================================================
+
+DataStoreValues::~DataStoreValues()
+{
+    // Delete our DataStoreValue objects
+
+    for (auto dataStoreValue : qAsConst(*this)) {
+        delete dataStoreValue;
+    }
+
+    clear();
+}
+
+//==============================================================================
+
+DataStoreVariableRun::DataStoreVariableRun(quint64 pCapacity, double *pValue,
+                                           bool pConstant,
+                                           DataStoreFile *pFile) :
+    mCapacity(pCapacity),
+    mConstant(pConstant),
+    mFile(pConstant?nullptr:pFile),
+    mValue(pValue)
+{
+    // Map a column of our file to memory, if we have a file, so that our
+    // values can be stored in it, and make sure that our file doesn't get
+    // deleted while we are still around
+    // Note: our constant values are few and far between, so we always keep
+    //       them in memory...
+
+    if (mFile != nullptr) {
+        if ((mCapacity != 0) && !addColumn()) {
+            throw std::exception();
+        }
+
+        mFile->hold();
+
+        return;
+    }
+
+    // Reserve enough room for the chunks that we expect to need
+    // Note: our capacity is only a hint, i.e. our values are stored in chunks
+    //       that are allocated on demand (so that a long simulation doesn't
+    //       have to reserve all of its memory upfront and so that we can keep
+    //       adding values past our capacity, e.g. for a simulation with an
+    //       unknown number of data points). Still, reserving room for our
+    //       chunks means that, in most cases, our list of chunks won't get
+    //       reallocated while a simulation is running...
+
+    if (!mConstant) {
+        mChunks.reserve(int((mCapacity+DataStoreChunkMask) >> DataStoreChunkShift));
+    }
+}
+
+//==============================================================================
+
+DataStoreVariableRun::~DataStoreVariableRun()
+{
+    // Delete some internal objects
+
+    for (auto chunk : qAsConst(mChunks)) {
+        DataStoreChunkPool::release(chunk);
+    }
+
+    if (mArray != nullptr) {
+        mArray->release();
+    }
+
+    if (mOldArray != nullptr) {
+        mOldArray->release();
+    }
+
+    if (mFile != nullptr) {
+        mFile->release();
+    }
+}
+
+//==============================================================================
+
+quint64 DataStoreVariableRun::size() const
+{
+    // Return our size
+    // Note: our size is only updated once our new values have been stored, so
+    //       they are visible to whoever sees our new size...
+
+    return mSize.loadAcquire();
+}
+
+//==============================================================================
+
+bool DataStoreVariableRun::addChunk()
+{
+    // Add a chunk to our list of chunks and make it our current chunk
+
+    double *chunk = DataStoreChunkPool::chunk();
+
+    if (chunk == nullptr) {
+        return false;
+    }
+
+    QMutexLocker locker(&mChunksMutex);
+
+    mChunks << chunk;
+
+    mChunk = chunk;
+
+    return true;
+}
+
+//==============================================================================
+
+bool DataStoreVariableRun::addColumn()
+{
+    // Add a column to our file that is big enough to hold our capacity or,
+    // if we have already reached it, twice as many values as our current
+    // column, and make it our current column
+    // Note: our old column remains mapped to memory (until our file gets
+    //       deleted), so it can still be used by an old array of ours...
+
+    quint64 columnSize = qMax(quint64(DataStoreChunkSize),
+                              qMax(mCapacity, 2*mColumnSize));
+    double *column = mFile->column(columnSize);
+
+    if (column == nullptr) {
+        return false;
+    }
+
+    QMutexLocker locker(&mChunksMutex);
+
+    if (mColumn != nullptr) {
+        memcpy(column, mColumn, mSize.load()*Solver::SizeOfDouble);
+    }
+
+    mColumn = column;
+    mColumnSize = columnSize;
+
+    return true;
+}
+
+//==============================================================================
+
+bool DataStoreVariableRun::save(QDataStream &pStream, DataStoreFile *pFile)
+{
+    // Save ourselves to the given stream, copying our values to a column of
+    // the given file, unless they are already in it
+
+    QMutexLocker locker(&mChunksMutex);
+
+    quint64 size = mSize.loadAcquire();
+
+    pStream << size << mConstant;
+
+    if (mConstant) {
+        pStream << mConstantPositions << mConstantValues;
+
+        return true;
+    }
+
+    quint64 offset = ((mFile == pFile) && (mColumn != nullptr))?
+                         pFile->offset(mColumn):
+                         0;
+
+    if (offset != 0) {
+        pStream << offset << mColumnSize;
+
+        return true;
+    }
+
+    offset = pFile->appendColumn(size);
+
+    if (offset == 0) {
+        return false;
+    }
+
+    if (mFile != nullptr) {
+        if (!pFile->write(offset, mColumn, size)) {
+            return false;
+        }
+    } else {
+        for (quint64 i = 0; i < size; i += DataStoreChunkSize) {
+            if (!pFile->write(offset+i*Solver::SizeOfDouble, mChunks[int(i >> DataStoreChunkShift)],
+                              qMin(size-i, quint64(DataStoreChunkSize)))) {
+                return false;
+            }
+        }
+    }
+
+    pStream << offset << size;
+
+    return true;
+}
+
+//==============================================================================
+
+bool DataStoreVariableRun::load(QDataStream &pStream)
+{
+    // Load ourselves from the given stream, mapping our column, if any, to
+    // memory
+
+    quint64 size;
+
+    pStream >> size >> mConstant;
+
+    mSize.storeRelease(size);
+
+    if (mConstant) {
+        if (mFile != nullptr) {
+            mFile->release();
+
+            mFile = nullptr;
+        }
+
+        pStream >> mConstantPositions >> mConstantValues;
+
+        return    (pStream.status() == QDataStream::Ok)
+               && ((size == 0) || (   !mConstantPositions.isEmpty()
+                                    && (mConstantPositions.count() == mConstantValues.count())));
+    }
+
+    quint64 offset;
+
+    pStream >> offset >> mColumnSize;
+
+    if ((pStream.status() != QDataStream::Ok) || (size > mColumnSize)) {
+        return false;
+    }
+
+    mColumn = mFile->column(offset, mColumnSize);
+
+    // Our file is read-only (see DataStoreFile::open()), so make sure that any
+    // new value gets added to a new column (which our file won't be able to
+    // provide) rather than to our current column
+
+    if (mFile->isReadOnly()) {
+        mColumnSize = size;
+    }
+
+    mCapacity = mColumnSize;
+
+    return mColumn != nullptr;
+}
+
+//==============================================================================
+
+void DataStoreVariableRun::addValue()
+{
+    // Add the value of the variable to our current chunk, after having added a
+    // new chunk, if needed
+
+    if (mValue != nullptr) {
+        addValue(*mValue);
+    }
+}
+
+//==============================================================================
+
+void DataStoreVariableRun::addValue(double pValue)
+{
+    // Add the given value to our current chunk (or column, if we have a file),
+    // after having added a new chunk (or column), if needed, unless we are
+    // constant, in which case we only keep track of the given value if it is
+    // different from our previous one
+    // Note #1: our values are unlikely to change if we are constant, but they
+    //          might (e.g. if a constant was modified while a simulation was
+    //          paused)...
+    // Note #2: we only stop recording values if we can't allocate a new
+    //          chunk (or column)...
+    // Note #3: we are the only ones to update our size, but we publish it
+    //          only once our new value has been stored (see size())...
+
+    quint64 size = mSize.load();
+
+    if (mConstant) {
+        if (   mConstantValues.isEmpty()
+            || (   (pValue != mConstantValues.constLast())
+                && (!qIsNaN(pValue) || !qIsNaN(mConstantValues.constLast())))) {
+            QMutexLocker locker(&mChunksMutex);
+
+            mConstantPositions << size;
+            mConstantValues << pValue;
+        }
+
+        mSize.storeRelease(size+1);
+
+        return;
+    }
+
+    if (mFile != nullptr) {
+        if ((size == mColumnSize) && !addColumn()) {
+            return;
+        }
+
+        mColumn[size] = pValue;
+
+        mSize.storeRelease(size+1);
+
+        return;
+    }
+
+    quint64 position = size & DataStoreChunkMask;
+
+    if ((position == 0) && !addChunk()) {
+        return;
+    }
+
+    mChunk[position] = pValue;
+
+    mSize.storeRelease(size+1);
+}
+
+//==============================================================================
+
+void DataStoreVariableRun::addValues(const double *pValues, quint64 pCount)
+{
+    // Add the given values to our chunks (or column, if we have a file), a
+    // whole chunk (or column) at a time rather than a value at a time, unless
+    // we are constant, in which case we add them one by one since we need to
+    // check whether they differ from our previous value
+    // Note: like in addValue(), we only stop adding values if we can't
+    //       allocate a new chunk (or column)...
+
+    if (mConstant) {
+        for (quint64 i = 0; i < pCount; ++i) {
+            addValue(pValues[i]);
+        }
+
+        return;
+    }
+
+    quint64 size = mSize.load();
+
+    if (mFile != nullptr) {
+        while (size+pCount > mColumnSize) {
+            if (!addColumn()) {
+                pCount = mColumnSize-size;
+
+                break;
+            }
+        }
+
+        memcpy(mColumn+size, pValues, pCount*Solver::SizeOfDouble);
+
+        mSize.storeRelease(size+pCount);
+
+        return;
+    }
+
+    while (pCount != 0) {
+        quint64 position = size & DataStoreChunkMask;
+
+        if ((position == 0) && !addChunk()) {
+            return;
+        }
+
+        quint64 count = qMin(pCount, quint64(DataStoreChunkSize)-position);
+
+        memcpy(mChunk+position, pValues, count*Solver::SizeOfDouble);
+
+        size += count;
+
+        mSize.storeRelease(size);
+
+        pValues += count;
+        pCount -= count;
+    }
+}
+
+//==============================================================================
+
+DataStoreArray * DataStoreVariableRun::array()
+{
+    // Make sure that our array contains all of our values, reallocating it if
+    // needed, and return it
+    // Note #1: our array is a contiguous copy of our chunks that is only
+    //          created when someone needs it (e.g. to plot our values or to
+    //          access them from Python) and then updated incrementally. When we
+    //          need a bigger array, we grow it geometrically (without going
+    //          past our capacity, if we can), but keep our previous array
+    //          around since someone may still be using it (e.g. a graph that
+    //          has yet to be updated). Arrays older than that are released, so
+    //          they only get deleted once nobody holds them anymore, meaning
+    //          that whoever needs an array for longer (e.g. our Python wrapper)
+    //          must hold it...
+    // Note #2: this may be called from a thread other than the one in which our
+    //          values are added, hence we lock our chunks while we are copying
+    //          them...
+    // Note #3: if we have a file, then our values are already in a contiguous
+    //          column, so we just wrap it...
+
+    QMutexLocker locker(&mChunksMutex);
+
+    if (mFile != nullptr) {
+        if ((mColumn != nullptr) && ((mArray == nullptr) || (mArray->data() != mColumn))) {
+            DataStoreArray *array;
+
+            try {
+                array = new DataStoreArray(mColumnSize, mColumn, mFile);
+            } catch (...) {
+                return mArray;
+            }
+
+            retireArray();
+
+            mArray = array;
+        }
+
+        return mArray;
+    }
+
+    quint64 size = mSize.loadAcquire();
+
+    if ((mArray == nullptr) || (size > mArray->size())) {
+        quint64 arraySize = qMax(size, quint64(DataStoreChunkSize));
+
+        if (mArray != nullptr) {
+            arraySize = qMax(arraySize, 2*mArray->size());
+        }
+
+        if (size <= mCapacity) {
+            arraySize = qMin(arraySize, mCapacity);
+        }
+
+        DataStoreArray *array;
+
+        try {
+            array = new DataStoreArray(arraySize);
+        } catch (...) {
+            return mArray;
+        }
+
+        if (mArray != nullptr) {
+            memcpy(array->data(), mArray->data(), mArraySize*Solver::SizeOfDouble);
+        }
+
+        retireArray();
+
+        mArray = array;
     }
-}
 
-//==============================================================================
+    double *data = mArray->data();
 
-DataStoreValues::DataStoreValues(DataStoreArray *pDataStoreArray)
-{
-    // Create a list of DataStoreValue objects
+    if (mConstant) {
+        for (int i = int(std::upper_bound(mConstantPositions.constBegin(),
+                                          mConstantPositions.constEnd(),
+                                          mArraySize)-mConstantPositions.constBegin())-1,
+                 iMax = mConstantPositions.count(); mArraySize < size; ++i) {
+            quint64 end = (i+1 < iMax)?
+                              qMin(mConstantPositions[i+1], size):
+                              size;
 
-    double *data = pDataStoreArray->data();
+            std::fill(data+mArraySize, data+end, mConstantValues[i]);
 
-    for (quint64 i = 0, iMax = pDataStoreArray->size(); i < iMax; ++i) {
-        *this << new DataStoreValue(data);
+            mArraySize = end;
+        }
 
-        ++data;
+        return mArray;
     }
-}
 
-//==============================================================================
+    while (mArraySize < size) {
+        quint64 position = mArraySize & DataStoreChunkMask;
+        quint64 count = qMin(size-mArraySize, DataStoreChunkSize-position);
 
-DataStoreValues::~DataStoreValues()
-{
-    // Delete our DataStoreValue objects
+        memcpy(data+mArraySize,
+               mChunks[int(mArraySize >> DataStoreChunkShift)]+position,
+               count*Solver::SizeOfDouble);
 
-    for (auto dataStoreValue : qAsConst(*this)) {
-        delete dataStoreValue;
+        mArraySize += count;
     }
 
-    clear();
+    return mArray;
 }
 
 //==============================================================================
 
-DataStoreVariableRun::DataStoreVariableRun(quint64 pCapacity, double *pValue) :
-    mCapacity(pCapacity),
-    mValue(pValue)
+void DataStoreVariableRun::retireArray()
 {
-    // Create our array of values
+    // Our current array is about to be replaced, so release our previous one
+    // and keep track of our current one as our previous one
 
-    mArray = new DataStoreArray(mCapacity);
+    if (mOldArray != nullptr) {
+        mOldArray->release();
+    }
+
+    mOldArray = mArray;
 }
 
 //==============================================================================
 
-DataStoreVariableRun::~DataStoreVariableRun()
+double DataStoreVariableRun::value(quint64 pPosition) const
 {
-    // Delete some internal objects
+    // Return the value at the given position
+    // Note: this may be called from a thread other than the one in which our
+    //       values are added, hence we lock our chunks since our list of
+    //       chunks (or our constant values, or our column) may get reallocated
+    //       while we are reading from it...
 
-    mArray->release();
-}
+    QMutexLocker locker(&mChunksMutex);
 
-//==============================================================================
+    quint64 size = mSize.loadAcquire();
 
-quint64 DataStoreVariableRun::size() const
-{
-    // Return our size
+    if (mConstant) {
+        return (pPosition < size)?
+                   mConstantValues[int(std::upper_bound(mConstantPositions.constBegin(),
+                                                        mConstantPositions.constEnd(),
+                                                        pPosition)-mConstantPositions.constBegin())-1]:
+                   qQNaN();
+    }
 
-    return mSize;
+    if (pPosition >= size) {
+        return qQNaN();
+    }
+
+    return (mFile != nullptr)?
+               mColumn[pPosition]:
+               mChunks[int(pPosition >> DataStoreChunkShift)][pPosition & DataStoreChunkMask];
 }
 
 //==============================================================================
 
-void DataStoreVariableRun::addValue()
+quint64 DataStoreVariableRun::values(quint64 pPosition, quint64 pCount,
+                                     double *pValues) const
 {
-    // Set the value of the variable at the given position
+    // Copy (up to) the given number of values, starting at the given position,
+    // to the given buffer, and return the number of values that were copied
+    // Note: like value(), we lock our chunks, but only once for the whole
+    //       block of values, which makes this method the one to use when
+    //       reading lots of values...
+
+    QMutexLocker locker(&mChunksMutex);
 
-    if ((mSize < mCapacity) && (mValue != nullptr)) {
-        mArray->data()[mSize] = *mValue;
+    quint64 size = mSize.loadAcquire();
 
-        ++mSize;
+    if (pPosition >= size) {
+        return 0;
     }
-}
 
-//==============================================================================
+    quint64 count = qMin(pCount, size-pPosition);
+    quint64 end = pPosition+count;
 
-void DataStoreVariableRun::addValue(double pValue)
-{
-    // Set the value of the variable at the given position using the given value
+    if (mConstant) {
+        for (int i = int(std::upper_bound(mConstantPositions.constBegin(),
+                                          mConstantPositions.constEnd(),
+                                          pPosition)-mConstantPositions.constBegin())-1,
+                 iMax = mConstantPositions.count(); pPosition < end; ++i) {
+            quint64 constantEnd = (i+1 < iMax)?
+                                      qMin(mConstantPositions[i+1], end):
+                                      end;
+
+            std::fill(pValues, pValues+constantEnd-pPosition, mConstantValues[i]);
 
-    if (mSize < mCapacity) {
-        mArray->data()[mSize] = pValue;
+            pValues += constantEnd-pPosition;
+            pPosition = constantEnd;
+        }
 
-        ++mSize;
+        return count;
     }
-}
 
-//==============================================================================
+    if (mFile != nullptr) {
+        memcpy(pValues, mColumn+pPosition, count*Solver::SizeOfDouble);
 
-DataStoreArray * DataStoreVariableRun::array() const
-{
-    // Return our array
+        return count;
+    }
 
-    return mArray;
-}
+    while (pPosition < end) {
+        quint64 position = pPosition & DataStoreChunkMask;
+        quint64 chunkCount = qMin(end-pPosition, DataStoreChunkSize-position);
 
-//==============================================================================
+        memcpy(pValues, mChunks[int(pPosition >> DataStoreChunkShift)]+position,
+               chunkCount*Solver::SizeOfDouble);
 
-double DataStoreVariableRun::value(quint64 pPosition) const
-{
-    // Return the value at the given position
+        pValues += chunkCount;
+        pPosition += chunkCount;
+    }
 
-    return (pPosition < mSize)?
-               mArray->data()[pPosition]:
-               qQNaN();
+    return count;
 }
 
 //==============================================================================
 
-double * DataStoreVariableRun::values() const
+double * DataStoreVariableRun::values()
 {
-    // Return our values
+    // Return our values as a contiguous array
+
+    DataStoreArray *array = DataStoreVariableRun::array();
 
-    return mArray->data();
+    return (array != nullptr)?
+               array->data():
+               nullptr;
 }
 
 //==============================================================================
@@ -334,12 +1228,13 @@ int DataStoreVariable::runsCount() const
 
 //==============================================================================
 
-bool DataStoreVariable::addRun(quint64 pCapacity)
+bool DataStoreVariable::addRun(quint64 pCapacity, DataStoreFile *pFile)
 {
-    // Try to add a run of the given capacity
+    // Try to add a run of the given capacity, which values are to be stored in
+    // the given file, if any
 
     try {
-        mRuns << new DataStoreVariableRun(pCapacity, mValue);
+        mRuns << new DataStoreVariableRun(pCapacity, mValue, mConstant, pFile);
     } catch (...) {
         return false;
     }
@@ -362,6 +1257,50 @@ void DataStoreVariable::keepRuns(int pRunsCount)
 
 //==============================================================================
 
+bool DataStoreVariable::save(QDataStream &pStream, DataStoreFile *pFile) const
+{
+    // Save ourselves and our runs to the given stream
+
+    pStream << mType << mUri << mName << mUnit << mConstant << mRuns.count();
+
+    for (auto run : mRuns) {
+        if (!run->save(pStream, pFile)) {
+            return false;
+        }
+    }
+
+    return pStream.status() == QDataStream::Ok;
+}
+
+//==============================================================================
+
+bool DataStoreVariable::load(QDataStream &pStream, DataStoreFile *pFile)
+{
+    // Load ourselves and our runs from the given stream
+
+    int runsCount;
+
+    pStream >> mType >> mUri >> mName >> mUnit >> mConstant >> runsCount;
+
+    if (pStream.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    for (int i = 0; i < runsCount; ++i) {
+        auto run = new DataStoreVariableRun(0, mValue, false, pFile);
+
+        mRuns << run;
+
+        if (!run->load(pStream)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//==============================================================================
+
 int DataStoreVariable::type() const
 {
     // Return our type
@@ -380,6 +1319,46 @@ void DataStoreVariable::setType(int pType)
 
 //==============================================================================
 
+bool DataStoreVariable::isRecorded() const
+{
+    // Return whether we are recorded, i.e. whether our values are to be added
+    // to our runs each time our data store adds values to its runs
+
+    return mRecorded;
+}
+
+//==============================================================================
+
+void DataStoreVariable::setRecorded(bool pRecorded)
+{
+    // Set whether we are recorded
+    // Note: this only takes effect when our data store adds a run...
+
+    mRecorded = pRecorded;
+}
+
+//==============================================================================
+
+bool DataStoreVariable::isConstant() const
+{
+    // Return whether we are constant
+
+    return mConstant;
+}
+
+//==============================================================================
+
+void DataStoreVariable::setConstant(bool pConstant)
+{
+    // Set whether we are constant, i.e. whether our runs should only keep track
+    // of our value when it changes rather than at each point
+    // Note: this only affects our new runs...
+
+    mConstant = pConstant;
+}
+
+//==============================================================================
+
 QString DataStoreVariable::uri() const
 {
     // Return our URI
@@ -498,6 +1477,22 @@ void DataStoreVariable::addValue(double pValue, int pRun)
 
 //==============================================================================
 
+void DataStoreVariable::addValues(const double *pValues, quint64 pCount,
+                                  int pRun)
+{
+    // Add the given values to our current (i.e. last) run
+
+    if (!mRuns.isEmpty()) {
+        if (pRun == -1) {
+            mRuns.last()->addValues(pValues, pCount);
+        } else if ((pRun >= 0) && (pRun < mRuns.count())) {
+            mRuns[pRun]->addValues(pValues, pCount);
+        }
+    }
+}
+
+//==============================================================================
+
 double DataStoreVariable::value(quint64 pPosition, int pRun) const
 {
     // Return the value at the given position and this for the given run
@@ -517,6 +1512,28 @@ double DataStoreVariable::value(quint64 pPosition, int pRun) const
 
 //==============================================================================
 
+quint64 DataStoreVariable::values(quint64 pPosition, quint64 pCount,
+                                  double *pValues, int pRun) const
+{
+    // Copy (up to) the given number of values, starting at the given position,
+    // for the given run to the given buffer, and return the number of values
+    // that were copied
+
+    if (mRuns.isEmpty()) {
+        return 0;
+    }
+
+    if (pRun == -1) {
+        return mRuns.last()->values(pPosition, pCount, pValues);
+    }
+
+    return ((pRun >= 0) && (pRun < mRuns.count()))?
+               mRuns[pRun]->values(pPosition, pCount, pValues):
+               0;
+}
+
+//==============================================================================
+
 double * DataStoreVariable::values(int pRun) const
 {
     // Return the values for the given run, if any
@@ -758,11 +1775,14 @@ QList<quint64> DataStoreImportData::runSizes() const
 
 //==============================================================================
 
-double DataStoreImportData::progress()
+double DataStoreImportData::progress(quint64 pNbOfDataPoints)
 {
-    // Increase and return our normalised progress
+    // Increase, by the given number of data points, and return our normalised
+    // progress
 
-    return double(++mProgress)*mOneOverTotalProgress;
+    mProgress += pNbOfDataPoints;
+
+    return double(mProgress)*mOneOverTotalProgress;
 }
 
 //==============================================================================
@@ -806,12 +1826,169 @@ DataStore::DataStore(const QString &pUri) :
 DataStore::~DataStore()
 {
     // Delete some internal objects
-
     delete mVoi;
 
     for (auto variable : qAsConst(mVariables)) {
         delete variable;
     }
+
+    if (mFile != nullptr) {
+        mFile->release();
+    }
+}
+
+//==============================================================================
+
+DataStore * DataStore::load(const QString &pFileName)
+{
+    // Load a data store from the given file, mapping the values of its runs to
+    // memory rather than reading them, so that they only get paged in when
+    // they are actually needed
+
+    auto file = new DataStoreFile(pFileName);
+
+    if (!file->open()) {
+        file->release();
+
+        return nullptr;
+    }
+
+    QByteArray index = file->index();
+    QDataStream stream(index);
+    QString uri;
+    int variablesCount;
+
+    stream.setVersion(QDataStream::Qt_5_12);
+
+    stream >> uri >> variablesCount;
+
+    auto res = new DataStore(uri);
+
+    res->mFile = file;
+
+    bool loaded = (stream.status() == QDataStream::Ok) && res->mVoi->load(stream, file);
+
+    for (int i = 0; loaded && (i < variablesCount); ++i) {
+        auto variable = new DataStoreVariable();
+
+        res->mVariables << variable;
+
+        loaded = variable->load(stream, file);
+    }
+
+    if (!loaded) {
+        delete res;
+
+        return nullptr;
+    }
+
+    res->updateRecordedVariables();
+
+    return res;
+}
+
+//==============================================================================
+
+bool DataStore::save(const QString &pFileName)
+{
+    // Save ourselves to the given file, i.e. a file with one column per
+    // variable per run, followed by an index that describes our variables and
+    // their runs
+    // Note #1: if we are already mapped to the given file, then we only need
+    //          to (re)write our index...
+    // Note #2: if we were loaded from the given file, then we can't write to it
+    //          and we mustn't truncate it (since our runs are mapped to it), so
+    //          we save ourselves to a new file that then replaces it...
+
+    DataStoreFile *file;
+    bool sameFile =    (mFile != nullptr)
+                    && (QFileInfo(mFile->fileName()).absoluteFilePath() == QFileInfo(pFileName).absoluteFilePath());
+    QString fileName = (sameFile && mFile->isReadOnly())?
+                           pFileName+".new":
+                           pFileName;
+
+    if (sameFile && !mFile->isReadOnly()) {
+        file = mFile;
+
+        file->hold();
+    } else {
+        file = new DataStoreFile(fileName);
+
+        if (!file->create()) {
+            file->release();
+
+            return false;
+        }
+    }
+
+    QByteArray index;
+    QDataStream stream(&index, QIODevice::WriteOnly);
+
+    stream.setVersion(QDataStream::Qt_5_12);
+
+    stream << mUri << mVariables.count();
+
+    bool res = mVoi->save(stream, file);
+
+    for (int i = 0, iMax = mVariables.count(); res && (i < iMax); ++i) {
+        res = mVariables[i]->save(stream, file);
+    }
+
+    res = res && file->setIndex(index);
+
+    file->release();
+
+    if (fileName != pFileName) {
+        res =    res && QFile::remove(pFileName)
+              && QFile::rename(fileName, pFileName);
+
+        if (!res) {
+            QFile::remove(fileName);
+        }
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+QString DataStore::fileName() const
+{
+    // Return the name of the file to which we are mapped, if any
+
+    return (mFile != nullptr)?
+                mFile->fileName():
+                QString();
+}
+
+//==============================================================================
+
+bool DataStore::mapToFile(const QString &pFileName, quint64 pCapacity)
+{
+    // Map our new runs to the given file or to a temporary file, if no file
+    // name is given, so that their values get written to disk rather than kept
+    // in memory
+    // Note: the given capacity is the number of bytes that we expect our new
+    //       runs to need. Our file can't be resized once some of it has been
+    //       mapped to memory, so if our new runs need more than that then their
+    //       values will end up in another (temporary) file (see
+    //       DataStoreFile::column())...
+
+    auto file = new DataStoreFile(pFileName);
+
+    if (!file->create(pCapacity)) {
+        file->release();
+
+        return false;
+    }
+
+    if (mFile != nullptr) {
+        mFile->release();
+    }
+
+    mFile = file;
+
+    return true;
 }
 
 //==============================================================================
@@ -841,13 +2018,21 @@ bool DataStore::addRun(quint64 pCapacity)
 
     int oldRunsCount = mVoi->runsCount();
 
+    // Note: we can't add our new run to our file if it is read-only (i.e. if
+    //       we were loaded from it), in which case our new run is kept in
+    //       memory...
+
+    DataStoreFile *file = ((mFile != nullptr) && !mFile->isReadOnly())?
+                              mFile:
+                              nullptr;
+
     try {
-        if (!mVoi->addRun(pCapacity)) {
+        if (!mVoi->addRun(pCapacity, file)) {
             throw std::exception();
         }
 
         for (auto variable : qAsConst(mVariables)) {
-            if (!variable->addRun(pCapacity)) {
+            if (!variable->addRun(pCapacity, file)) {
                 throw std::exception();
             }
         }
@@ -855,20 +2040,33 @@ bool DataStore::addRun(quint64 pCapacity)
         // We couldn't add a run to our VOI and all our variables, so only keep
         // the number of runs we used to have
 
-        mVoi->keepRuns(oldRunsCount);
-
-        for (auto variable : qAsConst(mVariables)) {
-            variable->keepRuns(oldRunsCount);
-        }
+        keepRuns(oldRunsCount);
 
         return false;
     }
 
+    // Keep track of the variables that are to be recorded in our new run
+
+    updateRecordedVariables();
+
     return true;
 }
 
 //==============================================================================
 
+void DataStore::keepRuns(int pRunsCount)
+{
+    // Keep the given number of runs for our VOI and all our variables
+
+    mVoi->keepRuns(pRunsCount);
+
+    for (auto variable : qAsConst(mVariables)) {
+        variable->keepRuns(pRunsCount);
+    }
+}
+
+//==============================================================================
+
 quint64 DataStore::size(int pRun) const
 {
     // Return our size, i.e. the size of our VOI, for example
@@ -926,6 +2124,8 @@ DataStoreVariables DataStore::addVariables(double *pValues, int pCount)
 
     mVariables << variables;
 
+    updateRecordedVariables();
+
     return variables;
 }
 
@@ -939,6 +2139,8 @@ DataStoreVariable * DataStore::addVariable(double *pValue)
 
     mVariables << variable;
 
+    updateRecordedVariables();
+
     return variable;
 }
 
@@ -953,6 +2155,8 @@ void DataStore::removeVariables(const DataStoreVariables &pVariables)
 
         mVariables.removeOne(variable);
     }
+
+    updateRecordedVariables();
 }
 
 //==============================================================================
@@ -964,20 +2168,38 @@ void DataStore::removeVariable(DataStoreVariable *pVariable)
     delete pVariable;
 
     mVariables.removeOne(pVariable);
+
+    updateRecordedVariables();
+}
+
+//==============================================================================
+
+void DataStore::updateRecordedVariables()
+{
+    // Keep track of our variables that are recorded, so that we don't have to
+    // go through all of our variables each time we add values to our runs
+
+    mRecordedVariables.clear();
+
+    for (auto variable : qAsConst(mVariables)) {
+        if (variable->isRecorded()) {
+            mRecordedVariables << variable;
+        }
+    }
 }
 
 //==============================================================================
 
 void DataStore::addValues(double pVoiValue)
 {
-    // Set the value at the mSize position of all our variables including our
-    // VOI, which value is directly given to us
+    // Set the value at the mSize position of all our recorded variables
+    // including our VOI, which value is directly given to us
     // Note: it is very important to add the VOI value last since our size()
     //       method relies on it to determine our size. So, if we were to add
     //       the VOI value first, we might in some cases (see issue #1579 for
     //       example) end up with the wrong size...
 
-    for (auto variable : qAsConst(mVariables)) {
+    for (auto variable : qAsConst(mRecordedVariables)) {
         variable->addValue();
     }
 
@@ -993,6 +2215,23 @@ DataStoreImporterWorker::DataStoreImporterWorker(DataStoreImportData *pImportDat
 
 //==============================================================================
 
+void DataStoreImporterWorker::updateProgress(quint64 pNbOfDataPoints)
+{
+    // Update our progress by the given number of data points, but only let
+    // people know about it every so often since it would otherwise slow down
+    // our import (and the GUI) quite considerably
+
+    double newProgress = mImportData->progress(pNbOfDataPoints);
+
+    if (!mProgressTimer.isValid() || mProgressTimer.hasExpired(ProgressInterval)) {
+        mProgressTimer.start();
+
+        emit progress(mImportData, newProgress);
+    }
+}
+
+//==============================================================================
+
 void DataStoreImporter::importData(DataStoreImportData *pImportData)
 {
     // Create and move our worker to a thread
@@ -25,7 +25,14 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 //==============================================================================
 
+#include <QAtomicInteger>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMap>
+#include <QMutex>
 #include <QObject>
+#include <QVector>
 
 //==============================================================================
 
@@ -34,10 +41,87 @@ namespace DataStore {
 
 //==============================================================================
 
+enum {
+    DataStoreChunkShift = 12,
+    DataStoreChunkSize = 1 << DataStoreChunkShift,
+    DataStoreChunkMask = DataStoreChunkSize-1,
+    DataStoreChunkPoolSize = 256
+};
+
+//==============================================================================
+
+enum {
+    DataStoreFileMagic = 0x4f434453,
+    DataStoreFileVersion = 2,
+    DataStoreFileAlignment = 65536
+};
+
+//==============================================================================
+
+class DataStoreChunkPool
+{
+public:
+    static double * chunk();
+    static void release(double *pChunk);
+};
+
+//==============================================================================
+
+class DataStoreFile
+{
+public:
+    explicit DataStoreFile(const QString &pFileName = {});
+
+    QString fileName() const;
+
+    bool create(quint64 pCapacity = 0);
+    bool open();
+
+    bool isReadOnly() const;
+
+    double * column(quint64 pSize);
+    double * column(quint64 pOffset, quint64 pSize);
+
+    quint64 appendColumn(quint64 pSize);
+    bool write(quint64 pOffset, const double *pValues, quint64 pCount);
+
+    quint64 offset(const double *pColumn);
+
+    QByteArray index();
+    bool setIndex(const QByteArray &pIndex);
+
+    void hold();
+    void release();
+
+private:
+    int mReferenceCounter = 1;
+
+    QMutex mMutex;
+
+    QFile *mFile;
+
+    quint64 mSize = DataStoreFileAlignment;
+    quint64 mCapacity = DataStoreFileAlignment;
+    quint64 mIndexOffset = 0;
+    quint64 mIndexSize = 0;
+
+    QMap<const double *, quint64> mOffsets;
+
+    DataStoreFile *mNextFile = nullptr;
+
+    ~DataStoreFile();
+
+    bool writeHeader();
+};
+
+//==============================================================================
+
 class DataStoreArray
 {
 public:
     explicit DataStoreArray(quint64 pSize);
+    explicit DataStoreArray(quint64 pSize, double *pData,
+                            DataStoreFile *pFile);
 
     quint64 size() const;
 
@@ -54,6 +138,8 @@ private:
 
     quint64 mSize;
     double *mData = nullptr;
+
+    DataStoreFile *mFile = nullptr;
 };
 
 //==============================================================================
@@ -95,25 +181,52 @@ class DataStoreVariableRun : public QObject
     Q_OBJECT
 
 public:
-    explicit DataStoreVariableRun(quint64 pCapacity, double *pValue);
+    explicit DataStoreVariableRun(quint64 pCapacity, double *pValue,
+                                  bool pConstant = false,
+                                  DataStoreFile *pFile = nullptr);
     ~DataStoreVariableRun() override;
 
+    bool save(QDataStream &pStream, DataStoreFile *pFile);
+    bool load(QDataStream &pStream);
+
     quint64 size() const;
 
-    DataStoreArray * array() const;
+    DataStoreArray * array();
 
     void addValue();
     void addValue(double pValue);
+    void addValues(const double *pValues, quint64 pCount);
 
     double value(quint64 pPosition) const;
-    double * values() const;
+    quint64 values(quint64 pPosition, quint64 pCount, double *pValues) const;
+    double * values();
 
 private:
     quint64 mCapacity;
-    quint64 mSize = 0;
+    QAtomicInteger<quint64> mSize;
+
+    bool mConstant;
+    QVector<quint64> mConstantPositions;
+    QVector<double> mConstantValues;
+
+    mutable QMutex mChunksMutex;
+    QVector<double *> mChunks;
+    double *mChunk = nullptr;
+
+    DataStoreFile *mFile;
+    double *mColumn = nullptr;
+    quint64 mColumnSize = 0;
 
     DataStoreArray *mArray = nullptr;
+    DataStoreArray *mOldArray = nullptr;
+    quint64 mArraySize = 0;
+
     double *mValue;
+
+    bool addChunk();
+    bool addColumn();
+
+    void retireArray();
 };
 
 //==============================================================================
@@ -133,11 +246,20 @@ public:
     static bool compare(DataStoreVariable *pVariable1,
                         DataStoreVariable *pVariable2);
 
-    bool addRun(quint64 pCapacity);
+    bool addRun(quint64 pCapacity, DataStoreFile *pFile = nullptr);
     void keepRuns(int pRunsCount);
 
+    bool save(QDataStream &pStream, DataStoreFile *pFile) const;
+    bool load(QDataStream &pStream, DataStoreFile *pFile);
+
     void setType(int pType);
 
+    bool isRecorded() const;
+    void setRecorded(bool pRecorded);
+
+    bool isConstant() const;
+    void setConstant(bool pConstant);
+
     void setUri(const QString &pUri);
     void setName(const QString &pName);
     void setUnit(const QString &pUnit);
@@ -146,7 +268,10 @@ public:
 
     void addValue();
     void addValue(double pValue, int pRun = -1);
+    void addValues(const double *pValues, quint64 pCount, int pRun = -1);
 
+    quint64 values(quint64 pPosition, quint64 pCount, double *pValues,
+                   int pRun = -1) const;
     double * values(int pRun = -1) const;
 
 public slots:
@@ -173,6 +298,9 @@ private:
     QString mName;
     QString mUnit;
 
+    bool mRecorded = true;
+    bool mConstant = false;
+
     double *mValue;
 
     DataStoreVariableRuns mRuns;
@@ -234,7 +362,7 @@ public:
 
     QList<quint64> runSizes() const;
 
-    double progress();
+    double progress(quint64 pNbOfDataPoints = 1);
 
 private:
     bool mValid = true;
@@ -290,7 +418,14 @@ public:
     explicit DataStore(const QString &pUri = {});
     ~DataStore() override;
 
+    static DataStore * load(const QString &pFileName);
+    bool save(const QString &pFileName);
+
+    QString fileName() const;
+    bool mapToFile(const QString &pFileName = {}, quint64 pCapacity = 0);
+
     bool addRun(quint64 pCapacity);
+    void keepRuns(int pRunsCount);
 
     DataStoreVariables variables();
     DataStoreVariables voiAndVariables();
@@ -303,6 +438,8 @@ public:
 
     void addValues(double pVoiValue);
 
+    void updateRecordedVariables();
+
 public slots:
     QString uri() const;
 
@@ -317,6 +454,9 @@ private:
 
     DataStoreVariable *mVoi = nullptr;
     DataStoreVariables mVariables;
+    DataStoreVariables mRecordedVariables;
+
+    DataStoreFile *mFile = nullptr;
 };
 
 //==============================================================================
@@ -329,8 +469,17 @@ public:
     explicit DataStoreImporterWorker(DataStoreImportData *pImportData);
 
 protected:
+    enum {
+        ProgressInterval = 250
+    };
+
     DataStoreImportData *mImportData = nullptr;
 
+    void updateProgress(quint64 pNbOfDataPoints);
+
+private:
+    QElapsedTimer mProgressTimer;
+
 signals:
     void progress(DataStoreImportData *pImportData, double pProgress);
     void done(DataStoreImportData *pImportData, const QString &pErrorMessage);
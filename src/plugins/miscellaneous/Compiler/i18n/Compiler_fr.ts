@@ -43,5 +43,9 @@
         <source>the IR module could not be added to the ORC-based JIT</source>
         <translation>le module IR n&apos;a pas pu être ajouté au JIT basé sur ORC</translation>
     </message>
+    <message>
+        <source>the cached object could not be added to the ORC-based JIT</source>
+        <translation>l&apos;objet mis en cache n&apos;a pas pu être ajouté au JIT basé sur ORC</translation>
+    </message>
 </context>
 </TS>
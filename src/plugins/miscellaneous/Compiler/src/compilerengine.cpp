@@ -29,6 +29,7 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 #include "compilerengine.h"
 #include "compilermath.h"
+#include "compilerobjectcache.h"
 
 //==============================================================================
 
@@ -41,19 +42,69 @@ along with this program. If not, see <https://gnu.org/licenses>.
     #include "clang/Frontend/TextDiagnosticPrinter.h"
     #include "clang/Lex/PreprocessorOptions.h"
 
+    #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+    #include "llvm/Object/ObjectFile.h"
+    #include "llvm/Passes/PassBuilder.h"
     #include "llvm/Support/Host.h"
     #include "llvm/Support/TargetSelect.h"
-
-    #include "llvm-c/Core.h"
 #include "llvmclangend.h"
 
 //==============================================================================
 
+#include <QElapsedTimer>
+
+//==============================================================================
+
 namespace OpenCOR {
 namespace Compiler {
 
 //==============================================================================
 
+static const char *DummyFileName = "dummy.c";
+
+//==============================================================================
+
+CompilerEngineIrCompiler::CompilerEngineIrCompiler(std::unique_ptr<llvm::TargetMachine> pTargetMachine,
+                                                   llvm::ObjectCache *pObjectCache,
+                                                   qint64 &pCodeGenerationTime) :
+    llvm::orc::TMOwningSimpleCompiler(std::move(pTargetMachine), pObjectCache),
+    mCodeGenerationTime(pCodeGenerationTime)
+{
+}
+
+//==============================================================================
+
+llvm::Expected<llvm::orc::SimpleCompiler::CompileResult> CompilerEngineIrCompiler::operator()(llvm::Module &pModule)
+{
+    // Generate the object for the given module and keep track of the time it
+    // took us to do so
+    // Note: the ORC-based JIT generates an object when one of its symbols is
+    //       looked up for the first time (see CompilerEngine::function())...
+
+    QElapsedTimer timer;
+
+    timer.start();
+
+    auto res = llvm::orc::TMOwningSimpleCompiler::operator()(pModule);
+
+    mCodeGenerationTime += timer.elapsed();
+
+    return res;
+}
+
+//==============================================================================
+
+CompilerEngine::CompilerEngine() :
+    mObjectCacheDirName(CompilerObjectCache::dirName())
+{
+}
+
+//==============================================================================
+
+CompilerEngine::~CompilerEngine() = default;
+
+//==============================================================================
+
 bool CompilerEngine::hasError() const
 {
     // Return whether an error occurred
@@ -72,6 +123,74 @@ QString CompilerEngine::error() const
 
 //==============================================================================
 
+QString CompilerEngine::objectCacheDirName() const
+{
+    // Return the name of the directory where our compiled objects are cached
+
+    return mObjectCacheDirName;
+}
+
+//==============================================================================
+
+void CompilerEngine::setObjectCacheDirName(const QString &pObjectCacheDirName)
+{
+    // Set the name of the directory where our compiled objects are to be
+    // cached
+    // Note: an empty directory name means that our compiled objects are not to
+    //       be cached...
+
+    mObjectCacheDirName = pObjectCacheDirName;
+}
+
+//==============================================================================
+
+bool CompilerEngine::hasCachedObject(const QString &pCode, bool pOptimize) const
+{
+    // Return whether we have a cached object for the given code, i.e. whether
+    // compiling it would be (almost) instantaneous
+
+    return CompilerObjectCache(mObjectCacheDirName).hasObject(CompilerObjectCache::key(fullCode(pCode),
+                                                                                       compilationArguments(pOptimize)));
+}
+
+//==============================================================================
+
+qint64 CompilerEngine::parsingTime() const
+{
+    // Return the time it took to parse our code and generate its IR
+
+    return mParsingTime;
+}
+
+//==============================================================================
+
+qint64 CompilerEngine::optimizationTime() const
+{
+    // Return the time it took to optimise our IR
+
+    return mOptimizationTime;
+}
+
+//==============================================================================
+
+qint64 CompilerEngine::codeGenerationTime() const
+{
+    // Return the time it took to generate our object
+
+    return mCodeGenerationTime;
+}
+
+//==============================================================================
+
+qint64 CompilerEngine::linkingTime() const
+{
+    // Return the time it took to link our object
+
+    return mLinkingTime;
+}
+
+//==============================================================================
+
 bool CompilerEngine::addFunction(const QString &pName, void *pFunction)
 {
     // Add the given function.
@@ -89,66 +208,145 @@ bool CompilerEngine::addFunction(const QString &pName, void *pFunction)
 
 //==============================================================================
 
-bool CompilerEngine::compileCode(const QString &pCode)
+bool CompilerEngine::compileCode(const QString &pCode, bool pOptimize)
 {
     // Reset ourselves
 
     mError = QString();
 
-    // Prepend all the external functions that may, or not, be needed by the
-    // given code
+    mParsingTime = 0;
+    mOptimizationTime = 0;
+    mCodeGenerationTime = 0;
+    mLinkingTime = 0;
 
-    QString code =  R"(
-extern double fabs(double);
+    // Determine whether our code is really to be optimised
+    // Note: in debug mode, we always want to be able to debug our code...
 
-extern double log(double);
-extern double exp(double);
+#ifdef QT_DEBUG
+    Q_UNUSED(pOptimize)
 
-extern double floor(double);
-extern double ceil(double);
+    bool optimize = false;
+#else
+    bool optimize = pOptimize;
+#endif
 
-extern double factorial(double);
+    // Determine the code and arguments with which it is to be compiled and,
+    // from there, the key of the object that would result from compiling it
 
-extern double sin(double);
-extern double sinh(double);
-extern double asin(double);
-extern double asinh(double);
+    QString code = fullCode(pCode);
+    std::vector<const char *> compilationArguments = CompilerEngine::compilationArguments(optimize);
+    QString objectKey = CompilerObjectCache::key(code, compilationArguments);
 
-extern double cos(double);
-extern double cosh(double);
-extern double acos(double);
-extern double acosh(double);
+    // Initialise the native target (and its ASM printer), so not only can we
+    // then create an execution engine, but more importantly its data layout
+    // will match that of our target platform
+    // Note: we may be compiling code from different threads (see
+    //       CellmlFileRuntime::update()), hence we make sure that the native
+    //       target gets initialised only once...
 
-extern double tan(double);
-extern double tanh(double);
-extern double atan(double);
-extern double atanh(double);
+    static const bool NativeTargetInitialized = !llvm::InitializeNativeTarget()
+                                                && !llvm::InitializeNativeTargetAsmPrinter();
 
-extern double sec(double);
-extern double sech(double);
-extern double asec(double);
-extern double asech(double);
+    Q_UNUSED(NativeTargetInitialized)
 
-extern double csc(double);
-extern double csch(double);
-extern double acsc(double);
-extern double acsch(double);
+    // Create an ORC-based JIT that caches the objects it compiles and keep
+    // track of it (so that we can use it in function())
+    // Note: we keep track of our object cache after our ORC-based JIT since
+    //       our previous ORC-based JIT, if any, uses our previous object
+    //       cache...
 
-extern double cot(double);
-extern double coth(double);
-extern double acot(double);
-extern double acoth(double);
+    auto objectCache = std::make_unique<CompilerObjectCache>(mObjectCacheDirName);
+    auto lljit = llvm::orc::LLJITBuilder().setCompileFunctionCreator([this, &objectCache, optimize](llvm::orc::JITTargetMachineBuilder pJitTargetMachineBuilder) -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+                                              pJitTargetMachineBuilder.setCodeGenOptLevel(optimize?
+                                                                                              llvm::CodeGenOpt::Aggressive:
+                                                                                              llvm::CodeGenOpt::None);
 
-extern double arbitrary_log(double, double);
+                                              auto targetMachine = pJitTargetMachineBuilder.createTargetMachine();
 
-extern double pow(double, double);
+                                              if (!targetMachine) {
+                                                  return targetMachine.takeError();
+                                              }
 
-extern double multi_min(int, ...);
-extern double multi_max(int, ...);
+                                              return std::make_unique<CompilerEngineIrCompiler>(std::move(*targetMachine), objectCache.get(),
+                                                                                                mCodeGenerationTime);
+                                          }).create();
 
-extern double gcd_multi(int, ...);
-extern double lcm_multi(int, ...);
-)"+pCode;
+    if (!lljit) {
+        mError = tr("the ORC-based JIT could not be created");
+
+        return false;
+    }
+
+    mLljit = std::move(*lljit);
+    mObjectCache = std::move(objectCache);
+
+    // Make sure that we can find various mathematical functions in the standard
+    // C library and the additional ones that we want to support (see
+    // compilermath.[cpp|h])
+
+    auto dynamicLibrarySearchGenerator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(mLljit->getDataLayout().getGlobalPrefix());
+
+    if (!dynamicLibrarySearchGenerator) {
+        mError = tr("the dynamic library search generator could not be created");
+
+        return false;
+    }
+
+    mLljit->getMainJITDylib().addGenerator(std::move(*dynamicLibrarySearchGenerator));
+
+    if (   !addFunction("factorial", reinterpret_cast<void *>(factorial))
+
+        || !addFunction("sec", reinterpret_cast<void *>(sec))
+        || !addFunction("sech", reinterpret_cast<void *>(sech))
+        || !addFunction("asec", reinterpret_cast<void *>(asec))
+        || !addFunction("asech", reinterpret_cast<void *>(asech))
+
+        || !addFunction("csc", reinterpret_cast<void *>(csc))
+        || !addFunction("csch", reinterpret_cast<void *>(csch))
+        || !addFunction("acsc", reinterpret_cast<void *>(acsc))
+        || !addFunction("acsch", reinterpret_cast<void *>(acsch))
+
+        || !addFunction("cot", reinterpret_cast<void *>(cot))
+        || !addFunction("coth", reinterpret_cast<void *>(coth))
+        || !addFunction("acot", reinterpret_cast<void *>(acot))
+        || !addFunction("acoth", reinterpret_cast<void *>(acoth))
+
+        || !addFunction("arbitrary_log", reinterpret_cast<void *>(arbitrary_log))
+
+        || !addFunction("multi_min", reinterpret_cast<void *>(multi_min))
+        || !addFunction("multi_max", reinterpret_cast<void *>(multi_max))
+
+        || !addFunction("gcd_multi", reinterpret_cast<void *>(gcd_multi))
+        || !addFunction("lcm_multi", reinterpret_cast<void *>(lcm_multi))) {
+        mError = tr("the additional mathematical methods could not be added");
+
+        return false;
+    }
+
+    // Add the cached object for our code, if any, to our ORC-based JIT, in
+    // which case we don't need to compile our code
+    // Note: we make sure that the cached object is a valid object file and if
+    //       it isn't then we remove it from our cache and compile our code...
+
+    auto object = mObjectCache->object(objectKey);
+
+    if (object) {
+        auto objectFile = llvm::object::ObjectFile::createObjectFile(object->getMemBufferRef());
+
+        if (objectFile) {
+            if (mLljit->addObjectFile(std::move(object))) {
+                mError = tr("the cached object could not be added to the ORC-based JIT");
+
+                return false;
+            }
+
+            return true;
+        }
+
+        llvm::consumeError(objectFile.takeError());
+
+        mObjectCache->removeObject(objectKey);
+    }
 
     // Create a diagnostics engine
 
@@ -165,19 +363,7 @@ extern double lcm_multi(int, ...);
 
     driver.setCheckInputsExist(false);
 
-    // Get a compilation object to which we pass some arguments
-
-    constexpr char const *DummyFileName = "dummy.c";
-
-    std::vector<const char *> compilationArguments = {"clang", "-fsyntax-only",
-#ifdef QT_DEBUG
-                                                      "-g",
-                                                      "-O0",
-#else
-                                                      "-O3",
-#endif
-                                                      "-fno-math-errno",
-                                                      DummyFileName};
+    // Get a compilation object to which we pass our arguments
 
     std::unique_ptr<clang::driver::Compilation> compilation(driver.BuildCompilation(compilationArguments));
 
@@ -247,8 +433,15 @@ extern double lcm_multi(int, ...);
                                                                            llvm::MemoryBuffer::getMemBuffer(codeByteArray.constData()).release());
 
     // Compile the given code, resulting in an LLVM bitcode module
+    // Note: we use our own LLVM context rather than the global one since we may
+    //       be compiling code from different threads...
 
-    std::unique_ptr<clang::CodeGenAction> codeGenAction(new clang::EmitLLVMOnlyAction(llvm::unwrap(LLVMGetGlobalContext())));
+    QElapsedTimer timer;
+
+    timer.start();
+
+    auto llvmContext = std::make_unique<llvm::LLVMContext>();
+    std::unique_ptr<clang::CodeGenAction> codeGenAction(new clang::EmitLLVMOnlyAction(llvmContext.get()));
 
     if (!compilerInstance.ExecuteAction(*codeGenAction)) {
         mError = tr("the code could not be compiled");
@@ -266,92 +459,168 @@ extern double lcm_multi(int, ...);
         return false;
     }
 
-    // Initialise the native target (and its ASM printer), so not only can we
-    // then create an execution engine, but more importantly its data layout
-    // will match that of our target platform
+    mParsingTime = timer.elapsed();
+
+    // Optimise our LLVM bitcode module, if requested
+    // Note: Clang was asked not to run any LLVM pass (see
+    //       compilationArguments()), so that we can keep track of how long it
+    //       takes to optimise our module...
+
+    if (optimize) {
+        timer.restart();
+
+        auto targetMachine = llvm::orc::JITTargetMachineBuilder::detectHost();
+
+        if (targetMachine) {
+            auto hostTargetMachine = targetMachine->createTargetMachine();
+
+            if (hostTargetMachine) {
+                llvm::LoopAnalysisManager loopAnalysisManager;
+                llvm::FunctionAnalysisManager functionAnalysisManager;
+                llvm::CGSCCAnalysisManager cgsccAnalysisManager;
+                llvm::ModuleAnalysisManager moduleAnalysisManager;
+                llvm::PassBuilder passBuilder(hostTargetMachine->get());
+
+                passBuilder.registerModuleAnalyses(moduleAnalysisManager);
+                passBuilder.registerCGSCCAnalyses(cgsccAnalysisManager);
+                passBuilder.registerFunctionAnalyses(functionAnalysisManager);
+                passBuilder.registerLoopAnalyses(loopAnalysisManager);
+                passBuilder.crossRegisterProxies(loopAnalysisManager,
+                                                 functionAnalysisManager,
+                                                 cgsccAnalysisManager,
+                                                 moduleAnalysisManager);
+
+                passBuilder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O3).run(*module, moduleAnalysisManager);
+            } else {
+                llvm::consumeError(hostTargetMachine.takeError());
+            }
+        } else {
+            llvm::consumeError(targetMachine.takeError());
+        }
 
-    llvm::InitializeNativeTarget();
-    llvm::InitializeNativeTargetAsmPrinter();
+        mOptimizationTime = timer.elapsed();
+    }
 
-    // Create an ORC-based JIT and keep track of it (so that we can use it in
-    // function())
+    // Add our LLVM bitcode module to our ORC-based JIT, using our object key as
+    // its identifier so that our object cache knows under which key to cache
+    // the resulting object (see CompilerObjectCache::notifyObjectCompiled())
 
-    auto lljit = llvm::orc::LLJITBuilder().create();
+    module->setModuleIdentifier(objectKey.toStdString());
 
-    if (!lljit) {
-        mError = tr("the ORC-based JIT could not be created");
+    auto threadSafeModule = llvm::orc::ThreadSafeModule(std::move(module), std::move(llvmContext));
+
+    if (mLljit->addIRModule(std::move(threadSafeModule))) {
+        mError = tr("the IR module could not be added to the ORC-based JIT");
 
         return false;
     }
 
-    mLljit = std::move(*lljit);
+    return true;
+}
 
-    // Make sure that we can find various mathematical functions in the standard
-    // C library and the additional ones that we want to support (see
-    // compilermath.[cpp|h])
+//==============================================================================
 
-    auto dynamicLibrarySearchGenerator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(mLljit->getDataLayout().getGlobalPrefix());
+QString CompilerEngine::fullCode(const QString &pCode)
+{
+    // Return the given code to which we prepend all the external functions
+    // that may, or not, be needed by it
 
-    if (!dynamicLibrarySearchGenerator) {
-        mError = tr("the dynamic library search generator could not be created");
+    return R"(
+extern double fabs(double);
 
-        return false;
-    }
+extern double log(double);
+extern double exp(double);
 
-    mLljit->getMainJITDylib().addGenerator(std::move(*dynamicLibrarySearchGenerator));
+extern double floor(double);
+extern double ceil(double);
 
-    if (   !addFunction("factorial", reinterpret_cast<void *>(factorial))
+extern double factorial(double);
 
-        || !addFunction("sec", reinterpret_cast<void *>(sec))
-        || !addFunction("sech", reinterpret_cast<void *>(sech))
-        || !addFunction("asec", reinterpret_cast<void *>(asec))
-        || !addFunction("asech", reinterpret_cast<void *>(asech))
+extern double sin(double);
+extern double sinh(double);
+extern double asin(double);
+extern double asinh(double);
 
-        || !addFunction("csc", reinterpret_cast<void *>(csc))
-        || !addFunction("csch", reinterpret_cast<void *>(csch))
-        || !addFunction("acsc", reinterpret_cast<void *>(acsc))
-        || !addFunction("acsch", reinterpret_cast<void *>(acsch))
+extern double cos(double);
+extern double cosh(double);
+extern double acos(double);
+extern double acosh(double);
 
-        || !addFunction("cot", reinterpret_cast<void *>(cot))
-        || !addFunction("coth", reinterpret_cast<void *>(coth))
-        || !addFunction("acot", reinterpret_cast<void *>(acot))
-        || !addFunction("acoth", reinterpret_cast<void *>(acoth))
+extern double tan(double);
+extern double tanh(double);
+extern double atan(double);
+extern double atanh(double);
 
-        || !addFunction("arbitrary_log", reinterpret_cast<void *>(arbitrary_log))
+extern double sec(double);
+extern double sech(double);
+extern double asec(double);
+extern double asech(double);
 
-        || !addFunction("multi_min", reinterpret_cast<void *>(multi_min))
-        || !addFunction("multi_max", reinterpret_cast<void *>(multi_max))
+extern double csc(double);
+extern double csch(double);
+extern double acsc(double);
+extern double acsch(double);
 
-        || !addFunction("gcd_multi", reinterpret_cast<void *>(gcd_multi))
-        || !addFunction("lcm_multi", reinterpret_cast<void *>(lcm_multi))) {
-        mError = tr("the additional mathematical methods could not be added");
+extern double cot(double);
+extern double coth(double);
+extern double acot(double);
+extern double acoth(double);
 
-        return false;
-    }
+extern double arbitrary_log(double, double);
 
-    // Add our LLVM bitcode module to our ORC-based JIT
+extern double pow(double, double);
 
-    auto llvmContext = std::make_unique<llvm::LLVMContext>();
-    auto threadSafeModule = llvm::orc::ThreadSafeModule(std::move(module), std::move(llvmContext));
+extern double multi_min(int, ...);
+extern double multi_max(int, ...);
 
-    if (mLljit->addIRModule(std::move(threadSafeModule))) {
-        mError = tr("the IR module could not be added to the ORC-based JIT");
+extern double gcd_multi(int, ...);
+extern double lcm_multi(int, ...);
+)"+pCode;
+}
 
-        return false;
-    }
+//==============================================================================
 
-    return true;
+std::vector<const char *> CompilerEngine::compilationArguments(bool pOptimize)
+{
+    // Return the arguments with which our code is to be compiled
+    // Note: we ask Clang not to run any LLVM pass since we optimise our code
+    //       ourselves (see compileCode())...
+
+    std::vector<const char *> res = { "clang", "-fsyntax-only" };
+
+#ifdef QT_DEBUG
+    Q_UNUSED(pOptimize)
+
+    res.insert(res.end(), { "-g", "-O0" });
+#else
+    res.push_back(pOptimize?"-O3":"-O0");
+#endif
+
+    res.insert(res.end(), { "-fno-math-errno",
+                            "-Xclang", "-disable-llvm-passes",
+                            DummyFileName });
+
+    return res;
 }
 
 //==============================================================================
 
 void * CompilerEngine::function(const QString &pName)
 {
-    // Return the address of the requested function
+    // Return the address of the requested function and keep track of the time
+    // it took us to link it (i.e. the time it took to look it up minus the
+    // time it took to generate its object, if it hadn't already been generated)
 
     if ((mLljit != nullptr) && !pName.isEmpty()) {
+        QElapsedTimer timer;
+        qint64 codeGenerationTime = mCodeGenerationTime;
+
+        timer.start();
+
         auto symbol = mLljit->lookup(qPrintable(pName));
 
+        mLinkingTime += timer.elapsed()-(mCodeGenerationTime-codeGenerationTime);
+
         if (symbol) {
             return reinterpret_cast<void *>(symbol->getAddress());
         }
@@ -30,6 +30,7 @@ along with this program. If not, see <https://gnu.org/licenses>.
 //==============================================================================
 
 #include "llvmclangbegin.h"
+    #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
     #include "llvm/ExecutionEngine/Orc/LLJIT.h"
 #include "llvmclangend.h"
 
@@ -45,24 +46,66 @@ namespace Compiler {
 
 //==============================================================================
 
+class CompilerObjectCache;
+
+//==============================================================================
+
+class CompilerEngineIrCompiler : public llvm::orc::TMOwningSimpleCompiler
+{
+public:
+    explicit CompilerEngineIrCompiler(std::unique_ptr<llvm::TargetMachine> pTargetMachine,
+                                      llvm::ObjectCache *pObjectCache,
+                                      qint64 &pCodeGenerationTime);
+
+    llvm::Expected<CompileResult> operator()(llvm::Module &pModule) override;
+
+private:
+    qint64 &mCodeGenerationTime;
+};
+
+//==============================================================================
+
 class COMPILER_EXPORT CompilerEngine : public QObject
 {
     Q_OBJECT
 
 public:
+    explicit CompilerEngine();
+    ~CompilerEngine() override;
+
     bool hasError() const;
     QString error() const;
 
+    bool hasCachedObject(const QString &pCode, bool pOptimize = true) const;
+
+    qint64 parsingTime() const;
+    qint64 optimizationTime() const;
+    qint64 codeGenerationTime() const;
+    qint64 linkingTime() const;
+
+    QString objectCacheDirName() const;
+    void setObjectCacheDirName(const QString &pObjectCacheDirName);
+
     bool addFunction(const QString &pName, void *pFunction);
 
-    bool compileCode(const QString &pCode);
+    bool compileCode(const QString &pCode, bool pOptimize = true);
 
     void * function(const QString &pName);
 
 private:
+    QString mObjectCacheDirName;
+    std::unique_ptr<CompilerObjectCache> mObjectCache;
     std::unique_ptr<llvm::orc::LLJIT> mLljit;
 
     QString mError;
+
+    qint64 mParsingTime = 0;
+    qint64 mOptimizationTime = 0;
+    qint64 mCodeGenerationTime = 0;
+    qint64 mLinkingTime = 0;
+
+    static QString fullCode(const QString &pCode);
+    static std::vector<const char *> compilationArguments(bool pOptimize);
 };
 
 //==============================================================================
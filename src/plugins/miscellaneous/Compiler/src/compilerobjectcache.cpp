@@ -0,0 +1,244 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Compiler object cache
+//==============================================================================
+
+#include "compilerobjectcache.h"
+#include "corecliutils.h"
+
+//==============================================================================
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QStringList>
+
+//==============================================================================
+
+#include "llvmclangbegin.h"
+    #include "llvm/ADT/StringMap.h"
+    #include "llvm/Config/llvm-config.h"
+    #include "llvm/IR/Module.h"
+    #include "llvm/Support/Host.h"
+#include "llvmclangend.h"
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace Compiler {
+
+//==============================================================================
+
+static const char *DirNameProperty = "OpenCOR::jitCacheDirName()";
+static const char *ObjectFileExtension = ".o";
+
+static const qint64 MaximumCacheSize = 256*1024*1024;
+
+//==============================================================================
+
+CompilerObjectCache::CompilerObjectCache(const QString &pDirName) :
+    mDirName(pDirName)
+{
+}
+
+//==============================================================================
+
+QString CompilerObjectCache::dirName()
+{
+    // Return the name of the directory where our objects are to be cached
+    // Note #1: the directory can be specified on the command line (see
+    //          CliApplication::run()), in which case it is kept track of as a
+    //          qApp property...
+    // Note #2: an empty directory name means that objects are not to be
+    //          cached, which is what we want if we don't have an application
+    //          (e.g. when running our tests)...
+
+    if (qApp == nullptr) {
+        return {};
+    }
+
+    QVariant res = qApp->property(DirNameProperty);
+
+    if (!res.isValid()) {
+        return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)+"/JIT";
+    }
+
+    return res.toString();
+}
+
+//==============================================================================
+
+QString CompilerObjectCache::key(const QString &pCode,
+                                 const std::vector<const char *> &pArguments)
+{
+    // Return a key that uniquely identifies the object that would result from
+    // compiling the given code using the given arguments on our machine
+    // Note: the host CPU and its features are used by the ORC-based JIT to
+    //       generate the object, so they must be part of our key, as must be
+    //       the version of LLVM...
+
+    QStringList keyItems = { pCode,
+                             llvm::sys::getProcessTriple().c_str(),
+                             llvm::sys::getHostCPUName().str().c_str(),
+                             LLVM_VERSION_STRING };
+
+    for (const auto &argument : pArguments) {
+        keyItems << argument;
+    }
+
+    llvm::StringMap<bool> hostCpuFeatures;
+    QStringList features;
+
+    if (llvm::sys::getHostCPUFeatures(hostCpuFeatures)) {
+        for (const auto &hostCpuFeature : hostCpuFeatures) {
+            features << QString("%1%2").arg(hostCpuFeature.getValue()?"+":"-")
+                                       .arg(hostCpuFeature.getKey().str().c_str());
+        }
+
+        features.sort();
+    }
+
+    keyItems << features;
+
+    return Core::sha1(keyItems.join(QChar::Null));
+}
+
+//==============================================================================
+
+bool CompilerObjectCache::hasObject(const QString &pKey) const
+{
+    // Return whether we have an object for the given key
+
+    return !mDirName.isEmpty() && QFile::exists(fileName(pKey));
+}
+
+//==============================================================================
+
+std::unique_ptr<llvm::MemoryBuffer> CompilerObjectCache::object(const QString &pKey) const
+{
+    // Return the object, if any, that corresponds to the given key
+
+    if (!hasObject(pKey)) {
+        return nullptr;
+    }
+
+    QString objectFileName = fileName(pKey);
+    QByteArray objectContents;
+
+    if (!Core::readFile(objectFileName, objectContents)) {
+        return nullptr;
+    }
+
+    // Mark the object as having been recently used, so that it doesn't get
+    // evicted before less recently used objects (see evictObjects())
+
+    QFile objectFile(objectFileName);
+
+    if (objectFile.open(QIODevice::Append)) {
+        objectFile.setFileTime(QDateTime::currentDateTime(),
+                               QFileDevice::FileModificationTime);
+    }
+
+    return llvm::MemoryBuffer::getMemBufferCopy(llvm::StringRef(objectContents.constData(), size_t(objectContents.size())),
+                                                qPrintable(pKey));
+}
+
+//==============================================================================
+
+void CompilerObjectCache::removeObject(const QString &pKey) const
+{
+    // Remove the object that corresponds to the given key, if any
+    // Note: this is typically used when an object could not be loaded, i.e.
+    //       when it is corrupted...
+
+    if (!mDirName.isEmpty()) {
+        QFile::remove(fileName(pKey));
+    }
+}
+
+//==============================================================================
+
+void CompilerObjectCache::notifyObjectCompiled(const llvm::Module *pModule,
+                                               llvm::MemoryBufferRef pObject)
+{
+    // An object has been compiled, so cache it using the identifier of its
+    // module as its key (see CompilerEngine::compileCode()) and make sure that
+    // we don't exceed our maximum cache size
+
+    if (mDirName.isEmpty() || !QDir().mkpath(mDirName)) {
+        return;
+    }
+
+    if (Core::writeFile(fileName(QString::fromStdString(pModule->getModuleIdentifier())),
+                        QByteArray(pObject.getBufferStart(), int(pObject.getBufferSize())))) {
+        evictObjects();
+    }
+}
+
+//==============================================================================
+
+std::unique_ptr<llvm::MemoryBuffer> CompilerObjectCache::getObject(const llvm::Module *pModule)
+{
+    // Return the object, if any, that corresponds to the given module
+
+    return object(QString::fromStdString(pModule->getModuleIdentifier()));
+}
+
+//==============================================================================
+
+QString CompilerObjectCache::fileName(const QString &pKey) const
+{
+    // Return the name of the file for the object that corresponds to the given
+    // key
+
+    return mDirName+"/"+pKey+ObjectFileExtension;
+}
+
+//==============================================================================
+
+void CompilerObjectCache::evictObjects() const
+{
+    // Evict our least recently used objects until our cache fits within its
+    // maximum size
+
+    QFileInfoList objectFileInfos = QDir(mDirName).entryInfoList({ QString("*")+ObjectFileExtension },
+                                                                 QDir::Files, QDir::Time);
+    qint64 cacheSize = 0;
+
+    for (const auto &objectFileInfo : qAsConst(objectFileInfos)) {
+        cacheSize += objectFileInfo.size();
+
+        if (cacheSize > MaximumCacheSize) {
+            QFile::remove(objectFileInfo.absoluteFilePath());
+        }
+    }
+}
+
+//==============================================================================
+
+} // namespace Compiler
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
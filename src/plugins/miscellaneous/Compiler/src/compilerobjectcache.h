@@ -0,0 +1,85 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Compiler object cache
+//==============================================================================
+
+#pragma once
+
+//==============================================================================
+
+#include "compilerglobal.h"
+
+//==============================================================================
+
+#include "llvmclangbegin.h"
+    #include "llvm/ExecutionEngine/ObjectCache.h"
+    #include "llvm/Support/MemoryBuffer.h"
+#include "llvmclangend.h"
+
+//==============================================================================
+
+#include <QString>
+
+//==============================================================================
+
+#include <vector>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace Compiler {
+
+//==============================================================================
+
+class COMPILER_EXPORT CompilerObjectCache : public llvm::ObjectCache
+{
+public:
+    explicit CompilerObjectCache(const QString &pDirName);
+
+    static QString dirName();
+
+    static QString key(const QString &pCode,
+                       const std::vector<const char *> &pArguments);
+
+    bool hasObject(const QString &pKey) const;
+    std::unique_ptr<llvm::MemoryBuffer> object(const QString &pKey) const;
+    void removeObject(const QString &pKey) const;
+
+    void notifyObjectCompiled(const llvm::Module *pModule,
+                              llvm::MemoryBufferRef pObject) override;
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *pModule) override;
+
+private:
+    QString mDirName;
+
+    QString fileName(const QString &pKey) const;
+
+    void evictObjects() const;
+};
+
+//==============================================================================
+
+} // namespace Compiler
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -1063,6 +1063,83 @@ void Tests::lcmFunctionTests()
 
 //==============================================================================
 
+void Tests::optimizationTests()
+{
+    // Compile some code without optimising it and make sure that no time was
+    // spent optimising it
+
+    static const QString Code = "double function(double pNb1, double pNb2)\n"
+                                "{\n"
+                                "    return pNb1+pNb2;\n"
+                                "}";
+
+    QVERIFY(mCompilerEngine->compileCode(Code, false));
+    QVERIFY(qFuzzyCompare(reinterpret_cast<double (*)(double, double)>(mCompilerEngine->function("function"))(mA, mB), mA+mB));
+    QCOMPARE(mCompilerEngine->optimizationTime(), qint64(0));
+
+    // Compile the same code, but optimising it this time, and make sure that
+    // we get the same result
+
+    QVERIFY(mCompilerEngine->compileCode(Code));
+    QVERIFY(qFuzzyCompare(reinterpret_cast<double (*)(double, double)>(mCompilerEngine->function("function"))(mA, mB), mA+mB));
+    QVERIFY(mCompilerEngine->parsingTime() >= 0);
+    QVERIFY(mCompilerEngine->optimizationTime() >= 0);
+    QVERIFY(mCompilerEngine->codeGenerationTime() >= 0);
+    QVERIFY(mCompilerEngine->linkingTime() >= 0);
+}
+
+//==============================================================================
+
+void Tests::objectCacheTests()
+{
+    // Cache our compiled objects in a temporary directory
+
+    QTemporaryDir objectCacheDir;
+
+    QVERIFY(objectCacheDir.isValid());
+
+    mCompilerEngine->setObjectCacheDirName(objectCacheDir.path());
+
+    // Compile some code and check that its object gets cached
+
+    static const QString Code = "double function(double pNb1, double pNb2)\n"
+                                "{\n"
+                                "    return pNb1*pNb2;\n"
+                                "}";
+
+    QVERIFY(mCompilerEngine->compileCode(Code));
+    QVERIFY(qFuzzyCompare(reinterpret_cast<double (*)(double, double)>(mCompilerEngine->function("function"))(mA, mB), mA*mB));
+    QCOMPARE(QDir(objectCacheDir.path()).entryList(QDir::Files).count(), 1);
+
+    // Compile the same code again, which means that its cached object should
+    // get used
+
+    QVERIFY(mCompilerEngine->compileCode(Code));
+    QVERIFY(qFuzzyCompare(reinterpret_cast<double (*)(double, double)>(mCompilerEngine->function("function"))(mA, mB), mA*mB));
+    QCOMPARE(QDir(objectCacheDir.path()).entryList(QDir::Files).count(), 1);
+
+    // Corrupt our cached object and check that our code gets recompiled
+
+    QString objectFileName = QDir(objectCacheDir.path()).entryInfoList(QDir::Files).first().absoluteFilePath();
+
+    QFile objectFile(objectFileName);
+
+    QVERIFY(objectFile.open(QIODevice::WriteOnly|QIODevice::Truncate));
+    QVERIFY(objectFile.write("Corrupted object") != -1);
+
+    objectFile.close();
+
+    QVERIFY(mCompilerEngine->compileCode(Code));
+    QVERIFY(qFuzzyCompare(reinterpret_cast<double (*)(double, double)>(mCompilerEngine->function("function"))(mA, mB), mA*mB));
+    QVERIFY(QFileInfo(objectFileName).size() != qint64(strlen("Corrupted object")));
+
+    // Stop caching our compiled objects
+
+    mCompilerEngine->setObjectCacheDirName(QString());
+}
+
+//==============================================================================
+
 QTEST_APPLESS_MAIN(Tests)
 
 //==============================================================================
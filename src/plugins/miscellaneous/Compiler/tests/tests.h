@@ -124,6 +124,9 @@ private slots:
 
     void gcdFunctionTests();
     void lcmFunctionTests();
+
+    void optimizationTests();
+    void objectCacheTests();
 };
 
 //==============================================================================
@@ -178,6 +178,10 @@
         <source>Plot Against Last Used Parameter</source>
         <translation>Tracer En Fonction Du Dernier Paramètre Utilisé</translation>
     </message>
+    <message>
+        <source>Record Values</source>
+        <translation>Enregistrer Valeurs</translation>
+    </message>
     <message>
         <source>variable of integration</source>
         <translation>variable d&apos;intégration</translation>
@@ -67,6 +67,10 @@ void SimulationExperimentViewInformationParametersWidget::retranslateContextMenu
     if (mPlotAgainstLastUsedParameterMenuAction != nullptr) {
         mPlotAgainstLastUsedParameterMenuAction->setText(tr("Plot Against Last Used Parameter"));
     }
+
+    if (mRecordValuesMenuAction != nullptr) {
+        mRecordValuesMenuAction->setText(tr("Record Values"));
+    }
 }
 
 //==============================================================================
@@ -104,6 +108,18 @@ void SimulationExperimentViewInformationParametersWidget::contextMenuEvent(QCont
         return;
     }
 
+    // Update our record values menu item, which only applies to our rates and
+    // algebraic variables
+
+    CellMLSupport::CellmlFileRuntimeParameter *parameter = mParameters.value(crtProperty);
+    bool canBeUnrecorded =    (parameter != nullptr)
+                           && (   (parameter->type() == CellMLSupport::CellmlFileRuntimeParameter::Type::Rate)
+                               || (parameter->type() == CellMLSupport::CellmlFileRuntimeParameter::Type::Algebraic));
+
+    mRecordValuesMenuAction->setEnabled(canBeUnrecorded);
+    mRecordValuesMenuAction->setChecked(   !canBeUnrecorded
+                                        || mSimulation->results()->isRecorded(SimulationSupport::SimulationResults::uri(parameter)));
+
     // Generate and show the context menu
 
     mContextMenu->exec(pEvent->globalPos());
@@ -171,6 +187,8 @@ void SimulationExperimentViewInformationParametersWidget::finalize()
 
     mContextMenu->clear();
 
+    mRecordValuesMenuAction = nullptr;
+
     mParameters.clear();
     mParameterActions.clear();
 }
@@ -462,6 +480,18 @@ void SimulationExperimentViewInformationParametersWidget::populateContextMenu(Ce
     mContextMenu->addSeparator();
     mContextMenu->addAction(mPlotAgainstLastUsedParameterMenuAction);
 
+    // Create our record values menu item
+
+    mRecordValuesMenuAction = new QAction(mContextMenu);
+
+    mRecordValuesMenuAction->setCheckable(true);
+
+    mContextMenu->addSeparator();
+    mContextMenu->addAction(mRecordValuesMenuAction);
+
+    connect(mRecordValuesMenuAction, &QAction::triggered,
+            this, &SimulationExperimentViewInformationParametersWidget::recordValues);
+
     // Initialise our menu items
 
     retranslateContextMenu();
@@ -630,6 +660,23 @@ void SimulationExperimentViewInformationParametersWidget::emitGraphRequired()
 
 //==============================================================================
 
+void SimulationExperimentViewInformationParametersWidget::recordValues(bool pChecked)
+{
+    // Let our simulation results know whether the values of the current
+    // parameter are to be recorded
+    // Note: this only takes effect when a run is added, and the values of a
+    //       parameter that is not recorded can still be plotted since they get
+    //       computed on demand...
+
+    CellMLSupport::CellmlFileRuntimeParameter *parameter = mParameters.value(currentProperty());
+
+    if (parameter != nullptr) {
+        mSimulation->results()->setRecorded(SimulationSupport::SimulationResults::uri(parameter), pChecked);
+    }
+}
+
+//==============================================================================
+
 } // namespace SimulationExperimentView
 } // namespace OpenCOR
 
@@ -81,6 +81,7 @@ private:
     QAction *mPlotAgainstVoiMenuAction = nullptr;
     QAction *mPlotAgainstLastUsedParameterMenuAction = nullptr;
     QMenu *mPlotAgainstMenu = nullptr;
+    QAction *mRecordValuesMenuAction = nullptr;
 
     QHash<Core::Property *, CellMLSupport::CellmlFileRuntimeParameter *> mParameters;
     QHash<QAction *, CellMLSupport::CellmlFileRuntimeParameter *> mParameterActions;
@@ -112,6 +113,8 @@ private slots:
     void propertyChanged(Core::Property *pProperty);
 
     void emitGraphRequired();
+
+    void recordValues(bool pChecked);
 };
 
 //==============================================================================
@@ -1651,12 +1651,19 @@ void SimulationExperimentViewSimulationWidget::addSedmlSimulationAlgorithm(libse
 {
     // Customise the given algorithm using the given solver interface and
     // properties
+    // Note: a solver property that has no KiSAO id (e.g. CVODE's "Output
+    //       solver steps") cannot be described in SED-ML, so we skip it...
 
     if (pSolverInterface != nullptr) {
         const QStringList solverPropertyKeys = pSolverProperties.keys();
 
         for (const auto &solverProperty : solverPropertyKeys) {
             QString kisaoId = pSolverInterface->kisaoId(solverProperty);
+
+            if (kisaoId.isEmpty()) {
+                continue;
+            }
+
             QVariant solverPropertyValue = pSolverProperties.value(solverProperty);
             QString value = (solverPropertyValue.type() == QVariant::Double)?
                                 QString::number(solverPropertyValue.toDouble(), 'g', 15):
@@ -2977,6 +2984,11 @@ void SimulationExperimentViewSimulationWidget::remoteDataImport()
 
 void SimulationExperimentViewSimulationWidget::simulationResultsExport()
 {
+    // Make sure that the values of our unrecorded model parameters, if any,
+    // have been computed
+
+    mSimulation->results()->computeValues();
+
     // Retrieve some data so that we can effectively export our simulation
     // results
 
@@ -3844,32 +3856,23 @@ void SimulationExperimentViewSimulationWidget::updateSimulationResults(Simulatio
                     // current viewport, but only if the user hasn't changed the
                     // plot's viewport since we last came here (e.g. by panning
                     // the plot's contents)
+                    // Note: our graph's run keeps track of its bounding
+                    //       rectangle as data gets appended to it, so we can
+                    //       simply check it rather than go through our graph
+                    //       segment. This is fine since the rest of the run
+                    //       already fits within our plot's current viewport...
 
                     if (!plot->hasDirtyAxes()) {
-                        double minX = plotMinX;
-                        double maxX = plotMaxX;
-                        double minY = plotMinY;
-                        double maxY = plotMaxY;
-
-                        for (quint64 i = (oldDataSize != 0)?oldDataSize-1:0;
-                             i < pSimulationResultsSize; ++i) {
-                            double valX = graph->data(pSimulationRun)->sample(i).x();
-                            double valY = graph->data(pSimulationRun)->sample(i).y();
-
-                            if (   !qIsInf(valX) && !qIsNaN(valX)
-                                && !qIsInf(valY) && !qIsNaN(valY)) {
-                                minX = qMin(minX, valX);
-                                maxX = qMax(maxX, valX);
-                                minY = qMin(minY, valY);
-                                maxY = qMax(maxY, valY);
-                            }
-                        }
+                        QRectF boundingRect = graph->boundingRect(pSimulationRun);
 
                         // Update our plot, if our graph segment cannot fit
                         // within our plot's current viewport
 
-                        needFullUpdatePlot =    (minX < plotMinX) || (maxX > plotMaxX)
-                                             || (minY < plotMinY) || (maxY > plotMaxY);
+                        needFullUpdatePlot =     (boundingRect.width() >= 0.0)
+                                             && (   (boundingRect.left() < plotMinX)
+                                                 || (boundingRect.right() > plotMaxX)
+                                                 || (boundingRect.top() < plotMinY)
+                                                 || (boundingRect.bottom() > plotMaxY));
                     }
 
                     if (!needFullUpdatePlot) {
@@ -35,6 +35,7 @@ along with this program. If not, see <https://gnu.org/licenses>.
 //==============================================================================
 
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QHeaderView>
 #include <QLayout>
 #include <QScreen>
@@ -529,6 +530,13 @@ void SimulationExperimentViewWidget::checkSimulationResults(const QString &pFile
         return;
     }
 
+    // Keep track of when we started checking our simulation results, so that
+    // we can recheck them at a bounded rate (see below)
+
+    QElapsedTimer timer;
+
+    timer.start();
+
     // Make sure that our previous run, if any, is complete, if we are coming
     // here as a result of having added a new run
 
@@ -550,14 +558,19 @@ void SimulationExperimentViewWidget::checkSimulationResults(const QString &pFile
     }
 
     // Update all of our simulation widgets' results, but only if needed
-    // Note: to update only the given simulation widget's results is not enough
-    //       since another simulation widget may have graphs that refer to the
-    //       given simulation widget...
-
+    // Note #1: to update only the given simulation widget's results is not
+    //          enough since another simulation widget may have graphs that
+    //          refer to the given simulation widget...
+    // Note #2: we retrieve the epoch of our simulation results before their
+    //          size since it is cheap to retrieve and it guarantees that the
+    //          points that make up our size are visible to us...
+
+    quint64 crtSimulationResultsEpoch = simulation->results()->epoch();
     quint64 crtSimulationResultsSize = simulation->results()->size();
 
     if (   (pTask != SimulationExperimentViewSimulationWidget::Task::None)
-        || (crtSimulationResultsSize != simulationResultsSize(pFileName))) {
+        || (   (crtSimulationResultsEpoch != mSimulationResultsEpochs.value(pFileName))
+            && (crtSimulationResultsSize != simulationResultsSize(pFileName)))) {
         mSimulationResultsSizes.insert(pFileName, crtSimulationResultsSize);
 
         for (auto currentSimulationWidget : qAsConst(mSimulationWidgets)) {
@@ -568,19 +581,34 @@ void SimulationExperimentViewWidget::checkSimulationResults(const QString &pFile
         }
     }
 
+    mSimulationResultsEpochs.insert(pFileName, crtSimulationResultsEpoch);
+
     // Ask to recheck our simulation widget's results, but only if its
-    // simulation is still running
+    // simulation is still running and if we haven't already asked for it
+    // Note: we recheck our simulation widget's results at a bounded rate since
+    //       rechecking them straightaway would keep the GUI thread busy and
+    //       steal CPU time from our simulation, not to mention that there is
+    //       no point in updating our graphs faster than they can be seen...
 
     if (   simulation->isRunning()
-        || (crtSimulationResultsSize != simulation->results()->size())) {
-        QTimer::singleShot(0, this, std::bind(&SimulationExperimentViewWidget::checkSimulationResults,
-                                              this, pFileName,
-                                              SimulationExperimentViewSimulationWidget::Task::None));
+        || (crtSimulationResultsEpoch != simulation->results()->epoch())) {
+        if (!mSimulationResultsChecks.contains(pFileName)) {
+            enum {
+                RecheckInterval = 1000/50
+            };
+
+            mSimulationResultsChecks << pFileName;
+
+            QTimer::singleShot(qMax(RecheckInterval-int(timer.elapsed()), 0),
+                               this, std::bind(&SimulationExperimentViewWidget::recheckSimulationResults,
+                                               this, pFileName));
+        }
     } else if (!simulation->isRunning() && !simulation->isPaused()) {
         // The simulation is over, so stop tracking the result's size and reset
         // the simulation progress of the given file
 
         mSimulationResultsSizes.remove(pFileName);
+        mSimulationResultsEpochs.remove(pFileName);
 
         simulationWidget->resetSimulationProgress();
     }
@@ -588,6 +616,17 @@ void SimulationExperimentViewWidget::checkSimulationResults(const QString &pFile
 
 //==============================================================================
 
+void SimulationExperimentViewWidget::recheckSimulationResults(const QString &pFileName)
+{
+    // Recheck the simulation results of the given file
+
+    mSimulationResultsChecks.remove(pFileName);
+
+    checkSimulationResults(pFileName);
+}
+
+//==============================================================================
+
 void SimulationExperimentViewWidget::simulationWidgetSplitterMoved(const QIntList &pSizes)
 {
     // The splitter of our simulation widget has moved, so keep track of its new
@@ -126,9 +126,13 @@ private:
     QStringList mFileNames;
 
     QMap<QString, quint64> mSimulationResultsSizes;
+    QMap<QString, quint64> mSimulationResultsEpochs;
+    QSet<QString> mSimulationResultsChecks;
 
     void updateContentsInformationGui(SimulationExperimentViewSimulationWidget *pSimulationWidget);
 
+    void recheckSimulationResults(const QString &pFileName);
+
 private slots:
     void simulationWidgetSplitterMoved(const QIntList &pSizes);
     void contentsWidgetSplitterMoved(const QIntList &pSizes);
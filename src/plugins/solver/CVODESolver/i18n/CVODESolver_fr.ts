@@ -55,5 +55,9 @@
         <source>the &quot;Interpolate solution&quot; property value could not be retrieved</source>
         <translation>la valeur de la propriété &quot;Interpoler solution&quot; n&apos;a pas pu être retrouvée</translation>
     </message>
+    <message>
+        <source>the &quot;Output solver steps&quot; property value could not be retrieved</source>
+        <translation>la valeur de la propriété &quot;Sortir pas du solveur&quot; n&apos;a pas pu être retrouvée</translation>
+    </message>
 </context>
 </TS>
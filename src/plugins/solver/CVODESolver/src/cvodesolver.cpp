@@ -30,6 +30,8 @@ along with this program. If not, see <https://gnu.org/licenses>.
     #include "cvodes/cvodes_bandpre.h"
     #include "cvodes/cvodes_diag.h"
     #include "nvector/nvector_serial.h"
+    #include "sunmatrix/sunmatrix_band.h"
+    #include "sunmatrix/sunmatrix_dense.h"
     #include "sunlinsol/sunlinsol_band.h"
     #include "sunlinsol/sunlinsol_dense.h"
     #include "sunlinsol/sunlinsol_spbcgs.h"
@@ -40,6 +42,11 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 //==============================================================================
 
+#include <cmath>
+#include <limits>
+
+//==============================================================================
+
 namespace OpenCOR {
 namespace CVODESolver {
 
@@ -61,6 +68,99 @@ int rhsFunction(double pVoi, N_Vector pStates, N_Vector pRates, void *pUserData)
 
 //==============================================================================
 
+int jacobianFunction(double pVoi, N_Vector pStates, N_Vector pRates,
+                     SUNMatrix pJacobian, void *pUserData, N_Vector pTemp1,
+                     N_Vector pTemp2, N_Vector pTemp3)
+{
+    Q_UNUSED(pTemp3)
+
+    // Compute the non-zero entries of our Jacobian, either using our compute
+    // Jacobian function or using finite differences with coloured columns
+    // Note #1: our compute Jacobian function also computes our rates, hence we
+    //          give it a scratch array for them rather than the rates that
+    //          CVODES gave us...
+    // Note #2: our finite-difference increments are computed the same way as
+    //          those used by CVODES' own dense finite-difference approximation
+    //          (see cvLsDenseDQJac()), i.e. max(sqrt(uround)*|y_i|,
+    //          minInc/ewt_i) with minInc = 1000*|h|*uround*N*||f||_wrms, or 1
+    //          if ||f||_wrms is zero...
+
+    auto userData = static_cast<CvodeSolverUserData *>(pUserData);
+    Solver::FiniteDifferenceJacobian *finiteDifferenceJacobian = userData->finiteDifferenceJacobian();
+    double *states = N_VGetArrayPointer_Serial(pStates);
+    double *jacobian;
+
+    if (finiteDifferenceJacobian != nullptr) {
+        static const double UnitRoundoff = std::numeric_limits<double>::epsilon();
+        static const double SquareRootOfUnitRoundoff = std::sqrt(UnitRoundoff);
+
+        int ratesStatesCount = userData->ratesStatesCount();
+        double *increments = N_VGetArrayPointer_Serial(pTemp1);
+        double *errorWeights = N_VGetArrayPointer_Serial(pTemp2);
+        double currentStep = 0.0;
+
+        CVodeGetErrWeights(userData->solver(), pTemp2);
+        CVodeGetCurrentStep(userData->solver(), &currentStep);
+
+        double ratesNorm = N_VWrmsNorm(pRates, pTemp2);
+        double minimumIncrement = (ratesNorm != 0.0)?
+                                      1000.0*qAbs(currentStep)*UnitRoundoff*ratesStatesCount*ratesNorm:
+                                      1.0;
+
+        for (int i = 0; i < ratesStatesCount; ++i) {
+            increments[i] = qMax(SquareRootOfUnitRoundoff*qAbs(states[i]),
+                                 minimumIncrement/errorWeights[i]);
+        }
+
+        finiteDifferenceJacobian->compute(states, N_VGetArrayPointer_Serial(pRates),
+                                          increments, [=](double *pX, double *pF) {
+            userData->computeRates()(pVoi, userData->constants(), pF, pX,
+                                     userData->algebraic());
+        });
+
+        jacobian = finiteDifferenceJacobian->values();
+    } else {
+        jacobian = userData->jacobian();
+
+        userData->computeJacobian()(pVoi, userData->constants(),
+                                    userData->rates(), states,
+                                    userData->algebraic(), jacobian);
+    }
+
+    // Scatter those non-zero entries into our dense or banded matrix
+    // Note: in the case of a banded matrix, the entries outside of our band
+    //       are ignored, just like when CVODES approximates our Jacobian
+    //       using finite differences...
+
+    const QVector<int> &columnPointers = (finiteDifferenceJacobian != nullptr)?
+                                             finiteDifferenceJacobian->columnPointers():
+                                             userData->jacobianColumnPointers();
+    const QVector<int> &rowIndices = (finiteDifferenceJacobian != nullptr)?
+                                         finiteDifferenceJacobian->rowIndices():
+                                         userData->jacobianRowIndices();
+    bool denseMatrix = SUNMatGetID(pJacobian) == SUNMATRIX_DENSE;
+    sunindextype upperHalfBandwidth = denseMatrix?0:SM_UBAND_B(pJacobian);
+    sunindextype lowerHalfBandwidth = denseMatrix?0:SM_LBAND_B(pJacobian);
+
+    SUNMatZero(pJacobian);
+
+    for (int j = 0, jMax = columnPointers.count()-1; j < jMax; ++j) {
+        for (int k = columnPointers[j], kMax = columnPointers[j+1]; k < kMax; ++k) {
+            int i = rowIndices[k];
+
+            if (denseMatrix) {
+                SM_ELEMENT_D(pJacobian, i, j) = jacobian[k];
+            } else if ((i-j <= lowerHalfBandwidth) && (j-i <= upperHalfBandwidth)) {
+                SM_ELEMENT_B(pJacobian, i, j) = jacobian[k];
+            }
+        }
+    }
+
+    return 0;
+}
+
+//==============================================================================
+
 void errorHandler(int pErrorCode, const char *pModule, const char *pFunction,
                   char *pErrorMessage, void *pUserData)
 {
@@ -77,11 +177,25 @@ void errorHandler(int pErrorCode, const char *pModule, const char *pFunction,
 //==============================================================================
 
 CvodeSolverUserData::CvodeSolverUserData(double *pConstants, double *pAlgebraic,
-                                         Solver::OdeSolver::ComputeRatesFunction pComputeRates) :
+                                         Solver::OdeSolver::ComputeRatesFunction pComputeRates,
+                                         Solver::OdeSolver::ComputeJacobianFunction pComputeJacobian,
+                                         const QVector<int> &pJacobianColumnPointers,
+                                         const QVector<int> &pJacobianRowIndices,
+                                         int pRatesStatesCount) :
     mConstants(pConstants),
     mAlgebraic(pAlgebraic),
-    mComputeRates(pComputeRates)
+    mComputeRates(pComputeRates),
+    mComputeJacobian(pComputeJacobian),
+    mJacobianColumnPointers(pJacobianColumnPointers),
+    mJacobianRowIndices(pJacobianRowIndices),
+    mRatesStatesCount(pRatesStatesCount)
 {
+    // Allocate the scratch arrays needed to compute our Jacobian, if any
+
+    if (pComputeJacobian != nullptr) {
+        mRates.resize(pRatesStatesCount);
+        mJacobian.resize(pJacobianRowIndices.count());
+    }
 }
 
 //==============================================================================
@@ -113,7 +227,117 @@ Solver::OdeSolver::ComputeRatesFunction CvodeSolverUserData::computeRates() cons
 
 //==============================================================================
 
+void CvodeSolverUserData::setComputeRates(Solver::OdeSolver::ComputeRatesFunction pComputeRates)
+{
+    // Set our compute rates function
+
+    mComputeRates = pComputeRates;
+}
+
+//==============================================================================
+
+Solver::OdeSolver::ComputeJacobianFunction CvodeSolverUserData::computeJacobian() const
+{
+    // Return our compute Jacobian function
+
+    return mComputeJacobian;
+}
+
+//==============================================================================
+
+void CvodeSolverUserData::setComputeJacobian(Solver::OdeSolver::ComputeJacobianFunction pComputeJacobian)
+{
+    // Set our compute Jacobian function
+
+    mComputeJacobian = pComputeJacobian;
+}
+
+//==============================================================================
+
+const QVector<int> & CvodeSolverUserData::jacobianColumnPointers() const
+{
+    // Return the column pointers of the sparsity pattern of our Jacobian
+
+    return mJacobianColumnPointers;
+}
+
+//==============================================================================
+
+const QVector<int> & CvodeSolverUserData::jacobianRowIndices() const
+{
+    // Return the row indices of the sparsity pattern of our Jacobian
+
+    return mJacobianRowIndices;
+}
+
+//==============================================================================
+
+int CvodeSolverUserData::ratesStatesCount() const
+{
+    // Return our number of rates/states
+
+    return mRatesStatesCount;
+}
+
+//==============================================================================
+
+double * CvodeSolverUserData::rates()
+{
+    // Return our scratch rates array
+
+    return mRates.data();
+}
+
+//==============================================================================
+
+double * CvodeSolverUserData::jacobian()
+{
+    // Return our scratch Jacobian array
+
+    return mJacobian.data();
+}
+
+//==============================================================================
+
+void * CvodeSolverUserData::solver() const
+{
+    // Return our CVODES solver
+
+    return mSolver;
+}
+
+//==============================================================================
+
+Solver::FiniteDifferenceJacobian * CvodeSolverUserData::finiteDifferenceJacobian() const
+{
+    // Return our finite-difference Jacobian, if any
+
+    return mFiniteDifferenceJacobian;
+}
+
+//==============================================================================
+
+void CvodeSolverUserData::setFiniteDifferenceJacobian(void *pSolver,
+                                                      Solver::FiniteDifferenceJacobian *pFiniteDifferenceJacobian)
+{
+    // Set our finite-difference Jacobian and the CVODES solver that uses it
+
+    mSolver = pSolver;
+    mFiniteDifferenceJacobian = pFiniteDifferenceJacobian;
+}
+
+//==============================================================================
+
 CvodeSolver::~CvodeSolver()
+{
+    // Delete some internal objects
+
+    deleteInternals();
+}
+
+//==============================================================================
+
+void CvodeSolver::deleteInternals()
 {
     // Make sure that the solver has been initialised
 
@@ -121,7 +345,8 @@ CvodeSolver::~CvodeSolver()
         return;
     }
 
-    // Delete some internal objects
+    // Delete some internal objects and reset them, so that we can be
+    // initialised again
 
     N_VDestroy_Serial(mStatesVector);
     SUNLinSolFree(mLinearSolver);
@@ -130,7 +355,17 @@ CvodeSolver::~CvodeSolver()
 
     CVodeFree(&mSolver);
 
+    SUNContext_Free(&mContext);
+
     delete mUserData;
+    delete mFiniteDifferenceJacobian;
+
+    mStatesVector = nullptr;
+    mLinearSolver = nullptr;
+    mNonLinearSolver = nullptr;
+    mMatrix = nullptr;
+    mUserData = nullptr;
+    mFiniteDifferenceJacobian = nullptr;
 }
 
 //==============================================================================
@@ -283,6 +518,19 @@ void CvodeSolver::initialize(double pVoi, int pRatesStatesCount,
         return;
     }
 
+    if (mProperties.contains(OutputSolverStepsId)) {
+        mOutputSolverSteps = mProperties.value(OutputSolverStepsId).toBool();
+    } else {
+        emit error(tr(R"(the "Output solver steps" property value could not be retrieved)"));
+
+        return;
+    }
+
+    // Delete our previous internal objects, if any, in case we are being
+    // reused (e.g. by a simulation executor)
+
+    deleteInternals();
+
     // Initialise our ODE solver
 
     OdeSolver::initialize(pVoi, pRatesStatesCount, pConstants, pRates, pStates,
@@ -290,19 +538,17 @@ void CvodeSolver::initialize(double pVoi, int pRatesStatesCount,
 
     // Create our SUNDIALS context
 
-    SUNContext context;
-
-    SUNContext_Create(nullptr, &context);
+    SUNContext_Create(nullptr, &mContext);
 
     // Create our states vector
 
-    mStatesVector = N_VMake_Serial(pRatesStatesCount, pStates, context);
+    mStatesVector = N_VMake_Serial(pRatesStatesCount, pStates, mContext);
 
     // Create our CVODES solver
 
     bool newtonIteration = iterationType == NewtonIteration;
 
-    mSolver = CVodeCreate((integrationMethod == BdfMethod)?CV_BDF:CV_ADAMS, context);
+    mSolver = CVodeCreate((integrationMethod == BdfMethod)?CV_BDF:CV_ADAMS, mContext);
 
     // Use our own error handler
 
@@ -314,7 +560,13 @@ void CvodeSolver::initialize(double pVoi, int pRatesStatesCount,
 
     // Set our user data
 
-    mUserData = new CvodeSolverUserData(pConstants, pAlgebraic, pComputeRates);
+    bool analyticJacobian =    newtonIteration && (mComputeJacobian != nullptr)
+                            && ((linearSolver == DenseLinearSolver) || (linearSolver == BandedLinearSolver));
+
+    mUserData = new CvodeSolverUserData(pConstants, pAlgebraic, pComputeRates,
+                                        analyticJacobian?mComputeJacobian:nullptr,
+                                        mJacobianColumnPointers,
+                                        mJacobianRowIndices, pRatesStatesCount);
 
     CVodeSetUserData(mSolver, mUserData);
 
@@ -330,14 +582,14 @@ void CvodeSolver::initialize(double pVoi, int pRatesStatesCount,
 
     if (newtonIteration) {
         if (linearSolver == DenseLinearSolver) {
-            mMatrix = SUNDenseMatrix(pRatesStatesCount, pRatesStatesCount, context);
-            mLinearSolver = SUNLinSol_Dense(mStatesVector, mMatrix, context);
+            mMatrix = SUNDenseMatrix(pRatesStatesCount, pRatesStatesCount, mContext);
+            mLinearSolver = SUNLinSol_Dense(mStatesVector, mMatrix, mContext);
 
             CVodeSetLinearSolver(mSolver, mLinearSolver, mMatrix);
         } else if (linearSolver == BandedLinearSolver) {
             mMatrix = SUNBandMatrix(pRatesStatesCount, upperHalfBandwidth,
-                                                       lowerHalfBandwidth, context);
-            mLinearSolver = SUNLinSol_Band(mStatesVector, mMatrix, context);
+                                                       lowerHalfBandwidth, mContext);
+            mLinearSolver = SUNLinSol_Band(mStatesVector, mMatrix, mContext);
 
             CVodeSetLinearSolver(mSolver, mLinearSolver, mMatrix);
         } else if (linearSolver == DiagonalLinearSolver) {
@@ -347,11 +599,11 @@ void CvodeSolver::initialize(double pVoi, int pRatesStatesCount,
 
             if (preconditioner == BandedPreconditioner) {
                 if (linearSolver == GmresLinearSolver) {
-                    mLinearSolver = SUNLinSol_SPGMR(mStatesVector, PREC_LEFT, 0, context);
+                    mLinearSolver = SUNLinSol_SPGMR(mStatesVector, PREC_LEFT, 0, mContext);
                 } else if (linearSolver == BiCgStabLinearSolver) {
-                    mLinearSolver = SUNLinSol_SPBCGS(mStatesVector, PREC_LEFT, 0, context);
+                    mLinearSolver = SUNLinSol_SPBCGS(mStatesVector, PREC_LEFT, 0, mContext);
                 } else {
-                    mLinearSolver = SUNLinSol_SPTFQMR(mStatesVector, PREC_LEFT, 0, context);
+                    mLinearSolver = SUNLinSol_SPTFQMR(mStatesVector, PREC_LEFT, 0, mContext);
                 }
 
                 CVodeSetLinearSolver(mSolver, mLinearSolver, mMatrix);
@@ -359,18 +611,57 @@ void CvodeSolver::initialize(double pVoi, int pRatesStatesCount,
                                                            lowerHalfBandwidth);
             } else {
                 if (linearSolver == GmresLinearSolver) {
-                    mLinearSolver = SUNLinSol_SPGMR(mStatesVector, PREC_NONE, 0, context);
+                    mLinearSolver = SUNLinSol_SPGMR(mStatesVector, PREC_NONE, 0, mContext);
                 } else if (linearSolver == BiCgStabLinearSolver) {
-                    mLinearSolver = SUNLinSol_SPBCGS(mStatesVector, PREC_NONE, 0, context);
+                    mLinearSolver = SUNLinSol_SPBCGS(mStatesVector, PREC_NONE, 0, mContext);
                 } else {
-                    mLinearSolver = SUNLinSol_SPTFQMR(mStatesVector, PREC_NONE, 0, context);
+                    mLinearSolver = SUNLinSol_SPTFQMR(mStatesVector, PREC_NONE, 0, mContext);
                 }
 
                 CVodeSetLinearSolver(mSolver, mLinearSolver, mMatrix);
             }
         }
+
+        // Use our model's Jacobian rather than have CVODES approximate it
+        // using finite differences, if possible
+
+        if (analyticJacobian) {
+            CVodeSetJacFn(mSolver, jacobianFunction);
+        } else if (   (linearSolver == DenseLinearSolver)
+                   || (linearSolver == BandedLinearSolver)) {
+            // We don't have our model's Jacobian, so approximate it using
+            // finite differences, but with coloured columns, using the
+            // sparsity pattern of our model's Jacobian or, if we don't know
+            // it, by probing our model
+            // Note: this is only worth it if we need fewer colours than
+            //       columns, otherwise we let CVODES do its own thing...
+
+            QVector<int> columnPointers = mJacobianColumnPointers;
+            QVector<int> rowIndices = mJacobianRowIndices;
+
+            if (columnPointers.isEmpty()) {
+                OpenCOR::Solver::FiniteDifferenceJacobian::probeSparsityPattern(pRatesStatesCount, pStates,
+                                                                                [=](double *pX, double *pF) {
+                    pComputeRates(pVoi, pConstants, pF, pX, pAlgebraic);
+                }, columnPointers, rowIndices);
+            }
+
+            auto finiteDifferenceJacobian = new OpenCOR::Solver::FiniteDifferenceJacobian(pRatesStatesCount,
+                                                                                           columnPointers,
+                                                                                           rowIndices);
+
+            if (finiteDifferenceJacobian->coloursCount() < pRatesStatesCount) {
+                mFiniteDifferenceJacobian = finiteDifferenceJacobian;
+
+                mUserData->setFiniteDifferenceJacobian(mSolver, finiteDifferenceJacobian);
+
+                CVodeSetJacFn(mSolver, jacobianFunction);
+            } else {
+                delete finiteDifferenceJacobian;
+            }
+        }
     } else {
-        mNonLinearSolver = SUNNonlinSol_FixedPoint(mStatesVector, 0, context);
+        mNonLinearSolver = SUNNonlinSol_FixedPoint(mStatesVector, 0, mContext);
 
         CVodeSetNonlinearSolver(mSolver, mNonLinearSolver);
     }
@@ -391,15 +682,68 @@ void CvodeSolver::reinitialize(double pVoi)
 
 //==============================================================================
 
+void CvodeSolver::setComputeRates(ComputeRatesFunction pComputeRates)
+{
+    // Use the given compute rates function, both for ourselves and for our
+    // RHS function
+
+    OdeSolver::setComputeRates(pComputeRates);
+
+    if (mUserData != nullptr) {
+        mUserData->setComputeRates(pComputeRates);
+    }
+}
+
+//==============================================================================
+
+void CvodeSolver::setComputeJacobian(ComputeJacobianFunction pComputeJacobian)
+{
+    // Use the given compute Jacobian function, both for ourselves and for our
+    // Jacobian function, if we use it
+
+    OdeSolver::setComputeJacobian(pComputeJacobian);
+
+    if ((mUserData != nullptr) && (mUserData->computeJacobian() != nullptr)) {
+        mUserData->setComputeJacobian(pComputeJacobian);
+    }
+}
+
+//==============================================================================
+
 void CvodeSolver::solve(double &pVoi, double pVoiEnd) const
 {
     // Solve the model
+    // Note: if we are to output our solver steps, then we take at most one
+    //       internal step, so that our caller can record each of them. We let
+    //       CVODES step freely (i.e. without a stop time, even if we are not to
+    //       interpolate our solution) and if its step takes us to or past
+    //       pVoiEnd (or if a previous step already did), then we use dense
+    //       output (i.e. CVodeGetDky()) to retrieve our solution at pVoiEnd, as
+    //       CVode() does in CV_NORMAL mode...
 
-    if (!mInterpolateSolution) {
-        CVodeSetStopTime(mSolver, pVoiEnd);
-    }
+    if (mOutputSolverSteps) {
+        double voi;
+
+        CVodeGetCurrentTime(mSolver, &voi);
 
-    CVode(mSolver, pVoiEnd, mStatesVector, &pVoi, CV_NORMAL);
+        if (voi < pVoiEnd) {
+            CVode(mSolver, pVoiEnd, mStatesVector, &voi, CV_ONE_STEP);
+        }
+
+        if (voi >= pVoiEnd) {
+            CVodeGetDky(mSolver, pVoiEnd, 0, mStatesVector);
+
+            pVoi = pVoiEnd;
+        } else {
+            pVoi = voi;
+        }
+    } else {
+        if (!mInterpolateSolution) {
+            CVodeSetStopTime(mSolver, pVoiEnd);
+        }
+
+        CVode(mSolver, pVoiEnd, mStatesVector, &pVoi, CV_NORMAL);
+    }
 
     // Compute the rates one more time to get up to date values for the rates
     // Note: another way of doing this would be to copy the contents of the
@@ -408,7 +752,7 @@ void CvodeSolver::solve(double &pVoi, double pVoiEnd) const
     //       few calls to rhsFunction(), so that would be quite a few memory
     //       transfers while here we 'only' compute the rates one more time...
 
-    mComputeRates(pVoiEnd, mConstants, mRates,
+    mComputeRates(pVoi, mConstants, mRates,
                   N_VGetArrayPointer_Serial(mStatesVector), mAlgebraic);
 }
 
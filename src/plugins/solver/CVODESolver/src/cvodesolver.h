@@ -53,6 +53,7 @@ static const auto LowerHalfBandwidthId   = QStringLiteral("LowerHalfBandwidth");
 static const auto RelativeToleranceId    = QStringLiteral("RelativeTolerance");
 static const auto AbsoluteToleranceId    = QStringLiteral("AbsoluteTolerance");
 static const auto InterpolateSolutionId  = QStringLiteral("InterpolateSolution");
+static const auto OutputSolverStepsId    = QStringLiteral("OutputSolverSteps");
 
 //==============================================================================
 
@@ -106,6 +107,7 @@ static const double RelativeToleranceDefaultValue = 1.0e-7;
 static const double AbsoluteToleranceDefaultValue = 1.0e-7;
 
 static const bool InterpolateSolutionDefaultValue = true;
+static const bool OutputSolverStepsDefaultValue = false;
 
 //==============================================================================
 
@@ -113,18 +115,51 @@ class CvodeSolverUserData
 {
 public:
     explicit CvodeSolverUserData(double *pConstants, double *pAlgebraic,
-                                 Solver::OdeSolver::ComputeRatesFunction pComputeRates);
+                                 Solver::OdeSolver::ComputeRatesFunction pComputeRates,
+                                 Solver::OdeSolver::ComputeJacobianFunction pComputeJacobian,
+                                 const QVector<int> &pJacobianColumnPointers,
+                                 const QVector<int> &pJacobianRowIndices,
+                                 int pRatesStatesCount);
 
     double * constants() const;
     double * algebraic() const;
 
     Solver::OdeSolver::ComputeRatesFunction computeRates() const;
+    void setComputeRates(Solver::OdeSolver::ComputeRatesFunction pComputeRates);
+
+    Solver::OdeSolver::ComputeJacobianFunction computeJacobian() const;
+    void setComputeJacobian(Solver::OdeSolver::ComputeJacobianFunction pComputeJacobian);
+
+    const QVector<int> & jacobianColumnPointers() const;
+    const QVector<int> & jacobianRowIndices() const;
+
+    int ratesStatesCount() const;
+
+    double * rates();
+    double * jacobian();
+
+    void * solver() const;
+    Solver::FiniteDifferenceJacobian * finiteDifferenceJacobian() const;
+    void setFiniteDifferenceJacobian(void *pSolver,
+                                     Solver::FiniteDifferenceJacobian *pFiniteDifferenceJacobian);
 
 private:
     double *mConstants;
     double *mAlgebraic;
 
     Solver::OdeSolver::ComputeRatesFunction mComputeRates;
+    Solver::OdeSolver::ComputeJacobianFunction mComputeJacobian;
+
+    QVector<int> mJacobianColumnPointers;
+    QVector<int> mJacobianRowIndices;
+
+    int mRatesStatesCount;
+
+    QVector<double> mRates;
+    QVector<double> mJacobian;
+
+    void *mSolver = nullptr;
+    Solver::FiniteDifferenceJacobian *mFiniteDifferenceJacobian = nullptr;
 };
 
 //==============================================================================
@@ -141,9 +176,14 @@ public:
                     ComputeRatesFunction pComputeRates) override;
     void reinitialize(double pVoi) override;
 
+    void setComputeRates(ComputeRatesFunction pComputeRates) override;
+    void setComputeJacobian(ComputeJacobianFunction pComputeJacobian) override;
+
     void solve(double &pVoi, double pVoiEnd) const override;
 
 private:
+    SUNContext mContext = nullptr;
+
     void *mSolver = nullptr;
 
     N_Vector mStatesVector = nullptr;
@@ -154,7 +194,12 @@ private:
 
     CvodeSolverUserData *mUserData = nullptr;
 
+    Solver::FiniteDifferenceJacobian *mFiniteDifferenceJacobian = nullptr;
+
     bool mInterpolateSolution = InterpolateSolutionDefaultValue;
+    bool mOutputSolverSteps = OutputSolverStepsDefaultValue;
+
+    void deleteInternals();
 };
 
 //==============================================================================
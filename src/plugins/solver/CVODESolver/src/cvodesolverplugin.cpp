@@ -261,6 +261,10 @@ Solver::Properties CVODESolverPlugin::solverProperties() const
                                                                     { "en", QString::fromUtf8("Interpolate solution") },
                                                                     { "fr", QString::fromUtf8("Interpoler solution") }
                                                                 };
+    static const Descriptions OutputSolverStepsDescriptions = {
+                                                                  { "en", QString::fromUtf8("Output solver steps") },
+                                                                  { "fr", QString::fromUtf8("Sortir pas du solveur") }
+                                                              };
     static const QStringList IntegrationMethodListValues = {
                                                                AdamsMoultonMethod,
                                                                BdfMethod
@@ -292,7 +296,8 @@ Solver::Properties CVODESolverPlugin::solverProperties() const
              Solver::Property(Solver::Property::Type::IntegerGe0, LowerHalfBandwidthId, LowerHalfBandwidthDescriptions, {}, LowerHalfBandwidthDefaultValue, false),
              Solver::Property(Solver::Property::Type::DoubleGe0, RelativeToleranceId, RelativeToleranceDescriptions, {}, RelativeToleranceDefaultValue, false),
              Solver::Property(Solver::Property::Type::DoubleGe0, AbsoluteToleranceId, AbsoluteToleranceDescriptions, {}, AbsoluteToleranceDefaultValue, false),
-             Solver::Property(Solver::Property::Type::Boolean, InterpolateSolutionId, InterpolateSolutionDescriptions, {}, InterpolateSolutionDefaultValue, false) };
+             Solver::Property(Solver::Property::Type::Boolean, InterpolateSolutionId, InterpolateSolutionDescriptions, {}, InterpolateSolutionDefaultValue, false),
+             Solver::Property(Solver::Property::Type::Boolean, OutputSolverStepsId, OutputSolverStepsDescriptions, {}, OutputSolverStepsDefaultValue, false) };
 }
 
 //==============================================================================
@@ -0,0 +1,466 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Dormand-Prince solver
+//==============================================================================
+
+#include "dormandprincesolver.h"
+
+//==============================================================================
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace DormandPrinceSolver {
+
+//==============================================================================
+
+static bool isFinite(double pValue)
+{
+    // Return whether the given value is finite, i.e. whether its exponent bits
+    // are not all set
+    // Note: our release builds use -ffast-math, so qIsFinite() may get
+    //       optimised away, hence we check the bits of the given value...
+
+    static const quint64 ExponentMask = 0x7ff0000000000000ULL;
+
+    quint64 bits;
+
+    memcpy(&bits, &pValue, sizeof(quint64));
+
+    return (bits & ExponentMask) != ExponentMask;
+}
+
+//==============================================================================
+
+DormandPrinceSolver::~DormandPrinceSolver()
+{
+    // Delete some internal objects
+
+    deleteArrays();
+}
+
+//==============================================================================
+
+void DormandPrinceSolver::deleteArrays()
+{
+    // Delete our various arrays
+
+    delete[] mK1;
+    delete[] mK2;
+    delete[] mK3;
+    delete[] mK4;
+    delete[] mK5;
+    delete[] mK6;
+    delete[] mK7;
+    delete[] mYk;
+    delete[] mYNew;
+}
+
+//==============================================================================
+
+void DormandPrinceSolver::initialize(double pVoi, int pRatesStatesCount,
+                                     double *pConstants, double *pRates,
+                                     double *pStates, double *pAlgebraic,
+                                     ComputeRatesFunction pComputeRates)
+{
+    // Retrieve the solver's properties
+
+    if (mProperties.contains(MaximumStepId)) {
+        mMaximumStep = mProperties.value(MaximumStepId).toDouble();
+    } else {
+        emit error(tr(R"(the "Maximum step" property value could not be retrieved)"));
+
+        return;
+    }
+
+    if (mProperties.contains(MaximumNumberOfStepsId)) {
+        mMaximumNumberOfSteps = mProperties.value(MaximumNumberOfStepsId).toInt();
+    } else {
+        emit error(tr(R"(the "Maximum number of steps" property value could not be retrieved)"));
+
+        return;
+    }
+
+    if (mProperties.contains(RelativeToleranceId)) {
+        mRelativeTolerance = mProperties.value(RelativeToleranceId).toDouble();
+    } else {
+        emit error(tr(R"(the "Relative tolerance" property value could not be retrieved)"));
+
+        return;
+    }
+
+    if (mProperties.contains(AbsoluteToleranceId)) {
+        mAbsoluteTolerance = mProperties.value(AbsoluteToleranceId).toDouble();
+    } else {
+        emit error(tr(R"(the "Absolute tolerance" property value could not be retrieved)"));
+
+        return;
+    }
+
+    // Initialise the ODE solver itself
+
+    OdeSolver::initialize(pVoi, pRatesStatesCount, pConstants, pRates, pStates,
+                          pAlgebraic, pComputeRates);
+
+    // (Re)create our various arrays
+
+    deleteArrays();
+
+    mK1 = new double[pRatesStatesCount] {};
+    mK2 = new double[pRatesStatesCount] {};
+    mK3 = new double[pRatesStatesCount] {};
+    mK4 = new double[pRatesStatesCount] {};
+    mK5 = new double[pRatesStatesCount] {};
+    mK6 = new double[pRatesStatesCount] {};
+    mK7 = new double[pRatesStatesCount] {};
+    mYk = new double[pRatesStatesCount] {};
+    mYNew = new double[pRatesStatesCount] {};
+
+    // Reset our step size control
+
+    mStep = 0.0;
+
+    reinitialize(pVoi);
+}
+
+//==============================================================================
+
+void DormandPrinceSolver::reinitialize(double pVoi)
+{
+    Q_UNUSED(pVoi)
+
+    // Our states may have been changed from outside, so our last evaluation of
+    // our rates (which we would otherwise reuse as the first stage of our next
+    // step) and our error history cannot be trusted anymore
+    // Note: our step size, on the other hand, is still a good guess, so we keep
+    //       it...
+
+    mK1Valid = false;
+    mPreviousError = 1.0e-4;
+}
+
+//==============================================================================
+
+void DormandPrinceSolver::computeK(double pVoi, double *pStates,
+                                   double *pK) const
+{
+    // Compute f(pVoi, pStates) and keep a copy of it in the given array
+
+    computeRates(pVoi, pStates);
+
+    memcpy(pK, mRates, size_t(mRatesStatesCount)*OpenCOR::Solver::SizeOfDouble);
+}
+
+//==============================================================================
+
+double DormandPrinceSolver::norm(const double *pValues,
+                                 const double *pStates) const
+{
+    // Return the root-mean-square norm of the given values, scaled using our
+    // tolerances and the given states
+
+    double res = 0.0;
+
+    for (int i = 0; i < mRatesStatesCount; ++i) {
+        double value = pValues[i]/(mAbsoluteTolerance+mRelativeTolerance*qAbs(pStates[i]));
+
+        res += value*value;
+    }
+
+    return std::sqrt(res/mRatesStatesCount);
+}
+
+//==============================================================================
+
+double DormandPrinceSolver::initialStep(double pVoi) const
+{
+    // Determine an initial step, based on the size of our states and of their
+    // first and (an estimate of their) second derivatives
+    // Note: this is the algorithm used by Hairer and Wanner in DOPRI5, but
+    //       using root-mean-square norms...
+
+    double statesNorm = norm(mStates, mStates);
+    double ratesNorm = norm(mK1, mStates);
+    double res = ((statesNorm <= 1.0e-10) || (ratesNorm <= 1.0e-10))?
+                     1.0e-6:
+                     0.01*statesNorm/ratesNorm;
+
+    if (mMaximumStep > 0.0) {
+        res = qMin(res, mMaximumStep);
+    }
+
+    // Take an explicit Euler step and use it to estimate the norm of our
+    // second derivatives
+
+    for (int i = 0; i < mRatesStatesCount; ++i) {
+        mYk[i] = mStates[i]+res*mK1[i];
+    }
+
+    computeK(pVoi+res, mYk, mK2);
+
+    for (int i = 0; i < mRatesStatesCount; ++i) {
+        mK3[i] = mK2[i]-mK1[i];
+    }
+
+    double derivativesNorm = qMax(norm(mK3, mStates)/res, ratesNorm);
+    double step = (derivativesNorm <= 1.0e-15)?
+                      qMax(1.0e-6, 1.0e-3*res):
+                      std::pow(0.01/derivativesNorm, 0.2);
+
+    res = qMin(100.0*res, step);
+
+    if (mMaximumStep > 0.0) {
+        res = qMin(res, mMaximumStep);
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+void DormandPrinceSolver::solve(double &pVoi, double pVoiEnd) const
+{
+    // k1 = f(t_n, Y_n)
+    // k2 = f(t_n + c2 h, Y_n + h (a21 k1))
+    // ...
+    // k7 = f(t_n + h, Y_n + h (a71 k1 + a73 k3 + a74 k4 + a75 k5 + a76 k6))
+    // Y_n+1 = Y_n + h (a71 k1 + a73 k3 + a74 k4 + a75 k5 + a76 k6)
+    // E_n+1 = h (e1 k1 + e3 k3 + e4 k4 + e5 k5 + e6 k6 + e7 k7)
+
+    // Note #1: the fifth-order solution is used to advance through time while
+    //          the difference with the embedded fourth-order solution gives us
+    //          an estimate of our local error, which we use to accept or reject
+    //          a step and to determine the next one using a PI controller (see
+    //          Hairer and Wanner's DOPRI5)...
+    // Note #2: k7 is computed using Y_n+1, so it is the k1 of our next step
+    //          (i.e. First Same As Last, or FSAL), meaning that an accepted
+    //          step requires six evaluations of our rates rather than seven...
+
+    static const double C2 = 1.0/5.0;
+    static const double C3 = 3.0/10.0;
+    static const double C4 = 4.0/5.0;
+    static const double C5 = 8.0/9.0;
+
+    static const double A21 = 1.0/5.0;
+    static const double A31 = 3.0/40.0;
+    static const double A32 = 9.0/40.0;
+    static const double A41 = 44.0/45.0;
+    static const double A42 = -56.0/15.0;
+    static const double A43 = 32.0/9.0;
+    static const double A51 = 19372.0/6561.0;
+    static const double A52 = -25360.0/2187.0;
+    static const double A53 = 64448.0/6561.0;
+    static const double A54 = -212.0/729.0;
+    static const double A61 = 9017.0/3168.0;
+    static const double A62 = -355.0/33.0;
+    static const double A63 = 46732.0/5247.0;
+    static const double A64 = 49.0/176.0;
+    static const double A65 = -5103.0/18656.0;
+    static const double A71 = 35.0/384.0;
+    static const double A73 = 500.0/1113.0;
+    static const double A74 = 125.0/192.0;
+    static const double A75 = -2187.0/6784.0;
+    static const double A76 = 11.0/84.0;
+
+    static const double E1 = 71.0/57600.0;
+    static const double E3 = -71.0/16695.0;
+    static const double E4 = 71.0/1920.0;
+    static const double E5 = -17253.0/339200.0;
+    static const double E6 = 22.0/525.0;
+    static const double E7 = -1.0/40.0;
+
+    static const double Safety = 0.9;
+    static const double MinimumFactor = 0.2;
+    static const double MaximumFactor = 10.0;
+    static const double Beta = 0.04;
+    static const double Alpha = 0.2-0.75*Beta;
+
+    static const double UnitRoundoff = std::numeric_limits<double>::epsilon();
+    static const double MinimumStep = std::numeric_limits<double>::min();
+
+    // Make sure that we know f(t_n, Y_n) and have a step to start with
+
+    if (!mK1Valid) {
+        computeK(pVoi, mStates, mK1);
+
+        mK1Valid = true;
+    }
+
+    if (mStep <= 0.0) {
+        mStep = initialStep(pVoi);
+    }
+
+    bool rejected = false;
+    int stepsCount = 0;
+
+    while (!qFuzzyCompare(pVoi, pVoiEnd)) {
+        // Check that we haven't taken too many steps and that our step is
+        // valid, i.e. that it is finite and positive
+        // Note: we must check the latter explicitly since our loop would never
+        //       end otherwise...
+
+        double step = mStep;
+
+        if (++stepsCount > mMaximumNumberOfSteps) {
+            const_cast<DormandPrinceSolver *>(this)->emitError(tr("the maximum number of steps (%1) was reached at %2").arg(mMaximumNumberOfSteps)
+                                                                                                                        .arg(pVoi));
+
+            return;
+        }
+
+        if (!isFinite(step) || (step <= 0.0)) {
+            const_cast<DormandPrinceSolver *>(this)->emitError(tr("the step became invalid at %1").arg(pVoi));
+
+            return;
+        }
+
+        // Check that our step doesn't take us past pVoiEnd and that it isn't
+        // too small
+        // Note #1: a step that would take us just short of pVoiEnd is also our
+        //          last step, or we would stop there (see our loop condition)
+        //          rather than at pVoiEnd...
+        // Note #2: our step is too small if it cannot make a difference to
+        //          pVoi or pVoiEnd, with an absolute minimum for when both of
+        //          them are (close to) zero...
+
+        bool lastStep = (pVoi+step >= pVoiEnd) || qFuzzyCompare(pVoi+step, pVoiEnd);
+
+        if (lastStep) {
+            step = pVoiEnd-pVoi;
+        } else if (step <= qMax(16.0*UnitRoundoff*qMax(qAbs(pVoi), qAbs(pVoiEnd)), MinimumStep)) {
+            const_cast<DormandPrinceSolver *>(this)->emitError(tr("the step became too small at %1").arg(pVoi));
+
+            return;
+        }
+
+        // Compute k2 to k6
+
+        for (int i = 0; i < mRatesStatesCount; ++i) {
+            mYk[i] = mStates[i]+step*A21*mK1[i];
+        }
+
+        computeK(pVoi+C2*step, mYk, mK2);
+
+        for (int i = 0; i < mRatesStatesCount; ++i) {
+            mYk[i] = mStates[i]+step*(A31*mK1[i]+A32*mK2[i]);
+        }
+
+        computeK(pVoi+C3*step, mYk, mK3);
+
+        for (int i = 0; i < mRatesStatesCount; ++i) {
+            mYk[i] = mStates[i]+step*(A41*mK1[i]+A42*mK2[i]+A43*mK3[i]);
+        }
+
+        computeK(pVoi+C4*step, mYk, mK4);
+
+        for (int i = 0; i < mRatesStatesCount; ++i) {
+            mYk[i] = mStates[i]+step*(A51*mK1[i]+A52*mK2[i]+A53*mK3[i]+A54*mK4[i]);
+        }
+
+        computeK(pVoi+C5*step, mYk, mK5);
+
+        for (int i = 0; i < mRatesStatesCount; ++i) {
+            mYk[i] = mStates[i]+step*(A61*mK1[i]+A62*mK2[i]+A63*mK3[i]+A64*mK4[i]+A65*mK5[i]);
+        }
+
+        computeK(pVoi+step, mYk, mK6);
+
+        // Compute Y_n+1 and k7
+
+        for (int i = 0; i < mRatesStatesCount; ++i) {
+            mYNew[i] = mStates[i]+step*(A71*mK1[i]+A73*mK3[i]+A74*mK4[i]+A75*mK5[i]+A76*mK6[i]);
+        }
+
+        computeK(pVoi+step, mYNew, mK7);
+
+        // Estimate our local error
+
+        double error = 0.0;
+
+        for (int i = 0; i < mRatesStatesCount; ++i) {
+            double localError = step*(E1*mK1[i]+E3*mK3[i]+E4*mK4[i]+E5*mK5[i]+E6*mK6[i]+E7*mK7[i])
+                               /(mAbsoluteTolerance+mRelativeTolerance*qMax(qAbs(mStates[i]), qAbs(mYNew[i])));
+
+            error += localError*localError;
+        }
+
+        error = std::sqrt(error/mRatesStatesCount);
+
+        if (!isFinite(error)) {
+            error = std::numeric_limits<double>::max();
+        }
+
+        // Accept or reject our step and determine our next step
+
+        double errorFactor = std::pow(error, Alpha);
+
+        if (error <= 1.0) {
+            double factor = qBound(1.0/MaximumFactor,
+                                   errorFactor/std::pow(mPreviousError, Beta)/Safety,
+                                   1.0/MinimumFactor);
+            double newStep = step/factor;
+
+            if (rejected) {
+                newStep = qMin(newStep, step);
+            }
+
+            memcpy(mStates, mYNew, size_t(mRatesStatesCount)*OpenCOR::Solver::SizeOfDouble);
+            memcpy(mK1, mK7, size_t(mRatesStatesCount)*OpenCOR::Solver::SizeOfDouble);
+
+            mPreviousError = qMax(error, 1.0e-4);
+
+            // Advance through time and keep track of our next step
+            // Note: if our step was shortened so as not to go past pVoiEnd,
+            //       then we don't want it to shrink our next step...
+
+            if (lastStep) {
+                pVoi = pVoiEnd;
+                mStep = qMax(mStep, newStep);
+            } else {
+                pVoi += step;
+                mStep = newStep;
+            }
+
+            rejected = false;
+        } else {
+            mStep = step/qMin(1.0/MinimumFactor, errorFactor/Safety);
+
+            rejected = true;
+        }
+
+        if (mMaximumStep > 0.0) {
+            mStep = qMin(mStep, mMaximumStep);
+        }
+    }
+}
+
+//==============================================================================
+
+} // namespace DormandPrinceSolver
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
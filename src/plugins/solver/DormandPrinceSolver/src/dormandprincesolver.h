@@ -0,0 +1,113 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Dormand-Prince solver
+//==============================================================================
+
+#pragma once
+
+//==============================================================================
+
+#include "solverinterface.h"
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace DormandPrinceSolver {
+
+//==============================================================================
+
+static const auto MaximumStepId          = QStringLiteral("MaximumStep");
+static const auto MaximumNumberOfStepsId = QStringLiteral("MaximumNumberOfSteps");
+static const auto RelativeToleranceId    = QStringLiteral("RelativeTolerance");
+static const auto AbsoluteToleranceId    = QStringLiteral("AbsoluteTolerance");
+
+//==============================================================================
+
+// Default Dormand-Prince parameter values
+// Note #1: a maximum step of 0 means that there is no maximum step as such and
+//          that we can use whatever step our error control allows...
+// Note #2: the maximum number of steps is the number of steps (be they
+//          accepted or rejected) that we can take to go from one point to the
+//          next, so it needs to be big enough for our error control to cope
+//          with coarse output intervals...
+
+static const double MaximumStepDefaultValue = 0.0;
+
+enum {
+    MaximumNumberOfStepsDefaultValue = 10000
+};
+
+static const double RelativeToleranceDefaultValue = 1.0e-7;
+static const double AbsoluteToleranceDefaultValue = 1.0e-7;
+
+//==============================================================================
+
+class DormandPrinceSolver : public OpenCOR::Solver::OdeSolver
+{
+    Q_OBJECT
+
+public:
+    ~DormandPrinceSolver() override;
+
+    void initialize(double pVoi, int pRatesStatesCount, double *pConstants,
+                    double *pRates, double *pStates, double *pAlgebraic,
+                    ComputeRatesFunction pComputeRates) override;
+    void reinitialize(double pVoi) override;
+
+    void solve(double &pVoi, double pVoiEnd) const override;
+
+private:
+    double mMaximumStep = MaximumStepDefaultValue;
+    int mMaximumNumberOfSteps = MaximumNumberOfStepsDefaultValue;
+    double mRelativeTolerance = RelativeToleranceDefaultValue;
+    double mAbsoluteTolerance = AbsoluteToleranceDefaultValue;
+
+    double *mK1 = nullptr;
+    double *mK2 = nullptr;
+    double *mK3 = nullptr;
+    double *mK4 = nullptr;
+    double *mK5 = nullptr;
+    double *mK6 = nullptr;
+    double *mK7 = nullptr;
+    double *mYk = nullptr;
+    double *mYNew = nullptr;
+
+    mutable double mStep = 0.0;
+    mutable double mPreviousError = 1.0e-4;
+    mutable bool mK1Valid = false;
+
+    void deleteArrays();
+
+    void computeK(double pVoi, double *pStates, double *pK) const;
+
+    double norm(const double *pValues, const double *pStates) const;
+
+    double initialStep(double pVoi) const;
+};
+
+//==============================================================================
+
+} // namespace DormandPrinceSolver
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
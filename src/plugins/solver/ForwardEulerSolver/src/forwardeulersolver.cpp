@@ -53,6 +53,16 @@ void ForwardEulerSolver::initialize(double pVoi, int pRatesStatesCount,
 
 //==============================================================================
 
+bool ForwardEulerSolver::supportsBatch() const
+{
+    // We support batches of instances since we update our states entry by
+    // entry
+
+    return true;
+}
+
+//==============================================================================
+
 void ForwardEulerSolver::solve(double &pVoi, double pVoiEnd) const
 {
     // Y_n+1 = Y_n + h * f(t_n, Y_n)
@@ -71,7 +81,7 @@ void ForwardEulerSolver::solve(double &pVoi, double pVoiEnd) const
 
         // Compute f(t_n, Y_n)
 
-        mComputeRates(pVoi, mConstants, mRates, mStates, mAlgebraic);
+        computeRates(pVoi, mStates);
 
         // Compute Y_n+1
 
@@ -51,6 +51,8 @@ public:
                     double *pRates, double *pStates, double *pAlgebraic,
                     ComputeRatesFunction pComputeRates) override;
 
+    bool supportsBatch() const override;
+
     void solve(double &pVoi, double pVoiEnd) const override;
 
 private:
@@ -75,6 +75,16 @@ void FourthOrderRungeKuttaSolver::initialize(double pVoi, int pRatesStatesCount,
 
 //==============================================================================
 
+bool FourthOrderRungeKuttaSolver::supportsBatch() const
+{
+    // We support batches of instances since we update our states entry by
+    // entry
+
+    return true;
+}
+
+//==============================================================================
+
 void FourthOrderRungeKuttaSolver::solve(double &pVoi, double pVoiEnd) const
 {
     // k1 = h * f(t_n, Y_n)
@@ -105,7 +115,7 @@ void FourthOrderRungeKuttaSolver::solve(double &pVoi, double pVoiEnd) const
 
         // Compute f(t_n, Y_n)
 
-        mComputeRates(pVoi, mConstants, mRates, mStates, mAlgebraic);
+        computeRates(pVoi, mStates);
 
         // Compute k1 and Yk1
 
@@ -116,7 +126,7 @@ void FourthOrderRungeKuttaSolver::solve(double &pVoi, double pVoiEnd) const
 
         // Compute f(t_n + h / 2, Y_n + k1 / 2)
 
-        mComputeRates(pVoi+realHalfStep, mConstants, mRates, mYk123, mAlgebraic);
+        computeRates(pVoi+realHalfStep, mYk123);
 
         // Compute k2 and Yk2
 
@@ -127,7 +137,7 @@ void FourthOrderRungeKuttaSolver::solve(double &pVoi, double pVoiEnd) const
 
         // Compute f(t_n + h / 2, Y_n + k2 / 2)
 
-        mComputeRates(pVoi+realHalfStep, mConstants, mRates, mYk123, mAlgebraic);
+        computeRates(pVoi+realHalfStep, mYk123);
 
         // Compute k3 and Yk3
 
@@ -138,7 +148,7 @@ void FourthOrderRungeKuttaSolver::solve(double &pVoi, double pVoiEnd) const
 
         // Compute f(t_n + h, Y_n + k3)
 
-        mComputeRates(pVoi+realStep, mConstants, mRates, mYk123, mAlgebraic);
+        computeRates(pVoi+realStep, mYk123);
 
         // Compute k4 and therefore Y_n+1
 
@@ -71,6 +71,16 @@ void HeunSolver::initialize(double pVoi, int pRatesStatesCount,
 
 //==============================================================================
 
+bool HeunSolver::supportsBatch() const
+{
+    // We support batches of instances since we update our states entry by
+    // entry
+
+    return true;
+}
+
+//==============================================================================
+
 void HeunSolver::solve(double &pVoi, double pVoiEnd) const
 {
     // k = h * f(t_n, Y_n)
@@ -92,7 +102,7 @@ void HeunSolver::solve(double &pVoi, double pVoiEnd) const
 
         // Compute f(t_n, Y_n)
 
-        mComputeRates(pVoi, mConstants, mRates, mStates, mAlgebraic);
+        computeRates(pVoi, mStates);
 
         // Compute k and Yk
 
@@ -103,7 +113,7 @@ void HeunSolver::solve(double &pVoi, double pVoiEnd) const
 
         // Compute f(t_n + h, Y_n + k)
 
-        mComputeRates(pVoi+realStep, mConstants, mRates, mYk, mAlgebraic);
+        computeRates(pVoi+realStep, mYk);
 
         // Compute Y_n+1
 
@@ -28,6 +28,7 @@ along with this program. If not, see <https://gnu.org/licenses>.
 #include "sundialsbegin.h"
     #include "kinsol/kinsol.h"
     #include "nvector/nvector_serial.h"
+    #include "sunmatrix/sunmatrix_dense.h"
     #include "sunlinsol/sunlinsol_band.h"
     #include "sunlinsol/sunlinsol_dense.h"
     #include "sunlinsol/sunlinsol_spbcgs.h"
@@ -37,6 +38,11 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 //==============================================================================
 
+#include <cmath>
+#include <limits>
+
+//==============================================================================
+
 namespace OpenCOR {
 namespace KINSOLSolver {
 
@@ -67,6 +73,62 @@ int systemFunction(N_Vector pY, N_Vector pF, void *pUserData)
 
 //==============================================================================
 
+int jacobianFunction(N_Vector pY, N_Vector pF, SUNMatrix pJacobian,
+                     void *pUserData, N_Vector pTemp1, N_Vector pTemp2)
+{
+    Q_UNUSED(pTemp2)
+
+    // Compute the Jacobian of our system function, either using our compute
+    // Jacobian function, which stores it in a dense column-major format (just
+    // like our dense matrix), or using finite differences with coloured
+    // columns
+    // Note: our finite-difference increments are the same as those used by
+    //       KINSOL's own finite-difference approximation, knowing that we
+    //       don't scale our parameters...
+
+    auto userData = static_cast<KinsolSolverUserData *>(pUserData);
+    Solver::FiniteDifferenceJacobian *finiteDifferenceJacobian = userData->finiteDifferenceJacobian();
+
+    SUNMatZero(pJacobian);
+
+    if (finiteDifferenceJacobian == nullptr) {
+        userData->computeJacobian()(N_VGetArrayPointer_Serial(pY),
+                                    SUNDenseMatrix_Data(pJacobian),
+                                    userData->userData());
+
+        return 0;
+    }
+
+    static const double SquareRootOfUnitRoundoff = std::sqrt(std::numeric_limits<double>::epsilon());
+
+    double *parameters = N_VGetArrayPointer_Serial(pY);
+    double *increments = N_VGetArrayPointer_Serial(pTemp1);
+    const QVector<int> &columnPointers = finiteDifferenceJacobian->columnPointers();
+    const QVector<int> &rowIndices = finiteDifferenceJacobian->rowIndices();
+    int size = columnPointers.count()-1;
+
+    for (int i = 0; i < size; ++i) {
+        increments[i] = SquareRootOfUnitRoundoff*qMax(qAbs(parameters[i]), 1.0);
+    }
+
+    finiteDifferenceJacobian->compute(parameters, N_VGetArrayPointer_Serial(pF),
+                                      increments, [=](double *pX, double *pValues) {
+        userData->computeSystem()(pX, pValues, userData->userData());
+    });
+
+    double *jacobian = finiteDifferenceJacobian->values();
+
+    for (int j = 0; j < size; ++j) {
+        for (int k = columnPointers[j], kMax = columnPointers[j+1]; k < kMax; ++k) {
+            SM_ELEMENT_D(pJacobian, rowIndices[k], j) = jacobian[k];
+        }
+    }
+
+    return 0;
+}
+
+//==============================================================================
+
 void errorHandler(int pErrorCode, const char *pModule, const char *pFunction,
                   char *pErrorMessage, void *pUserData)
 {
@@ -83,8 +145,12 @@ void errorHandler(int pErrorCode, const char *pModule, const char *pFunction,
 //==============================================================================
 
 KinsolSolverUserData::KinsolSolverUserData(Solver::NlaSolver::ComputeSystemFunction pComputeSystem,
+                                           Solver::NlaSolver::ComputeJacobianFunction pComputeJacobian,
+                                           Solver::FiniteDifferenceJacobian *pFiniteDifferenceJacobian,
                                            void *pUserData) :
     mComputeSystem(pComputeSystem),
+    mComputeJacobian(pComputeJacobian),
+    mFiniteDifferenceJacobian(pFiniteDifferenceJacobian),
     mUserData(pUserData)
 {
 }
@@ -100,6 +166,33 @@ Solver::NlaSolver::ComputeSystemFunction KinsolSolverUserData::computeSystem() c
 
 //==============================================================================
 
+Solver::NlaSolver::ComputeJacobianFunction KinsolSolverUserData::computeJacobian() const
+{
+    // Return our compute Jacobian function
+
+    return mComputeJacobian;
+}
+
+//==============================================================================
+
+Solver::FiniteDifferenceJacobian * KinsolSolverUserData::finiteDifferenceJacobian() const
+{
+    // Return our finite-difference Jacobian, if any
+
+    return mFiniteDifferenceJacobian;
+}
+
+//==============================================================================
+
+void KinsolSolverUserData::setFiniteDifferenceJacobian(Solver::FiniteDifferenceJacobian *pFiniteDifferenceJacobian)
+{
+    // Set our finite-difference Jacobian
+
+    mFiniteDifferenceJacobian = pFiniteDifferenceJacobian;
+}
+
+//==============================================================================
+
 void * KinsolSolverUserData::userData() const
 {
     // Return our user data
@@ -109,15 +202,26 @@ void * KinsolSolverUserData::userData() const
 
 //==============================================================================
 
+void KinsolSolverUserData::setUserData(void *pUserData)
+{
+    // Set our user data
+
+    mUserData = pUserData;
+}
+
+//==============================================================================
+
 KinsolSolverData::KinsolSolverData(void *pSolver, N_Vector pParametersVector,
                                    N_Vector pOnesVector, SUNMatrix pMatrix,
                                    SUNLinearSolver pLinearSolver,
+                                   Solver::FiniteDifferenceJacobian *pFiniteDifferenceJacobian,
                                    KinsolSolverUserData *pUserData) :
     mSolver(pSolver),
     mParametersVector(pParametersVector),
     mOnesVector(pOnesVector),
     mMatrix(pMatrix),
     mLinearSolver(pLinearSolver),
+    mFiniteDifferenceJacobian(pFiniteDifferenceJacobian),
     mUserData(pUserData)
 {
 }
@@ -135,6 +239,7 @@ KinsolSolverData::~KinsolSolverData()
 
     KINFree(&mSolver);
 
+    delete mFiniteDifferenceJacobian;
     delete mUserData;
 }
 
@@ -165,6 +270,7 @@ N_Vector KinsolSolverData::onesVector() const
     return mOnesVector;
 }
 
+
 //==============================================================================
 
 KinsolSolverUserData * KinsolSolverData::userData() const
@@ -176,17 +282,6 @@ KinsolSolverUserData * KinsolSolverData::userData() const
 
 //==============================================================================
 
-void KinsolSolverData::setUserData(KinsolSolverUserData *pUserData)
-{
-    // Set our user data, after having delete our 'old' ones
-
-    delete mUserData;
-
-    mUserData = pUserData;
-}
-
-//==============================================================================
-
 KinsolSolver::~KinsolSolver()
 {
     // Delete some internal objects
@@ -199,11 +294,18 @@ KinsolSolver::~KinsolSolver()
 //==============================================================================
 
 void KinsolSolver::solve(ComputeSystemFunction pComputeSystem,
+                         ComputeJacobianFunction pComputeJacobian,
                          double *pParameters, int pSize, void *pUserData)
 {
     // Check whether we need to initialise or update ourselves
+    // Note: our data is keyed on both our compute system and compute Jacobian
+    //       functions since the latter determines how KINSOL gets initialised
+    //       (and since our model code may stop providing it for a given NLA
+    //       system, should its Jacobian turn out to be wrong)...
 
-    KinsolSolverData *data = mData.value(reinterpret_cast<void *>(pComputeSystem));
+    QPair<void *, void *> key(reinterpret_cast<void *>(pComputeSystem),
+                              reinterpret_cast<void *>(pComputeJacobian));
+    KinsolSolverData *data = mData.value(key);
 
     if (data == nullptr) {
         // Retrieve our properties
@@ -286,7 +388,8 @@ void KinsolSolver::solve(ComputeSystemFunction pComputeSystem,
 
         // Set our user data
 
-        auto userData = new KinsolSolverUserData(pComputeSystem, pUserData);
+        auto userData = new KinsolSolverUserData(pComputeSystem, pComputeJacobian,
+                                                 nullptr, pUserData);
 
         KINSetUserData(solver, userData);
 
@@ -298,12 +401,47 @@ void KinsolSolver::solve(ComputeSystemFunction pComputeSystem,
 
         SUNMatrix matrix = nullptr;
         SUNLinearSolver linearSolver;
+        OpenCOR::Solver::FiniteDifferenceJacobian *finiteDifferenceJacobian = nullptr;
 
         if (linearSolverValue == DenseLinearSolver) {
             matrix = SUNDenseMatrix(pSize, pSize, context);
             linearSolver = SUNLinSol_Dense(parametersVector, matrix, context);
 
             KINSetLinearSolver(solver, linearSolver, matrix);
+
+            // Use the Jacobian of our system function rather than have KINSOL
+            // approximate it using finite differences, if possible, or
+            // approximate it ourselves using finite differences with coloured
+            // columns, based on the sparsity pattern that we get by probing
+            // our system function
+            // Note: the latter is only worth it if we need fewer colours than
+            //       columns, otherwise we let KINSOL do its own thing...
+
+            if (pComputeJacobian != nullptr) {
+                KINSetJacFn(solver, jacobianFunction);
+            } else {
+                QVector<int> columnPointers;
+                QVector<int> rowIndices;
+
+                OpenCOR::Solver::FiniteDifferenceJacobian::probeSparsityPattern(pSize, pParameters,
+                                                                                [=](double *pX, double *pF) {
+                    pComputeSystem(pX, pF, pUserData);
+                }, columnPointers, rowIndices);
+
+                finiteDifferenceJacobian = new OpenCOR::Solver::FiniteDifferenceJacobian(pSize,
+                                                                                         columnPointers,
+                                                                                         rowIndices);
+
+                if (finiteDifferenceJacobian->coloursCount() < pSize) {
+                    userData->setFiniteDifferenceJacobian(finiteDifferenceJacobian);
+
+                    KINSetJacFn(solver, jacobianFunction);
+                } else {
+                    delete finiteDifferenceJacobian;
+
+                    finiteDifferenceJacobian = nullptr;
+                }
+            }
         } else if (linearSolverValue == BandedLinearSolver) {
             matrix = SUNBandMatrix(pSize, upperHalfBandwidthValue,
                                           lowerHalfBandwidthValue, context);
@@ -327,15 +465,25 @@ void KinsolSolver::solve(ComputeSystemFunction pComputeSystem,
         // Keep track of our data
 
         data = new KinsolSolverData(solver, parametersVector, onesVector,
-                                    matrix, linearSolver, userData);
+                                    matrix, linearSolver,
+                                    finiteDifferenceJacobian, userData);
 
-        mData.insert(reinterpret_cast<void *>(pComputeSystem), data);
+        mData.insert(key, data);
     } else {
-        // We are already initialised, so simply update our user data
-
-        data->setUserData(new KinsolSolverUserData(pComputeSystem, pUserData));
-
-        KINSetUserData(data->solver(), data->userData());
+        // We are already initialised, so simply update our user data and make
+        // our parameters vector point to the given parameters
+        // Note #1: this is our hot path (we may get called several times for
+        //          each evaluation of our model's rates), so we reuse our
+        //          existing user data and parameters vector rather than
+        //          (re)allocate them...
+        // Note #2: the given parameters are initialised by our model code with
+        //          the values of the corresponding model parameters, i.e. with
+        //          the solution of our previous solve, so KINSOL is always warm
+        //          started...
+
+        data->userData()->setUserData(pUserData);
+
+        N_VSetArrayPointer_Serial(pParameters, data->parametersVector());
     }
 
     // Solve our linear system
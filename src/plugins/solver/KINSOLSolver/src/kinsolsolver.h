@@ -77,14 +77,24 @@ class KinsolSolverUserData
 {
 public:
     explicit KinsolSolverUserData(Solver::NlaSolver::ComputeSystemFunction pComputeSystem,
+                                  Solver::NlaSolver::ComputeJacobianFunction pComputeJacobian,
+                                  Solver::FiniteDifferenceJacobian *pFiniteDifferenceJacobian,
                                   void *pUserData);
 
     Solver::NlaSolver::ComputeSystemFunction computeSystem() const;
+    Solver::NlaSolver::ComputeJacobianFunction computeJacobian() const;
+
+    Solver::FiniteDifferenceJacobian * finiteDifferenceJacobian() const;
+    void setFiniteDifferenceJacobian(Solver::FiniteDifferenceJacobian *pFiniteDifferenceJacobian);
 
     void * userData() const;
+    void setUserData(void *pUserData);
 
 private:
     Solver::NlaSolver::ComputeSystemFunction mComputeSystem;
+    Solver::NlaSolver::ComputeJacobianFunction mComputeJacobian;
+
+    Solver::FiniteDifferenceJacobian *mFiniteDifferenceJacobian;
 
     void *mUserData;
 };
@@ -97,6 +107,7 @@ public:
     explicit KinsolSolverData(void *pSolver, N_Vector pParametersVector,
                               N_Vector pOnesVector, SUNMatrix pMatrix,
                               SUNLinearSolver pLinearSolver,
+                              Solver::FiniteDifferenceJacobian *pFiniteDifferenceJacobian,
                               KinsolSolverUserData *pUserData);
     ~KinsolSolverData();
 
@@ -106,7 +117,6 @@ public:
     N_Vector onesVector() const;
 
     KinsolSolverUserData * userData() const;
-    void setUserData(KinsolSolverUserData *pUserData);
 
 private:
     void *mSolver;
@@ -117,6 +127,8 @@ private:
     SUNMatrix mMatrix;
     SUNLinearSolver mLinearSolver;
 
+    Solver::FiniteDifferenceJacobian *mFiniteDifferenceJacobian;
+
     KinsolSolverUserData *mUserData;
 };
 
@@ -129,11 +141,12 @@ class KinsolSolver : public OpenCOR::Solver::NlaSolver
 public:
     ~KinsolSolver() override;
 
-    void solve(ComputeSystemFunction pComputeSystem, double *pParameters,
+    void solve(ComputeSystemFunction pComputeSystem,
+               ComputeJacobianFunction pComputeJacobian, double *pParameters,
                int pSize, void *pUserData) override;
 
 private:
-    QHash<void *, KinsolSolverData *> mData;
+    QHash<QPair<void *, void *>, KinsolSolverData *> mData;
 };
 
 //==============================================================================
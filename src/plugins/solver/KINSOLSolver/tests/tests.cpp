@@ -0,0 +1,154 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// KINSOL solver tests
+//==============================================================================
+
+#include "kinsolsolver.h"
+#include "tests.h"
+
+//==============================================================================
+
+#include <QtTest/QtTest>
+
+//==============================================================================
+
+#include <array>
+
+//==============================================================================
+
+static const double Sqrt2 = std::sqrt(2.0);
+
+//==============================================================================
+
+static void circleSystem(double *pParameters, double *pResiduals,
+                         void *pUserData)
+{
+    Q_UNUSED(pUserData)
+
+    // Compute the residuals of x^2+y^2 = 4 and x = y
+
+    pResiduals[0] = pParameters[0]*pParameters[0]+pParameters[1]*pParameters[1]-4.0;
+    pResiduals[1] = pParameters[0]-pParameters[1];
+}
+
+//==============================================================================
+
+static void circleSystemJacobian(double *pParameters, double *pJacobian,
+                                 void *pUserData)
+{
+    Q_UNUSED(pUserData)
+
+    // Compute the Jacobian of x^2+y^2 = 4 and x = y, in a dense column-major
+    // format
+
+    pJacobian[0] = 2.0*pParameters[0];
+    pJacobian[1] = 1.0;
+    pJacobian[2] = 2.0*pParameters[1];
+    pJacobian[3] = -1.0;
+}
+
+//==============================================================================
+
+static OpenCOR::KINSOLSolver::KinsolSolver * kinsolSolver()
+{
+    // Create and return a KINSOL solver that uses its default properties
+
+    auto res = new OpenCOR::KINSOLSolver::KinsolSolver();
+
+    res->setProperties({ { OpenCOR::KINSOLSolver::MaximumNumberOfIterationsId,
+                           int(OpenCOR::KINSOLSolver::MaximumNumberOfIterationsDefaultValue) },
+                         { OpenCOR::KINSOLSolver::LinearSolverId,
+                           OpenCOR::KINSOLSolver::LinearSolverDefaultValue } });
+
+    return res;
+}
+
+//==============================================================================
+
+void Tests::solveTests()
+{
+    // Solve our system using its Jacobian
+
+    OpenCOR::KINSOLSolver::KinsolSolver *solver = kinsolSolver();
+    std::array<double, 2> parameters = { 1.0, 2.0 };
+
+    solver->solve(circleSystem, circleSystemJacobian, parameters.data(), 2);
+
+    QVERIFY(qAbs(parameters[0]-Sqrt2) < 1.0e-6);
+    QVERIFY(qAbs(parameters[1]-Sqrt2) < 1.0e-6);
+
+    // Solve the same system without its Jacobian, which means that KINSOL must
+    // be initialised differently rather than reuse what it was initialised
+    // with for our previous solve
+
+    parameters = { 3.0, 1.0 };
+
+    solver->solve(circleSystem, nullptr, parameters.data(), 2);
+
+    QVERIFY(qAbs(parameters[0]-Sqrt2) < 1.0e-6);
+    QVERIFY(qAbs(parameters[1]-Sqrt2) < 1.0e-6);
+
+    // Solve our system using its Jacobian again
+
+    parameters = { -1.0, -2.0 };
+
+    solver->solve(circleSystem, circleSystemJacobian, parameters.data(), 2);
+
+    QVERIFY(qAbs(parameters[0]+Sqrt2) < 1.0e-6);
+    QVERIFY(qAbs(parameters[1]+Sqrt2) < 1.0e-6);
+
+    delete solver;
+}
+
+//==============================================================================
+
+void Tests::warmSolveTests()
+{
+    // Measure the cost of a warm solve, i.e. of a solve that reuses KINSOL's
+    // state and that starts close to the solution, which is what happens when
+    // a model needs an NLA solver and we compute its rates at each step of a
+    // simulation
+
+    OpenCOR::KINSOLSolver::KinsolSolver *solver = kinsolSolver();
+    std::array<double, 2> parameters = { 1.0, 2.0 };
+
+    solver->solve(circleSystem, circleSystemJacobian, parameters.data(), 2);
+
+    QBENCHMARK {
+        parameters[0] += 1.0e-3;
+        parameters[1] -= 1.0e-3;
+
+        solver->solve(circleSystem, circleSystemJacobian, parameters.data(), 2);
+    }
+
+    QVERIFY(qAbs(parameters[0]-Sqrt2) < 1.0e-6);
+    QVERIFY(qAbs(parameters[1]-Sqrt2) < 1.0e-6);
+
+    delete solver;
+}
+
+//==============================================================================
+
+QTEST_GUILESS_MAIN(Tests)
+
+//==============================================================================
+// End of file
+//==============================================================================
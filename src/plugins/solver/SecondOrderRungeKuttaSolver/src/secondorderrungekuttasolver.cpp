@@ -69,6 +69,16 @@ void SecondOrderRungeKuttaSolver::initialize(double pVoi, int pRatesStatesCount,
 
 //==============================================================================
 
+bool SecondOrderRungeKuttaSolver::supportsBatch() const
+{
+    // We support batches of instances since we update our states entry by
+    // entry
+
+    return true;
+}
+
+//==============================================================================
+
 void SecondOrderRungeKuttaSolver::solve(double &pVoi, double pVoiEnd) const
 {
     // k1 = h * f(t_n, Y_n)
@@ -94,7 +104,7 @@ void SecondOrderRungeKuttaSolver::solve(double &pVoi, double pVoiEnd) const
 
         // Compute f(t_n, Y_n)
 
-        mComputeRates(pVoi, mConstants, mRates, mStates, mAlgebraic);
+        computeRates(pVoi, mStates);
 
         // Compute k1 and therefore Yk1
 
@@ -104,7 +114,7 @@ void SecondOrderRungeKuttaSolver::solve(double &pVoi, double pVoiEnd) const
 
         // Compute f(t_n + h / 2, Y_n + k1 / 2)
 
-        mComputeRates(pVoi+realHalfStep, mConstants, mRates, mYk1, mAlgebraic);
+        computeRates(pVoi+realHalfStep, mYk1);
 
         // Compute Y_n+1
 
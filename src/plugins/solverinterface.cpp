@@ -25,18 +25,129 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 //==============================================================================
 
-void doNonLinearSolve(char *pRuntime,
+#include <QAtomicInt>
+
+//==============================================================================
+
+void doNonLinearSolve(void *pNlaSolver,
                       void (*pFunction)(double *, double *, void *),
                       double *pParameters, int pSize, void *pUserData)
 {
     // Retrieve the NLA solver which we should use and solve our NLA system
-    // Note: we should always have an NLA solver, but better be safe than
-    //       sorry...
+    // Note #1: pNlaSolver is the address of the pointer to the NLA solver of
+    //          the runtime that called us, so retrieving our NLA solver is
+    //          just a matter of dereferencing it...
+    // Note #2: we should always have an NLA solver, but better be safe than
+    //          sorry...
 
-    OpenCOR::Solver::NlaSolver *nlaSolver = OpenCOR::Solver::nlaSolver(pRuntime);
+    OpenCOR::Solver::NlaSolver *nlaSolver = *static_cast<OpenCOR::Solver::NlaSolver **>(pNlaSolver);
 
     if (nlaSolver != nullptr) {
-        nlaSolver->solve(pFunction, pParameters, pSize, pUserData);
+        nlaSolver->solve(pFunction, nullptr, pParameters, pSize, pUserData);
+    } else {
+        qWarning("WARNING | %s:%d: no NLA solver could be found.", __FILE__, __LINE__);
+    }
+}
+
+//==============================================================================
+
+static bool isValidJacobian(void (*pFunction)(double *, double *, void *),
+                            void (*pJacobianFunction)(double *, double *, void *),
+                            double *pParameters, int pSize, void *pUserData)
+{
+    // Check the given Jacobian function against a forward finite-difference
+    // approximation of our Jacobian at the given parameters
+    // Note: our objective function may update the user data (e.g. the
+    //       algebraic variables that it solves for), hence we evaluate it one
+    //       last time at the given parameters before returning...
+
+    QVector<double> x(pSize);
+    QVector<double> f(pSize);
+    QVector<double> perturbedF(pSize);
+    QVector<double> jacobian(pSize*pSize);
+
+    memcpy(x.data(), pParameters, size_t(pSize)*OpenCOR::Solver::SizeOfDouble);
+
+    pJacobianFunction(x.data(), jacobian.data(), pUserData);
+    pFunction(x.data(), f.data(), pUserData);
+
+    bool res = true;
+
+    for (int j = 0; res && (j < pSize); ++j) {
+        double xj = x[j];
+        double increment = 1.0e-7*qMax(1.0, qAbs(xj));
+
+        x[j] = xj+increment;
+
+        pFunction(x.data(), perturbedF.data(), pUserData);
+
+        x[j] = xj;
+
+        for (int i = 0; i < pSize; ++i) {
+            double analyticDerivative = jacobian[j*pSize+i];
+            double numericalDerivative = (perturbedF[i]-f[i])/increment;
+
+            // Note: we test for our derivatives being close rather than for
+            //       them being far apart, so that a NaN results in our
+            //       Jacobian being considered invalid...
+
+            if (!(qAbs(analyticDerivative-numericalDerivative) <= 1.0e-3*qMax(1.0, qAbs(numericalDerivative)))) {
+                res = false;
+
+                break;
+            }
+        }
+    }
+
+    pFunction(x.data(), f.data(), pUserData);
+
+    return res;
+}
+
+//==============================================================================
+
+void doNonLinearSolveWithJacobian(void *pNlaSolver,
+                                  void (*pFunction)(double *, double *, void *),
+                                  void (*pJacobianFunction)(double *, double *, void *),
+                                  void *pJacobianStatus,
+                                  double *pParameters, int pSize,
+                                  void *pUserData)
+{
+    // Retrieve the NLA solver which we should use and solve our NLA system
+    // using the given Jacobian function, but only if it is valid
+    // Note #1: the given Jacobian function was generated from the code of our
+    //          objective function, so we check it against finite differences
+    //          the first time we are called and, if it doesn't match, we let
+    //          our NLA solver use its own Jacobian instead. The outcome of
+    //          that check is kept in the given Jacobian status, which is owned
+    //          by the runtime that called us. Two threads may end up checking
+    //          the same Jacobian function, but they will reach the same
+    //          conclusion, so it doesn't matter...
+    // Note #2: we should always have an NLA solver, but better be safe than
+    //          sorry...
+
+    enum {
+        UncheckedJacobian = 0,
+        ValidJacobian = 1,
+        InvalidJacobian = 2
+    };
+
+    OpenCOR::Solver::NlaSolver *nlaSolver = *static_cast<OpenCOR::Solver::NlaSolver **>(pNlaSolver);
+
+    if (nlaSolver != nullptr) {
+        auto jacobianStatus = static_cast<QAtomicInt *>(pJacobianStatus);
+        int status = jacobianStatus->loadAcquire();
+
+        if (status == UncheckedJacobian) {
+            status = isValidJacobian(pFunction, pJacobianFunction, pParameters, pSize, pUserData)?
+                         ValidJacobian:
+                         InvalidJacobian;
+
+            jacobianStatus->storeRelease(status);
+        }
+
+        nlaSolver->solve(pFunction, (status == ValidJacobian)?pJacobianFunction:nullptr,
+                         pParameters, pSize, pUserData);
     } else {
         qWarning("WARNING | %s:%d: no NLA solver could be found.", __FILE__, __LINE__);
     }
@@ -52,7 +163,7 @@ extern "C" Q_DECL_EXPORT int solverInterfaceVersion()
 {
     // Version of the solver interface
 
-    return 2;
+    return 3;
 }
 
 //==============================================================================
@@ -114,6 +225,9 @@ void OdeSolver::initialize(double pVoi, int pRatesStatesCount,
     mAlgebraic = pAlgebraic;
 
     mComputeRates = pComputeRates;
+
+    mBatchCount = 0;
+    mComputeRatesBatch = nullptr;
 }
 
 //==============================================================================
@@ -127,38 +241,303 @@ void OdeSolver::reinitialize(double pVoi)
 
 //==============================================================================
 
+void OdeSolver::setComputeRates(ComputeRatesFunction pComputeRates)
+{
+    // Use the given compute rates function from now on
+    // Note: this is typically used when the functions of a runtime have been
+    //       swapped for their optimised version (see
+    //       CellmlFileRuntime::swapFunctions())...
+
+    mComputeRates = pComputeRates;
+}
+
+//==============================================================================
+
+void OdeSolver::setJacobianSparsityPattern(const QVector<int> &pColumnPointers,
+                                           const QVector<int> &pRowIndices)
+{
+    // Keep track of the sparsity pattern of our model's Jacobian, which is
+    // stored in a compressed sparse column format
+    // Note: this must be done before initialising the ODE solver, and an empty
+    //       pattern means that the sparsity pattern is not known...
+
+    mJacobianColumnPointers = pColumnPointers;
+    mJacobianRowIndices = pRowIndices;
+}
+
+//==============================================================================
+
+void OdeSolver::setComputeJacobian(ComputeJacobianFunction pComputeJacobian)
+{
+    // Use the given compute Jacobian function, which computes the non-zero
+    // entries of our model's Jacobian, following its sparsity pattern
+    // Note: this must be done before initialising the ODE solver, unless we
+    //       are swapping our functions for their optimised version (see
+    //       setComputeRates())...
+
+    mComputeJacobian = pComputeJacobian;
+}
+
+//==============================================================================
+
+bool OdeSolver::supportsBatch() const
+{
+    // By default, we don't support batches of instances
+
+    return false;
+}
+
+//==============================================================================
+
+void OdeSolver::initializeBatch(double pVoi, int pCount, int pRatesStatesCount,
+                                double *pConstants, double *pRates,
+                                double *pStates, double *pAlgebraic,
+                                ComputeRatesBatchFunction pComputeRatesBatch)
+{
+    // Initialise the ODE solver for a batch of instances
+    // Note #1: the model's arrays hold the values of all our instances in a
+    //          structure-of-arrays layout, i.e. the value of the i-th entry of
+    //          the k-th instance is at position i*pCount+k. This means that a
+    //          solver that updates its states entry by entry can simply
+    //          consider our batch as one big model, as long as it computes its
+    //          rates using computeRates()...
+    // Note #2: only solvers that support batches should be initialised this
+    //          way (see supportsBatch())...
+
+    initialize(pVoi, pCount*pRatesStatesCount, pConstants, pRates, pStates,
+               pAlgebraic, nullptr);
+
+    mBatchCount = pCount;
+    mComputeRatesBatch = pComputeRatesBatch;
+}
+
+//==============================================================================
+
+void OdeSolver::computeRates(double pVoi, double *pStates) const
+{
+    // Compute our rates using the given states, be it for one instance or a
+    // batch of them
+
+    if (mComputeRatesBatch != nullptr) {
+        mComputeRatesBatch(mBatchCount, pVoi, mConstants, mRates, pStates, mAlgebraic);
+    } else {
+        mComputeRates(pVoi, mConstants, mRates, pStates, mAlgebraic);
+    }
+}
+
+//==============================================================================
+
 NlaSolver::~NlaSolver() = default;
 
 //==============================================================================
 
-QString objectAddress(QObject *pObject)
+FiniteDifferenceJacobian::FiniteDifferenceJacobian(int pSize,
+                                                   const QVector<int> &pColumnPointers,
+                                                   const QVector<int> &pRowIndices) :
+    mColumnPointers(pColumnPointers),
+    mRowIndices(pRowIndices),
+    mX(pSize),
+    mPerturbedF(pSize),
+    mValues(pRowIndices.count())
 {
-    // Return the given object's address as a string
+    // Colour the columns of our Jacobian so that two columns that have a
+    // non-zero entry in the same row have a different colour
+    // Note: the columns that have the same colour are structurally orthogonal,
+    //       so they can all be perturbed at once, meaning that computing our
+    //       Jacobian requires as many evaluations of our function as there are
+    //       colours rather than as there are columns...
+
+    QVector<QVector<int>> rowColumns(pSize);
+
+    for (int j = 0; j < pSize; ++j) {
+        for (int k = pColumnPointers[j], kMax = pColumnPointers[j+1]; k < kMax; ++k) {
+            rowColumns[pRowIndices[k]] << j;
+        }
+    }
+
+    QVector<int> columnColours(pSize, -1);
+    QVector<int> forbiddenColours(pSize, -1);
+
+    for (int j = 0; j < pSize; ++j) {
+        for (int k = pColumnPointers[j], kMax = pColumnPointers[j+1]; k < kMax; ++k) {
+            for (auto column : qAsConst(rowColumns[pRowIndices[k]])) {
+                if (columnColours[column] != -1) {
+                    forbiddenColours[columnColours[column]] = j;
+                }
+            }
+        }
 
-    return QString::number(quint64(pObject));
+        int colour = 0;
+
+        while (forbiddenColours[colour] == j) {
+            ++colour;
+        }
+
+        columnColours[j] = colour;
+
+        if (colour == mColours.count()) {
+            mColours << QVector<int>();
+        }
+
+        mColours[colour] << j;
+    }
 }
 
 //==============================================================================
 
-NlaSolver * nlaSolver(const QString &pObjectAddress)
+void FiniteDifferenceJacobian::probeSparsityPattern(int pSize, double *pX,
+                                                    const Function &pFunction,
+                                                    QVector<int> &pColumnPointers,
+                                                    QVector<int> &pRowIndices)
 {
-    // Return the runtime's NLA solver
+    // Determine the sparsity pattern of the Jacobian of the given function by
+    // perturbing each of its variables in turn and checking which entries of
+    // the function are affected, and this at the given point and at a few
+    // points around it
+    // Note #1: the perturbation is much bigger than the one used to compute
+    //          our Jacobian, so that it doesn't get lost in rounding errors...
+    // Note #2: an entry may happen not to be affected at a given point (e.g.
+    //          because of a piecewise definition or of a factor that is zero
+    //          at that point), hence we probe several points. Still, our
+    //          sparsity pattern is only an approximation of the real one, and
+    //          an entry that is missing from it will not only be missing from
+    //          our Jacobian, but may also (through our colouring) pollute
+    //          other entries. This may slow down the convergence of a Newton
+    //          iteration (or even prevent it), but it won't affect the
+    //          accuracy of a solution that is found, since that accuracy is
+    //          determined by our function rather than by its Jacobian...
+    // Note #3: our points around the given point are such that their
+    //          variables are perturbed in different directions, so that we
+    //          don't end up on some line of symmetry of our function...
+
+    static const double RelativePerturbation = 1.0e-3;
+    static const double ProbeOffsets[] = { 0.0, 0.1, -0.07 };
+
+    int probesCount = int(sizeof(ProbeOffsets)/sizeof(ProbeOffsets[0]));
+    QVector<double> x(pSize);
+    QVector<double> probesX(probesCount*pSize);
+    QVector<double> probesF(probesCount*pSize);
+    QVector<double> perturbedF(pSize);
+    QVector<bool> affectedRows(pSize);
+
+    memcpy(x.data(), pX, size_t(pSize)*SizeOfDouble);
+
+    for (int k = 0; k < probesCount; ++k) {
+        double *probeX = probesX.data()+k*pSize;
+
+        for (int j = 0; j < pSize; ++j) {
+            probeX[j] = x[j]+(((j%2) != 0)?-1.0:1.0)*ProbeOffsets[k]*qMax(qAbs(x[j]), 1.0);
+        }
+
+        memcpy(pX, probeX, size_t(pSize)*SizeOfDouble);
+
+        pFunction(pX, probesF.data()+k*pSize);
+    }
+
+    pColumnPointers = { 0 };
+    pRowIndices.clear();
+
+    for (int j = 0; j < pSize; ++j) {
+        affectedRows.fill(false);
+
+        for (int k = 0; k < probesCount; ++k) {
+            const double *probeX = probesX.constData()+k*pSize;
+            const double *probeF = probesF.constData()+k*pSize;
+
+            memcpy(pX, probeX, size_t(pSize)*SizeOfDouble);
+
+            pX[j] += RelativePerturbation*qMax(qAbs(probeX[j]), 1.0);
+
+            pFunction(pX, perturbedF.data());
+
+            for (int i = 0; i < pSize; ++i) {
+                if ((perturbedF[i] != probeF[i]) || !qIsFinite(perturbedF[i])) {
+                    affectedRows[i] = true;
+                }
+            }
+        }
+
+        for (int i = 0; i < pSize; ++i) {
+            if (affectedRows[i]) {
+                pRowIndices << i;
+            }
+        }
+
+        pColumnPointers << pRowIndices.count();
+    }
 
-    QObject *object = reinterpret_cast<NlaSolver *>(QVariant(pObjectAddress).toULongLong());
+    // Go back to the given point and make sure that our function is up to date
+    // with it
 
-    return reinterpret_cast<NlaSolver *>(QVariant(object->objectName()).toULongLong());
+    memcpy(pX, x.constData(), size_t(pSize)*SizeOfDouble);
+
+    pFunction(pX, perturbedF.data());
+}
+
+//==============================================================================
+
+int FiniteDifferenceJacobian::coloursCount() const
+{
+    // Return our number of colours
+
+    return mColours.count();
+}
+
+//==============================================================================
+
+const QVector<int> & FiniteDifferenceJacobian::columnPointers() const
+{
+    // Return our column pointers
+
+    return mColumnPointers;
 }
 
 //==============================================================================
 
-void setNlaSolver(QObject *pObject, NlaSolver *pNlaSolver)
+const QVector<int> & FiniteDifferenceJacobian::rowIndices() const
 {
-    // Keep track of the runtime's NLA solver
-    // Note: normally, we would use QObject::setProperty(), but it doesn't play
-    //       well on Windows without a GUI (see https://bit.ly/2YCpzew). So,
-    //       instead, we use QObject::setObjectName() (!!)...
+    // Return our row indices
+
+    return mRowIndices;
+}
 
-    pObject->setObjectName(objectAddress(pNlaSolver));
+//==============================================================================
+
+double * FiniteDifferenceJacobian::values()
+{
+    // Return the non-zero entries of our Jacobian, as last computed
+
+    return mValues.data();
+}
+
+//==============================================================================
+
+void FiniteDifferenceJacobian::compute(double *pX, const double *pF,
+                                       const double *pIncrements,
+                                       const Function &pFunction)
+{
+    // Compute the non-zero entries of our Jacobian at the given point, using
+    // one evaluation of the given function per colour
+
+    for (const auto &columns : qAsConst(mColours)) {
+        for (auto column : columns) {
+            mX[column] = pX[column];
+
+            pX[column] += pIncrements[column];
+        }
+
+        pFunction(pX, mPerturbedF.data());
+
+        for (auto column : columns) {
+            pX[column] = mX[column];
+
+            for (int k = mColumnPointers[column], kMax = mColumnPointers[column+1]; k < kMax; ++k) {
+                int row = mRowIndices[k];
+
+                mValues[k] = (mPerturbedF[row]-pF[row])/pIncrements[column];
+            }
+        }
+    }
 }
 
 //==============================================================================
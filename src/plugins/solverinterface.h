@@ -30,13 +30,24 @@ along with this program. If not, see <https://gnu.org/licenses>.
 //==============================================================================
 
 #include <QVariant>
+#include <QVector>
 
 //==============================================================================
 
-extern "C" void doNonLinearSolve(char *pRuntime,
+#include <functional>
+
+//==============================================================================
+
+extern "C" void doNonLinearSolve(void *pNlaSolver,
                                  void (*pFunction)(double *, double *, void *),
                                  double *pParameters, int pSize,
                                  void *pUserData);
+extern "C" void doNonLinearSolveWithJacobian(void *pNlaSolver,
+                                             void (*pFunction)(double *, double *, void *),
+                                             void (*pJacobianFunction)(double *, double *, void *),
+                                             void *pJacobianStatus,
+                                             double *pParameters, int pSize,
+                                             void *pUserData);
 
 //==============================================================================
 
@@ -75,6 +86,8 @@ class OdeSolver : public Solver
 {
 public:
     using ComputeRatesFunction = void (*)(double pVoi, double *pConstants, double *pRates, double *pStates, double *pAlgebraic);
+    using ComputeRatesBatchFunction = void (*)(int pCount, double pVoi, double *pConstants, double *pRates, double *pStates, double *pAlgebraic);
+    using ComputeJacobianFunction = void (*)(double pVoi, double *pConstants, double *pRates, double *pStates, double *pAlgebraic, double *pJacobian);
 
     virtual void initialize(double pVoi, int pRatesStatesCount,
                             double *pConstants, double *pRates, double *pStates,
@@ -82,6 +95,19 @@ public:
                             ComputeRatesFunction pComputeRates);
     virtual void reinitialize(double pVoi);
 
+    virtual void setComputeRates(ComputeRatesFunction pComputeRates);
+
+    void setJacobianSparsityPattern(const QVector<int> &pColumnPointers,
+                                    const QVector<int> &pRowIndices);
+    virtual void setComputeJacobian(ComputeJacobianFunction pComputeJacobian);
+
+    virtual bool supportsBatch() const;
+
+    void initializeBatch(double pVoi, int pCount, int pRatesStatesCount,
+                         double *pConstants, double *pRates, double *pStates,
+                         double *pAlgebraic,
+                         ComputeRatesBatchFunction pComputeRatesBatch);
+
     virtual void solve(double &pVoi, double pVoiEnd) const = 0;
 
 protected:
@@ -93,6 +119,17 @@ protected:
     double *mAlgebraic = nullptr;
 
     ComputeRatesFunction mComputeRates = nullptr;
+
+    QVector<int> mJacobianColumnPointers;
+    QVector<int> mJacobianRowIndices;
+
+    ComputeJacobianFunction mComputeJacobian = nullptr;
+
+    int mBatchCount = 0;
+
+    ComputeRatesBatchFunction mComputeRatesBatch = nullptr;
+
+    void computeRates(double pVoi, double *pStates) const;
 };
 
 //==============================================================================
@@ -103,19 +140,51 @@ public:
     ~NlaSolver() override;
 
     using ComputeSystemFunction = void (*)(double *, double *, void *);
+    using ComputeJacobianFunction = void (*)(double *, double *, void *);
 
     virtual void solve(ComputeSystemFunction pComputeSystem,
+                       ComputeJacobianFunction pComputeJacobian,
                        double *pParameters, int pSize,
                        void *pUserData = nullptr) = 0;
 };
 
 //==============================================================================
 
-QString objectAddress(QObject *pObject);
+class FiniteDifferenceJacobian
+{
+public:
+    using Function = std::function<void(double *pX, double *pF)>;
+
+    explicit FiniteDifferenceJacobian(int pSize,
+                                      const QVector<int> &pColumnPointers,
+                                      const QVector<int> &pRowIndices);
+
+    static void probeSparsityPattern(int pSize, double *pX,
+                                     const Function &pFunction,
+                                     QVector<int> &pColumnPointers,
+                                     QVector<int> &pRowIndices);
+
+    int coloursCount() const;
+
+    const QVector<int> & columnPointers() const;
+    const QVector<int> & rowIndices() const;
 
-NlaSolver * nlaSolver(const QString &pObjectAddress);
+    double * values();
+
+    void compute(double *pX, const double *pF, const double *pIncrements,
+                 const Function &pFunction);
+
+private:
+    QVector<int> mColumnPointers;
+    QVector<int> mRowIndices;
+
+    QVector<QVector<int>> mColours;
+
+    QVector<double> mX;
+    QVector<double> mPerturbedF;
+    QVector<double> mValues;
+};
 
-void setNlaSolver(QObject *pObject, NlaSolver *pNlaSolver);
 
 //==============================================================================
 
@@ -23,6 +23,7 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 #include "cellmlfile.h"
 #include "cellmlfilecellml10exporter.h"
+#include "cellmlfileimportcache.h"
 #include "corecliutils.h"
 #include "coreguiutils.h"
 #include "filemanager.h"
@@ -197,100 +198,128 @@ bool CellmlFile::fullyInstantiateImports(iface::cellml_api::Model *pModel,
 
             retrieveImports(crtUrl, pModel, imports, crtUrls, importedUrls);
 
-            // Instantiate all the imports in our list
+            // Instantiate all the imports in our list, one level of imports at
+            // a time
+            // Note: the imports of a given level are independent of one
+            //       another, so we retrieve the contents of all of them at once
+            //       (using our 'global' import cache), before instantiating
+            //       them (which must be done one at a time since the CellML API
+            //       is not thread safe)...
 
             while (!imports.isEmpty()) {
-                // Retrieve the first import and instantiate it, if needed
-                // Note: CDA_CellMLImport::instantiate() would normally be
-                //       called, but it doesn't work with https, so we retrieve
-                //       the contents of the import ourselves and instantiate it
-                //       from text instead...
-
-                ObjRef<iface::cellml_api::CellMLImport> import = imports.first();
-                bool dummy;
-                QString crtFileNameOrUrl;
-                QString importedUrl = importedUrls.first();
-                bool isLocalImportedFile;
-                QString importedFileNameOrUrl;
-
-                Core::checkFileNameOrUrl(crtUrls.first(), dummy, crtFileNameOrUrl);
-                Core::checkFileNameOrUrl(importedUrl, isLocalImportedFile, importedFileNameOrUrl);
-
-                imports.removeFirst();
-                crtUrls.removeFirst();
-                importedUrls.removeFirst();
-
-                if (importedFileNameOrUrl == mFileName) {
-                    // We want to import ourselves, something we can't do
-
-                    throw std::runtime_error(tr("%1 cannot import itself").arg(QDir::toNativeSeparators(importedFileNameOrUrl)).toStdString());
-                }
+                // Retrieve the contents of the imports that we haven't already
+                // loaded, with a busy widget if we are dealing with some remote
+                // files
+
+                QStringList fileNamesOrUrls;
+                bool needBusyWidget = false;
+
+                for (const auto &importedUrl : qAsConst(importedUrls)) {
+                    bool isLocalImportedFile;
+                    QString importedFileNameOrUrl;
 
-                if (mImportContents.contains(importedFileNameOrUrl)) {
-                    // We have already loaded the import contents, so directly
-                    // instantiate the import with it
+                    Core::checkFileNameOrUrl(importedUrl, isLocalImportedFile, importedFileNameOrUrl);
 
-                    import->instantiateFromText(mImportContents.value(importedFileNameOrUrl).toStdWString());
-                } else {
-                    // We haven't already loaded the import contents, so do so
-                    // now, with a busy widget if requested and if we are not
-                    // dealing with a local file
+                    if (   (importedFileNameOrUrl != mFileName)
+                        && !mImportContents.contains(importedFileNameOrUrl)
+                        && !fileNamesOrUrls.contains(importedFileNameOrUrl)) {
+                        fileNamesOrUrls << importedFileNameOrUrl;
 
-                    QString fileContents;
+                        needBusyWidget = needBusyWidget || !isLocalImportedFile;
+                    }
+                }
 
-                    if (!isLocalImportedFile) {
+                if (!fileNamesOrUrls.isEmpty()) {
+                    if (needBusyWidget) {
                         Core::showCentralBusyWidget();
                     }
 
-                    bool res = Core::readFile(importedFileNameOrUrl, fileContents);
+                    QMap<QString, QString> importContents = CellmlFileImportCache::instance()->contents(fileNamesOrUrls);
 
-                    if (!isLocalImportedFile) {
+                    if (needBusyWidget) {
                         Core::hideCentralBusyWidget();
                     }
 
-                    if (res) {
-                        // We were able to retrieve the import contents, so
-                        // instantiate the import with it
+                    for (auto iter = importContents.constBegin(), iterEnd = importContents.constEnd();
+                         iter != iterEnd; ++iter) {
+                        // Keep track of the import contents and of the import
+                        // as being one of our dependencies, should it be local
+                        // and should we be directly dealing with our model
+
+                        bool isLocalImportedFile;
+                        QString importedFileNameOrUrl;
 
-                        try {
-                            import->instantiateFromText(fileContents.toStdWString());
-                        } catch (iface::cellml_api::CellMLException &exception) {
-                            // Something went wrong with the instantiation of
-                            // the import
+                        Core::checkFileNameOrUrl(iter.key(), isLocalImportedFile, importedFileNameOrUrl);
 
-                            throw std::runtime_error(tr("<strong>%1</strong> imports <strong>%2</strong>, which contents could not be retrieved (%3)").arg(QDir::toNativeSeparators(crtFileNameOrUrl),
-                                                                                                                                                           QDir::toNativeSeparators(importedFileNameOrUrl),
-                                                                                                                                                           Core::formatMessage(QString::fromStdWString(exception.explanation))).toStdString());
+                        mImportContents.insert(iter.key(), iter.value());
+
+                        if (isLocalImportedFile && (pModel == mModel)) {
+                            dependencies << iter.key();
                         }
+                    }
+                }
 
-                        // Keep track of the import contents
+                // Instantiate the imports and retrieve their own imports, which
+                // will be instantiated next
 
-                        mImportContents.insert(importedFileNameOrUrl, fileContents);
+                QList<iface::cellml_api::CellMLImport *> levelImports = imports;
+                QStringList levelCrtUrls = crtUrls;
+                QStringList levelImportedUrls = importedUrls;
 
-                        // Keep track of the import as being one of our
-                        // dependencies, should it be local and should we be
-                        // directly dealing with our model
+                imports.clear();
+                crtUrls.clear();
+                importedUrls.clear();
 
-                        if (isLocalImportedFile && (pModel == mModel)) {
-                            dependencies << importedFileNameOrUrl;
-                        }
-                    } else {
+                for (int i = 0, iMax = levelImports.count(); i < iMax; ++i) {
+                    ObjRef<iface::cellml_api::CellMLImport> import = levelImports[i];
+                    bool dummy;
+                    QString crtFileNameOrUrl;
+                    QString importedUrl = levelImportedUrls[i];
+                    QString importedFileNameOrUrl;
+
+                    Core::checkFileNameOrUrl(levelCrtUrls[i], dummy, crtFileNameOrUrl);
+                    Core::checkFileNameOrUrl(importedUrl, dummy, importedFileNameOrUrl);
+
+                    if (importedFileNameOrUrl == mFileName) {
+                        // We want to import ourselves, something we can't do
+
+                        throw std::runtime_error(tr("%1 cannot import itself").arg(QDir::toNativeSeparators(importedFileNameOrUrl)).toStdString());
+                    }
+
+                    if (!mImportContents.contains(importedFileNameOrUrl)) {
                         throw std::runtime_error(tr("<strong>%1</strong> imports <strong>%2</strong>, which contents could not be retrieved").arg(QDir::toNativeSeparators(crtFileNameOrUrl),
                                                                                                                                                   QDir::toNativeSeparators(importedFileNameOrUrl)).toStdString());
                     }
-                }
 
-                // Now that the import is instantiated, add its own imports to
-                // our list
+                    // Instantiate the import from its contents
+                    // Note: CDA_CellMLImport::instantiate() would normally be
+                    //       called, but it doesn't work with https, so we
+                    //       retrieve the contents of the import ourselves and
+                    //       instantiate it from text instead...
+
+                    try {
+                        import->instantiateFromText(mImportContents.value(importedFileNameOrUrl).toStdWString());
+                    } catch (iface::cellml_api::CellMLException &exception) {
+                        // Something went wrong with the instantiation of the
+                        // import
+
+                        throw std::runtime_error(tr("<strong>%1</strong> imports <strong>%2</strong>, which contents could not be retrieved (%3)").arg(QDir::toNativeSeparators(crtFileNameOrUrl),
+                                                                                                                                                       QDir::toNativeSeparators(importedFileNameOrUrl),
+                                                                                                                                                       Core::formatMessage(QString::fromStdWString(exception.explanation))).toStdString());
+                    }
 
-                ObjRef<iface::cellml_api::Model> importedModel = import->importedModel();
+                    // Now that the import is instantiated, add its own imports
+                    // to our list
 
-                if (importedModel == nullptr) {
-                    throw std::runtime_error(tr("<strong>%1</strong> imports <strong>%2</strong>, which CellML object could not be retrieved").arg(QDir::toNativeSeparators(crtFileNameOrUrl),
-                                                                                                                                                   QDir::toNativeSeparators(importedFileNameOrUrl)).toStdString());
-                }
+                    ObjRef<iface::cellml_api::Model> importedModel = import->importedModel();
 
-                retrieveImports(importedUrl, importedModel, imports, crtUrls, importedUrls);
+                    if (importedModel == nullptr) {
+                        throw std::runtime_error(tr("<strong>%1</strong> imports <strong>%2</strong>, which CellML object could not be retrieved").arg(QDir::toNativeSeparators(crtFileNameOrUrl),
+                                                                                                                                                       QDir::toNativeSeparators(importedFileNameOrUrl)).toStdString());
+                    }
+
+                    retrieveImports(importedUrl, importedModel, imports, crtUrls, importedUrls);
+                }
             }
         } catch (std::runtime_error &runtimeError) {
             // Something went wrong with the full instantiation of the imports
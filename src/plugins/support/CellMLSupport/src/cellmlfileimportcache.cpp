@@ -0,0 +1,380 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// CellML file import cache
+//==============================================================================
+
+#include "cellmlfileimportcache.h"
+#include "corecliutils.h"
+
+//==============================================================================
+
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSslError>
+#include <QTimer>
+#include <QUrl>
+#include <QtConcurrent/QtConcurrent>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace CellMLSupport {
+
+//==============================================================================
+
+CellmlFileImportCache * CellmlFileImportCache::instance()
+{
+    // Return the 'global' instance of our CellML file import cache class
+
+    static CellmlFileImportCache instance;
+
+    return static_cast<CellmlFileImportCache *>(Core::globalInstance("OpenCOR::CellMLSupport::CellmlFileImportCache::instance()",
+                                                                     &instance));
+}
+
+//==============================================================================
+
+QString CellmlFileImportCache::mirrorDirName() const
+{
+    // Return the name of our mirror directory
+
+    QMutexLocker locker(&mMutex);
+
+    return mMirrorDirName;
+}
+
+//==============================================================================
+
+void CellmlFileImportCache::setMirrorDirName(const QString &pMirrorDirName)
+{
+    // Set the name of our mirror directory, i.e. a local directory where a URL
+    // like https://host/path is mirrored as <mirror directory>/host/path
+
+    QMutexLocker locker(&mMutex);
+
+    mMirrorDirName = pMirrorDirName;
+}
+
+//==============================================================================
+
+QString CellmlFileImportCache::mirrorFileName(const QString &pUrl) const
+{
+    // Return the name of the local file that mirrors the given URL, if any
+    // Note: if no mirror directory has been set (e.g. when running from the
+    //       command line, in which case no settings get loaded), then we use
+    //       the one given by the OPENCOR_IMPORT_MIRROR_DIR environment
+    //       variable, if any...
+
+    static const QString EnvironmentMirrorDirName = qEnvironmentVariable("OPENCOR_IMPORT_MIRROR_DIR");
+
+    const QString &mirrorDirName = mMirrorDirName.isEmpty()?
+                                       EnvironmentMirrorDirName:
+                                       mMirrorDirName;
+
+    if (mirrorDirName.isEmpty()) {
+        return {};
+    }
+
+    QUrl url = pUrl;
+    QString res = QDir(mirrorDirName).filePath(url.host()+url.path());
+
+    return QFileInfo(res).isFile()?
+                res:
+                QString();
+}
+
+//==============================================================================
+
+CellmlFileImportCache::Document CellmlFileImportCache::readDocument(const QString &pFileName)
+{
+    // Read the given local file, keeping track of its last modified date and
+    // size, so that we can later determine whether it is still up to date
+
+    Document res;
+    QFile file(pFileName);
+
+    if (file.open(QIODevice::ReadOnly)) {
+        QFileInfo fileInfo(file);
+
+        res.fileName = pFileName;
+        res.lastModified = fileInfo.lastModified();
+        res.size = fileInfo.size();
+        res.valid = true;
+        res.contents = QString::fromUtf8(file.readAll());
+
+        file.close();
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+bool CellmlFileImportCache::isUpToDate(const Document &pDocument)
+{
+    // Return whether the given (local) document is still up to date
+    // Note: a downloaded document has no local file and must be revalidated
+    //       against its server (see downloadDocuments())...
+
+    if (pDocument.fileName.isEmpty()) {
+        return false;
+    }
+
+    QFileInfo fileInfo(pDocument.fileName);
+
+    return    fileInfo.isFile()
+           && (fileInfo.lastModified() == pDocument.lastModified)
+           && (fileInfo.size() == pDocument.size);
+}
+
+//==============================================================================
+
+QMap<QString, CellmlFileImportCache::Document> CellmlFileImportCache::downloadDocuments(const QStringList &pUrls,
+                                                                                        const QHash<QString, Document> &pCachedDocuments) const
+{
+    // Download the given URLs all at once, but only if we are connected to the
+    // Internet, revalidating the documents that we have already downloaded
+    // Note #1: we can't rely on Core::readFile() since it downloads one URL at
+    //          a time...
+    // Note #2: a cached document is revalidated using a conditional request
+    //          based on its ETag and/or Last-Modified header, if any, meaning
+    //          that it only gets downloaded again if it has changed on its
+    //          server (or if its server doesn't let us know whether it has
+    //          changed). If we are not connected to the Internet, if a
+    //          download fails or if it takes too long, then we use our cached
+    //          document as is since it's better than nothing...
+
+    QMap<QString, Document> res;
+
+    if (pUrls.isEmpty()) {
+        return res;
+    }
+
+    if (!Core::hasInternetConnection()) {
+        for (const auto &url : pUrls) {
+            auto cachedDocument = pCachedDocuments.constFind(url);
+
+            if (cachedDocument != pCachedDocuments.constEnd()) {
+                res.insert(url, *cachedDocument);
+            }
+        }
+
+        return res;
+    }
+
+    static const QByteArray ETagHeader = "ETag";
+    static const QByteArray LastModifiedHeader = "Last-Modified";
+    static const QByteArray IfNoneMatchHeader = "If-None-Match";
+    static const QByteArray IfModifiedSinceHeader = "If-Modified-Since";
+
+    enum {
+        NotModifiedStatusCode = 304,
+        DownloadTimeout = 30000
+    };
+
+    QNetworkAccessManager networkAccessManager;
+    QEventLoop waitLoop;
+    QTimer timeoutTimer;
+    QMap<QString, QNetworkReply *> networkReplies;
+    int nbOfPendingNetworkReplies = pUrls.count();
+
+    // Ignore SSL errors, like Core::readFile() does
+
+    QObject::connect(&networkAccessManager, &QNetworkAccessManager::sslErrors,
+                     [](QNetworkReply *pNetworkReply, const QList<QSslError> &pSslErrors) {
+        pNetworkReply->ignoreSslErrors(pSslErrors);
+    });
+
+    for (const auto &url : pUrls) {
+        QNetworkRequest networkRequest(url);
+
+        networkRequest.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+
+        auto cachedDocument = pCachedDocuments.constFind(url);
+
+        if (cachedDocument != pCachedDocuments.constEnd()) {
+            if (!cachedDocument->entityTag.isEmpty()) {
+                networkRequest.setRawHeader(IfNoneMatchHeader, cachedDocument->entityTag);
+            }
+
+            if (!cachedDocument->lastModifiedHeader.isEmpty()) {
+                networkRequest.setRawHeader(IfModifiedSinceHeader, cachedDocument->lastModifiedHeader);
+            }
+        }
+
+        QNetworkReply *networkReply = networkAccessManager.get(networkRequest);
+
+        QObject::connect(networkReply, &QNetworkReply::finished, [&]() {
+            if (--nbOfPendingNetworkReplies == 0) {
+                waitLoop.quit();
+            }
+        });
+
+        networkReplies.insert(url, networkReply);
+    }
+
+    // Wait for our downloads to finish, but not forever, aborting those that
+    // are still pending after our timeout
+
+    if (nbOfPendingNetworkReplies != 0) {
+        timeoutTimer.setSingleShot(true);
+
+        QObject::connect(&timeoutTimer, &QTimer::timeout,
+                         &waitLoop, &QEventLoop::quit);
+
+        timeoutTimer.start(DownloadTimeout);
+
+        waitLoop.exec();
+
+        timeoutTimer.stop();
+
+        for (auto networkReply : networkReplies) {
+            if (!networkReply->isFinished()) {
+                networkReply->abort();
+            }
+        }
+    }
+
+    // Retrieve the documents that we were able to download or revalidate
+
+    for (auto iter = networkReplies.constBegin(), iterEnd = networkReplies.constEnd();
+         iter != iterEnd; ++iter) {
+        QNetworkReply *networkReply = iter.value();
+        auto cachedDocument = pCachedDocuments.constFind(iter.key());
+
+        if (networkReply->error() == QNetworkReply::NoError) {
+            if (   (cachedDocument != pCachedDocuments.constEnd())
+                && (networkReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == NotModifiedStatusCode)) {
+                res.insert(iter.key(), *cachedDocument);
+            } else {
+                Document document;
+
+                document.entityTag = networkReply->rawHeader(ETagHeader);
+                document.lastModifiedHeader = networkReply->rawHeader(LastModifiedHeader);
+                document.valid = true;
+                document.contents = QString::fromUtf8(networkReply->readAll());
+
+                res.insert(iter.key(), document);
+            }
+        } else if (cachedDocument != pCachedDocuments.constEnd()) {
+            res.insert(iter.key(), *cachedDocument);
+        }
+
+        networkReply->deleteLater();
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+QMap<QString, QString> CellmlFileImportCache::contents(const QStringList &pFileNamesOrUrls)
+{
+    // Retrieve the contents of the given files or URLs, using our cached
+    // documents when they are still up to date
+    // Note #1: local files, as well as URLs that are mirrored locally, are read
+    //          in parallel while the other URLs are downloaded all at once...
+    // Note #2: a file or URL which contents could not be retrieved is not part
+    //          of our result...
+    // Note #3: a downloaded document is always revalidated against its server
+    //          (see downloadDocuments()), so that reloading a file picks up
+    //          any change to its remote imports...
+
+    QMap<QString, QString> res;
+    QStringList fileNamesOrUrls;
+    QStringList fileNames;
+    QStringList urls;
+    QHash<QString, Document> cachedDocuments;
+
+    for (const auto &fileNameOrUrl : pFileNamesOrUrls) {
+        bool isLocalFile;
+        QString fileName;
+
+        Core::checkFileNameOrUrl(fileNameOrUrl, isLocalFile, fileName);
+
+        QMutexLocker locker(&mMutex);
+
+        if (!isLocalFile) {
+            fileName = mirrorFileName(fileName);
+        }
+
+        auto document = mDocuments.constFind(fileNameOrUrl);
+
+        if (   (document != mDocuments.constEnd())
+            && (document->fileName == fileName) && isUpToDate(*document)) {
+            res.insert(fileNameOrUrl, document->contents);
+        } else if (fileName.isEmpty()) {
+            urls << fileNameOrUrl;
+
+            if ((document != mDocuments.constEnd()) && document->fileName.isEmpty()) {
+                cachedDocuments.insert(fileNameOrUrl, *document);
+            }
+        } else {
+            fileNamesOrUrls << fileNameOrUrl;
+            fileNames << fileName;
+        }
+    }
+
+    // Read our local files in parallel
+
+    const QList<Document> documents = QtConcurrent::blockingMapped<QList<Document>>(fileNames, readDocument);
+
+    // Download our remote files
+
+    QMap<QString, Document> downloadedDocuments = downloadDocuments(urls, cachedDocuments);
+
+    // Cache and return the contents that we have just retrieved
+
+    QMutexLocker locker(&mMutex);
+
+    for (int i = 0, iMax = documents.count(); i < iMax; ++i) {
+        const Document &document = documents[i];
+
+        if (document.valid) {
+            mDocuments.insert(fileNamesOrUrls[i], document);
+
+            res.insert(fileNamesOrUrls[i], document.contents);
+        }
+    }
+
+    for (auto iter = downloadedDocuments.constBegin(), iterEnd = downloadedDocuments.constEnd();
+         iter != iterEnd; ++iter) {
+        mDocuments.insert(iter.key(), iter.value());
+
+        res.insert(iter.key(), iter.value().contents);
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+} // namespace CellMLSupport
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -0,0 +1,90 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// CellML file import cache
+//==============================================================================
+
+#pragma once
+
+//==============================================================================
+
+#include "cellmlsupportglobal.h"
+
+//==============================================================================
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QStringList>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace CellMLSupport {
+
+//==============================================================================
+
+class CELLMLSUPPORT_EXPORT CellmlFileImportCache
+{
+public:
+    static CellmlFileImportCache * instance();
+
+    QString mirrorDirName() const;
+    void setMirrorDirName(const QString &pMirrorDirName);
+
+    QMap<QString, QString> contents(const QStringList &pFileNamesOrUrls);
+
+private:
+    struct Document
+    {
+        QString fileName;
+        QDateTime lastModified;
+        qint64 size = 0;
+        QByteArray entityTag;
+        QByteArray lastModifiedHeader;
+        bool valid = false;
+        QString contents;
+    };
+
+    mutable QMutex mMutex;
+
+    QString mMirrorDirName;
+
+    QHash<QString, Document> mDocuments;
+
+    QString mirrorFileName(const QString &pUrl) const;
+
+    static Document readDocument(const QString &pFileName);
+    static bool isUpToDate(const Document &pDocument);
+
+    QMap<QString, Document> downloadDocuments(const QStringList &pUrls,
+                                              const QHash<QString, Document> &pCachedDocuments) const;
+};
+
+//==============================================================================
+
+} // namespace CellMLSupport
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -445,6 +445,85 @@ CellmlFileRdfTriples::CellmlFileRdfTriples(CellmlFile *pCellmlFile) :
 
 //==============================================================================
 
+CellmlFileRdfTriples & CellmlFileRdfTriples::operator<<(CellmlFileRdfTriple *pRdfTriple)
+{
+    // Add the given RDF triple to our list and index it
+
+    append(pRdfTriple);
+
+    return *this;
+}
+
+//==============================================================================
+
+void CellmlFileRdfTriples::append(CellmlFileRdfTriple *pRdfTriple)
+{
+    // Add the given RDF triple to our list and index it
+
+    QList<CellmlFileRdfTriple *>::append(pRdfTriple);
+
+    indexRdfTriple(pRdfTriple);
+}
+
+//==============================================================================
+
+void CellmlFileRdfTriples::clear()
+{
+    // Clear our list and indexes
+
+    QList<CellmlFileRdfTriple *>::clear();
+
+    mMetadataIdRdfTriples.clear();
+    mSubjectRdfTriples.clear();
+}
+
+//==============================================================================
+
+void CellmlFileRdfTriples::indexRdfTriple(CellmlFileRdfTriple *pRdfTriple)
+{
+    // Index the given RDF triple by metadata id and by subject, so that
+    // associatedWith() doesn't have to go through all of our RDF triples
+    // Note: our list should therefore only ever be modified through append(),
+    //       operator<<(), clear() and removeRdfTriples()...
+
+    mMetadataIdRdfTriples.insert(pRdfTriple->metadataId(), pRdfTriple);
+    mSubjectRdfTriples.insert(pRdfTriple->subject()->asString(), pRdfTriple);
+}
+
+//==============================================================================
+
+void CellmlFileRdfTriples::unindexRdfTriple(CellmlFileRdfTriple *pRdfTriple)
+{
+    // Unindex the given RDF triple
+
+    mMetadataIdRdfTriples.remove(pRdfTriple->metadataId(), pRdfTriple);
+    mSubjectRdfTriples.remove(pRdfTriple->subject()->asString(), pRdfTriple);
+}
+
+//==============================================================================
+
+QList<CellmlFileRdfTriple *> CellmlFileRdfTriples::indexedRdfTriples(const QMultiHash<QString, CellmlFileRdfTriple *> &pIndex,
+                                                                     const QString &pKey)
+{
+    // Return the RDF triples that have the given key in the given index, in the
+    // order in which they were added to our list
+    // Note: QMultiHash::values() returns the most recently inserted values
+    //       first, hence we reverse them...
+
+    QList<CellmlFileRdfTriple *> values = pIndex.values(pKey);
+    QList<CellmlFileRdfTriple *> res;
+
+    res.reserve(values.count());
+
+    for (auto iter = values.crbegin(), iterEnd = values.crend(); iter != iterEnd; ++iter) {
+        res << *iter;
+    }
+
+    return res;
+}
+
+//==============================================================================
+
 CellmlFileRdfTriple::Type CellmlFileRdfTriples::type() const
 {
     // Return the type of the RDF triples
@@ -530,27 +609,27 @@ bool CellmlFileRdfTriple::decodeTerm(const QString &pTerm, QString &pResource,
 //==============================================================================
 
 void CellmlFileRdfTriples::recursiveAssociatedWith(CellmlFileRdfTriples &pRdfTriples,
+                                                   QSet<CellmlFileRdfTriple *> &pVisitedRdfTriples,
                                                    CellmlFileRdfTriple *pRdfTriple) const
 {
     // Add pRdfTriple to pRdfTriples, but only if it's not already part of
     // pRdfTriples
     // Note: indeed, a given RDF triple may be referenced more than once...
 
-    if (pRdfTriples.contains(pRdfTriple)) {
+    if (pVisitedRdfTriples.contains(pRdfTriple)) {
         return;
     }
 
+    pVisitedRdfTriples << pRdfTriple;
     pRdfTriples << pRdfTriple;
 
     // Recursively add all the RDF triples, which subject matches that of
     // pRdfTriple's object
 
-    QString rdfTripleObject = pRdfTriple->object()->asString();
+    const QList<CellmlFileRdfTriple *> rdfTriples = indexedRdfTriples(mSubjectRdfTriples, pRdfTriple->object()->asString());
 
-    for (auto rdfTriple : *this) {
-        if (rdfTriple->subject()->asString() == rdfTripleObject) {
-            recursiveAssociatedWith(pRdfTriples, rdfTriple);
-        }
+    for (auto rdfTriple : rdfTriples) {
+        recursiveAssociatedWith(pRdfTriples, pVisitedRdfTriples, rdfTriple);
     }
 }
 
@@ -562,17 +641,11 @@ CellmlFileRdfTriples CellmlFileRdfTriples::associatedWith(iface::cellml_api::Cel
     // with the given element's metadata id
 
     CellmlFileRdfTriples res = CellmlFileRdfTriples(mCellmlFile);
-    QString cmetaId = QString::fromStdWString(pElement->cmetaId());
-
-    for (auto rdfTriple : *this) {
-        // Retrieve the RDF triple's subject so we can determine whether it's
-        // from the group of RDF triples in which we are interested
+    QSet<CellmlFileRdfTriple *> visitedRdfTriples;
+    const QList<CellmlFileRdfTriple *> rdfTriples = indexedRdfTriples(mMetadataIdRdfTriples, QString::fromStdWString(pElement->cmetaId()));
 
-        if (cmetaId == rdfTriple->metadataId()) {
-            // It's the correct metadata id, so add it to our list
-
-            recursiveAssociatedWith(res, rdfTriple);
-        }
+    for (auto rdfTriple : rdfTriples) {
+        recursiveAssociatedWith(res, visitedRdfTriples, rdfTriple);
     }
 
     return res;
@@ -611,12 +684,33 @@ CellmlFileRdfTriple * CellmlFileRdfTriples::add(CellmlFileRdfTriple *pRdfTriple)
 bool CellmlFileRdfTriples::removeRdfTriples(const CellmlFileRdfTriples &pRdfTriples)
 {
     // Remove all the given RDF triples
+    // Note: we determine which RDF triples to remove before modifying our list
+    //       since pRdfTriples may be ourselves (see removeAll()), and we then
+    //       remove them from our list in one go rather than one by one...
 
     if (!pRdfTriples.isEmpty()) {
+        QSet<CellmlFileRdfTriple *> rdfTriples;
+
         for (auto rdfTriple : pRdfTriples) {
-            // Remove the RDF triple
+            rdfTriples << rdfTriple;
+        }
+
+        QList<CellmlFileRdfTriple *> remainingRdfTriples;
+
+        remainingRdfTriples.reserve(count());
+
+        for (auto rdfTriple : qAsConst(*this)) {
+            if (!rdfTriples.contains(rdfTriple)) {
+                remainingRdfTriples << rdfTriple;
+            }
+        }
+
+        QList<CellmlFileRdfTriple *>::operator=(remainingRdfTriples);
+
+        for (auto rdfTriple : qAsConst(rdfTriples)) {
+            // Unindex the RDF triple
 
-            removeOne(rdfTriple);
+            unindexRdfTriple(rdfTriple);
 
             // Remove the CellML API version of the RDF triple from its data
             // source
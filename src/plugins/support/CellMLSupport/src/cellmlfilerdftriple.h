@@ -30,6 +30,8 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 //==============================================================================
 
+#include <QMultiHash>
+#include <QSet>
 #include <QStringList>
 
 //==============================================================================
@@ -164,6 +166,11 @@ class CELLMLSUPPORT_EXPORT CellmlFileRdfTriples: public QList<CellmlFileRdfTripl
 public:
     explicit CellmlFileRdfTriples(CellmlFile *pCellmlFile);
 
+    CellmlFileRdfTriples & operator<<(CellmlFileRdfTriple *pRdfTriple);
+
+    void append(CellmlFileRdfTriple *pRdfTriple);
+    void clear();
+
     CellmlFileRdfTriple::Type type() const;
 
     CellmlFileRdfTriples associatedWith(iface::cellml_api::CellMLElement *pElement) const;
@@ -181,7 +188,17 @@ private:
 
     QStringList mOriginalRdfTriples;
 
+    QMultiHash<QString, CellmlFileRdfTriple *> mMetadataIdRdfTriples;
+    QMultiHash<QString, CellmlFileRdfTriple *> mSubjectRdfTriples;
+
+    void indexRdfTriple(CellmlFileRdfTriple *pRdfTriple);
+    void unindexRdfTriple(CellmlFileRdfTriple *pRdfTriple);
+
+    static QList<CellmlFileRdfTriple *> indexedRdfTriples(const QMultiHash<QString, CellmlFileRdfTriple *> &pIndex,
+                                                          const QString &pKey);
+
     void recursiveAssociatedWith(CellmlFileRdfTriples &pRdfTriples,
+                                 QSet<CellmlFileRdfTriple *> &pVisitedRdfTriples,
                                  CellmlFileRdfTriple *pRdfTriple) const;
 
     bool removeRdfTriples(const CellmlFileRdfTriples &pRdfTriples);
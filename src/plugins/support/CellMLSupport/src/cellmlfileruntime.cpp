@@ -29,6 +29,7 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 #include "cellmlfile.h"
 #include "cellmlfileruntime.h"
+#include "cellmlfileruntimejacobian.h"
 #include "compilerengine.h"
 #include "corecliutils.h"
 #include "solverinterface.h"
@@ -37,6 +38,7 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 #include <QRegularExpression>
 #include <QStringList>
+#include <QtConcurrent/QtConcurrent>
 
 //==============================================================================
 
@@ -496,9 +498,12 @@ void CellmlFileRuntime::update(CellmlFile *pCellmlFile, bool pAll)
                       "    double *aALGEBRAIC;\n"
                       "};\n"
                       "\n"
-                      "extern void doNonLinearSolve(char *, void (*)(double *, double *, void*), double *, int, void *);\n"
+                      "extern void *nlaSolver;\n"
                       "\n"
-                     +functionsString
+                      "extern void doNonLinearSolve(void *, void (*)(double *, double *, void*), double *, int, void *);\n"
+                      "extern void doNonLinearSolveWithJacobian(void *, void (*)(double *, double *, void*), void (*)(double *, double *, void*), void *, double *, int, void *);\n"
+                      "\n"
+                     +nlaSystemsJacobianCode(functionsString)
                      +"\n";
     }
 
@@ -535,13 +540,52 @@ void CellmlFileRuntime::update(CellmlFile *pCellmlFile, bool pAll)
                  +methodCode("computeRates(double VOI, double *CONSTANTS, double *RATES, double *STATES, double *ALGEBRAIC)",
                              mCodeInformation->ratesString());
 
+    // Generate a batched version of computeRates(), if possible, i.e. if we
+    // don't need to solve any NLA system
+    // Note: the NLA solver to use is associated with us, not with any of the
+    //       instances of a batch, hence we cannot batch NLA systems...
+
+    if (!mAtLeastOneNlaSystem) {
+        modelCode += batchMethodCode("computeRatesBatch", mCodeInformation->ratesString());
+    }
+
+    // Determine the sparsity pattern of the Jacobian of computeRates() and
+    // generate a function that computes its non-zero entries, if possible
+    // Note: this is not possible if we need to solve an NLA system, since the
+    //       rates then depend on the solution of that NLA system...
+
+    CellmlFileRuntimeJacobian jacobian(cleanCode(mCodeInformation->ratesString()),
+                                       "STATES", "RATES", mStatesRatesCount);
+
+    if (jacobian.hasSparsityPattern()) {
+        mJacobianColumnPointers = jacobian.columnPointers();
+        mJacobianRowIndices = jacobian.rowIndices();
+
+        if (jacobian.isDifferentiable()) {
+            mHasJacobian = true;
+
+            modelCode += methodCode("computeJacobian(double VOI, double *CONSTANTS, double *RATES, double *STATES, double *ALGEBRAIC, double *JACOBIAN)",
+                                    jacobian.code("JACOBIAN", false));
+        }
+    }
+
     // Check whether the model code contains a definite integral, otherwise
     // compute it and check that everything went fine
+    // Note: unless our model code has already been compiled and optimised (and
+    //       is therefore cached), we first compile it without optimising it,
+    //       so that it can be used as soon as possible, and then compile and
+    //       optimise it in the background (see swapFunctions())...
+
+    bool optimize = true;
+
+#ifndef QT_DEBUG
+    optimize = mCompilerEngine->hasCachedObject(modelCode);
+#endif
 
     if (modelCode.contains("defint(func")) {
         mIssues << CellmlFileIssue(CellmlFileIssue::Type::Error,
                                    tr("definite integrals are not supported"));
-    } else if (!mCompilerEngine->compileCode(modelCode)) {
+    } else if (!mCompilerEngine->compileCode(modelCode, optimize)) {
         mIssues << CellmlFileIssue(CellmlFileIssue::Type::Error,
                                    mCompilerEngine->error());
     }
@@ -550,28 +594,29 @@ void CellmlFileRuntime::update(CellmlFile *pCellmlFile, bool pAll)
 
     if (!mIssues.isEmpty()) {
         reset(true, false, true);
-    } else {
-        // Add the symbol of any required external function, if any
-
-        if (mAtLeastOneNlaSystem) {
-            mCompilerEngine->addFunction("doNonLinearSolve", reinterpret_cast<void *>(doNonLinearSolve));
-        }
+    } else if (!prepareFunctions(mCompilerEngine, nlaSymbols(), mAtLeastOneNlaSystem, mHasJacobian)) {
+        mIssues << CellmlFileIssue(CellmlFileIssue::Type::Error,
+                                   tr("an unexpected problem occurred while trying to retrieve the model functions"));
 
-        // Retrieve the ODE functions
+        reset(true, false, true);
+    } else {
+        retrieveFunctions(mCompilerEngine, mFunctions);
 
-        mInitializeConstants = reinterpret_cast<InitializeConstantsFunction>(mCompilerEngine->function("initializeConstants"));
-        mComputeComputedConstants = reinterpret_cast<ComputeComputedConstantsFunction>(mCompilerEngine->function("computeComputedConstants"));
-        mComputeVariables = reinterpret_cast<ComputeVariablesFunction>(mCompilerEngine->function("computeVariables"));
-        mComputeRates = reinterpret_cast<ComputeRatesFunction>(mCompilerEngine->function("computeRates"));
+        mCurrentFunctions.storeRelease(&mFunctions);
 
-        // Make sure that we managed to retrieve all the ODE functions
+        // Compile and optimise our model code in the background, if needed
 
-        if (   (mInitializeConstants == nullptr) || (mComputeComputedConstants == nullptr)
-            || (mComputeVariables == nullptr) || (mComputeRates == nullptr)) {
-            mIssues << CellmlFileIssue(CellmlFileIssue::Type::Error,
-                                       tr("an unexpected problem occurred while trying to retrieve the model functions"));
+        if (!optimize) {
+            auto optimizedCompilerEngine = std::make_shared<Compiler::CompilerEngine>();
+            QMap<QString, void *> nlaSymbols = CellmlFileRuntime::nlaSymbols();
+            bool atLeastOneNlaSystem = mAtLeastOneNlaSystem;
+            bool hasJacobian = mHasJacobian;
 
-            reset(true, false, true);
+            mOptimizedCompilerEngine = optimizedCompilerEngine;
+            mOptimizedFunctionsReady = QtConcurrent::run([optimizedCompilerEngine, modelCode, nlaSymbols, atLeastOneNlaSystem, hasJacobian]() {
+                return    optimizedCompilerEngine->compileCode(modelCode)
+                       && prepareFunctions(optimizedCompilerEngine.get(), nlaSymbols, atLeastOneNlaSystem, hasJacobian);
+            });
         }
     }
 }
@@ -596,6 +641,28 @@ bool CellmlFileRuntime::needNlaSolver() const
 
 //==============================================================================
 
+Solver::NlaSolver * CellmlFileRuntime::nlaSolver() const
+{
+    // Return our NLA solver
+
+    return mNlaSolver;
+}
+
+//==============================================================================
+
+void CellmlFileRuntime::setNlaSolver(Solver::NlaSolver *pNlaSolver)
+{
+    // Set our NLA solver
+    // Note: our model code is bound to our NLA solver pointer (see
+    //       nlaSymbols()), so the NLA solver we set here is the one that will
+    //       be used the next time our model code needs to solve an NLA
+    //       system...
+
+    mNlaSolver = pNlaSolver;
+}
+
+//==============================================================================
+
 void CellmlFileRuntime::importData(const QString &pName,
                                    const QStringList &pComponentHierarchy,
                                    int pIndex, double *pData)
@@ -648,7 +715,7 @@ CellmlFileRuntime::InitializeConstantsFunction CellmlFileRuntime::initializeCons
 {
     // Return the initializeConstants function
 
-    return mInitializeConstants;
+    return mCurrentFunctions.loadAcquire()->initializeConstants;
 }
 
 //==============================================================================
@@ -657,7 +724,7 @@ CellmlFileRuntime::ComputeComputedConstantsFunction CellmlFileRuntime::computeCo
 {
     // Return the computeComputedConstants function
 
-    return mComputeComputedConstants;
+    return mCurrentFunctions.loadAcquire()->computeComputedConstants;
 }
 
 //==============================================================================
@@ -666,7 +733,7 @@ CellmlFileRuntime::ComputeVariablesFunction CellmlFileRuntime::computeVariables(
 {
     // Return the computeVariables function
 
-    return mComputeVariables;
+    return mCurrentFunctions.loadAcquire()->computeVariables;
 }
 
 //==============================================================================
@@ -675,7 +742,92 @@ CellmlFileRuntime::ComputeRatesFunction CellmlFileRuntime::computeRates() const
 {
     // Return the computeRates function
 
-    return mComputeRates;
+    return mCurrentFunctions.loadAcquire()->computeRates;
+}
+
+//==============================================================================
+
+CellmlFileRuntime::ComputeRatesBatchFunction CellmlFileRuntime::computeRatesBatch() const
+{
+    // Return the computeRatesBatch function, if any
+
+    return mCurrentFunctions.loadAcquire()->computeRatesBatch;
+}
+
+//==============================================================================
+
+CellmlFileRuntime::ComputeJacobianFunction CellmlFileRuntime::computeJacobian() const
+{
+    // Return the computeJacobian function, if any
+
+    return mCurrentFunctions.loadAcquire()->computeJacobian;
+}
+
+//==============================================================================
+
+QVector<int> CellmlFileRuntime::jacobianColumnPointers() const
+{
+    // Return the column pointers of the sparsity pattern of our Jacobian, if
+    // known
+
+    return mJacobianColumnPointers;
+}
+
+//==============================================================================
+
+QVector<int> CellmlFileRuntime::jacobianRowIndices() const
+{
+    // Return the row indices of the sparsity pattern of our Jacobian, if known
+
+    return mJacobianRowIndices;
+}
+
+//==============================================================================
+
+bool CellmlFileRuntime::swapFunctions()
+{
+    // Swap our functions for their optimised version, if it has become
+    // available, and return whether we did
+    // Note #1: this is to be called from a safe point, i.e. when none of our
+    //          functions are being called (e.g. in between two points in
+    //          SimulationWorker::run())...
+    // Note #2: we keep track of our original compiler engine until we get
+    //          reset, meaning that our original functions remain valid and
+    //          that whoever still uses them can safely do so...
+    // Note #3: our functions may be retrieved from other threads (e.g. those
+    //          of a parameter sweep), so we fill in a separate table of
+    //          functions and then publish it in one go...
+
+    QMutexLocker functionsLocker(&mFunctionsMutex);
+
+    if (   (mOptimizedCompilerEngine == nullptr) || mFunctionsOptimized
+        || !mOptimizedFunctionsReady.isFinished()) {
+        return false;
+    }
+
+    mFunctionsOptimized = true;
+
+    if (!mOptimizedFunctionsReady.result()) {
+        return false;
+    }
+
+    retrieveFunctions(mOptimizedCompilerEngine.get(), mOptimizedFunctions);
+
+    mCurrentFunctions.storeRelease(&mOptimizedFunctions);
+
+    return true;
+}
+
+//==============================================================================
+
+Compiler::CompilerEngine * CellmlFileRuntime::compilerEngine() const
+{
+    // Return the compiler engine that was used to compile our current
+    // functions, e.g. to retrieve the time it took to compile them
+
+    return (mCurrentFunctions.loadAcquire() == &mOptimizedFunctions)?
+               mOptimizedCompilerEngine.get():
+               mCompilerEngine;
 }
 
 //==============================================================================
@@ -731,10 +883,87 @@ void CellmlFileRuntime::resetFunctions()
 {
     // Reset the functions
 
-    mInitializeConstants = nullptr;
-    mComputeComputedConstants = nullptr;
-    mComputeVariables = nullptr;
-    mComputeRates = nullptr;
+    mFunctions = Functions();
+    mOptimizedFunctions = Functions();
+
+    mCurrentFunctions.storeRelease(&mFunctions);
+}
+
+//==============================================================================
+
+QMap<QString, void *> CellmlFileRuntime::nlaSymbols()
+{
+    // Return the symbols through which our model code accesses our NLA solver
+    // pointer and the status of the Jacobian of each of our NLA systems
+    // Note: our model code only refers to those symbols by name, so that it
+    //       doesn't depend on where we are in memory and can therefore be
+    //       cached (see Compiler::CompilerObjectCache)...
+
+    QMap<QString, void *> res;
+
+    if (mAtLeastOneNlaSystem) {
+        res.insert("nlaSolver", &mNlaSolver);
+
+        for (auto jacobianStatus = mNlaSystemsJacobianStatuses.constBegin(),
+                  jacobianStatusEnd = mNlaSystemsJacobianStatuses.constEnd();
+             jacobianStatus != jacobianStatusEnd; ++jacobianStatus) {
+            res.insert(jacobianStatus.key(), jacobianStatus.value());
+        }
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+bool CellmlFileRuntime::prepareFunctions(Compiler::CompilerEngine *pCompilerEngine,
+                                         const QMap<QString, void *> &pNlaSymbols,
+                                         bool pAtLeastOneNlaSystem,
+                                         bool pHasJacobian)
+{
+    // Add the symbol of any required external function and data, if any
+
+    if (pAtLeastOneNlaSystem) {
+        pCompilerEngine->addFunction("doNonLinearSolve", reinterpret_cast<void *>(doNonLinearSolve));
+        pCompilerEngine->addFunction("doNonLinearSolveWithJacobian", reinterpret_cast<void *>(doNonLinearSolveWithJacobian));
+
+        for (auto nlaSymbol = pNlaSymbols.constBegin(), nlaSymbolEnd = pNlaSymbols.constEnd();
+             nlaSymbol != nlaSymbolEnd; ++nlaSymbol) {
+            pCompilerEngine->addFunction(nlaSymbol.key(), nlaSymbol.value());
+        }
+    }
+
+    // Make sure that our ODE functions can be retrieved
+    // Note: this means that our functions get generated and linked, which is
+    //       what we want when our functions are prepared in the background...
+
+    return    (pCompilerEngine->function("initializeConstants") != nullptr)
+           && (pCompilerEngine->function("computeComputedConstants") != nullptr)
+           && (pCompilerEngine->function("computeVariables") != nullptr)
+           && (pCompilerEngine->function("computeRates") != nullptr)
+           && (pAtLeastOneNlaSystem || (pCompilerEngine->function("computeRatesBatch") != nullptr))
+           && (!pHasJacobian || (pCompilerEngine->function("computeJacobian") != nullptr));
+}
+
+//==============================================================================
+
+void CellmlFileRuntime::retrieveFunctions(Compiler::CompilerEngine *pCompilerEngine,
+                                          Functions &pFunctions)
+{
+    // Retrieve the ODE functions
+
+    pFunctions.initializeConstants = reinterpret_cast<InitializeConstantsFunction>(pCompilerEngine->function("initializeConstants"));
+    pFunctions.computeComputedConstants = reinterpret_cast<ComputeComputedConstantsFunction>(pCompilerEngine->function("computeComputedConstants"));
+    pFunctions.computeVariables = reinterpret_cast<ComputeVariablesFunction>(pCompilerEngine->function("computeVariables"));
+    pFunctions.computeRates = reinterpret_cast<ComputeRatesFunction>(pCompilerEngine->function("computeRates"));
+
+    if (!mAtLeastOneNlaSystem) {
+        pFunctions.computeRatesBatch = reinterpret_cast<ComputeRatesBatchFunction>(pCompilerEngine->function("computeRatesBatch"));
+    }
+
+    if (mHasJacobian) {
+        pFunctions.computeJacobian = reinterpret_cast<ComputeJacobianFunction>(pCompilerEngine->function("computeJacobian"));
+    }
 }
 
 //==============================================================================
@@ -745,6 +974,14 @@ void CellmlFileRuntime::reset(bool pRecreateCompilerEngine, bool pResetIssues,
     // Reset all of the runtime's properties
 
     mAtLeastOneNlaSystem = false;
+    mHasJacobian = false;
+
+    mJacobianColumnPointers.clear();
+    mJacobianRowIndices.clear();
+
+    qDeleteAll(mNlaSystemsJacobianStatuses);
+
+    mNlaSystemsJacobianStatuses.clear();
 
     resetCodeInformation();
 
@@ -756,6 +993,14 @@ void CellmlFileRuntime::reset(bool pRecreateCompilerEngine, bool pResetIssues,
         mCompilerEngine = nullptr;
     }
 
+    // Forget about our optimised compiler engine, if any
+    // Note: if it is still compiling our model code in the background then it
+    //       will get deleted once it is done (see update())...
+
+    mOptimizedCompilerEngine = nullptr;
+    mOptimizedFunctionsReady = QFuture<bool>();
+    mFunctionsOptimized = false;
+
     resetFunctions();
 
     if (pResetIssues) {
@@ -885,6 +1130,136 @@ QString CellmlFileRuntime::methodCode(const QString &pCodeSignature,
 
 //==============================================================================
 
+QString CellmlFileRuntime::batchMethodCode(const QString &pMethodName,
+                                           const std::wstring &pCodeBody)
+{
+    // Generate and return the code for the given method, but for COUNT
+    // instances which arrays are laid out as structures of arrays, i.e. the
+    // i-th entry of the k-th instance is at position i*COUNT+k
+    // Note #1: this allows the compiler to vectorise our loop over our
+    //          instances, all the more since our arrays never overlap, hence
+    //          we make them restricted...
+    // Note #2: our loop is in a function that is always inlined and which is
+    //          called with a constant COUNT for full batches (see
+    //          SimulationSweep::run()), so that the compiler can generate code
+    //          that is specific to that number of instances (e.g. with
+    //          constant strides and no loop remainder)...
+
+    static const QRegularExpression ArrayEntryRegEx = QRegularExpression(R"(\b(CONSTANTS|RATES|STATES|ALGEBRAIC)\[(\d+)\])");
+    static const QString Parameters = "double VOI, double * __restrict CONSTANTS, double * __restrict RATES, double * __restrict STATES, double * __restrict ALGEBRAIC";
+    static const QString Arguments = "VOI, CONSTANTS, RATES, STATES, ALGEBRAIC";
+
+    QString codeBody = cleanCode(pCodeBody);
+
+    codeBody.replace(ArrayEntryRegEx, "\\1[\\2*COUNT+INSTANCE]");
+
+    return  "static inline __attribute__((always_inline)) "
+           +methodCode(pMethodName+"Instances(const int COUNT, "+Parameters+")",
+                       "for (int INSTANCE = 0; INSTANCE < COUNT; ++INSTANCE) {\n"
+                      +codeBody
+                      +"\n}")
+           +methodCode(pMethodName+"(int COUNT, "+Parameters+")",
+                       QString("if (COUNT == %1) {\n"
+                               "    %2Instances(%1, %3);\n"
+                               "} else {\n"
+                               "    %2Instances(COUNT, %3);\n"
+                               "}").arg(int(MaximumBatchCount))
+                                   .arg(pMethodName, Arguments));
+}
+
+//==============================================================================
+
+QString CellmlFileRuntime::nlaSystemsJacobianCode(const QString &pFunctionsString)
+{
+    // Generate, for each of the NLA systems defined in the given functions,
+    // a function that computes the (dense, column-major) Jacobian of its
+    // objective function, if possible, and have it used when solving the NLA
+    // system
+    // Note: our Jacobian functions are derived from the code of our objective
+    //       functions, so doNonLinearSolveWithJacobian() checks them against
+    //       finite differences the first time they are used and falls back to
+    //       the NLA solver's own Jacobian if they don't match. The outcome of
+    //       that check is kept in a status that we own and which our model
+    //       code accesses through a symbol (see nlaSymbols())...
+
+    static const QRegularExpression ObjectiveFunctionRegEx = QRegularExpression(R"(void (objfunc_\d+)\(double \*p, double \*hx, void \*adata\)\n\{\n(.*?)\n\}\n)",
+                                                                                QRegularExpression::DotMatchesEverythingOption);
+    static const QRegularExpression ResidualRegEx = QRegularExpression(R"(^\s*(\*hx|hx\[\d+\])\s*=)");
+
+    QString res;
+    QStringList jacobianFunctions;
+    QRegularExpressionMatchIterator matchIter = ObjectiveFunctionRegEx.globalMatch(pFunctionsString);
+    int position = 0;
+
+    while (matchIter.hasNext()) {
+        QRegularExpressionMatch match = matchIter.next();
+
+        res += pFunctionsString.mid(position, match.capturedEnd()-position);
+
+        position = match.capturedEnd();
+
+        // Split the body of our objective function into its prologue (i.e.
+        // the retrieval of our user data and the definition of our macros),
+        // its statements and its epilogue (i.e. the undefinition of our
+        // macros)
+
+        const QStringList lines = match.captured(2).split('\n');
+        QString prologue;
+        QString statements;
+        QString epilogue;
+        int size = 0;
+
+        for (const auto &line : lines) {
+            QString trimmedLine = line.trimmed();
+
+            if (trimmedLine.startsWith("#undef")) {
+                epilogue += line+"\n";
+            } else if (trimmedLine.startsWith('#') || trimmedLine.startsWith("struct ")) {
+                prologue += line+"\n";
+            } else {
+                statements += line+"\n";
+
+                if (ResidualRegEx.match(line).hasMatch()) {
+                    ++size;
+                }
+            }
+        }
+
+        CellmlFileRuntimeJacobian jacobian(statements, "p", "hx", size);
+
+        if (jacobian.isDifferentiable()) {
+            QString objectiveFunction = match.captured(1);
+
+            res += "extern int "+objectiveFunction+"_jacobianStatus;\n"
+                   "\n"
+                   "void "+objectiveFunction+"_jacobian(double *p, double *jac, void *adata)\n"
+                   "{\n"
+                  +prologue
+                  +QString("double hx[%1];\n").arg(size)
+                  +jacobian.code("jac", true)
+                  +epilogue
+                  +"}\n";
+
+            jacobianFunctions << objectiveFunction;
+        }
+    }
+
+    res += pFunctionsString.mid(position);
+
+    // Use our Jacobian functions
+
+    for (const auto &jacobianFunction : qAsConst(jacobianFunctions)) {
+        mNlaSystemsJacobianStatuses.insert(jacobianFunction+"_jacobianStatus", new QAtomicInt(0));
+
+        res.replace(QString("doNonLinearSolve(&nlaSolver, %1, ").arg(jacobianFunction),
+                    QString("doNonLinearSolveWithJacobian(&nlaSolver, %1, %1_jacobian, &%1_jacobianStatus, ").arg(jacobianFunction));
+    }
+
+    return res;
+}
+
+//==============================================================================
+
 QStringList CellmlFileRuntime::componentHierarchy(iface::cellml_api::CellMLElement *pElement)
 {
     // Make sure that we have a given element
@@ -950,8 +1325,12 @@ QString CellmlFileRuntime::cleanCode(const std::wstring &pCode)
     // own non-linear solve routine defined in our Solver interface, and add a
     // new parameter to all our calls to doNonLinearSolve() so that
     // doNonLinearSolve() can retrieve the correct instance of our NLA solver
+    // Note: that new parameter is the address of our NLA solver pointer, which
+    //       our model code gets through the nlaSolver symbol (see
+    //       nlaSymbols()), meaning that doNonLinearSolve() can retrieve our NLA
+    //       solver without having to look it up...
 
-    res.replace("do_nonlinearsolve(", QString(R"(doNonLinearSolve("%1", )").arg(Solver::objectAddress(this)));
+    res.replace("do_nonlinearsolve(", "doNonLinearSolve(&nlaSolver, ");
 
     return res;
 }
@@ -30,12 +30,16 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 //==============================================================================
 
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QFuture>
 #include <QIcon>
 #include <QList>
 #include <QMap>
+#include <QMutex>
+#include <QVector>
 #ifdef Q_OS_WIN
     #include <QSet>
-    #include <QVector>
 #endif
 
 //==============================================================================
@@ -49,6 +53,10 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 //==============================================================================
 
+#include <memory>
+
+//==============================================================================
+
 namespace OpenCOR {
 
 //==============================================================================
@@ -59,6 +67,12 @@ namespace Compiler {
 
 //==============================================================================
 
+namespace Solver {
+    class NlaSolver;
+} // namespace Solver
+
+//==============================================================================
+
 namespace CellMLSupport {
 
 //==============================================================================
@@ -134,6 +148,12 @@ public:
     using ComputeComputedConstantsFunction = void (*)(double VOI, double *CONSTANTS, double *RATES, double *STATES, double *ALGEBRAIC);
     using ComputeVariablesFunction = void (*)(double VOI, double *CONSTANTS, double *RATES, double *STATES, double *ALGEBRAIC);
     using ComputeRatesFunction = void (*)(double VOI, double *CONSTANTS, double *RATES, double *STATES, double *ALGEBRAIC);
+    using ComputeRatesBatchFunction = void (*)(int COUNT, double VOI, double *CONSTANTS, double *RATES, double *STATES, double *ALGEBRAIC);
+    using ComputeJacobianFunction = void (*)(double VOI, double *CONSTANTS, double *RATES, double *STATES, double *ALGEBRAIC, double *JACOBIAN);
+
+    enum {
+        MaximumBatchCount = 8
+    };
 
     explicit CellmlFileRuntime(CellmlFile *pCellmlFile);
     ~CellmlFileRuntime() override;
@@ -144,6 +164,9 @@ public:
 
     bool needNlaSolver() const;
 
+    Solver::NlaSolver * nlaSolver() const;
+    void setNlaSolver(Solver::NlaSolver *pNlaSolver);
+
     void importData(const QString &pName,
                     const QStringList &pComponentHierarchy, int pIndex,
                     double *pData);
@@ -157,6 +180,15 @@ public:
     ComputeComputedConstantsFunction computeComputedConstants() const;
     ComputeVariablesFunction computeVariables() const;
     ComputeRatesFunction computeRates() const;
+    ComputeRatesBatchFunction computeRatesBatch() const;
+    ComputeJacobianFunction computeJacobian() const;
+
+    QVector<int> jacobianColumnPointers() const;
+    QVector<int> jacobianRowIndices() const;
+
+    bool swapFunctions();
+
+    Compiler::CompilerEngine * compilerEngine() const;
 
     CellmlFileIssues issues() const;
 
@@ -167,6 +199,10 @@ public:
 
 private:
     bool mAtLeastOneNlaSystem = false;
+    bool mHasJacobian = false;
+
+    Solver::NlaSolver *mNlaSolver = nullptr;
+    QMap<QString, QAtomicInt *> mNlaSystemsJacobianStatuses;
 
     ObjRef<iface::cellml_services::CodeInformation> mCodeInformation;
 
@@ -176,20 +212,45 @@ private:
 
     Compiler::CompilerEngine *mCompilerEngine = nullptr;
 
+    std::shared_ptr<Compiler::CompilerEngine> mOptimizedCompilerEngine;
+    QFuture<bool> mOptimizedFunctionsReady;
+    bool mFunctionsOptimized = false;
+    QMutex mFunctionsMutex;
+
     CellmlFileIssues mIssues;
 
     CellmlFileRuntimeParameter *mVoi = nullptr;
     CellmlFileRuntimeParameters mParameters;
 
-    InitializeConstantsFunction mInitializeConstants = nullptr;
-    ComputeComputedConstantsFunction mComputeComputedConstants = nullptr;
-    ComputeVariablesFunction mComputeVariables = nullptr;
-    ComputeRatesFunction mComputeRates = nullptr;
+    struct Functions
+    {
+        InitializeConstantsFunction initializeConstants = nullptr;
+        ComputeComputedConstantsFunction computeComputedConstants = nullptr;
+        ComputeVariablesFunction computeVariables = nullptr;
+        ComputeRatesFunction computeRates = nullptr;
+        ComputeRatesBatchFunction computeRatesBatch = nullptr;
+        ComputeJacobianFunction computeJacobian = nullptr;
+    };
+
+    Functions mFunctions;
+    Functions mOptimizedFunctions;
+    QAtomicPointer<Functions> mCurrentFunctions;
+
+    QVector<int> mJacobianColumnPointers;
+    QVector<int> mJacobianRowIndices;
 
     void resetCodeInformation();
 
     void resetFunctions();
 
+    QMap<QString, void *> nlaSymbols();
+
+    static bool prepareFunctions(Compiler::CompilerEngine *pCompilerEngine,
+                                 const QMap<QString, void *> &pNlaSymbols,
+                                 bool pAtLeastOneNlaSystem, bool pHasJacobian);
+    void retrieveFunctions(Compiler::CompilerEngine *pCompilerEngine,
+                           Functions &pFunctions);
+
     void reset(bool pRecreateCompilerEngine, bool pResetIssues, bool pResetAll);
 
     void couldNotGenerateModelCodeIssue(const QString &pExtraInfo);
@@ -203,6 +264,9 @@ private:
     QString methodCode(const QString &pCodeSignature, const QString &pCodeBody);
     QString methodCode(const QString &pCodeSignature,
                        const std::wstring &pCodeBody);
+    QString batchMethodCode(const QString &pMethodName,
+                            const std::wstring &pCodeBody);
+    QString nlaSystemsJacobianCode(const QString &pFunctionsString);
 
     QStringList componentHierarchy(iface::cellml_api::CellMLElement *pElement);
 };
@@ -0,0 +1,1007 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// CellML file runtime Jacobian
+//==============================================================================
+
+#include "cellmlfileruntimejacobian.h"
+
+//==============================================================================
+
+#include <QMap>
+#include <QRegularExpression>
+
+//==============================================================================
+
+#include <algorithm>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace CellMLSupport {
+
+//==============================================================================
+
+CellmlFileRuntimeJacobianExpression::CellmlFileRuntimeJacobianExpression(Type pType,
+                                                                         const QString &pValue,
+                                                                         const Expressions &pArguments) :
+    mType(pType),
+    mValue(pValue),
+    mArguments(pArguments)
+{
+}
+
+//==============================================================================
+
+CellmlFileRuntimeJacobianExpression::~CellmlFileRuntimeJacobianExpression()
+{
+    // Delete some internal objects
+
+    qDeleteAll(mArguments);
+}
+
+//==============================================================================
+
+CellmlFileRuntimeJacobianExpression::Type CellmlFileRuntimeJacobianExpression::type() const
+{
+    // Return our type
+
+    return mType;
+}
+
+//==============================================================================
+
+QString CellmlFileRuntimeJacobianExpression::value() const
+{
+    // Return our value
+
+    return mValue;
+}
+
+//==============================================================================
+
+CellmlFileRuntimeJacobianExpression::Expressions CellmlFileRuntimeJacobianExpression::arguments() const
+{
+    // Return our arguments
+
+    return mArguments;
+}
+
+//==============================================================================
+
+QString CellmlFileRuntimeJacobianExpression::code() const
+{
+    // Return our (fully parenthesised) code
+
+    switch (mType) {
+    case Type::Number:
+    case Type::Variable:
+        return mValue;
+    case Type::Call: {
+        QStringList arguments;
+
+        for (auto argument : mArguments) {
+            arguments << argument->code();
+        }
+
+        return mValue+"("+arguments.join(", ")+")";
+    }
+    case Type::Cast:
+        return "(("+mValue+") "+mArguments[0]->code()+")";
+    case Type::UnaryMinus:
+        return "(-"+mArguments[0]->code()+")";
+    case Type::Not:
+        return "(!"+mArguments[0]->code()+")";
+    case Type::Operator:
+        return "("+mArguments[0]->code()+" "+mValue+" "+mArguments[1]->code()+")";
+    case Type::Conditional:
+        return "("+mArguments[0]->code()+"?"+mArguments[1]->code()+":"+mArguments[2]->code()+")";
+    }
+
+    return {};
+}
+
+//==============================================================================
+
+static const QMap<QString, QString> & firstDerivatives()
+{
+    // Return the first derivative of the mathematical functions, with one
+    // argument, that can be found in our model code
+    // Note #1: %1 is to be replaced with the code of the argument...
+    // Note #2: sqrt() is not available to our model code, hence we use pow()
+    //          instead...
+
+    static const QMap<QString, QString> FirstDerivatives = {
+                                                               { "fabs", "((%1 < 0.0)?-1.0:1.0)" },
+                                                               { "exp", "exp(%1)" },
+                                                               { "log", "(1.0/%1)" },
+                                                               { "sin", "cos(%1)" },
+                                                               { "cos", "(-sin(%1))" },
+                                                               { "tan", "(1.0/(cos(%1)*cos(%1)))" },
+                                                               { "sinh", "cosh(%1)" },
+                                                               { "cosh", "sinh(%1)" },
+                                                               { "tanh", "(1.0-tanh(%1)*tanh(%1))" },
+                                                               { "asin", "pow(1.0-%1*%1, -0.5)" },
+                                                               { "acos", "(-pow(1.0-%1*%1, -0.5))" },
+                                                               { "atan", "(1.0/(1.0+%1*%1))" },
+                                                               { "asinh", "pow(%1*%1+1.0, -0.5)" },
+                                                               { "acosh", "pow(%1*%1-1.0, -0.5)" },
+                                                               { "atanh", "(1.0/(1.0-%1*%1))" },
+                                                               { "sec", "(sec(%1)*tan(%1))" },
+                                                               { "csc", "(-csc(%1)*cot(%1))" },
+                                                               { "cot", "(-csc(%1)*csc(%1))" },
+                                                               { "sech", "(-sech(%1)*tanh(%1))" },
+                                                               { "csch", "(-csch(%1)*coth(%1))" },
+                                                               { "coth", "(-csch(%1)*csch(%1))" },
+                                                               { "asec", "(1.0/(fabs(%1)*pow(%1*%1-1.0, 0.5)))" },
+                                                               { "acsc", "(-1.0/(fabs(%1)*pow(%1*%1-1.0, 0.5)))" },
+                                                               { "acot", "(-1.0/(1.0+%1*%1))" },
+                                                               { "asech", "(-1.0/(%1*pow(1.0-%1*%1, 0.5)))" },
+                                                               { "acsch", "(-1.0/(fabs(%1)*pow(1.0+%1*%1, 0.5)))" },
+                                                               { "acoth", "(1.0/(1.0-%1*%1))" }
+                                                           };
+
+    return FirstDerivatives;
+}
+
+//==============================================================================
+
+static const QStringList & piecewiseConstantFunctions()
+{
+    // Return the mathematical functions that can be found in our model code
+    // and which derivative is zero (almost) everywhere
+
+    static const QStringList PiecewiseConstantFunctions = { "floor", "ceil", "factorial",
+                                                            "gcd_multi", "lcm_multi" };
+
+    return PiecewiseConstantFunctions;
+}
+
+//==============================================================================
+
+static QString sum(const QString &pTerm1, const QString &pTerm2)
+{
+    // Return the sum of the two given terms, keeping in mind that an empty
+    // term stands for zero
+
+    if (pTerm1.isEmpty()) {
+        return pTerm2;
+    }
+
+    if (pTerm2.isEmpty()) {
+        return pTerm1;
+    }
+
+    return "("+pTerm1+"+"+pTerm2+")";
+}
+
+//==============================================================================
+
+static QString negation(const QString &pTerm)
+{
+    // Return the negation of the given term, keeping in mind that an empty term
+    // stands for zero
+
+    if (pTerm.isEmpty()) {
+        return {};
+    }
+
+    return "(-"+pTerm+")";
+}
+
+//==============================================================================
+
+static QString difference(const QString &pTerm1, const QString &pTerm2)
+{
+    // Return the difference of the two given terms, keeping in mind that an
+    // empty term stands for zero
+
+    if (pTerm2.isEmpty()) {
+        return pTerm1;
+    }
+
+    if (pTerm1.isEmpty()) {
+        return negation(pTerm2);
+    }
+
+    return "("+pTerm1+"-"+pTerm2+")";
+}
+
+//==============================================================================
+
+static QString product(const QString &pFactor1, const QString &pFactor2)
+{
+    // Return the product of the two given factors, keeping in mind that an
+    // empty factor stands for zero
+
+    static const QString One = "1.0";
+
+    if (pFactor1.isEmpty() || pFactor2.isEmpty()) {
+        return {};
+    }
+
+    if (pFactor1 == One) {
+        return pFactor2;
+    }
+
+    if (pFactor2 == One) {
+        return pFactor1;
+    }
+
+    return "("+pFactor1+"*"+pFactor2+")";
+}
+
+//==============================================================================
+
+CellmlFileRuntimeJacobian::CellmlFileRuntimeJacobian(const QString &pCode,
+                                                     const QString &pIndependentName,
+                                                     const QString &pDependentName,
+                                                     int pSize) :
+    mIndependentName(pIndependentName),
+    mDependentName(pDependentName),
+    mSize(pSize)
+{
+    // Parse the given code, which is expected to be a sequence of assignments
+    // that compute our dependent variables (e.g. RATES[i]) from our independent
+    // variables (e.g. STATES[j]), possibly through intermediate variables
+    // (e.g. ALGEBRAIC[k])
+    // Note: if a statement cannot be parsed (e.g. it is a call to a function
+    //       that solves an NLA system), then we cannot tell anything about our
+    //       Jacobian...
+
+    const QStringList statements = pCode.split(';');
+
+    for (const auto &statement : statements) {
+        if (!statement.trimmed().isEmpty() && !parseStatement(statement)) {
+            return;
+        }
+    }
+
+    // Make sure that all of our dependent variables get computed, or we cannot
+    // tell anything about our Jacobian either
+    // Note: this is our safeguard against code that we have only partially
+    //       recognised (e.g. the objective function of an NLA system)...
+
+    for (int i = 0; i < mSize; ++i) {
+        if (!mDependencies.contains(QString("%1[%2]").arg(mDependentName).arg(i))) {
+            return;
+        }
+    }
+
+    // Determine the sparsity pattern of our Jacobian, which we store in a
+    // compressed sparse column format
+
+    QVector<QVector<int>> columns(mSize);
+
+    for (int i = 0; i < mSize; ++i) {
+        const QList<int> rowDependencies = mDependencies.value(QString("%1[%2]").arg(mDependentName).arg(i)).values();
+
+        for (auto column : rowDependencies) {
+            columns[column] << i;
+        }
+    }
+
+    mColumnPointers << 0;
+
+    for (auto &column : columns) {
+        std::sort(column.begin(), column.end());
+
+        mRowIndices << column;
+        mColumnPointers << mRowIndices.count();
+    }
+
+    mHasSparsityPattern = true;
+
+    // Check whether we can differentiate our code
+
+    mIsDifferentiable = true;
+
+    for (auto expression : qAsConst(mExpressions)) {
+        if (!isDifferentiable(expression)) {
+            mIsDifferentiable = false;
+
+            break;
+        }
+    }
+}
+
+//==============================================================================
+
+CellmlFileRuntimeJacobian::~CellmlFileRuntimeJacobian()
+{
+    // Delete some internal objects
+
+    qDeleteAll(mExpressions);
+}
+
+//==============================================================================
+
+bool CellmlFileRuntimeJacobian::hasSparsityPattern() const
+{
+    // Return whether we know the sparsity pattern of our Jacobian
+
+    return mHasSparsityPattern;
+}
+
+//==============================================================================
+
+bool CellmlFileRuntimeJacobian::isDifferentiable() const
+{
+    // Return whether our code can be differentiated
+
+    return mIsDifferentiable;
+}
+
+//==============================================================================
+
+QVector<int> CellmlFileRuntimeJacobian::columnPointers() const
+{
+    // Return the column pointers of our sparsity pattern, i.e. the position
+    // of the first non-zero entry of each column, followed by the number of
+    // non-zero entries
+
+    return mColumnPointers;
+}
+
+//==============================================================================
+
+QVector<int> CellmlFileRuntimeJacobian::rowIndices() const
+{
+    // Return the row indices of the non-zero entries of our sparsity pattern
+
+    return mRowIndices;
+}
+
+//==============================================================================
+
+QString CellmlFileRuntimeJacobian::code(const QString &pJacobianName,
+                                        bool pDense) const
+{
+    // Generate the code that computes our Jacobian, i.e. the original
+    // statements (so that our intermediate variables are up to date), each of
+    // them followed by the non-zero partial derivatives of its variable
+    // Note: our Jacobian is either stored in a compressed sparse column format
+    //       (following our sparsity pattern) or in a dense column-major
+    //       format, in which case it must have been zeroed beforehand...
+
+    if (!mIsDifferentiable) {
+        return {};
+    }
+
+    QString res;
+    QHash<QString, QSet<int>> derivatives;
+
+    for (int i = 0, iMax = mVariables.count(); i < iMax; ++i) {
+        QString variable = mVariables[i];
+        CellmlFileRuntimeJacobianExpression *expression = mExpressions[i];
+
+        res += variable+" = "+expression->code()+";\n";
+
+        QList<int> variableDependencies = mDependencies.value(variable).values();
+
+        std::sort(variableDependencies.begin(), variableDependencies.end());
+
+        for (auto column : variableDependencies) {
+            QString columnDerivative = derivative(expression, column, derivatives);
+
+            if (!columnDerivative.isEmpty()) {
+                res += "double "+derivativeName(variable, column)+" = "+columnDerivative+";\n";
+
+                derivatives[variable] << column;
+            }
+        }
+    }
+
+    for (int j = 0; j < mSize; ++j) {
+        for (int k = mColumnPointers[j], kMax = mColumnPointers[j+1]; k < kMax; ++k) {
+            QString variable = QString("%1[%2]").arg(mDependentName).arg(mRowIndices[k]);
+            bool nonZero = derivatives.value(variable).contains(j);
+
+            if (pDense) {
+                if (nonZero) {
+                    res += QString("%1[%2] = %3;\n").arg(pJacobianName)
+                                                    .arg(j*mSize+mRowIndices[k])
+                                                    .arg(derivativeName(variable, j));
+                }
+            } else {
+                res += QString("%1[%2] = %3;\n").arg(pJacobianName)
+                                                .arg(k)
+                                                .arg(nonZero?
+                                                         derivativeName(variable, j):
+                                                         "0.0");
+            }
+        }
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+void CellmlFileRuntimeJacobian::nextToken()
+{
+    // Retrieve our next token
+
+    static const QStringList TwoCharacterTokens = { "&&", "||", "==", "!=", "<=", ">=" };
+
+    int codeSize = mCode.size();
+
+    while ((mPosition < codeSize) && mCode[mPosition].isSpace()) {
+        ++mPosition;
+    }
+
+    if (mPosition == codeSize) {
+        mToken = QString();
+
+        return;
+    }
+
+    int start = mPosition;
+    QChar character = mCode[mPosition];
+
+    if (   character.isDigit()
+        || ((character == '.') && (mPosition+1 < codeSize) && mCode[mPosition+1].isDigit())) {
+        // A number
+
+        while ((mPosition < codeSize) && (mCode[mPosition].isDigit() || (mCode[mPosition] == '.'))) {
+            ++mPosition;
+        }
+
+        if (   (mPosition < codeSize)
+            && ((mCode[mPosition] == 'e') || (mCode[mPosition] == 'E'))) {
+            ++mPosition;
+
+            if (   (mPosition < codeSize)
+                && ((mCode[mPosition] == '+') || (mCode[mPosition] == '-'))) {
+                ++mPosition;
+            }
+
+            while ((mPosition < codeSize) && mCode[mPosition].isDigit()) {
+                ++mPosition;
+            }
+        }
+    } else if (character.isLetter() || (character == '_')) {
+        // An identifier, possibly with an index
+
+        while (   (mPosition < codeSize)
+               && (mCode[mPosition].isLetterOrNumber() || (mCode[mPosition] == '_'))) {
+            ++mPosition;
+        }
+
+        if ((mPosition < codeSize) && (mCode[mPosition] == '[')) {
+            int end = mCode.indexOf(']', mPosition);
+
+            if (end == -1) {
+                mPosition = codeSize;
+            } else {
+                mPosition = end+1;
+            }
+        }
+    } else if (TwoCharacterTokens.contains(mCode.mid(mPosition, 2))) {
+        mPosition += 2;
+    } else {
+        ++mPosition;
+    }
+
+    mToken = mCode.mid(start, mPosition-start);
+}
+
+//==============================================================================
+
+bool CellmlFileRuntimeJacobian::accept(const QString &pToken)
+{
+    // Move to our next token if our current one is the given one
+
+    if (mToken == pToken) {
+        nextToken();
+
+        return true;
+    }
+
+    return false;
+}
+
+//==============================================================================
+
+CellmlFileRuntimeJacobianExpression * CellmlFileRuntimeJacobian::parseConditional()
+{
+    // Parse a conditional expression, i.e. condition ? expression : expression
+
+    CellmlFileRuntimeJacobianExpression *condition = parseBinary(0);
+
+    if ((condition == nullptr) || !accept("?")) {
+        return condition;
+    }
+
+    CellmlFileRuntimeJacobianExpression *trueExpression = parseConditional();
+
+    if ((trueExpression == nullptr) || !accept(":")) {
+        delete condition;
+        delete trueExpression;
+
+        return nullptr;
+    }
+
+    CellmlFileRuntimeJacobianExpression *falseExpression = parseConditional();
+
+    if (falseExpression == nullptr) {
+        delete condition;
+        delete trueExpression;
+
+        return nullptr;
+    }
+
+    return new CellmlFileRuntimeJacobianExpression(CellmlFileRuntimeJacobianExpression::Type::Conditional,
+                                                   {}, { condition, trueExpression, falseExpression });
+}
+
+//==============================================================================
+
+CellmlFileRuntimeJacobianExpression * CellmlFileRuntimeJacobian::parseBinary(int pLevel)
+{
+    // Parse a binary expression, using C's operator precedence
+
+    static const QList<QStringList> Operators = { { "||" },
+                                                  { "&&" },
+                                                  { "^" },
+                                                  { "==", "!=" },
+                                                  { "<", ">", "<=", ">=" },
+                                                  { "+", "-" },
+                                                  { "*", "/", "%" } };
+
+    if (pLevel == Operators.count()) {
+        return parseUnary();
+    }
+
+    CellmlFileRuntimeJacobianExpression *res = parseBinary(pLevel+1);
+
+    while ((res != nullptr) && Operators[pLevel].contains(mToken)) {
+        QString op = mToken;
+
+        nextToken();
+
+        CellmlFileRuntimeJacobianExpression *rightOperand = parseBinary(pLevel+1);
+
+        if (rightOperand == nullptr) {
+            delete res;
+
+            return nullptr;
+        }
+
+        res = new CellmlFileRuntimeJacobianExpression(CellmlFileRuntimeJacobianExpression::Type::Operator,
+                                                      op, { res, rightOperand });
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+CellmlFileRuntimeJacobianExpression * CellmlFileRuntimeJacobian::parseUnary()
+{
+    // Parse a unary expression
+
+    if (accept("+")) {
+        return parseUnary();
+    }
+
+    if ((mToken == "-") || (mToken == "!")) {
+        auto type = (mToken == "-")?
+                        CellmlFileRuntimeJacobianExpression::Type::UnaryMinus:
+                        CellmlFileRuntimeJacobianExpression::Type::Not;
+
+        nextToken();
+
+        CellmlFileRuntimeJacobianExpression *operand = parseUnary();
+
+        if (operand == nullptr) {
+            return nullptr;
+        }
+
+        return new CellmlFileRuntimeJacobianExpression(type, {}, { operand });
+    }
+
+    if (accept("*")) {
+        // A dereferenced pointer (e.g. *p when solving an NLA system with only
+        // one unknown), which we consider as the first entry of an array
+
+        QString variable = mToken;
+
+        if (variable.isEmpty() || !variable[0].isLetter() || variable.contains('[')) {
+            return nullptr;
+        }
+
+        nextToken();
+
+        return new CellmlFileRuntimeJacobianExpression(CellmlFileRuntimeJacobianExpression::Type::Variable,
+                                                       variable+"[0]");
+    }
+
+    return parsePrimary();
+}
+
+//==============================================================================
+
+CellmlFileRuntimeJacobianExpression * CellmlFileRuntimeJacobian::parsePrimary()
+{
+    // Parse a primary expression, i.e. a number, a variable, a function call, a
+    // cast or a parenthesised expression
+
+    if (mToken.isEmpty()) {
+        return nullptr;
+    }
+
+    if (accept("(")) {
+        if ((mToken == "int") || (mToken == "double")) {
+            QString type = mToken;
+
+            nextToken();
+
+            if (!accept(")")) {
+                return nullptr;
+            }
+
+            CellmlFileRuntimeJacobianExpression *operand = parseUnary();
+
+            if (operand == nullptr) {
+                return nullptr;
+            }
+
+            return new CellmlFileRuntimeJacobianExpression(CellmlFileRuntimeJacobianExpression::Type::Cast,
+                                                           type, { operand });
+        }
+
+        CellmlFileRuntimeJacobianExpression *res = parseConditional();
+
+        if ((res == nullptr) || !accept(")")) {
+            delete res;
+
+            return nullptr;
+        }
+
+        return res;
+    }
+
+    QString token = mToken;
+
+    if (token[0].isDigit() || (token[0] == '.')) {
+        nextToken();
+
+        return new CellmlFileRuntimeJacobianExpression(CellmlFileRuntimeJacobianExpression::Type::Number,
+                                                       token);
+    }
+
+    if (!token[0].isLetter() && (token[0] != '_')) {
+        return nullptr;
+    }
+
+    nextToken();
+
+    if (token.contains('[') || !accept("(")) {
+        return new CellmlFileRuntimeJacobianExpression(CellmlFileRuntimeJacobianExpression::Type::Variable,
+                                                       token);
+    }
+
+    CellmlFileRuntimeJacobianExpression::Expressions arguments;
+
+    if (!accept(")")) {
+        do {
+            CellmlFileRuntimeJacobianExpression *argument = parseConditional();
+
+            if (argument == nullptr) {
+                qDeleteAll(arguments);
+
+                return nullptr;
+            }
+
+            arguments << argument;
+        } while (accept(","));
+
+        if (!accept(")")) {
+            qDeleteAll(arguments);
+
+            return nullptr;
+        }
+    }
+
+    return new CellmlFileRuntimeJacobianExpression(CellmlFileRuntimeJacobianExpression::Type::Call,
+                                                   token, arguments);
+}
+
+//==============================================================================
+
+bool CellmlFileRuntimeJacobian::parseStatement(const QString &pStatement)
+{
+    // Parse the given statement, which must be an assignment to a variable that
+    // has not yet been assigned and that is not one of our independent
+    // variables
+
+    static const QRegularExpression AssignmentRegEx = QRegularExpression(R"(^\s*(\*?)([A-Za-z_]\w*(\[\d+\])?)\s*=(?!=)(.*)$)",
+                                                                         QRegularExpression::DotMatchesEverythingOption);
+
+    QRegularExpressionMatch match = AssignmentRegEx.match(pStatement);
+
+    if (!match.hasMatch()) {
+        return false;
+    }
+
+    QString variable = match.captured(2);
+
+    if (!match.captured(1).isEmpty()) {
+        if (!match.captured(3).isEmpty()) {
+            return false;
+        }
+
+        variable += "[0]";
+    }
+
+    if (   mDependencies.contains(variable)
+        || (index(variable, mIndependentName) != -1)
+        || (variable.startsWith(mDependentName+"[") && (index(variable, mDependentName) == -1))) {
+        return false;
+    }
+
+    mCode = match.captured(4);
+    mPosition = 0;
+
+    nextToken();
+
+    CellmlFileRuntimeJacobianExpression *expression = parseConditional();
+
+    if (expression == nullptr) {
+        return false;
+    }
+
+    if (!mToken.isEmpty()) {
+        delete expression;
+
+        return false;
+    }
+
+    mVariables << variable;
+    mExpressions << expression;
+
+    mDependencies.insert(variable, dependencies(expression));
+
+    return true;
+}
+
+//==============================================================================
+
+int CellmlFileRuntimeJacobian::index(const QString &pVariable,
+                                     const QString &pName) const
+{
+    // Return the index of the given variable, if it is an entry of the given
+    // array and is within our size
+
+    if (!pVariable.startsWith(pName+"[")) {
+        return -1;
+    }
+
+    bool ok;
+    int res = pVariable.mid(pName.size()+1, pVariable.size()-pName.size()-2).toInt(&ok);
+
+    return (ok && (res >= 0) && (res < mSize))?res:-1;
+}
+
+//==============================================================================
+
+QSet<int> CellmlFileRuntimeJacobian::dependencies(CellmlFileRuntimeJacobianExpression *pExpression) const
+{
+    // Return the independent variables on which the given expression depends
+    // Note: we are conservative, i.e. an expression is considered to depend on
+    //       all the independent variables used in it, even if it is only in a
+    //       condition...
+
+    if (pExpression->type() == CellmlFileRuntimeJacobianExpression::Type::Variable) {
+        int variableIndex = index(pExpression->value(), mIndependentName);
+
+        if (variableIndex != -1) {
+            return { variableIndex };
+        }
+
+        return mDependencies.value(pExpression->value());
+    }
+
+    QSet<int> res;
+    const CellmlFileRuntimeJacobianExpression::Expressions arguments = pExpression->arguments();
+
+    for (auto argument : arguments) {
+        res.unite(dependencies(argument));
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+bool CellmlFileRuntimeJacobian::isDifferentiable(CellmlFileRuntimeJacobianExpression *pExpression) const
+{
+    // Check whether the given expression can be differentiated, i.e. whether
+    // all the functions it calls, and which depend on an independent variable,
+    // are known to us
+
+    const CellmlFileRuntimeJacobianExpression::Expressions arguments = pExpression->arguments();
+
+    if (pExpression->type() == CellmlFileRuntimeJacobianExpression::Type::Call) {
+        QString function = pExpression->value();
+        bool knownFunction =    (firstDerivatives().contains(function) && (arguments.count() == 1))
+                             || (((function == "pow") || (function == "arbitrary_log")) && (arguments.count() == 2))
+                             || piecewiseConstantFunctions().contains(function);
+
+        if (!knownFunction && !dependencies(pExpression).isEmpty()) {
+            return false;
+        }
+    }
+
+    for (auto argument : arguments) {
+        if (!isDifferentiable(argument)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//==============================================================================
+
+QString CellmlFileRuntimeJacobian::derivativeName(const QString &pVariable,
+                                                  int pIndex)
+{
+    // Return the name of the local variable that holds the partial derivative
+    // of the given variable with respect to the given independent variable
+
+    return QString("d%1_%2").arg(QString(pVariable).replace('[', '_').remove(']'))
+                            .arg(pIndex);
+}
+
+//==============================================================================
+
+QString CellmlFileRuntimeJacobian::derivative(CellmlFileRuntimeJacobianExpression *pExpression,
+                                              int pIndex,
+                                              const QHash<QString, QSet<int>> &pDerivatives) const
+{
+    // Return the code for the partial derivative of the given expression with
+    // respect to the given independent variable, or an empty string if it is
+    // zero
+
+    const CellmlFileRuntimeJacobianExpression::Expressions arguments = pExpression->arguments();
+
+    switch (pExpression->type()) {
+    case CellmlFileRuntimeJacobianExpression::Type::Number:
+    case CellmlFileRuntimeJacobianExpression::Type::Not:
+        return {};
+    case CellmlFileRuntimeJacobianExpression::Type::Variable: {
+        QString variable = pExpression->value();
+        int variableIndex = index(variable, mIndependentName);
+
+        if (variableIndex != -1) {
+            return (variableIndex == pIndex)?"1.0":QString();
+        }
+
+        return pDerivatives.value(variable).contains(pIndex)?
+                   derivativeName(variable, pIndex):
+                   QString();
+    }
+    case CellmlFileRuntimeJacobianExpression::Type::Call: {
+        if (arguments.isEmpty()) {
+            return {};
+        }
+
+        QString function = pExpression->value();
+        QString argument = arguments[0]->code();
+        QString argumentDerivative = derivative(arguments[0], pIndex, pDerivatives);
+
+        if (arguments.count() == 2) {
+            QString otherArgument = arguments[1]->code();
+            QString otherArgumentDerivative = derivative(arguments[1], pIndex, pDerivatives);
+
+            if (function == "pow") {
+                if (otherArgumentDerivative.isEmpty()) {
+                    return product(QString("(%1*pow(%2, %1-1.0))").arg(otherArgument, argument),
+                                   argumentDerivative);
+                }
+
+                return product(pExpression->code(),
+                               sum(product(otherArgumentDerivative, "log("+argument+")"),
+                                   product(argumentDerivative, "("+otherArgument+"/"+argument+")")));
+            }
+
+            if (function == "arbitrary_log") {
+                return difference(product(argumentDerivative,
+                                          QString("(1.0/(%1*log(%2)))").arg(argument, otherArgument)),
+                                  product(otherArgumentDerivative,
+                                          QString("(log(%1)/(%2*log(%2)*log(%2)))").arg(argument, otherArgument)));
+            }
+        }
+
+        if ((arguments.count() == 1) && firstDerivatives().contains(function)) {
+            return product(firstDerivatives().value(function).arg(argument),
+                           argumentDerivative);
+        }
+
+        return {};
+    }
+    case CellmlFileRuntimeJacobianExpression::Type::Cast:
+        if (pExpression->value() == "int") {
+            return {};
+        }
+
+        return derivative(arguments[0], pIndex, pDerivatives);
+    case CellmlFileRuntimeJacobianExpression::Type::UnaryMinus:
+        return negation(derivative(arguments[0], pIndex, pDerivatives));
+    case CellmlFileRuntimeJacobianExpression::Type::Operator: {
+        QString op = pExpression->value();
+
+        if ((op != "+") && (op != "-") && (op != "*") && (op != "/")) {
+            return {};
+        }
+
+        QString leftOperandDerivative = derivative(arguments[0], pIndex, pDerivatives);
+        QString rightOperandDerivative = derivative(arguments[1], pIndex, pDerivatives);
+
+        if (op == "+") {
+            return sum(leftOperandDerivative, rightOperandDerivative);
+        }
+
+        if (op == "-") {
+            return difference(leftOperandDerivative, rightOperandDerivative);
+        }
+
+        QString leftOperand = arguments[0]->code();
+        QString rightOperand = arguments[1]->code();
+
+        if (op == "*") {
+            return sum(product(leftOperandDerivative, rightOperand),
+                       product(leftOperand, rightOperandDerivative));
+        }
+
+        return difference(leftOperandDerivative.isEmpty()?
+                              QString():
+                              "("+leftOperandDerivative+"/"+rightOperand+")",
+                          rightOperandDerivative.isEmpty()?
+                              QString():
+                              "("+leftOperand+"*"+rightOperandDerivative+"/("+rightOperand+"*"+rightOperand+"))");
+    }
+    case CellmlFileRuntimeJacobianExpression::Type::Conditional: {
+        QString trueDerivative = derivative(arguments[1], pIndex, pDerivatives);
+        QString falseDerivative = derivative(arguments[2], pIndex, pDerivatives);
+
+        if (trueDerivative.isEmpty() && falseDerivative.isEmpty()) {
+            return {};
+        }
+
+        return "("+arguments[0]->code()+"?"
+               +(trueDerivative.isEmpty()?"0.0":trueDerivative)+":"
+               +(falseDerivative.isEmpty()?"0.0":falseDerivative)+")";
+    }
+    }
+
+    return {};
+}
+
+//==============================================================================
+
+} // namespace CellMLSupport
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -0,0 +1,144 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// CellML file runtime Jacobian
+//==============================================================================
+
+#pragma once
+
+//==============================================================================
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace CellMLSupport {
+
+//==============================================================================
+
+class CellmlFileRuntimeJacobianExpression
+{
+public:
+    enum class Type {
+        Number,
+        Variable,
+        Call,
+        Cast,
+        UnaryMinus,
+        Not,
+        Operator,
+        Conditional
+    };
+
+    using Expressions = QList<CellmlFileRuntimeJacobianExpression *>;
+
+    explicit CellmlFileRuntimeJacobianExpression(Type pType,
+                                                 const QString &pValue,
+                                                 const Expressions &pArguments = {});
+    ~CellmlFileRuntimeJacobianExpression();
+
+    Type type() const;
+    QString value() const;
+    Expressions arguments() const;
+
+    QString code() const;
+
+private:
+    Type mType;
+    QString mValue;
+    Expressions mArguments;
+};
+
+//==============================================================================
+
+class CellmlFileRuntimeJacobian
+{
+public:
+    explicit CellmlFileRuntimeJacobian(const QString &pCode,
+                                       const QString &pIndependentName,
+                                       const QString &pDependentName,
+                                       int pSize);
+    ~CellmlFileRuntimeJacobian();
+
+    bool hasSparsityPattern() const;
+    bool isDifferentiable() const;
+
+    QVector<int> columnPointers() const;
+    QVector<int> rowIndices() const;
+
+    QString code(const QString &pJacobianName, bool pDense) const;
+
+private:
+    QString mIndependentName;
+    QString mDependentName;
+
+    int mSize;
+
+    QStringList mVariables;
+    CellmlFileRuntimeJacobianExpression::Expressions mExpressions;
+
+    QHash<QString, QSet<int>> mDependencies;
+
+    bool mHasSparsityPattern = false;
+    bool mIsDifferentiable = false;
+
+    QVector<int> mColumnPointers;
+    QVector<int> mRowIndices;
+
+    QString mCode;
+    int mPosition = 0;
+    QString mToken;
+
+    void nextToken();
+    bool accept(const QString &pToken);
+
+    CellmlFileRuntimeJacobianExpression * parseConditional();
+    CellmlFileRuntimeJacobianExpression * parseBinary(int pLevel);
+    CellmlFileRuntimeJacobianExpression * parseUnary();
+    CellmlFileRuntimeJacobianExpression * parsePrimary();
+
+    bool parseStatement(const QString &pStatement);
+
+    int index(const QString &pVariable, const QString &pName) const;
+
+    QSet<int> dependencies(CellmlFileRuntimeJacobianExpression *pExpression) const;
+    bool isDifferentiable(CellmlFileRuntimeJacobianExpression *pExpression) const;
+
+    static QString derivativeName(const QString &pVariable, int pIndex);
+
+    QString derivative(CellmlFileRuntimeJacobianExpression *pExpression,
+                       int pIndex,
+                       const QHash<QString, QSet<int>> &pDerivatives) const;
+};
+
+//==============================================================================
+
+} // namespace CellMLSupport
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
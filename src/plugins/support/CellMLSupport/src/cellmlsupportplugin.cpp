@@ -21,6 +21,7 @@ along with this program. If not, see <https://gnu.org/licenses>.
 // CellML support plugin
 //==============================================================================
 
+#include "cellmlfileimportcache.h"
 #include "cellmlfilemanager.h"
 #include "cellmlinterface.h"
 #include "cellmlsupportplugin.h"
@@ -32,6 +33,7 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 #include <QAction>
 #include <QMainWindow>
+#include <QSettings>
 
 //==============================================================================
 
@@ -215,20 +217,29 @@ void CellMLSupportPlugin::pluginsInitialized(const Plugins &pLoadedPlugins)
 
 //==============================================================================
 
+static const char *SettingsImportMirrorDirName = "ImportMirrorDirName";
+
+//==============================================================================
+
 void CellMLSupportPlugin::loadSettings(QSettings &pSettings)
 {
-    Q_UNUSED(pSettings)
+    // Retrieve the local directory, if any, that mirrors the remote files that
+    // CellML files may import
+    // Note: if there is none, then the OPENCOR_IMPORT_MIRROR_DIR environment
+    //       variable, if set, is used instead (see
+    //       CellmlFileImportCache::mirrorFileName())...
 
-    // We don't handle this interface...
+    CellmlFileImportCache::instance()->setMirrorDirName(pSettings.value(SettingsImportMirrorDirName).toString());
 }
 
 //==============================================================================
 
 void CellMLSupportPlugin::saveSettings(QSettings &pSettings) const
 {
-    Q_UNUSED(pSettings)
+    // Keep track of the local directory that mirrors the remote files that
+    // CellML files may import
 
-    // We don't handle this interface...
+    pSettings.setValue(SettingsImportMirrorDirName, CellmlFileImportCache::instance()->mirrorDirName());
 }
 
 //==============================================================================
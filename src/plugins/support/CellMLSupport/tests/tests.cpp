@@ -26,7 +26,10 @@ along with this program. If not, see <https://gnu.org/licenses>.
 //==============================================================================
 
 #include "cellmlfile.h"
+#include "cellmlfileimportcache.h"
+#include "compilerengine.h"
 #include "corecliutils.h"
+#include "solverinterface.h"
 #include "tests.h"
 
 //==============================================================================
@@ -134,6 +137,478 @@ void Tests::runtimeTests()
 
 //==============================================================================
 
+void Tests::importTests()
+{
+    // Make sure that a model that imports a remote CellML file can be loaded
+    // offline, as long as that remote CellML file is mirrored locally
+
+    OpenCOR::CellMLSupport::CellmlFileImportCache *importCache = OpenCOR::CellMLSupport::CellmlFileImportCache::instance();
+    QString mirrorDirName = OpenCOR::Core::temporaryDirName();
+    QString fileName = OpenCOR::Core::temporaryFileName();
+    QString fileContents = OpenCOR::textFileContents(OpenCOR::fileName("src/plugins/support/CellMLSupport/tests/data/units_import_only_parent_model.cellml"));
+
+    fileContents.replace(R"(xlink:href="units_import_only_child_model.cellml")",
+                         R"(xlink:href="https://models.example.org/units/units_import_only_child_model.cellml")");
+
+    QVERIFY(QDir().mkpath(mirrorDirName+"/models.example.org/units"));
+    QVERIFY(QFile::copy(OpenCOR::fileName("src/plugins/support/CellMLSupport/tests/data/units_import_only_child_model.cellml"),
+                        mirrorDirName+"/models.example.org/units/units_import_only_child_model.cellml"));
+    QVERIFY(OpenCOR::Core::writeFile(fileName, fileContents));
+
+    importCache->setMirrorDirName(mirrorDirName);
+
+    runtimeTest(fileName, "1.1",
+                OpenCOR::fileContents(OpenCOR::fileName("src/plugins/support/CellMLSupport/tests/data/noble_model_1962.out")));
+
+    // Clean up after ourselves
+
+    importCache->setMirrorDirName(QString());
+
+    QDir(mirrorDirName).removeRecursively();
+    QFile::remove(fileName);
+}
+
+//==============================================================================
+
+void Tests::jacobianTest(const QString &pFileName)
+{
+    // Retrieve a runtime for the given model and make sure that it comes with
+    // a function to compute its Jacobian and a sparsity pattern for it
+
+    OpenCOR::CellMLSupport::CellmlFile cellmlFile(pFileName);
+    OpenCOR::CellMLSupport::CellmlFileRuntime *runtime = cellmlFile.runtime();
+
+    QVERIFY(runtime);
+    QVERIFY(runtime->isValid());
+    QVERIFY(runtime->computeJacobian() != nullptr);
+
+    int statesCount = runtime->statesCount();
+    QVector<int> columnPointers = runtime->jacobianColumnPointers();
+    QVector<int> rowIndices = runtime->jacobianRowIndices();
+
+    QCOMPARE(columnPointers.count(), statesCount+1);
+    QCOMPARE(rowIndices.count(), columnPointers.last());
+
+    // Compute the Jacobian of our model and check it against its
+    // finite-difference approximation
+
+    QVector<double> constants(runtime->constantsCount());
+    QVector<double> rates(statesCount);
+    QVector<double> states(statesCount);
+    QVector<double> algebraic(runtime->algebraicCount());
+    QVector<double> jacobian(rowIndices.count());
+    QVector<double> perturbedRates(statesCount);
+
+    runtime->initializeConstants()(constants.data(), rates.data(), states.data());
+    runtime->computeComputedConstants()(0.0, constants.data(), rates.data(), states.data(), algebraic.data());
+    runtime->computeJacobian()(0.0, constants.data(), rates.data(), states.data(), algebraic.data(), jacobian.data());
+    runtime->computeRates()(0.0, constants.data(), rates.data(), states.data(), algebraic.data());
+
+    for (int j = 0; j < statesCount; ++j) {
+        double state = states[j];
+        double delta = 1.0e-7*qMax(1.0, qAbs(state));
+
+        states[j] = state+delta;
+
+        runtime->computeRates()(0.0, constants.data(), perturbedRates.data(), states.data(), algebraic.data());
+
+        states[j] = state;
+
+        for (int i = 0; i < statesCount; ++i) {
+            double finiteDifference = (perturbedRates[i]-rates[i])/delta;
+            double derivative = 0.0;
+
+            for (int k = columnPointers[j]; k < columnPointers[j+1]; ++k) {
+                if (rowIndices[k] == i) {
+                    derivative = jacobian[k];
+                }
+            }
+
+            QVERIFY(qAbs(finiteDifference-derivative) <= 1.0e-3*qMax(1.0, qAbs(derivative)));
+        }
+    }
+}
+
+//==============================================================================
+
+void Tests::jacobianTests()
+{
+    // Check the Jacobian of some models which rates are nontrivial functions
+    // of their states
+
+    jacobianTest(OpenCOR::fileName("models/noble_model_1962.cellml"));
+    jacobianTest(OpenCOR::fileName("models/hodgkin_huxley_squid_axon_model_1952.cellml"));
+    jacobianTest(OpenCOR::fileName("models/van_der_pol_model_1928.cellml"));
+    jacobianTest(OpenCOR::fileName("models/tests/cellml/lorenz.cellml"));
+}
+
+//==============================================================================
+
+void Tests::batchTests()
+{
+    // Retrieve a runtime for the Noble 1962 model and make sure that it comes
+    // with a batched version of computeRates()
+
+    OpenCOR::CellMLSupport::CellmlFile cellmlFile(OpenCOR::fileName("models/noble_model_1962.cellml"));
+    OpenCOR::CellMLSupport::CellmlFileRuntime *runtime = cellmlFile.runtime();
+
+    QVERIFY(runtime);
+    QVERIFY(runtime->isValid());
+    QVERIFY(runtime->computeRatesBatch() != nullptr);
+
+    // Compute the rates of a full batch of instances and of a partial batch of
+    // instances, each instance having its own states, and make sure that they
+    // are the same as those computed by computeRates() for each instance
+
+    int constantsCount = runtime->constantsCount();
+    int statesCount = runtime->statesCount();
+    int algebraicCount = runtime->algebraicCount();
+    QVector<double> constants(constantsCount);
+    QVector<double> rates(statesCount);
+    QVector<double> states(statesCount);
+    QVector<double> algebraic(algebraicCount);
+
+    runtime->initializeConstants()(constants.data(), rates.data(), states.data());
+    runtime->computeComputedConstants()(0.0, constants.data(), rates.data(), states.data(), algebraic.data());
+
+    for (int count : { int(OpenCOR::CellMLSupport::CellmlFileRuntime::MaximumBatchCount), 3 }) {
+        QVector<double> batchConstants(count*constantsCount);
+        QVector<double> batchRates(count*statesCount);
+        QVector<double> batchStates(count*statesCount);
+        QVector<double> batchAlgebraic(count*algebraicCount);
+
+        for (int k = 0; k < count; ++k) {
+            for (int i = 0; i < constantsCount; ++i) {
+                batchConstants[i*count+k] = constants[i];
+            }
+
+            for (int i = 0; i < statesCount; ++i) {
+                batchStates[i*count+k] = states[i]*(1.0+0.01*k);
+            }
+
+            for (int i = 0; i < algebraicCount; ++i) {
+                batchAlgebraic[i*count+k] = algebraic[i];
+            }
+        }
+
+        runtime->computeRatesBatch()(count, 0.0, batchConstants.data(), batchRates.data(), batchStates.data(), batchAlgebraic.data());
+
+        for (int k = 0; k < count; ++k) {
+            QVector<double> instanceStates(statesCount);
+            QVector<double> instanceAlgebraic = algebraic;
+
+            for (int i = 0; i < statesCount; ++i) {
+                instanceStates[i] = batchStates[i*count+k];
+            }
+
+            runtime->computeRates()(0.0, constants.data(), rates.data(), instanceStates.data(), instanceAlgebraic.data());
+
+            for (int i = 0; i < statesCount; ++i) {
+                QVERIFY(qAbs(batchRates[i*count+k]-rates[i]) <= 1.0e-9*qMax(1.0, qAbs(rates[i])));
+            }
+        }
+    }
+}
+
+//==============================================================================
+
+class TestNlaSolver : public OpenCOR::Solver::NlaSolver
+{
+public:
+    void solve(ComputeSystemFunction pComputeSystem,
+               ComputeJacobianFunction pComputeJacobian, double *pParameters,
+               int pSize, void *pUserData) override
+    {
+        // Keep track of the fact that we have been called and evaluate the
+        // given system once, so that we get the per-call cost of going through
+        // an NLA solver
+
+        ++mCallsCount;
+
+        mResiduals.resize(pSize);
+
+        pComputeSystem(pParameters, mResiduals.data(), pUserData);
+
+        // Check the given Jacobian function, if any, against a finite-
+        // difference approximation of our Jacobian, both at the given
+        // parameters and away from them
+        // Note: we only do this the first time we are given a Jacobian
+        //       function, so as not to affect our per-call cost...
+
+        if (pComputeJacobian != nullptr) {
+            ++mJacobianCallsCount;
+        }
+
+        if ((pComputeJacobian != nullptr) && (mJacobianCallsCount == 1)) {
+            QVector<double> parameters(pSize);
+            QVector<double> residuals(pSize);
+            QVector<double> perturbedResiduals(pSize);
+            QVector<double> jacobian(pSize*pSize);
+
+            for (auto shift : { 0.0, 0.25, -0.5 }) {
+                for (int i = 0; i < pSize; ++i) {
+                    parameters[i] = pParameters[i]+shift;
+                }
+
+                pComputeJacobian(parameters.data(), jacobian.data(), pUserData);
+                pComputeSystem(parameters.data(), residuals.data(), pUserData);
+
+                for (int j = 0; j < pSize; ++j) {
+                    double parameter = parameters[j];
+                    double delta = 1.0e-7*qMax(1.0, qAbs(parameter));
+
+                    parameters[j] = parameter+delta;
+
+                    pComputeSystem(parameters.data(), perturbedResiduals.data(), pUserData);
+
+                    parameters[j] = parameter;
+
+                    for (int i = 0; i < pSize; ++i) {
+                        double derivative = jacobian[j*pSize+i];
+                        double finiteDifference = (perturbedResiduals[i]-residuals[i])/delta;
+
+                        mJacobianError = qMax(mJacobianError,
+                                              qAbs(finiteDifference-derivative)/qMax(1.0, qAbs(derivative)));
+                    }
+                }
+            }
+
+            pComputeSystem(pParameters, mResiduals.data(), pUserData);
+        }
+    }
+
+    int callsCount() const
+    {
+        // Return the number of times we have been called
+
+        return mCallsCount;
+    }
+
+    int jacobianCallsCount() const
+    {
+        // Return the number of times we have been given a Jacobian function
+
+        return mJacobianCallsCount;
+    }
+
+    double jacobianError() const
+    {
+        // Return the largest (relative) error between the Jacobian functions
+        // we have been given and their finite-difference approximation
+
+        return mJacobianError;
+    }
+
+private:
+    int mCallsCount = 0;
+    int mJacobianCallsCount = 0;
+
+    double mJacobianError = 0.0;
+
+    QVector<double> mResiduals;
+};
+
+//==============================================================================
+
+void Tests::nlaSolverTests()
+{
+    // Retrieve a runtime for a simple DAE model and make sure that it needs an
+    // NLA solver
+
+    OpenCOR::CellMLSupport::CellmlFile cellmlFile(OpenCOR::fileName("models/tests/cellml/simple_dae_model.cellml"));
+    OpenCOR::CellMLSupport::CellmlFileRuntime *runtime = cellmlFile.runtime();
+
+    QVERIFY(runtime);
+    QVERIFY(runtime->isValid());
+    QVERIFY(runtime->needNlaSolver());
+
+    // Set our NLA solver and make sure that it gets called when computing our
+    // model's rates
+
+    TestNlaSolver nlaSolver;
+
+    runtime->setNlaSolver(&nlaSolver);
+
+    QCOMPARE(runtime->nlaSolver(), &nlaSolver);
+
+    QVector<double> constants(runtime->constantsCount());
+    QVector<double> rates(runtime->ratesCount());
+    QVector<double> states(runtime->statesCount());
+    QVector<double> algebraic(runtime->algebraicCount());
+
+    runtime->initializeConstants()(constants.data(), rates.data(), states.data());
+    runtime->computeComputedConstants()(0.0, constants.data(), rates.data(), states.data(), algebraic.data());
+
+    int callsCount = nlaSolver.callsCount();
+
+    runtime->computeRates()(0.0, constants.data(), rates.data(), states.data(), algebraic.data());
+
+    QVERIFY(nlaSolver.callsCount() > callsCount);
+
+    // Make sure that our NLA solver was given the analytic Jacobian of our
+    // model's NLA system and that it matches its finite-difference
+    // approximation
+
+    QVERIFY(nlaSolver.jacobianCallsCount() > 0);
+    QVERIFY(nlaSolver.jacobianError() <= 1.0e-3);
+
+    runtime->setNlaSolver(nullptr);
+}
+
+//==============================================================================
+
+static void squareSystem(double *pParameters, double *pResiduals, void *pUserData)
+{
+    Q_UNUSED(pUserData)
+
+    // Compute the residual of x^2 = 2
+
+    pResiduals[0] = pParameters[0]*pParameters[0]-2.0;
+}
+
+//==============================================================================
+
+static void squareSystemJacobian(double *pParameters, double *pJacobian,
+                                 void *pUserData)
+{
+    Q_UNUSED(pUserData)
+
+    // Compute the Jacobian of x^2 = 2
+
+    pJacobian[0] = 2.0*pParameters[0];
+}
+
+//==============================================================================
+
+static void wrongSquareSystemJacobian(double *pParameters, double *pJacobian,
+                                      void *pUserData)
+{
+    Q_UNUSED(pUserData)
+
+    // Compute a wrong Jacobian of x^2 = 2
+
+    pJacobian[0] = pParameters[0];
+}
+
+//==============================================================================
+
+void Tests::nlaJacobianTests()
+{
+    // Make sure that a Jacobian function is only given to our NLA solver if it
+    // matches its finite-difference approximation, and that our check is only
+    // done once per Jacobian function
+
+    TestNlaSolver nlaSolver;
+    OpenCOR::Solver::NlaSolver *nlaSolverAddress = &nlaSolver;
+    QAtomicInt jacobianStatus(0);
+    double parameter = 1.0;
+
+    doNonLinearSolveWithJacobian(&nlaSolverAddress, squareSystem, squareSystemJacobian,
+                                 &jacobianStatus, &parameter, 1, nullptr);
+
+    QCOMPARE(nlaSolver.callsCount(), 1);
+    QCOMPARE(nlaSolver.jacobianCallsCount(), 1);
+
+    int validJacobianStatus = jacobianStatus.loadAcquire();
+
+    QVERIFY(validJacobianStatus != 0);
+
+    doNonLinearSolveWithJacobian(&nlaSolverAddress, squareSystem, squareSystemJacobian,
+                                 &jacobianStatus, &parameter, 1, nullptr);
+
+    QCOMPARE(nlaSolver.jacobianCallsCount(), 2);
+    QCOMPARE(jacobianStatus.loadAcquire(), validJacobianStatus);
+
+    // Make sure that a wrong Jacobian function is never given to our NLA
+    // solver, which should then use its own Jacobian
+
+    QAtomicInt wrongJacobianStatus(0);
+
+    doNonLinearSolveWithJacobian(&nlaSolverAddress, squareSystem, wrongSquareSystemJacobian,
+                                 &wrongJacobianStatus, &parameter, 1, nullptr);
+    doNonLinearSolveWithJacobian(&nlaSolverAddress, squareSystem, wrongSquareSystemJacobian,
+                                 &wrongJacobianStatus, &parameter, 1, nullptr);
+
+    QCOMPARE(nlaSolver.callsCount(), 4);
+    QCOMPARE(nlaSolver.jacobianCallsCount(), 2);
+    QVERIFY(wrongJacobianStatus.loadAcquire() != 0);
+    QVERIFY(wrongJacobianStatus.loadAcquire() != validJacobianStatus);
+}
+
+//==============================================================================
+
+void Tests::objectCacheTests()
+{
+    // Cache our compiled objects in a temporary directory
+
+    QTemporaryDir objectCacheDir;
+
+    QVERIFY(objectCacheDir.isValid());
+
+    qApp->setProperty("OpenCOR::jitCacheDirName()", objectCacheDir.path());
+
+    // Retrieve a runtime for a simple DAE model, wait for its model code to
+    // have been optimised (if needed) and check that it got cached
+
+    QString fileName = OpenCOR::fileName("models/tests/cellml/simple_dae_model.cellml");
+    OpenCOR::CellMLSupport::CellmlFile cellmlFile(fileName);
+    OpenCOR::CellMLSupport::CellmlFileRuntime *runtime = cellmlFile.runtime();
+
+    QVERIFY(runtime);
+    QVERIFY(runtime->isValid());
+    QVERIFY(runtime->needNlaSolver());
+
+#ifndef QT_DEBUG
+    QTRY_VERIFY_WITH_TIMEOUT(runtime->swapFunctions(), 30000);
+#endif
+
+    QStringList objectFileNames = QDir(objectCacheDir.path()).entryList(QDir::Files);
+
+    QVERIFY(!objectFileNames.isEmpty());
+
+    // Retrieve a runtime for the same model from another CellML file, which
+    // means that its model code should be the same (i.e. it shouldn't depend
+    // on where our runtimes are in memory) and that its cached object should
+    // therefore get used
+
+    OpenCOR::CellMLSupport::CellmlFile otherCellmlFile(fileName);
+    OpenCOR::CellMLSupport::CellmlFileRuntime *otherRuntime = otherCellmlFile.runtime();
+
+    QVERIFY(otherRuntime);
+    QVERIFY(otherRuntime->isValid());
+    QCOMPARE(otherRuntime->compilerEngine()->parsingTime(), qint64(0));
+    QCOMPARE(QDir(objectCacheDir.path()).entryList(QDir::Files), objectFileNames);
+
+    // Make sure that each runtime still uses its own NLA solver
+
+    TestNlaSolver nlaSolver;
+    TestNlaSolver otherNlaSolver;
+
+    runtime->setNlaSolver(&nlaSolver);
+    otherRuntime->setNlaSolver(&otherNlaSolver);
+
+    QVector<double> constants(otherRuntime->constantsCount());
+    QVector<double> rates(otherRuntime->ratesCount());
+    QVector<double> states(otherRuntime->statesCount());
+    QVector<double> algebraic(otherRuntime->algebraicCount());
+
+    otherRuntime->initializeConstants()(constants.data(), rates.data(), states.data());
+    otherRuntime->computeComputedConstants()(0.0, constants.data(), rates.data(), states.data(), algebraic.data());
+    otherRuntime->computeRates()(0.0, constants.data(), rates.data(), states.data(), algebraic.data());
+
+    QCOMPARE(nlaSolver.callsCount(), 0);
+    QVERIFY(otherNlaSolver.callsCount() > 0);
+
+    runtime->setNlaSolver(nullptr);
+    otherRuntime->setNlaSolver(nullptr);
+
+    // Stop caching our compiled objects
+
+    qApp->setProperty("OpenCOR::jitCacheDirName()", QVariant());
+}
+
+//==============================================================================
+
 QTEST_GUILESS_MAIN(Tests)
 
 //==============================================================================
@@ -36,9 +36,16 @@ class Tests : public QObject
 private:
     void runtimeTest(const QString &pFileName, const QString &pCellmlVersion,
                      const QStringList &pModelParameters, bool pIsValid = true);
+    void jacobianTest(const QString &pFileName);
 
 private slots:
     void runtimeTests();
+    void importTests();
+    void jacobianTests();
+    void batchTests();
+    void nlaSolverTests();
+    void nlaJacobianTests();
+    void objectCacheTests();
 };
 
 //==============================================================================
@@ -34,6 +34,37 @@
         <source>The memory required for the simulation could not be allocated.</source>
         <translation>La mémoire requise pour la simulation n&apos;a pas pu être allouée.</translation>
     </message>
+    <message>
+        <source>The requested constant or state (%1) could not be found.</source>
+        <translation>La constante ou l&apos;état demandé (%1) n&apos;a pas pu être trouvé.</translation>
+    </message>
+    <message>
+        <source>The requested interpolation (%1) is not supported.</source>
+        <translation>L&apos;interpolation demandée (%1) n&apos;est pas supportée.</translation>
+    </message>
+    <message>
+        <source>The sweep could not be run.</source>
+        <translation>Le balayage n&apos;a pas pu être exécuté.</translation>
+    </message>
+</context>
+<context>
+    <name>OpenCOR::SimulationSupport::SimulationSweep</name>
+    <message>
+        <source>the simulation settings are not valid</source>
+        <translation>les paramètres de la simulation ne sont pas valides</translation>
+    </message>
+    <message>
+        <source>the memory required for the sweep could not be allocated</source>
+        <translation>la mémoire requise pour le balayage n&apos;a pas pu être allouée</translation>
+    </message>
+    <message>
+        <source>the value of the &quot;%1&quot; property of the ODE solver is not valid</source>
+        <translation>la valeur de la propriété &quot;%1&quot; du solveur EDO n&apos;est pas valide</translation>
+    </message>
+    <message>
+        <source>the value of the &quot;%1&quot; property of the NLA solver is not valid</source>
+        <translation>la valeur de la propriété &quot;%1&quot; du solveur ANL n&apos;est pas valide</translation>
+    </message>
 </context>
 <context>
     <name>QObject</name>
@@ -24,21 +24,25 @@ along with this program. If not, see <https://gnu.org/licenses>.
 #include "cellmlfilemanager.h"
 #include "cellmlfileruntime.h"
 #include "combinefilemanager.h"
+#include "corecliutils.h"
 #include "filemanager.h"
 #include "interfaces.h"
 #include "sedmlfile.h"
 #include "sedmlfilemanager.h"
 #include "simulation.h"
+#include "simulationexecutor.h"
+#include "simulationresultswriter.h"
 #include "simulationworker.h"
 
 //==============================================================================
 
-#include <QThread>
+#include <QRegularExpression>
 
 //==============================================================================
 
 #include "libsedmlbegin.h"
     #include "sedml/SedAlgorithm.h"
+    #include "sedml/SedDataGenerator.h"
     #include "sedml/SedDocument.h"
     #include "sedml/SedOneStep.h"
     #include "sedml/SedUniformTimeCourse.h"
@@ -547,7 +551,7 @@ void SimulationData::reset(bool pInitialize, bool pAll)
 
         nlaSolver = static_cast<Solver::NlaSolver *>(nlaSolverInterface()->solverInstance());
 
-        Solver::setNlaSolver(runtime, nlaSolver);
+        runtime->setNlaSolver(nlaSolver);
 
         // Keep track of any error that might be reported by our NLA solver
 
@@ -561,9 +565,11 @@ void SimulationData::reset(bool pInitialize, bool pAll)
 
     // Keep track of our constants (in case we don't want to reset them)
 
-    auto currentConstants = new double[runtime->constantsCount()] {};
+    double *currentConstants = nullptr;
 
     if (!pAll) {
+        currentConstants = new double[runtime->constantsCount()];
+
         memcpy(currentConstants, constants(), size_t(runtime->constantsCount())*Solver::SizeOfDouble);
     }
 
@@ -592,9 +598,9 @@ void SimulationData::reset(bool pInitialize, bool pAll)
 
     if (!pAll) {
         memcpy(constants(), currentConstants, size_t(runtime->constantsCount())*Solver::SizeOfDouble);
-    }
 
-    delete[] currentConstants;
+        delete[] currentConstants;
+    }
 
     // Recompute our computed constants and variables, if we are using our
     // "current" constants
@@ -741,12 +747,57 @@ void SimulationData::checkForModifications()
 void SimulationData::updateParameters(SimulationData *pSimulationData)
 {
     // Recompute our 'computed constants' and 'variables'
+    // Note: reset() will let people know that parameters have changed (see
+    //       recomputeComputedConstantsAndVariables())...
 
     pSimulationData->reset(false);
+}
+
+//==============================================================================
+
+bool SimulationData::setValues(const QMap<int, double> &pConstants,
+                               const QMap<int, double> &pStates)
+{
+    // Set the given constants and states, and update our parameters, but only
+    // once and only if at least one value has actually changed
+    // Note #1: this is much faster than setting values one by one, as is done
+    //          from Python using our values dictionaries, since each change
+    //          would otherwise result in our parameters being updated...
+    // Note #2: a value has changed if it is different from our current one,
+    //          not if it is fuzzy different from it (since a small change may
+    //          still matter), but like in DataStoreVariableRun::addValue(), a
+    //          NaN value is not considered to be different from another NaN
+    //          value...
+
+    bool res = false;
+    double *constantsData = constants();
+    double *statesData = states();
+
+    for (auto constant = pConstants.constBegin(), constantEnd = pConstants.constEnd();
+         constant != constantEnd; ++constant) {
+        if (   (constantsData[constant.key()] != constant.value())
+            && (!qIsNaN(constantsData[constant.key()]) || !qIsNaN(constant.value()))) {
+            constantsData[constant.key()] = constant.value();
 
-    // Let people know that parameters have changed
+            res = true;
+        }
+    }
+
+    for (auto state = pStates.constBegin(), stateEnd = pStates.constEnd();
+         state != stateEnd; ++state) {
+        if (   (statesData[state.key()] != state.value())
+            && (!qIsNaN(statesData[state.key()]) || !qIsNaN(state.value()))) {
+            statesData[state.key()] = state.value();
+
+            res = true;
+        }
+    }
+
+    if (res) {
+        updateParameters(this);
+    }
 
-    emit pSimulationData->dataUpdated(pSimulationData->mStartingPoint);
+    return res;
 }
 
 //==============================================================================
@@ -893,6 +944,13 @@ void SimulationResults::createDataStore()
     mStatesVariables = mDataStore->addVariables(simulationData->states(), runtime->statesCount());
     mAlgebraicVariables = mDataStore->addVariables(simulationData->algebraic(), runtime->algebraicCount());
 
+    // Our constants are, well, constant, so there is no need to store their
+    // value at each point
+
+    for (auto constantVariable : qAsConst(mConstantsVariables)) {
+        constantVariable->setConstant(true);
+    }
+
     // Customise our VOI, as well as our constant, rate, state and algebraic
     // variables
 
@@ -950,11 +1008,13 @@ void SimulationResults::createDataStore()
 
         mData.insert(data, variables);
 
-        DataStore::DataStoreVariable *importVoi = importDataStore->voi();
+        SimulationDataInterpolator &interpolator = mDataInterpolators.insert(data, SimulationDataInterpolator(importDataStore->voi(), mDataInterpolationKind)).value();
         DataStore::DataStoreVariables importVariables = importDataStore->variables();
 
+        interpolator.setPoint(mSimulation->currentPoint());
+
         for (int i = 0, iMax = importVariables.count(); i < iMax; ++i) {
-            data[i] = realValue(mSimulation->currentPoint(), importVoi, importVariables[i]);
+            data[i] = interpolator.value(importVariables[i]);
         }
     }
 
@@ -986,6 +1046,11 @@ void SimulationResults::deleteDataStore()
     mAlgebraicVariables = DataStore::DataStoreVariables();
 
     mData.clear();
+    mDataInterpolators.clear();
+
+    QMutexLocker locker(&mRunOffsetsMutex);
+
+    mRunOffsets.clear();
 }
 
 //==============================================================================
@@ -1010,6 +1075,8 @@ void SimulationResults::reset()
     deleteDataStore();
     createDataStore();
 
+    mEpoch.fetchAndAddRelease(1);
+
     // Let people know that we have been reset
 
     emit resultsReset();
@@ -1027,6 +1094,22 @@ void SimulationResults::importData(DataStore::DataStoreImportData *pImportData)
         return;
     }
 
+    // Make sure that the values of our unrecorded variables have been
+    // computed and that all of our variables get recorded from now on, since
+    // we won't be able to compute values on demand once we have imported data
+
+    computeValues();
+
+    for (auto rateVariable : qAsConst(mRatesVariables)) {
+        rateVariable->setRecorded(true);
+    }
+
+    for (auto algebraicVariable : qAsConst(mAlgebraicVariables)) {
+        algebraicVariable->setRecorded(true);
+    }
+
+    mDataStore->updateRecordedVariables();
+
     // Ask our data and results objects to import the given data
 
     DataStore::DataStore *importDataStore = pImportData->importDataStore();
@@ -1053,8 +1136,8 @@ void SimulationResults::importData(DataStore::DataStoreImportData *pImportData)
     // along our other simulation results, if any
 
     int runsCount = pImportData->runSizes().count();
-    DataStore::DataStoreVariable *importVoi = importDataStore->voi();
     DataStore::DataStoreVariables importVariables = pImportData->importVariables();
+    SimulationDataInterpolator &interpolator = mDataInterpolators.insert(resultsValues, SimulationDataInterpolator(importDataStore->voi(), mDataInterpolationKind)).value();
 
     if (runsCount != 0) {
         DataStore::DataStoreVariable *resultsVoi = pImportData->resultsDataStore()->voi();
@@ -1063,12 +1146,13 @@ void SimulationResults::importData(DataStore::DataStoreImportData *pImportData)
             // Add the value of our imported data to our the corresponding run
 
             double *voiValues = resultsVoi->values(i);
+            double pointOffset = realPoint(0.0, i);
 
             for (quint64 j = 0, jMax = resultsVoi->size(i); j < jMax; ++j) {
-                double realPoint = SimulationResults::realPoint(voiValues[j], i);
+                interpolator.setPoint(pointOffset+voiValues[j]);
 
                 for (int k = 0, kMax = resultsVariables.count(); k < kMax; ++k) {
-                    resultsVariables[k]->addValue(realValue(realPoint, importVoi, importVariables[k]), i);
+                    resultsVariables[k]->addValue(interpolator.value(importVariables[k]), i);
                 }
             }
         }
@@ -1085,8 +1169,10 @@ void SimulationResults::importData(DataStore::DataStoreImportData *pImportData)
         // There are no runs, so update our imported data array so that it
         // contains the computed values for our start point
 
+        interpolator.setPoint(mSimulation->currentPoint());
+
         for (int i = 0, iMax = importVariables.count(); i < iMax; ++i) {
-            resultsValues[i] = realValue(mSimulation->currentPoint(), importVoi, importVariables[i]);
+            resultsValues[i] = interpolator.value(importVariables[i]);
         }
     }
 }
@@ -1106,21 +1192,69 @@ int SimulationResults::runsCount() const
 
 bool SimulationResults::addRun()
 {
-    // Ask our data store to add a run to itself and let people know about it,
-    // if we were able to add one
+    // Add one run
+
+    return addRuns(1);
+}
+
+//==============================================================================
+
+bool SimulationResults::addRuns(int pRunsCount)
+{
+    // Ask our data store to add the given number of runs to itself and let
+    // people know about them, if we were able to add all of them, or remove
+    // the ones that we added otherwise
     // Note: we consider things to be fine if our data store has had no problems
-    //       adding a run to itself or if the simulation size is zero...
+    //       adding our runs to itself or if the simulation size is zero...
 
     quint64 simulationSize = mSimulation->size();
 
     if (simulationSize != 0) {
-        bool res = mDataStore->addRun(simulationSize);
+        // Apply our recording mask to our rates and algebraic variables, but
+        // only if we can compute the values of our unrecorded variables on
+        // demand
 
-        if (res) {
-            emit runAdded();
+        applyRecordingMask(!canComputeValues());
+
+        quint64 variablesCount = quint64(1+mStatesVariables.count());
+
+        for (auto rateVariable : qAsConst(mRatesVariables)) {
+            variablesCount += rateVariable->isRecorded()?1:0;
+        }
+
+        for (auto algebraicVariable : qAsConst(mAlgebraicVariables)) {
+            variablesCount += algebraicVariable->isRecorded()?1:0;
+        }
+
+        for (const auto &dataVariables : qAsConst(mData)) {
+            variablesCount += quint64(dataVariables.count());
+        }
+
+        // Spill our runs to disk if our new run is unlikely to fit in memory
+        // Note: if we can't create a temporary file, then we keep our runs in
+        //       memory and hope for the best...
+
+        quint64 runsSize = quint64(pRunsCount)*simulationSize*variablesCount*Solver::SizeOfDouble;
+
+        if (mDataStore->fileName().isEmpty() && (runsSize > Core::freeMemory()/2)) {
+            mDataStore->mapToFile({}, runsSize);
+        }
+
+        int oldRunsCount = mDataStore->runsCount();
+
+        for (int i = 0; i < pRunsCount; ++i) {
+            if (!mDataStore->addRun(simulationSize)) {
+                mDataStore->keepRuns(oldRunsCount);
+
+                return false;
+            }
         }
 
-        return res;
+        mEpoch.fetchAndAddRelease(1);
+
+        for (int i = 0; i < pRunsCount; ++i) {
+            emit runAdded();
+        }
     }
 
     return true;
@@ -1132,97 +1266,201 @@ double SimulationResults::realPoint(double pPoint, int pRun) const
 {
     // Determine the real value of the given point, if we didn't have several
     // runs, but only one
+    // Note: the offset of a run is the sum of the last point of all the runs
+    //       before it. Those runs are complete by the time we need that offset,
+    //       so we cache our offsets rather than recompute them every time we
+    //       are called, which is for every point of every run...
 
-    double res = 0.0;
+    int run = (pRun == -1)?
+                  runsCount()-1:
+                  pRun;
 
-    for (int i = 0, iMax = (pRun == -1)?runsCount()-1:pRun; i < iMax; ++i) {
-        if (mDataStore->voi()->size(i) != 0) {
-            res += mDataStore->voi()->value(mDataStore->voi()->size(i)-1, i);
-        }
+    if (run <= 0) {
+        return pPoint;
     }
 
-    res += pPoint;
+    QMutexLocker locker(&mRunOffsetsMutex);
 
-    return res;
+    if (mRunOffsets.isEmpty()) {
+        mRunOffsets << 0.0;
+    }
+
+    DataStore::DataStoreVariable *voi = mDataStore->voi();
+
+    for (int i = mRunOffsets.count()-1; i < run; ++i) {
+        quint64 size = voi->size(i);
+
+        mRunOffsets << mRunOffsets.last()+((size != 0)?
+                                               voi->value(size-1, i):
+                                               0.0);
+    }
+
+    return mRunOffsets[run]+pPoint;
 }
 
 //==============================================================================
 
-double SimulationResults::realValue(double pPoint,
-                                    DataStore::DataStoreVariable *pVoi,
-                                    DataStore::DataStoreVariable *pVariable) const
+void SimulationResults::addPoint(double pPoint)
 {
-    // Return the value of the given variable at the given point, doing a linear
-    // interpolation, if needed
+    // Make sure that all our variables are up to date
 
-    quint64 first = 0;
-    quint64 last = pVoi->size()-1;
+    mSimulation->data()->recomputeVariables(pPoint);
 
-    if (   (pPoint < pVoi->value(first))
-        || (pPoint > pVoi->value(last))) {
-        return qQNaN();
+    // Make sure that we have the correct imported data values for the given
+    // point, keeping in mind that we may have several runs
+
+    if (!mDataInterpolators.isEmpty()) {
+        double realPoint = SimulationResults::realPoint(pPoint);
+
+        for (auto interpolator = mDataInterpolators.begin(), interpolatorEnd = mDataInterpolators.end();
+             interpolator != interpolatorEnd; ++interpolator) {
+            double *data = interpolator.key();
+            DataStore::DataStoreVariables variables = mDataDataStores.value(data)->variables();
+
+            interpolator->setPoint(realPoint);
+
+            for (int i = 0, iMax = variables.count(); i < iMax; ++i) {
+                data[i] = interpolator->value(variables[i]);
+            }
+        }
     }
 
-    quint64 middle = 0;
-    double middleVoiValue = 0.0;
+    // Now that we are all set, we can add the data to our data store or
+    // stream it through our writer, if we have one
 
-    while (first <= last) {
-        middle = (first+last)/2;
-        middleVoiValue = pVoi->value(middle);
+    if (mWriter != nullptr) {
+        mWriter->writePoint(pPoint);
+    } else {
+        mDataStore->addValues(pPoint);
+    }
+
+    // Let people know, in a cheap way, that we have a new point
+
+    mEpoch.fetchAndAddRelease(1);
+}
+
+//==============================================================================
+
+void SimulationResults::addPoint(double pPoint, double pRealPoint, int pRun,
+                                 const double *pConstants,
+                                 const double *pRates, const double *pStates,
+                                 const double *pAlgebraic)
+{
+    // Add the given point and values to the given run
+    // Note #1: this is used by our simulation sweep, which computes several
+    //          runs at once using its own arrays, hence we cannot rely on our
+    //          data store's variables to retrieve the values to add. The given
+    //          real point must also be computed beforehand since our other
+    //          runs may still be computed...
+    // Note #2: DataStore::variables() sorts the variables of the given data
+    //          store, hence we must make sure that only one run can retrieve
+    //          them at any given time...
+    // Note #3: like in DataStore::addValues(), we add the VOI value last since
+    //          our size relies on it...
+
+    for (int i = 0, iMax = mConstantsVariables.count(); i < iMax; ++i) {
+        mConstantsVariables[i]->addValue(pConstants[i], pRun);
+    }
 
-        if (middleVoiValue < pPoint) {
-            first = middle+1;
-        } else if (middleVoiValue > pPoint) {
-            last = middle-1;
-        } else {
-            break;
+    for (int i = 0, iMax = mRatesVariables.count(); i < iMax; ++i) {
+        if (mRatesVariables[i]->isRecorded()) {
+            mRatesVariables[i]->addValue(pRates[i], pRun);
         }
     }
 
-    if (middleVoiValue < pPoint) {
-        double afterVoiValue = pVoi->value(middle+1);
-        double afterDataValue = pVariable->value(middle+1);
+    for (int i = 0, iMax = mStatesVariables.count(); i < iMax; ++i) {
+        mStatesVariables[i]->addValue(pStates[i], pRun);
+    }
 
-        return afterDataValue-(afterVoiValue-pPoint)*(afterDataValue-pVariable->value(middle))/(afterVoiValue-middleVoiValue);
+    for (int i = 0, iMax = mAlgebraicVariables.count(); i < iMax; ++i) {
+        if (mAlgebraicVariables[i]->isRecorded()) {
+            mAlgebraicVariables[i]->addValue(pAlgebraic[i], pRun);
+        }
     }
 
-    if (middleVoiValue > pPoint) {
-        double beforeVoiValue = pVoi->value(middle-1);
-        double beforeDataValue = pVariable->value(middle-1);
+    // Note: we may be called from several threads at once (see
+    //       SimulationSweepRun::run()), so we can't use our cached interpolators
+    //       and their cursors, hence we use a local interpolator instead...
+
+    for (auto data = mDataDataStores.constBegin(), dataEnd = mDataDataStores.constEnd();
+         data != dataEnd; ++data) {
+        DataStore::DataStore *dataStore = data.value();
+        DataStore::DataStoreVariables variables;
+        DataStore::DataStoreVariables resultsVariables = mData.value(data.key());
+        SimulationDataInterpolator interpolator(dataStore->voi(), mDataInterpolationKind);
+
+        mDataMutex.lock();
+            variables = dataStore->variables();
+        mDataMutex.unlock();
+
+        interpolator.setPoint(pRealPoint);
 
-        return beforeDataValue+(pPoint-beforeVoiValue)*(pVariable->value(middle)-beforeDataValue)/(middleVoiValue-beforeVoiValue);
+        for (int i = 0, iMax = variables.count(); i < iMax; ++i) {
+            resultsVariables[i]->addValue(interpolator.value(variables[i]), pRun);
+        }
     }
 
-    return pVariable->value(middle);
+    mPointsVariable->addValue(pPoint, pRun);
+
+    mEpoch.fetchAndAddRelease(1);
 }
 
 //==============================================================================
 
-void SimulationResults::addPoint(double pPoint)
+SimulationDataInterpolator::Kind SimulationResults::dataInterpolationKind() const
 {
-    // Make sure that all our variables are up to date
+    // Return the kind of interpolation that we use for our imported data
 
-    mSimulation->data()->recomputeVariables(pPoint);
+    return mDataInterpolationKind;
+}
 
-    // Make sure that we have the correct imported data values for the given
-    // point, keeping in mind that we may have several runs
+//==============================================================================
 
-    const QList<double *> dataKeys = mDataDataStores.keys();
-    double realPoint = SimulationResults::realPoint(pPoint);
+void SimulationResults::setDataInterpolationKind(SimulationDataInterpolator::Kind pDataInterpolationKind)
+{
+    // Set the kind of interpolation that we use for our imported data, from
+    // now on
 
-    for (auto data : dataKeys) {
-        DataStore::DataStore *dataStore = mDataDataStores.value(data);
-        DataStore::DataStoreVariable *voi = dataStore->voi();
-        DataStore::DataStoreVariables variables = dataStore->variables();
+    mDataInterpolationKind = pDataInterpolationKind;
 
-        for (int i = 0, iMax = variables.count(); i < iMax; ++i) {
-            data[i] = realValue(realPoint, voi, variables[i]);
-        }
+    for (auto &interpolator : mDataInterpolators) {
+        interpolator.setKind(pDataInterpolationKind);
     }
+}
+
+//==============================================================================
+
+SimulationResultsWriter * SimulationResults::writer() const
+{
+    // Return our writer
+
+    return mWriter;
+}
+
+//==============================================================================
 
-    // Now that we are all set, we can add the data to our data store
+void SimulationResults::setWriter(SimulationResultsWriter *pWriter)
+{
+    // Set our writer
+    // Note: if we have a writer, then our points get streamed through it
+    //       rather than added to our data store, meaning that there is no need
+    //       to add a run to our simulation before running it...
+
+    mWriter = pWriter;
+}
+
+//==============================================================================
 
-    mDataStore->addValues(pPoint);
+quint64 SimulationResults::epoch() const
+{
+    // Return our epoch, i.e. a counter that gets incremented every time we are
+    // reset or a point is added to one of our runs
+    // Note: this is meant to be polled, e.g. by a view, to check whether we
+    //       have changed. It is lock free and, since it is incremented once a
+    //       point has been added, retrieving our size after it guarantees that
+    //       the new point is visible...
+
+    return mEpoch.loadAcquire();
 }
 
 //==============================================================================
@@ -1273,9 +1511,16 @@ double * SimulationResults::rates(int pIndex, int pRun) const
 {
     // Return our rates at the given index and for the given run
 
-    return (mRatesVariables.isEmpty() || (mRatesVariables[pIndex] == nullptr))?
-                nullptr:
-                mRatesVariables[pIndex]->values(pRun);
+    // Note: our rates may not have been recorded, in which case we compute
+    //       them on demand...
+
+    if (mRatesVariables.isEmpty() || (mRatesVariables[pIndex] == nullptr)) {
+        return nullptr;
+    }
+
+    computeValues(DataStore::DataStoreVariables() << mRatesVariables[pIndex], pRun);
+
+    return mRatesVariables[pIndex]->values(pRun);
 }
 
 //==============================================================================
@@ -1295,9 +1540,16 @@ double * SimulationResults::algebraic(int pIndex, int pRun) const
 {
     // Return our algebraic at the given index and for the given run
 
-    return (mAlgebraicVariables.isEmpty() || (mAlgebraicVariables[pIndex] == nullptr))?
-                nullptr:
-                mAlgebraicVariables[pIndex]->values(pRun);
+    // Note: our algebraic may not have been recorded, in which case we compute
+    //       them on demand...
+
+    if (mAlgebraicVariables.isEmpty() || (mAlgebraicVariables[pIndex] == nullptr)) {
+        return nullptr;
+    }
+
+    computeValues(DataStore::DataStoreVariables() << mAlgebraicVariables[pIndex], pRun);
+
+    return mAlgebraicVariables[pIndex]->values(pRun);
 }
 
 //==============================================================================
@@ -1360,6 +1612,193 @@ DataStore::DataStoreVariables SimulationResults::algebraicVariables() const
 
 //==============================================================================
 
+bool SimulationResults::isRecorded(const QString &pUri) const
+{
+    // Return whether the model parameter with the given URI is to be recorded
+    // Note: only our rates and algebraic variables can be unrecorded, since our
+    //       constants are stored only when they change and our states are
+    //       needed to compute the value of our unrecorded variables...
+
+    return    !mUnrecordedUris.contains(pUri)
+           && (mRecordedUris.isEmpty() || mRecordedUris.contains(pUri));
+}
+
+//==============================================================================
+
+void SimulationResults::setRecorded(const QString &pUri, bool pRecorded)
+{
+    // Set whether the model parameter with the given URI is to be recorded
+    // Note: this only takes effect when we add a run or apply our recording
+    //       mask...
+
+    if (pRecorded) {
+        mUnrecordedUris.remove(pUri);
+
+        if (!mRecordedUris.isEmpty()) {
+            mRecordedUris.insert(pUri);
+        }
+    } else {
+        mUnrecordedUris.insert(pUri);
+    }
+}
+
+//==============================================================================
+
+void SimulationResults::setRecordedVariables(const QStringList &pUris)
+{
+    // Record only the rates and algebraic variables with the given URIs, or all
+    // of them if no URIs are given
+    // Note: this only takes effect when we add a run or apply our recording
+    //       mask...
+
+    mRecordedUris = QSet<QString>::fromList(pUris);
+
+    mUnrecordedUris.clear();
+}
+
+//==============================================================================
+
+void SimulationResults::applyRecordingMask(bool pRecordAll)
+{
+    // Apply our recording mask to our rates and algebraic variables, unless we
+    // are to record all of them
+    // Note: this is done when we add a run, but it must also be done before
+    //       creating a writer for our results (see
+    //       SimulationResultsWriter::SimulationResultsWriter()) since a writer
+    //       only writes our recorded variables...
+
+    for (auto rateVariable : qAsConst(mRatesVariables)) {
+        rateVariable->setRecorded(pRecordAll || isRecorded(rateVariable->uri()));
+    }
+
+    for (auto algebraicVariable : qAsConst(mAlgebraicVariables)) {
+        algebraicVariable->setRecorded(pRecordAll || isRecorded(algebraicVariable->uri()));
+    }
+}
+
+//==============================================================================
+
+bool SimulationResults::canComputeValues() const
+{
+    // Return whether we can compute the values of our unrecorded variables on
+    // demand
+    // Note: we can't if our model needs an NLA solver (since we would need to
+    //       solve our NLA systems outside of our simulation worker) or if we
+    //       have imported data (since our model would then use the imported
+    //       data values for the current point rather than for the point for
+    //       which we want to compute values)...
+
+    CellMLSupport::CellmlFileRuntime *runtime = mSimulation->runtime();
+
+    return    (runtime != nullptr) && !runtime->needNlaSolver()
+           && mData.isEmpty();
+}
+
+//==============================================================================
+
+void SimulationResults::computeValues(const DataStore::DataStoreVariables &pVariables,
+                                      int pRun) const
+{
+    // Compute the missing values of the given (unrecorded) rates and algebraic
+    // variables for the given run, using our recorded constants and states
+    // Note: an unrecorded variable has fewer values than our VOI, which is not
+    //       the case of a recorded variable since our VOI value is always added
+    //       last...
+
+    int run = (pRun == -1)?runsCount()-1:pRun;
+
+    if ((run < 0) || (run >= runsCount()) || !canComputeValues()) {
+        return;
+    }
+
+    // Make sure that only one thread at a time computes missing values
+    // Note: we may be called from different threads (e.g. through rates() and
+    //       algebraic(), which are const), so we must check which values are
+    //       missing and add them in one go, or two threads could both find
+    //       that some values are missing and both add them...
+
+    QMutexLocker locker(&mComputeValuesMutex);
+
+    quint64 size = mPointsVariable->size(run);
+    quint64 position = size;
+    DataStore::DataStoreVariables variables;
+
+    for (auto variable : pVariables) {
+        quint64 variableSize = variable->size(run);
+
+        if (variableSize < size) {
+            variables << variable;
+
+            position = qMin(position, variableSize);
+        }
+    }
+
+    if (variables.isEmpty()) {
+        return;
+    }
+
+    // Compute our missing values, point by point
+
+    CellMLSupport::CellmlFileRuntime *runtime = mSimulation->runtime();
+    int constantsCount = runtime->constantsCount();
+    int statesCount = runtime->statesCount();
+    auto constants = new double[constantsCount] {};
+    auto rates = new double[runtime->ratesCount()] {};
+    auto states = new double[statesCount] {};
+    auto algebraic = new double[runtime->algebraicCount()] {};
+    QVector<double *> values;
+
+    for (auto variable : qAsConst(variables)) {
+        int index = mRatesVariables.indexOf(variable);
+
+        values << ((index != -1)?
+                       rates+index:
+                       algebraic+mAlgebraicVariables.indexOf(variable));
+    }
+
+    for (quint64 i = position; i < size; ++i) {
+        double point = mPointsVariable->value(i, run);
+
+        for (int j = 0; j < constantsCount; ++j) {
+            constants[j] = mConstantsVariables[j]->value(i, run);
+        }
+
+        for (int j = 0; j < statesCount; ++j) {
+            states[j] = mStatesVariables[j]->value(i, run);
+        }
+
+        runtime->computeRates()(point, constants, rates, states, algebraic);
+        runtime->computeVariables()(point, constants, rates, states, algebraic);
+
+        for (int j = 0, jMax = variables.count(); j < jMax; ++j) {
+            if (variables[j]->size(run) == i) {
+                variables[j]->addValue(*values[j], run);
+            }
+        }
+    }
+
+    delete[] constants;
+    delete[] rates;
+    delete[] states;
+    delete[] algebraic;
+}
+
+//==============================================================================
+
+void SimulationResults::computeValues()
+{
+    // Compute the missing values of all our unrecorded variables for all our
+    // runs
+
+    DataStore::DataStoreVariables variables = mRatesVariables+mAlgebraicVariables;
+
+    for (int i = 0, iMax = runsCount(); i < iMax; ++i) {
+        computeValues(variables, i);
+    }
+}
+
+//==============================================================================
+
 SimulationImportData::SimulationImportData(Simulation *pSimulation) :
     SimulationObject(pSimulation)
 {
@@ -1444,6 +1883,132 @@ Simulation::~Simulation()
 
 //==============================================================================
 
+QString Simulation::initialize()
+{
+    // Retrieve a default ODE and NLA solver
+    // Note: this is useful in case we are solely based on a CellML file...
+
+    const SolverInterfaces solverInterfaces = Core::solverInterfaces();
+    SolverInterface *odeSolverInterface = nullptr;
+    SolverInterface *nlaSolverInterface = nullptr;
+
+    for (auto solverInterface : solverInterfaces) {
+        QString solverName = solverInterface->solverName();
+
+        if (solverInterface->solverType() == Solver::Type::Ode) {
+            if (    (odeSolverInterface == nullptr)
+                || (odeSolverInterface->solverName().compare(solverName, Qt::CaseInsensitive) > 0)) {
+                odeSolverInterface = solverInterface;
+            }
+        } else if (solverInterface->solverType() == Solver::Type::Nla) {
+            if (    (nlaSolverInterface == nullptr)
+                || (nlaSolverInterface->solverName().compare(solverName, Qt::CaseInsensitive) > 0)) {
+                nlaSolverInterface = solverInterface;
+            }
+        }
+    }
+
+    // Set our default ODE and NLA, if needed, solvers, using the default value
+    // of their properties
+
+    if (odeSolverInterface != nullptr) {
+        mData->setOdeSolverName(odeSolverInterface->solverName());
+
+        const Solver::Properties solverInterfaceProperties = odeSolverInterface->solverProperties();
+
+        for (const auto &solverInterfaceProperty : solverInterfaceProperties) {
+            mData->setOdeSolverProperty(solverInterfaceProperty.id(), solverInterfaceProperty.defaultValue());
+        }
+    }
+
+    if ((mRuntime != nullptr) && mRuntime->needNlaSolver() && (nlaSolverInterface != nullptr)) {
+        mData->setNlaSolverName(nlaSolverInterface->solverName());
+
+        const Solver::Properties solverInterfaceProperties = nlaSolverInterface->solverProperties();
+
+        for (const auto &solverInterfaceProperty : solverInterfaceProperties) {
+            mData->setNlaSolverProperty(solverInterfaceProperty.id(), solverInterfaceProperty.defaultValue());
+        }
+    }
+
+    // Further initialise ourselves, should we be dealing with either a SED-ML
+    // file or a COMBINE archive
+    // Note: this will overwrite the default ODE and NLA solvers that we set
+    //       above...
+
+    if ((mFileType == FileType::SedmlFile) || (mFileType == FileType::CombineArchive)) {
+        QString error = furtherInitialize();
+
+        if (!error.isEmpty()) {
+            return error;
+        }
+    }
+
+    // Reset both our data and results (well, initialise in the case of our
+    // data), should we have a valid runtime
+
+    if ((mRuntime != nullptr) && mRuntime->isValid()) {
+        mData->reset();
+        mResults->reset();
+
+        // Only record the model parameters that are referenced by the data
+        // generators of our SED-ML file, if any, since the other ones can be
+        // computed on demand
+
+        if ((mFileType == FileType::SedmlFile) || (mFileType == FileType::CombineArchive)) {
+            mResults->setRecordedVariables(sedmlDataGeneratorUris());
+        }
+    }
+
+    return {};
+}
+
+//==============================================================================
+
+QStringList Simulation::sedmlDataGeneratorUris() const
+{
+    // Retrieve the URI of the model parameters that are referenced by the data
+    // generators of our SED-ML file, using the same format as the one used by
+    // our results
+    // Note: our SED-ML file has already been checked, so we know that its data
+    //       generators have one variable that references a CellML variable...
+
+    static const QRegularExpression TargetStartRegEx  = QRegularExpression(R"(^\/cellml:model\/cellml:component\[@name=')");
+    static const QRegularExpression TargetMiddleRegEx = QRegularExpression(R"(']\/cellml:variable\[@name=')");
+    static const QRegularExpression TargetEndRegEx    = QRegularExpression(R"('\]$)");
+
+    libsedml::SedDocument *sedmlDocument = sedmlFile()->sedmlDocument();
+    QStringList res;
+
+    for (uint i = 0, iMax = sedmlDocument->getNumDataGenerators(); i < iMax; ++i) {
+        libsedml::SedVariable *sedmlVariable = sedmlDocument->getDataGenerator(i)->getVariable(0);
+        QString target = QString::fromStdString(sedmlVariable->getTarget());
+
+        target.remove(TargetStartRegEx);
+        target.replace(TargetMiddleRegEx, "/");
+        target.remove(TargetEndRegEx);
+
+        libsbml::XMLNode *annotation = sedmlVariable->getAnnotation();
+
+        if (annotation != nullptr) {
+            for (uint j = 0, jMax = annotation->getNumChildren(); j < jMax; ++j) {
+                libsbml::XMLNode &variableDegreeNode = annotation->getChild(j);
+
+                if (   (QString::fromStdString(variableDegreeNode.getURI()) == SEDMLSupport::OpencorNamespace)
+                    && (QString::fromStdString(variableDegreeNode.getName()) == SEDMLSupport::VariableDegree)) {
+                    target += QString("/prime").repeated(QString::fromStdString(variableDegreeNode.getChild(0).getCharacters()).toInt());
+                }
+            }
+        }
+
+        res << target;
+    }
+
+    return res;
+}
+
+//==============================================================================
+
 void Simulation::retrieveFileDetails(bool pRecreateRuntime)
 {
     // Retrieve our CellML and SED-ML files, as well as COMBINE archive
@@ -1550,8 +2115,8 @@ void Simulation::save()
 void Simulation::reload()
 {
     // Stop our worker
-    // Note: we don't need to delete mWorker since it will be done as part of
-    //       its thread being stopped...
+    // Note: we don't need to delete mWorker since it will be done once it is
+    //       done...
 
     stop();
 
@@ -1900,6 +2465,17 @@ bool Simulation::addRun()
 
 //==============================================================================
 
+bool Simulation::addRuns(int pRunsCount)
+{
+    // Ask our results to add the given number of runs
+
+    return (mResults != nullptr)?
+                mResults->addRuns(pRunsCount):
+                false;
+}
+
+//==============================================================================
+
 bool Simulation::isRunning() const
 {
     // Return whether we are running
@@ -1990,27 +2566,27 @@ quint64 Simulation::size()
 
 //==============================================================================
 
-void Simulation::run()
+QFuture<qint64> Simulation::run()
 {
     // Make sure that we have a runtime
 
     if (mRuntime == nullptr) {
-        return;
+        return {};
     }
 
     // Initialise our worker, if we don't already have one and if the simulation
     // settings we were given are sound
+    // Note: if the simulation settings are not sound, then we return a
+    //       cancelled future, so that people know that nothing is running...
 
-    if ((mWorker == nullptr) && simulationSettingsOk()) {
-        // Create and move our worker to a thread
-
-        auto thread = new QThread();
-        mWorker = new SimulationWorker(this, thread, mWorker);
+    if (mWorker == nullptr) {
+        if (!simulationSettingsOk()) {
+            return {};
+        }
 
-        mWorker->moveToThread(thread);
+        // Create our worker
 
-        connect(thread, &QThread::started,
-                mWorker, &SimulationWorker::run);
+        mWorker = new SimulationWorker(this, mWorker);
 
         connect(mWorker, &SimulationWorker::running,
                 this, &Simulation::running);
@@ -2019,21 +2595,76 @@ void Simulation::run()
 
         connect(mWorker, &SimulationWorker::done,
                 this, &Simulation::done);
-        connect(mWorker, &SimulationWorker::done,
-                thread, &QThread::quit);
         connect(mWorker, &SimulationWorker::done,
                 mWorker, &SimulationWorker::deleteLater);
 
         connect(mWorker, &SimulationWorker::error,
                 this, &Simulation::error);
 
-        connect(thread, &QThread::finished,
-                thread, &QThread::deleteLater);
+        // Ask our simulation executor to run our worker and keep track of the
+        // future for it
+
+        mFuture = SimulationExecutor::instance()->run(mWorker);
+    }
+
+    return mFuture;
+}
 
-        // Start our worker by starting the thread in which it is
+//==============================================================================
 
-        thread->start();
+qint64 Simulation::runSynchronously()
+{
+    // Make sure that we have a runtime, that we are not already running and
+    // that the simulation settings we were given are sound
+
+    if (   (mRuntime == nullptr) || (mWorker != nullptr)
+        || !simulationSettingsOk()) {
+        return -1;
     }
+
+    // Run a worker in the calling thread
+    // Note: this is meant for headless use (e.g. from a Python script or the
+    //       CLI), hence there is no event loop involved, i.e. all the signals
+    //       of our worker, including done(), are emitted straightaway...
+
+    SimulationWorker worker(this, mWorker);
+
+    mWorker = &worker;
+
+    connect(mWorker, &SimulationWorker::running,
+            this, &Simulation::running);
+    connect(mWorker, &SimulationWorker::paused,
+            this, &Simulation::paused);
+
+    connect(mWorker, &SimulationWorker::done,
+            this, &Simulation::done);
+
+    connect(mWorker, &SimulationWorker::error,
+            this, &Simulation::error);
+
+    qint64 res = worker.run();
+
+    // Keep track of a future for our run, so that future() is consistent with
+    // what we would have got using run()
+
+    QFutureInterface<qint64> futureInterface;
+
+    futureInterface.reportStarted();
+    futureInterface.reportResult(res);
+    futureInterface.reportFinished();
+
+    mFuture = futureInterface.future();
+
+    return res;
+}
+
+//==============================================================================
+
+QFuture<qint64> Simulation::future() const
+{
+    // Return the future for our current (or last) run
+
+    return mFuture;
 }
 
 //==============================================================================
@@ -26,11 +26,21 @@ along with this program. If not, see <https://gnu.org/licenses>.
 //==============================================================================
 
 #include "datastoreinterface.h"
+#include "simulationdatainterpolator.h"
 #include "simulationsupportglobal.h"
 #include "solverinterface.h"
 
 //==============================================================================
 
+#include <QAtomicInteger>
+#include <QFuture>
+#include <QMap>
+#include <QMutex>
+#include <QSet>
+#include <QVector>
+
+//==============================================================================
+
 #include <functional>
 
 //==============================================================================
@@ -71,6 +81,7 @@ namespace SimulationSupport {
 
 class Simulation;
 class SimulationData;
+class SimulationResultsWriter;
 class SimulationWorker;
 
 //==============================================================================
@@ -171,6 +182,9 @@ public:
 
     static void updateParameters(SimulationData *pSimulationData);
 
+    bool setValues(const QMap<int, double> &pConstants,
+                   const QMap<int, double> &pStates);
+
 private:
     quint64 mDelay = 0;
 
@@ -270,8 +284,14 @@ public:
     void importData(DataStore::DataStoreImportData *pImportData);
 
     bool addRun();
+    bool addRuns(int pRunsCount);
 
     void addPoint(double pPoint);
+    void addPoint(double pPoint, double pRealPoint, int pRun,
+                  const double *pConstants, const double *pRates,
+                  const double *pStates, const double *pAlgebraic);
+
+    double realPoint(double pPoint, int pRun = -1) const;
 
     double * points(int pRun = -1) const;
 
@@ -289,9 +309,30 @@ public:
     DataStore::DataStoreVariables statesVariables() const;
     DataStore::DataStoreVariables algebraicVariables() const;
 
+    static QString uri(const CellMLSupport::CellmlFileRuntimeParameter *pParameter);
+
+    bool isRecorded(const QString &pUri) const;
+    void setRecorded(const QString &pUri, bool pRecorded);
+    void setRecordedVariables(const QStringList &pUris);
+    void applyRecordingMask(bool pRecordAll = false);
+
+    void computeValues();
+
+    SimulationDataInterpolator::Kind dataInterpolationKind() const;
+    void setDataInterpolationKind(SimulationDataInterpolator::Kind pDataInterpolationKind);
+
+    SimulationResultsWriter * writer() const;
+    void setWriter(SimulationResultsWriter *pWriter);
+
+    quint64 epoch() const;
+
 private:
     DataStore::DataStore *mDataStore = nullptr;
 
+    SimulationResultsWriter *mWriter = nullptr;
+
+    QAtomicInteger<quint64> mEpoch;
+
     DataStore::DataStoreVariable *mPointsVariable = nullptr;
 
     DataStore::DataStoreVariables mConstantsVariables;
@@ -301,16 +342,26 @@ private:
 
     QHash<double *, DataStore::DataStoreVariables> mData;
     QHash<double *, DataStore::DataStore *> mDataDataStores;
+    QHash<double *, SimulationDataInterpolator> mDataInterpolators;
 
-    void createDataStore();
-    void deleteDataStore();
+    SimulationDataInterpolator::Kind mDataInterpolationKind = SimulationDataInterpolator::Kind::Linear;
 
-    QString uri(const CellMLSupport::CellmlFileRuntimeParameter *pParameter);
+    QMutex mDataMutex;
 
-    double realPoint(double pPoint, int pRun = -1) const;
+    mutable QVector<double> mRunOffsets;
+    mutable QMutex mRunOffsetsMutex;
+
+    mutable QMutex mComputeValuesMutex;
 
-    double realValue(double pPoint, DataStore::DataStoreVariable *pVoi,
-                     DataStore::DataStoreVariable *pVariable) const;
+    QSet<QString> mRecordedUris;
+    QSet<QString> mUnrecordedUris;
+
+    void createDataStore();
+    void deleteDataStore();
+
+    bool canComputeValues() const;
+    void computeValues(const DataStore::DataStoreVariables &pVariables,
+                       int pRun) const;
 
 signals:
     void resultsReset();
@@ -364,6 +415,7 @@ public:
     SimulationIssues issues();
 
     QString furtherInitialize() const;
+    QString initialize();
 
     CellMLSupport::CellmlFileRuntime * runtime() const;
 
@@ -380,14 +432,18 @@ public:
     void importData(DataStore::DataStoreImportData *pImportData);
 
     bool addRun();
+    bool addRuns(int pRunsCount);
 
-    void run();
+    QFuture<qint64> run();
+    qint64 runSynchronously();
     void pause();
     void resume();
     void stop();
 
     void reset(bool pAll = true);
 
+    QFuture<qint64> future() const;
+
 private:
     QString mFileName;
 
@@ -403,6 +459,7 @@ private:
     CellMLSupport::CellmlFileRuntime *mRuntime = nullptr;
 
     SimulationWorker *mWorker = nullptr;
+    QFuture<qint64> mFuture;
 
     SimulationData *mData = nullptr;
     SimulationResults *mResults = nullptr;
@@ -417,6 +474,8 @@ private:
     QString initializeSolver(const libsedml::SedListOfAlgorithmParameters *pSedmlAlgorithmParameters,
                              const QString &pKisaoId) const;
 
+    QStringList sedmlDataGeneratorUris() const;
+
 signals:
     void running(bool pIsResuming);
     void paused();
@@ -0,0 +1,251 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Simulation data interpolator
+//==============================================================================
+
+#include "simulationdatainterpolator.h"
+
+//==============================================================================
+
+#include <QtNumeric>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace SimulationSupport {
+
+//==============================================================================
+
+SimulationDataInterpolator::SimulationDataInterpolator(DataStore::DataStoreVariable *pVoi,
+                                                       Kind pKind) :
+    mVoi(pVoi),
+    mKind(pKind)
+{
+}
+
+//==============================================================================
+
+SimulationDataInterpolator::Kind SimulationDataInterpolator::kind() const
+{
+    // Return our kind
+
+    return mKind;
+}
+
+//==============================================================================
+
+void SimulationDataInterpolator::setKind(Kind pKind)
+{
+    // Set our kind
+
+    mKind = pKind;
+}
+
+//==============================================================================
+
+void SimulationDataInterpolator::setPoint(double pPoint)
+{
+    // Make sure that the given point is within the range of our VOI
+
+    quint64 size = mVoi->size();
+
+    mInRange =    (size != 0)
+               && (pPoint >= mVoi->value(0))
+               && (pPoint <= mVoi->value(size-1));
+
+    if (!mInRange) {
+        return;
+    }
+
+    if (size == 1) {
+        mCursor = 0;
+        mPosition = 0.0;
+
+        return;
+    }
+
+    // Locate the interval [voi[i], voi[i+1]] that contains the given point,
+    // starting from where we were the last time around
+    // Note #1: points are normally given to us in increasing order, so we
+    //          gallop from our cursor to bracket the given point and then do a
+    //          binary search within that bracket. This means that consecutive
+    //          points are located in constant time while arbitrary points are
+    //          still located in logarithmic time...
+    // Note #2: throughout, we have voi[low] <= pPoint and either
+    //          high == last+1 or voi[high] > pPoint...
+
+    quint64 last = size-2;
+    quint64 low = 0;
+    quint64 high = 0;
+    quint64 step = 1;
+
+    mCursor = qMin(mCursor, last);
+
+    if (mVoi->value(mCursor) <= pPoint) {
+        low = mCursor;
+        high = low+step;
+
+        while ((high <= last) && (mVoi->value(high) <= pPoint)) {
+            low = high;
+            step <<= 1;
+            high = low+step;
+        }
+
+        high = qMin(high, last+1);
+    } else {
+        high = mCursor;
+
+        forever {
+            low = (high > step)?
+                      high-step:
+                      0;
+
+            if (mVoi->value(low) <= pPoint) {
+                break;
+            }
+
+            high = low;
+            step <<= 1;
+        }
+    }
+
+    while (high-low > 1) {
+        quint64 middle = low+(high-low)/2;
+
+        if (mVoi->value(middle) <= pPoint) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    // Keep track of where we are and of our relative position within our
+    // interval
+
+    double lowVoiValue = mVoi->value(low);
+    double highVoiValue = mVoi->value(low+1);
+
+    mCursor = low;
+    mPosition = (highVoiValue > lowVoiValue)?
+                    (pPoint-lowVoiValue)/(highVoiValue-lowVoiValue):
+                    1.0;
+}
+
+//==============================================================================
+
+static double secant(DataStore::DataStoreVariable *pVoi,
+                     DataStore::DataStoreVariable *pVariable, quint64 pIndex)
+{
+    // Return the slope of the given variable between the given index and the
+    // next one
+
+    double step = pVoi->value(pIndex+1)-pVoi->value(pIndex);
+
+    return (step > 0.0)?
+               (pVariable->value(pIndex+1)-pVariable->value(pIndex))/step:
+               0.0;
+}
+
+//==============================================================================
+
+double SimulationDataInterpolator::slope(DataStore::DataStoreVariable *pVariable,
+                                         quint64 pIndex) const
+{
+    // Return the slope of the given variable at the given index, using the
+    // Fritsch-Butland formula so that our cubic interpolation preserves the
+    // monotonicity of our data, i.e. it doesn't overshoot
+    // Note: at either end of our data, we simply use the one-sided secant...
+
+    quint64 last = mVoi->size()-1;
+
+    if (pIndex == 0) {
+        return secant(mVoi, pVariable, 0);
+    }
+
+    if (pIndex == last) {
+        return secant(mVoi, pVariable, last-1);
+    }
+
+    double beforeSecant = secant(mVoi, pVariable, pIndex-1);
+    double afterSecant = secant(mVoi, pVariable, pIndex);
+
+    if (beforeSecant*afterSecant <= 0.0) {
+        return 0.0;
+    }
+
+    double beforeStep = mVoi->value(pIndex)-mVoi->value(pIndex-1);
+    double afterStep = mVoi->value(pIndex+1)-mVoi->value(pIndex);
+    double beforeWeight = 2.0*afterStep+beforeStep;
+    double afterWeight = afterStep+2.0*beforeStep;
+
+    return (beforeWeight+afterWeight)/(beforeWeight/beforeSecant+afterWeight/afterSecant);
+}
+
+//==============================================================================
+
+double SimulationDataInterpolator::value(DataStore::DataStoreVariable *pVariable) const
+{
+    // Return the value of the given variable at our current point, using our
+    // kind of interpolation, if needed
+
+    if (!mInRange) {
+        return qQNaN();
+    }
+
+    double lowValue = pVariable->value(mCursor);
+
+    if (mPosition <= 0.0) {
+        return lowValue;
+    }
+
+    double highValue = pVariable->value(mCursor+1);
+
+    switch (mKind) {
+    case Kind::Step:
+        return (mPosition < 1.0)?
+                   lowValue:
+                   highValue;
+    case Kind::Linear:
+        return lowValue+mPosition*(highValue-lowValue);
+    case Kind::Cubic:
+        break;
+    }
+
+    // Cubic Hermite interpolation
+
+    double step = mVoi->value(mCursor+1)-mVoi->value(mCursor);
+    double position2 = mPosition*mPosition;
+    double position3 = position2*mPosition;
+
+    return  (2.0*position3-3.0*position2+1.0)*lowValue
+           +(position3-2.0*position2+mPosition)*step*slope(pVariable, mCursor)
+           +(3.0*position2-2.0*position3)*highValue
+           +(position3-position2)*step*slope(pVariable, mCursor+1);
+}
+
+//==============================================================================
+
+} // namespace SimulationSupport
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -0,0 +1,76 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Simulation data interpolator
+//==============================================================================
+
+#pragma once
+
+//==============================================================================
+
+#include "datastoreinterface.h"
+#include "simulationsupportglobal.h"
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace SimulationSupport {
+
+//==============================================================================
+
+class SIMULATIONSUPPORT_EXPORT SimulationDataInterpolator
+{
+public:
+    enum class Kind {
+        Step,
+        Linear,
+        Cubic
+    };
+
+    explicit SimulationDataInterpolator(DataStore::DataStoreVariable *pVoi = nullptr,
+                                        Kind pKind = Kind::Linear);
+
+    Kind kind() const;
+    void setKind(Kind pKind);
+
+    void setPoint(double pPoint);
+
+    double value(DataStore::DataStoreVariable *pVariable) const;
+
+private:
+    DataStore::DataStoreVariable *mVoi;
+    Kind mKind;
+
+    quint64 mCursor = 0;
+    double mPosition = 0.0;
+    bool mInRange = false;
+
+    double slope(DataStore::DataStoreVariable *pVariable,
+                 quint64 pIndex) const;
+};
+
+//==============================================================================
+
+} // namespace SimulationSupport
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -0,0 +1,236 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Simulation executor
+//==============================================================================
+
+#include "corecliutils.h"
+#include "simulationexecutor.h"
+#include "simulationworker.h"
+#include "solverinterface.h"
+
+//==============================================================================
+
+#include <QMutexLocker>
+#include <QThread>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace SimulationSupport {
+
+//==============================================================================
+
+static thread_local bool executorThread = false;
+
+//==============================================================================
+
+SimulationExecutorRun::SimulationExecutorRun(SimulationWorker *pWorker) :
+    mWorker(pWorker)
+{
+    // Let people know that we have started, even though we may have to wait
+    // for a thread to become available
+
+    mFutureInterface.reportStarted();
+}
+
+//==============================================================================
+
+QFuture<qint64> SimulationExecutorRun::future()
+{
+    // Return our future
+
+    return mFutureInterface.future();
+}
+
+//==============================================================================
+
+void SimulationExecutorRun::run()
+{
+    // Run our worker and report its elapsed time as our result
+    // Note: we keep track of the fact that our worker is run by one of the
+    //       threads of our simulation executor (see
+    //       SimulationExecutor::releaseThread())...
+
+    executorThread = true;
+
+    qint64 elapsedTime = mWorker->run();
+
+    executorThread = false;
+
+    mFutureInterface.reportResult(elapsedTime);
+    mFutureInterface.reportFinished();
+}
+
+//==============================================================================
+
+SimulationExecutor::SimulationExecutor()
+{
+    // Use as many threads as there are cores and never let them expire, so
+    // that their solvers can be reused from one run to another
+
+    mThreadPool.setMaxThreadCount(QThread::idealThreadCount());
+    mThreadPool.setExpiryTimeout(-1);
+}
+
+//==============================================================================
+
+SimulationExecutor * SimulationExecutor::instance()
+{
+    // Return the 'global' instance of our simulation executor class
+
+    static SimulationExecutor instance;
+
+    return static_cast<SimulationExecutor *>(Core::globalInstance("OpenCOR::SimulationSupport::SimulationExecutor::instance()",
+                                                                  &instance));
+}
+
+//==============================================================================
+
+int SimulationExecutor::threadsCount() const
+{
+    // Return our number of threads
+
+    return mThreadPool.maxThreadCount();
+}
+
+//==============================================================================
+
+QFuture<qint64> SimulationExecutor::run(SimulationWorker *pWorker)
+{
+    // Queue the given worker, so that it gets run as soon as one of our threads
+    // becomes available, and return a future for it
+
+    auto run = new SimulationExecutorRun(pWorker);
+    QFuture<qint64> res = run->future();
+
+    mThreadPool.start(run);
+
+    return res;
+}
+
+//==============================================================================
+
+void SimulationExecutor::releaseThread()
+{
+    // Let our thread pool know that the current thread is about to wait (e.g.
+    // because its worker has been paused), so that it can start another thread
+    // to run our queued workers, if any
+    // Note #1: without this, a few paused workers would be enough to starve
+    //          our queued workers and, at shutdown, to have finalize() wait
+    //          for workers that will never get started...
+    // Note #2: a worker may also be run in the calling thread (see
+    //          Simulation::runSynchronously()), in which case there is
+    //          nothing to release...
+
+    if (executorThread) {
+        mThreadPool.releaseThread();
+    }
+}
+
+//==============================================================================
+
+void SimulationExecutor::reserveThread()
+{
+    // Let our thread pool know that the current thread is not waiting anymore
+    // (see releaseThread())
+
+    if (executorThread) {
+        mThreadPool.reserveThread();
+    }
+}
+
+//==============================================================================
+
+Solver::OdeSolver * SimulationExecutor::odeSolver(SolverInterface *pSolverInterface)
+{
+    // Return the instance of the given ODE solver for the current thread,
+    // creating it if needed
+    // Note: an ODE solver instance can only be used by one run at a time, but
+    //       our threads only ever run one worker at a time, hence we can reuse
+    //       the instance from one run to another rather than create and delete
+    //       it each time...
+
+    QMutexLocker locker(&mSolversMutex);
+
+    QPair<QThread *, SolverInterface *> key(QThread::currentThread(), pSolverInterface);
+    Solver::OdeSolver *res = mOdeSolvers.value(key);
+
+    if (res == nullptr) {
+        res = static_cast<Solver::OdeSolver *>(pSolverInterface->solverInstance());
+
+        mOdeSolvers.insert(key, res);
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+Solver::NlaSolver * SimulationExecutor::nlaSolver(SolverInterface *pSolverInterface)
+{
+    // Return the instance of the given NLA solver for the current thread,
+    // creating it if needed (see odeSolver())
+
+    QMutexLocker locker(&mSolversMutex);
+
+    QPair<QThread *, SolverInterface *> key(QThread::currentThread(), pSolverInterface);
+    Solver::NlaSolver *res = mNlaSolvers.value(key);
+
+    if (res == nullptr) {
+        res = static_cast<Solver::NlaSolver *>(pSolverInterface->solverInstance());
+
+        mNlaSolvers.insert(key, res);
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+void SimulationExecutor::finalize()
+{
+    // Wait for our runs to be done and delete our solvers
+    // Note: this must be done before our solver plugins get unloaded...
+
+    mThreadPool.waitForDone();
+
+    QMutexLocker locker(&mSolversMutex);
+
+    for (auto odeSolver : qAsConst(mOdeSolvers)) {
+        delete odeSolver;
+    }
+
+    for (auto nlaSolver : qAsConst(mNlaSolvers)) {
+        delete nlaSolver;
+    }
+
+    mOdeSolvers.clear();
+    mNlaSolvers.clear();
+}
+
+//==============================================================================
+
+} // namespace SimulationSupport
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -0,0 +1,119 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Simulation executor
+//==============================================================================
+
+#pragma once
+
+//==============================================================================
+
+#include "simulationsupportglobal.h"
+
+//==============================================================================
+
+#include <QFuture>
+#include <QFutureInterface>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QRunnable>
+#include <QThreadPool>
+
+//==============================================================================
+
+namespace OpenCOR {
+
+//==============================================================================
+
+class SolverInterface;
+
+//==============================================================================
+
+namespace Solver {
+    class NlaSolver;
+    class OdeSolver;
+} // namespace Solver
+
+//==============================================================================
+
+namespace SimulationSupport {
+
+//==============================================================================
+
+class SimulationWorker;
+
+//==============================================================================
+
+class SimulationExecutorRun : public QRunnable
+{
+public:
+    explicit SimulationExecutorRun(SimulationWorker *pWorker);
+
+    QFuture<qint64> future();
+
+    void run() override;
+
+private:
+    SimulationWorker *mWorker;
+
+    QFutureInterface<qint64> mFutureInterface;
+};
+
+//==============================================================================
+
+class SIMULATIONSUPPORT_EXPORT SimulationExecutor : public QObject
+{
+    Q_OBJECT
+
+public:
+    static SimulationExecutor * instance();
+
+    int threadsCount() const;
+
+    QFuture<qint64> run(SimulationWorker *pWorker);
+
+    void releaseThread();
+    void reserveThread();
+
+    Solver::OdeSolver * odeSolver(SolverInterface *pSolverInterface);
+    Solver::NlaSolver * nlaSolver(SolverInterface *pSolverInterface);
+
+    void finalize();
+
+private:
+    QThreadPool mThreadPool;
+
+    QMutex mSolversMutex;
+    QMap<QPair<QThread *, SolverInterface *>, Solver::OdeSolver *> mOdeSolvers;
+    QMap<QPair<QThread *, SolverInterface *>, Solver::NlaSolver *> mNlaSolvers;
+
+    SimulationExecutor();
+};
+
+//==============================================================================
+
+} // namespace SimulationSupport
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -0,0 +1,237 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+
+//==============================================================================
+// Simulation results writer
+//==============================================================================
+
+#include "simulation.h"
+#include "simulationresultswriter.h"
+
+//==============================================================================
+
+#include <QIODevice>
+#include <QLocale>
+#include <QtEndian>
+#include <QVector>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace SimulationSupport {
+
+//==============================================================================
+
+SimulationResultsWriter::SimulationResultsWriter(SimulationResults *pResults,
+                                                 QIODevice *pDevice,
+                                                 Format pFormat) :
+    mDevice(pDevice),
+    mFormat(pFormat),
+    mPointsVariable(pResults->pointsVariable())
+{
+    // Retrieve the variables that we are to write, i.e. our states and our
+    // recorded rates and algebraic variables
+    // Note: our constants are, well, constant, so there is no point in writing
+    //       them for each point...
+
+    mVariables << pResults->statesVariables();
+
+    const DataStore::DataStoreVariables ratesVariables = pResults->ratesVariables();
+
+    for (auto rateVariable : ratesVariables) {
+        if (rateVariable->isRecorded()) {
+            mVariables << rateVariable;
+        }
+    }
+
+    const DataStore::DataStoreVariables algebraicVariables = pResults->algebraicVariables();
+
+    for (auto algebraicVariable : algebraicVariables) {
+        if (algebraicVariable->isRecorded()) {
+            mVariables << algebraicVariable;
+        }
+    }
+
+    // Make sure that our buffer can hold at least one row without having to be
+    // reallocated
+
+    mBuffer.reserve(BufferSize+(mVariables.count()+1)*32);
+}
+
+//==============================================================================
+
+QStringList SimulationResultsWriter::uris() const
+{
+    // Return the URI of our VOI and of our variables, in the order in which
+    // they are written
+
+    QStringList res = { mPointsVariable->uri() };
+
+    for (auto variable : mVariables) {
+        res << variable->uri();
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+bool SimulationResultsWriter::writeHeader()
+{
+    // Write our header, which consists of the URI of our VOI and of our
+    // variables, whatever our format
+    // Note: in the case of our binary format, the header is followed by our
+    //       values as little-endian 64-bit floating point numbers, row by
+    //       row...
+
+    mBuffer += uris().join(',').toUtf8();
+    mBuffer += '\n';
+
+    return flush();
+}
+
+//==============================================================================
+
+void SimulationResultsWriter::writeValue(double pValue, bool pFirstValue)
+{
+    // Write the given value to our buffer
+
+    if (mFormat == Format::Csv) {
+        if (!pFirstValue) {
+            mBuffer += ',';
+        }
+
+        mBuffer += QByteArray::number(pValue, 'g', QLocale::FloatingPointShortest);
+    } else {
+        quint64 rawValue;
+        char value[sizeof(quint64)];
+
+        memcpy(&rawValue, &pValue, sizeof(quint64));
+
+        qToLittleEndian(rawValue, value);
+
+        mBuffer.append(value, sizeof(quint64));
+    }
+}
+
+//==============================================================================
+
+void SimulationResultsWriter::writePoint(double pPoint)
+{
+    // Write the given point and the current value of our variables, and flush
+    // our buffer if it has become big enough
+    // Note: our variables are up to date since we are called from
+    //       SimulationResults::addPoint()...
+
+    writeValue(pPoint, true);
+
+    for (auto variable : qAsConst(mVariables)) {
+        writeValue(variable->value(), false);
+    }
+
+    endRow();
+}
+
+//==============================================================================
+
+bool SimulationResultsWriter::writeRun(int pRun)
+{
+    // Write the values stored for the given run, reading them a block at a
+    // time for each of our variables since reading stored values involves some
+    // locking
+
+    quint64 size = mPointsVariable->size(pRun);
+    int nbOfVariables = mVariables.count();
+    QVector<double> blocks(int(quint64(nbOfVariables+1)*BlockSize));
+
+    for (quint64 start = 0; start < size; start += BlockSize) {
+        quint64 count = qMin(quint64(BlockSize), size-start);
+
+        mPointsVariable->values(start, count, blocks.data(), pRun);
+
+        for (int i = 0; i < nbOfVariables; ++i) {
+            mVariables[i]->values(start, count, blocks.data()+quint64(i+1)*BlockSize, pRun);
+        }
+
+        for (quint64 j = 0; j < count; ++j) {
+            writeValue(blocks[int(j)], true);
+
+            for (int i = 0; i < nbOfVariables; ++i) {
+                writeValue(blocks[int(quint64(i+1)*BlockSize+j)], false);
+            }
+
+            endRow();
+        }
+    }
+
+    return flush();
+}
+
+//==============================================================================
+
+void SimulationResultsWriter::endRow()
+{
+    // End the row that we have just written, and flush our buffer if it has
+    // become big enough
+
+    if (mFormat == Format::Csv) {
+        mBuffer += '\n';
+    }
+
+    if (mBuffer.size() >= BufferSize) {
+        flush();
+    }
+}
+
+//==============================================================================
+
+bool SimulationResultsWriter::flush()
+{
+    // Write our buffer to our device, keeping track of any error, and empty it
+    // while keeping its capacity
+
+    if (!mBuffer.isEmpty()) {
+        if (mDevice->write(mBuffer) != mBuffer.size()) {
+            mError = true;
+        }
+
+        mBuffer.resize(0);
+    }
+
+    return !mError;
+}
+
+//==============================================================================
+
+bool SimulationResultsWriter::hasError() const
+{
+    // Return whether an error occurred while writing to our device
+
+    return mError;
+}
+
+//==============================================================================
+
+} // namespace SimulationSupport
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -0,0 +1,98 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+
+//==============================================================================
+// Simulation results writer
+//==============================================================================
+
+#pragma once
+
+//==============================================================================
+
+#include "datastoreinterface.h"
+#include "simulationsupportglobal.h"
+
+//==============================================================================
+
+#include <QByteArray>
+
+//==============================================================================
+
+class QIODevice;
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace SimulationSupport {
+
+//==============================================================================
+
+class SimulationResults;
+
+//==============================================================================
+
+class SIMULATIONSUPPORT_EXPORT SimulationResultsWriter
+{
+public:
+    enum class Format {
+        Csv,
+        Binary
+    };
+
+    explicit SimulationResultsWriter(SimulationResults *pResults,
+                                     QIODevice *pDevice, Format pFormat);
+
+    QStringList uris() const;
+
+    bool writeHeader();
+    void writePoint(double pPoint);
+    bool writeRun(int pRun);
+    bool flush();
+
+    bool hasError() const;
+
+private:
+    enum {
+        BufferSize = 1 << 20,
+        BlockSize = 1024
+    };
+
+    QIODevice *mDevice;
+    Format mFormat;
+
+    DataStore::DataStoreVariable *mPointsVariable;
+    DataStore::DataStoreVariables mVariables;
+
+    QByteArray mBuffer;
+
+    bool mError = false;
+
+    void writeValue(double pValue, bool pFirstValue);
+    void endRow();
+};
+
+//==============================================================================
+
+} // namespace SimulationSupport
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -21,9 +21,32 @@ along with this program. If not, see <https://gnu.org/licenses>.
 // Simulation support plugin
 //==============================================================================
 
+#include "cellmlfileruntime.h"
+#include "corecliutils.h"
+#include "filemanager.h"
+#include "simulation.h"
+#include "simulationexecutor.h"
 #include "simulationmanager.h"
+#include "simulationresultswriter.h"
 #include "simulationsupportplugin.h"
 #include "simulationsupportpythonwrapper.h"
+#include "simulationsweep.h"
+
+//==============================================================================
+
+#include <QDir>
+#include <QFile>
+
+//==============================================================================
+
+#include <iostream>
+
+//==============================================================================
+
+#ifdef Q_OS_WIN
+    #include <fcntl.h>
+    #include <io.h>
+#endif
 
 //==============================================================================
 
@@ -39,11 +62,54 @@ PLUGININFO_FUNC SimulationSupportPluginInfo()
                                                  { "fr", QString::fromUtf8("une extension pour supporter des simulations.") }
                                              };
 
-    return new PluginInfo(PluginInfo::Category::Support, false, false,
+    return new PluginInfo(PluginInfo::Category::Support, false, true,
                           { "COMBINESupport", "DataStore", "PythonQtSupport" },
                           descriptions);
 }
 
+//==============================================================================
+// CLI interface
+//==============================================================================
+
+bool SimulationSupportPlugin::executeCommand(const QString &pCommand,
+                                             const QStringList &pArguments,
+                                             int &pRes)
+{
+    Q_UNUSED(pRes)
+
+    // Run the given CLI command
+
+    static const QString Help  = "help";
+    static const QString Run   = "run";
+    static const QString Sweep = "sweep";
+
+    if (pCommand == Help) {
+        // Display the commands that we support
+
+        runHelpCommand();
+
+        return true;
+    }
+
+    if (pCommand == Run) {
+        // Run a simulation
+
+        return runRunCommand(pArguments);
+    }
+
+    if (pCommand == Sweep) {
+        // Run a parameter sweep of a simulation
+
+        return runSweepCommand(pArguments);
+    }
+
+    // Not a CLI command that we support
+
+    runHelpCommand();
+
+    return false;
+}
+
 //==============================================================================
 // File handling interface
 //==============================================================================
@@ -151,6 +217,83 @@ void SimulationSupportPlugin::retranslateUi()
     //       multilingual...
 }
 
+//==============================================================================
+// Plugin interface
+//==============================================================================
+
+bool SimulationSupportPlugin::definesPluginInterfaces()
+{
+    // We don't handle this interface...
+
+    return false;
+}
+
+//==============================================================================
+
+bool SimulationSupportPlugin::pluginInterfacesOk(const QString &pFileName,
+                                                 QObject *pInstance)
+{
+    Q_UNUSED(pFileName)
+    Q_UNUSED(pInstance)
+
+    // We don't handle this interface...
+
+    return false;
+}
+
+//==============================================================================
+
+void SimulationSupportPlugin::initializePlugin()
+{
+    // We don't handle this interface...
+}
+
+//==============================================================================
+
+void SimulationSupportPlugin::finalizePlugin()
+{
+    // Finalise our simulation executor, so that the ODE solvers that it reuses
+    // get deleted while our solver plugins are still loaded
+
+    SimulationExecutor::instance()->finalize();
+}
+
+//==============================================================================
+
+void SimulationSupportPlugin::pluginsInitialized(const Plugins &pLoadedPlugins)
+{
+    Q_UNUSED(pLoadedPlugins)
+
+    // We don't handle this interface...
+}
+
+//==============================================================================
+
+void SimulationSupportPlugin::loadSettings(QSettings &pSettings)
+{
+    Q_UNUSED(pSettings)
+
+    // We don't handle this interface...
+}
+
+//==============================================================================
+
+void SimulationSupportPlugin::saveSettings(QSettings &pSettings) const
+{
+    Q_UNUSED(pSettings)
+
+    // We don't handle this interface...
+}
+
+//==============================================================================
+
+void SimulationSupportPlugin::handleUrl(const QUrl &pUrl)
+{
+    Q_UNUSED(pUrl)
+
+    // We don't handle this interface...
+}
+
 //==============================================================================
 // Python interface
 //==============================================================================
@@ -162,6 +305,497 @@ void SimulationSupportPlugin::registerPythonClasses(void *pModule)
     new SimulationSupportPythonWrapper(pModule, this);
 }
 
+//==============================================================================
+// Plugin specific
+//==============================================================================
+
+void SimulationSupportPlugin::runHelpCommand()
+{
+    // Output the commands we support
+
+    std::cout << "Commands supported by the SimulationSupport plugin:" << std::endl;
+    std::cout << " * Display the commands supported by the SimulationSupport plugin:" << std::endl;
+    std::cout << "      help" << std::endl;
+    std::cout << " * Run <file>, i.e. a CellML file, a SED-ML file or a COMBINE archive, streaming" << std::endl;
+    std::cout << "   its results to <output> (or to the standard output) as they are computed:" << std::endl;
+    std::cout << "      run <file> [-o <output>] [-f csv|binary]" << std::endl;
+    std::cout << "   The results consist of the VOI, the states and the recorded rates and" << std::endl;
+    std::cout << "   algebraic variables, preceded by a CSV header with their URI. In binary" << std::endl;
+    std::cout << "   format, the values are little-endian 64-bit floating point numbers." << std::endl;
+    std::cout << " * Run a parameter sweep of <file>, i.e. run <file> for all the combinations of" << std::endl;
+    std::cout << "   the given constant and state values, using up to <threads> threads:" << std::endl;
+    std::cout << "      sweep <file> <parameter>=<value>[,<value>...] [...] [-t <threads>]" << std::endl;
+    std::cout << "            [-o <directory>] [-f csv|binary]" << std::endl;
+    std::cout << "   <parameter> is the URI of a constant or a state, e.g. membrane/Cm." << std::endl;
+    std::cout << "   The value of the states at the end of each run is output as CSV. The" << std::endl;
+    std::cout << "   results of each run can also be written to <directory>, as run<n>.csv" << std::endl;
+    std::cout << "   (or run<n>.bin), in the same format as those of the run command." << std::endl;
+}
+
+//==============================================================================
+
+Simulation * SimulationSupportPlugin::openSimulation(const QString &pFileNameOrUrl,
+                                                     QString &pFileName,
+                                                     QString &pOutput)
+{
+    // Open our file, be it local or remote
+
+    bool isLocalFile;
+    QString fileNameOrUrl;
+
+    Core::checkFileNameOrUrl(pFileNameOrUrl, isLocalFile, fileNameOrUrl);
+
+    pOutput = isLocalFile?
+                  Core::cliOpenFile(fileNameOrUrl):
+                  Core::cliOpenRemoteFile(fileNameOrUrl);
+
+    if (!pOutput.isEmpty()) {
+        return nullptr;
+    }
+
+    pFileName = isLocalFile?
+                    fileNameOrUrl:
+                    Core::FileManager::instance()->fileName(fileNameOrUrl);
+
+    // Retrieve and initialise the corresponding simulation
+
+    SimulationManager *simulationManager = SimulationManager::instance();
+
+    simulationManager->manage(pFileName);
+
+    Simulation *res = simulationManager->simulation(pFileName);
+
+    if (res->hasBlockingIssues()) {
+        pOutput = "The simulation has blocking issues and cannot therefore be run.";
+    } else {
+        pOutput = res->initialize();
+
+        if (    pOutput.isEmpty()
+            && ((res->runtime() == nullptr) || !res->runtime()->isValid())) {
+            pOutput = "The simulation has an invalid runtime and cannot therefore be run.";
+        }
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+void SimulationSupportPlugin::closeSimulation(const QString &pFileName)
+{
+    // No longer manage the given simulation and file
+
+    SimulationManager::instance()->unmanage(pFileName);
+    Core::FileManager::instance()->unmanage(pFileName);
+}
+
+//==============================================================================
+
+static bool openStandardOutput(QFile &pFile)
+{
+    // Open the standard output using the given file
+    // Note: on Windows, the standard output is in text mode by default, meaning
+    //       that every LF that we write would get converted to CR+LF, which
+    //       would corrupt our results in binary format, hence we switch it to
+    //       binary mode first...
+
+#ifdef Q_OS_WIN
+    fflush(stdout);
+
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    return pFile.open(stdout, QIODevice::WriteOnly);
+}
+
+//==============================================================================
+
+bool SimulationSupportPlugin::outputArguments(QStringList &pArguments,
+                                              QString &pOutputName,
+                                              SimulationResultsWriter::Format &pFormat)
+{
+    // Retrieve (and remove) the name of our output and the format to use, if
+    // any, from the given arguments
+
+    static const QString Output = "-o";
+    static const QString Format = "-f";
+    static const QString Csv    = "csv";
+    static const QString Binary = "binary";
+
+    pFormat = SimulationResultsWriter::Format::Csv;
+
+    int outputIndex = pArguments.indexOf(Output);
+
+    if (outputIndex != -1) {
+        if (outputIndex+1 == pArguments.count()) {
+            return false;
+        }
+
+        pOutputName = pArguments[outputIndex+1];
+
+        pArguments.removeAt(outputIndex+1);
+        pArguments.removeAt(outputIndex);
+    }
+
+    int formatIndex = pArguments.indexOf(Format);
+
+    if (formatIndex != -1) {
+        QString formatName = (formatIndex+1 < pArguments.count())?
+                                 pArguments[formatIndex+1]:
+                                 QString();
+
+        if (formatName == Binary) {
+            pFormat = SimulationResultsWriter::Format::Binary;
+        } else if (formatName != Csv) {
+            return false;
+        }
+
+        pArguments.removeAt(formatIndex+1);
+        pArguments.removeAt(formatIndex);
+    }
+
+    return true;
+}
+
+//==============================================================================
+
+bool SimulationSupportPlugin::runRunCommand(const QStringList &pArguments)
+{
+    // Retrieve the name of our output file and the format to use, if any, and
+    // make sure that we have a file
+
+    QStringList arguments = pArguments;
+    QString outputFileName;
+    SimulationResultsWriter::Format format;
+
+    if (   !outputArguments(arguments, outputFileName, format)
+        || (arguments.count() != 1)) {
+        runHelpCommand();
+
+        return false;
+    }
+
+    // Open our file and retrieve and initialise the corresponding simulation
+
+    QString fileName;
+    QString output;
+    Simulation *simulation = openSimulation(arguments[0], fileName, output);
+
+    if (simulation == nullptr) {
+        std::cerr << output.toStdString() << std::endl;
+
+        return false;
+    }
+
+    // Open our output, be it a file or the standard output, and run our
+    // simulation in our thread, streaming its results through a writer
+    // Note #1: we don't add a run to our simulation since our results are
+    //          streamed rather than stored, meaning that the memory we use
+    //          doesn't depend on the size of our simulation...
+    // Note #2: since we don't add a run, we must apply our recording mask
+    //          ourselves, so that only the variables that are referenced by
+    //          the data generators of a SED-ML file (if that is what we are
+    //          running) get written. Our results won't be used to compute the
+    //          values of our unrecorded variables, so we don't care whether
+    //          our model needs an NLA solver...
+
+    if (output.isEmpty()) {
+        simulation->results()->applyRecordingMask();
+
+        QFile outputFile(outputFileName);
+
+        if (outputFileName.isEmpty()?
+                !openStandardOutput(outputFile):
+                !outputFile.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+            output = QString("The output file (%1) could not be created.").arg(outputFileName);
+        } else {
+            SimulationResultsWriter writer(simulation->results(), &outputFile, format);
+            QMetaObject::Connection errorConnection = connect(simulation, &Simulation::error, [&output](const QString &pMessage) {
+                output = Core::formatMessage(pMessage, false)+'.';
+            });
+
+            simulation->results()->setWriter(&writer);
+
+            if (writer.writeHeader()) {
+                simulation->runSynchronously();
+
+                if (!writer.flush() && output.isEmpty()) {
+                    output = "The results could not be written.";
+                }
+            } else {
+                output = "The results could not be written.";
+            }
+
+            simulation->results()->setWriter(nullptr);
+
+            disconnect(errorConnection);
+
+            outputFile.close();
+        }
+    }
+
+    // We are done, so no longer manage our simulation and file
+
+    closeSimulation(fileName);
+
+    // Let the user know about any output we got and leave with the appropriate
+    // command code
+
+    if (!output.isEmpty()) {
+        std::cerr << output.toStdString() << std::endl;
+
+        return false;
+    }
+
+    return true;
+}
+
+//==============================================================================
+
+bool SimulationSupportPlugin::runSweepCommand(const QStringList &pArguments)
+{
+    // Make sure that we have at least a file and a parameter, and retrieve the
+    // number of threads to use, as well as the name of our output directory
+    // and the format to use, if any
+
+    static const QString Threads = "-t";
+
+    QStringList arguments = pArguments;
+    QString outputDirName;
+    SimulationResultsWriter::Format format;
+
+    if (!outputArguments(arguments, outputDirName, format)) {
+        runHelpCommand();
+
+        return false;
+    }
+
+    int threadsCount = 0;
+    int threadsIndex = arguments.indexOf(Threads);
+
+    if (threadsIndex != -1) {
+        bool validThreadsCount = false;
+
+        if (threadsIndex+1 < arguments.count()) {
+            threadsCount = arguments[threadsIndex+1].toInt(&validThreadsCount);
+        }
+
+        if (!validThreadsCount || (threadsCount <= 0)) {
+            runHelpCommand();
+
+            return false;
+        }
+
+        arguments.removeAt(threadsIndex+1);
+        arguments.removeAt(threadsIndex);
+    }
+
+    if (arguments.count() < 2) {
+        runHelpCommand();
+
+        return false;
+    }
+
+    // Open our file and retrieve and initialise the corresponding simulation
+
+    QString fileName;
+    QString output;
+    Simulation *simulation = openSimulation(arguments[0], fileName, output);
+
+    if (simulation == nullptr) {
+        std::cerr << output.toStdString() << std::endl;
+
+        return false;
+    }
+
+    QStringList headers = { "Run" };
+    QList<QList<double>> parametersValues;
+    QList<int> parametersIndexes;
+    QList<bool> parametersStates;
+
+    // Retrieve the values of our parameters
+
+    if (output.isEmpty()) {
+        DataStore::DataStoreValues *constantsValues = simulation->data()->constantsValues();
+        DataStore::DataStoreValues *statesValues = simulation->data()->statesValues();
+
+        for (int i = 1, iMax = arguments.count(); (i < iMax) && output.isEmpty(); ++i) {
+            QString uri = arguments[i].section('=', 0, 0);
+            const QStringList values = arguments[i].section('=', 1).split(',');
+            QList<double> parameterValues;
+
+            for (const auto &value : values) {
+                bool validValue;
+
+                parameterValues << value.toDouble(&validValue);
+
+                if (!validValue) {
+                    output = QString("The value of '%1' is not valid.").arg(uri);
+
+                    break;
+                }
+            }
+
+            int parameterIndex = -1;
+            bool parameterState = false;
+
+            for (int j = 0, jMax = constantsValues->count(); j < jMax; ++j) {
+                if (constantsValues->at(j)->uri() == uri) {
+                    parameterIndex = j;
+
+                    break;
+                }
+            }
+
+            if (parameterIndex == -1) {
+                for (int j = 0, jMax = statesValues->count(); j < jMax; ++j) {
+                    if (statesValues->at(j)->uri() == uri) {
+                        parameterIndex = j;
+                        parameterState = true;
+
+                        break;
+                    }
+                }
+            }
+
+            if (output.isEmpty() && (parameterIndex == -1)) {
+                output = QString("'%1' is neither a constant nor a state.").arg(uri);
+            }
+
+            headers << uri;
+
+            parametersValues << parameterValues;
+            parametersIndexes << parameterIndex;
+            parametersStates << parameterState;
+        }
+    }
+
+    // Run our sweep, which consists of all the combinations of our parameters'
+    // values
+
+    if (output.isEmpty()) {
+        SimulationSweep sweep(simulation);
+        QList<QList<double>> runsValues = { {} };
+
+        for (const auto &parameterValues : qAsConst(parametersValues)) {
+            QList<QList<double>> newRunsValues;
+
+            for (const auto &runValues : qAsConst(runsValues)) {
+                for (auto parameterValue : parameterValues) {
+                    newRunsValues << (QList<double>(runValues) << parameterValue);
+                }
+            }
+
+            runsValues = newRunsValues;
+        }
+
+        for (const auto &runValues : qAsConst(runsValues)) {
+            SimulationSweepValues constants;
+            SimulationSweepValues states;
+
+            for (int i = 0, iMax = runValues.count(); i < iMax; ++i) {
+                if (parametersStates[i]) {
+                    states.insert(parametersIndexes[i], runValues[i]);
+                } else {
+                    constants.insert(parametersIndexes[i], runValues[i]);
+                }
+            }
+
+            sweep.addRun(constants, states);
+        }
+
+        // Keep track of any error and run our sweep, waiting for it to complete
+        // Note: our sweep's error() signal is emitted from the thread of the
+        //       run that failed, but we only look at the error message once
+        //       all our runs are done...
+
+        connect(&sweep, &SimulationSweep::error, [&output](const QString &pMessage) {
+            output = Core::formatMessage(pMessage, false)+'.';
+        });
+
+        int firstRun = simulation->runsCount();
+
+        if (sweep.run(threadsCount)) {
+            sweep.wait();
+        } else if (output.isEmpty()) {
+            output = "The sweep could not be run.";
+        }
+
+        // Output the value of our states at the end of each run
+
+        if (output.isEmpty()) {
+            const DataStore::DataStoreVariables statesVariables = simulation->results()->statesVariables();
+
+            for (auto stateVariable : statesVariables) {
+                headers << stateVariable->uri();
+            }
+
+            std::cout << headers.join(',').toStdString() << std::endl;
+
+            for (int i = 0, iMax = runsValues.count(); i < iMax; ++i) {
+                int run = firstRun+i;
+                quint64 lastPosition = simulation->runSize(run)-1;
+                QStringList values = { QString::number(i+1) };
+
+                for (auto runValue : runsValues[i]) {
+                    values << QString::number(runValue);
+                }
+
+                for (auto stateVariable : statesVariables) {
+                    values << QString::number(stateVariable->value(lastPosition, run));
+                }
+
+                std::cout << values.join(',').toStdString() << std::endl;
+            }
+        }
+
+        // Write the results of each run to our output directory, if needed
+
+        if (output.isEmpty() && !outputDirName.isEmpty()) {
+            QDir outputDir(outputDirName);
+
+            if (!outputDir.mkpath(".")) {
+                output = QString("The output directory (%1) could not be created.").arg(outputDirName);
+            }
+
+            for (int i = 0, iMax = runsValues.count(); (i < iMax) && output.isEmpty(); ++i) {
+                QString outputFileName = outputDir.filePath(QString("run%1.%2").arg(i+1)
+                                                                               .arg((format == SimulationResultsWriter::Format::Csv)?
+                                                                                        "csv":
+                                                                                        "bin"));
+                QFile outputFile(outputFileName);
+
+                if (!outputFile.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+                    output = QString("The output file (%1) could not be created.").arg(outputFileName);
+                } else {
+                    SimulationResultsWriter writer(simulation->results(), &outputFile, format);
+
+                    if (!writer.writeHeader() || !writer.writeRun(firstRun+i)) {
+                        output = "The results could not be written.";
+                    }
+
+                    outputFile.close();
+                }
+            }
+        }
+    }
+
+    // We are done, so no longer manage our simulation and file
+
+    closeSimulation(fileName);
+
+    // Let the user know about any output we got and leave with the appropriate
+    // command code
+
+    if (!output.isEmpty()) {
+        std::cerr << output.toStdString() << std::endl;
+
+        return false;
+    }
+
+    return true;
+}
+
 //==============================================================================
 
 } // namespace SimulationSupport
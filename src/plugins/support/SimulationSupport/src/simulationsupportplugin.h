@@ -25,10 +25,13 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 //==============================================================================
 
+#include "cliinterface.h"
 #include "filehandlinginterface.h"
 #include "i18ninterface.h"
 #include "plugininfo.h"
+#include "plugininterface.h"
 #include "pythoninterface.h"
+#include "simulationresultswriter.h"
 
 //==============================================================================
 
@@ -41,21 +44,44 @@ PLUGININFO_FUNC SimulationSupportPluginInfo();
 
 //==============================================================================
 
-class SimulationSupportPlugin : public QObject, public FileHandlingInterface,
-                                public I18nInterface, public PythonInterface
+class Simulation;
+
+//==============================================================================
+
+class SimulationSupportPlugin : public QObject, public CliInterface,
+                                public FileHandlingInterface,
+                                public I18nInterface, public PluginInterface,
+                                public PythonInterface
 {
     Q_OBJECT
 
     Q_PLUGIN_METADATA(IID "OpenCOR.SimulationSupportPlugin" FILE "simulationsupportplugin.json")
 
+    Q_INTERFACES(OpenCOR::CliInterface)
     Q_INTERFACES(OpenCOR::FileHandlingInterface)
     Q_INTERFACES(OpenCOR::I18nInterface)
+    Q_INTERFACES(OpenCOR::PluginInterface)
     Q_INTERFACES(OpenCOR::PythonInterface)
 
 public:
+#include "cliinterface.inl"
 #include "filehandlinginterface.inl"
 #include "i18ninterface.inl"
+#include "plugininterface.inl"
 #include "pythoninterface.inl"
+
+private:
+    void runHelpCommand();
+
+    Simulation * openSimulation(const QString &pFileNameOrUrl,
+                                QString &pFileName, QString &pOutput);
+    void closeSimulation(const QString &pFileName);
+
+    bool outputArguments(QStringList &pArguments, QString &pOutputName,
+                         SimulationResultsWriter::Format &pFormat);
+
+    bool runRunCommand(const QStringList &pArguments);
+    bool runSweepCommand(const QStringList &pArguments);
 };
 
 //==============================================================================
@@ -29,13 +29,13 @@ along with this program. If not, see <https://gnu.org/licenses>.
 #include "pythonqtsupport.h"
 #include "simulation.h"
 #include "simulationmanager.h"
+#include "simulationsweep.h"
 #include "simulationsupportpythonwrapper.h"
 
 //==============================================================================
 
 #include <QApplication>
 #include <QFileInfo>
-#include <QTimer>
 #include <QWidget>
 
 //==============================================================================
@@ -118,6 +118,21 @@ static void setNlaSolver(SimulationData *pSimulationData,
 
 //==============================================================================
 
+static int valueIndex(DataStore::DataStoreValues *pValues, const QString &pUri)
+{
+    // Return the index of the given URI in the given values, if any
+
+    for (int i = 0, iMax = pValues->count(); i < iMax; ++i) {
+        if (pValues->at(i)->uri() == pUri) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+//==============================================================================
+
 static PyObject * initializeSimulation(const QString &pFileName)
 {
     // Ask our simulation manager to manage our file and then retrieve the
@@ -138,67 +153,21 @@ static PyObject * initializeSimulation(const QString &pFileName)
             return PythonQt::priv()->wrapQObject(simulation);
         }
 
-        // Retrieve a default ODE and NLA solver
-        // Note: this is useful in case our simulation is solely based on a
-        //       CellML file...
-
-        const SolverInterfaces solverInterfaces = Core::solverInterfaces();
-        QString odeSolverName;
-        QString nlaSolverName;
-
-        for (auto solverInterface : solverInterfaces) {
-            QString solverName = solverInterface->solverName();
-
-            if (solverInterface->solverType() == Solver::Type::Ode) {
-                if (    odeSolverName.isEmpty()
-                    || (odeSolverName.compare(solverName, Qt::CaseInsensitive) > 0)) {
-                    odeSolverName = solverName;
-                }
-            } else if (solverInterface->solverType() == Solver::Type::Nla) {
-                if (    nlaSolverName.isEmpty()
-                    || (nlaSolverName.compare(solverName, Qt::CaseInsensitive) > 0)) {
-                    nlaSolverName = solverName;
-                }
-            }
-        }
-
-        // Set our default ODE and NLA, if needed, solvers
-
-        CellMLSupport::CellmlFileRuntime *runtime = simulation->runtime();
-
-        setOdeSolver(simulation->data(), odeSolverName);
-
-        if ((runtime != nullptr) && runtime->needNlaSolver()) {
-            setNlaSolver(simulation->data(), nlaSolverName);
-        }
-
-        // Further initialise our simulation, should we be dealing with either
-        // a SED-ML file or a COMBINE archive
-        // Note: this will overwrite the default ODE and NLA solvers that we set
-        //       above...
+        // Initialise our simulation, i.e. set a default ODE and NLA, if
+        // needed, solvers, further initialise it, should we be dealing with
+        // either a SED-ML file or a COMBINE archive, and reset it
 
-        if (   (simulation->fileType() == SimulationSupport::Simulation::FileType::SedmlFile)
-            || (simulation->fileType() == SimulationSupport::Simulation::FileType::CombineArchive)) {
-            QString error = simulation->furtherInitialize();
+        QString error = simulation->initialize();
 
-            if (!error.isEmpty()) {
-                // We couldn't complete initialisation, so no longer manage the
-                // simulation and raise a Python exception
+        if (!error.isEmpty()) {
+            // We couldn't complete initialisation, so no longer manage the
+            // simulation and raise a Python exception
 
-                simulationManager->unmanage(pFileName);
+            simulationManager->unmanage(pFileName);
 
-                PyErr_SetString(PyExc_ValueError, qPrintable(error));
+            PyErr_SetString(PyExc_ValueError, qPrintable(error));
 
-                return nullptr;
-            }
-        }
-
-        // Reset both the simulation's data and results (well, initialise in the
-        // case of its data), should we have a valid runtime
-
-        if ((runtime != nullptr) && runtime->isValid()) {
-            simulation->data()->reset();
-            simulation->results()->reset();
+            return nullptr;
         }
 
         // Return our simulation object as a Python object
@@ -272,7 +241,8 @@ bool SimulationSupportPythonWrapper::valid(Simulation *pSimulation)
 
 //==============================================================================
 
-bool SimulationSupportPythonWrapper::run(Simulation *pSimulation)
+bool SimulationSupportPythonWrapper::run(Simulation *pSimulation,
+                                         bool pBlocking)
 {
     // Run the given simulation, but only if it doesn't have blocking issues and
     // if it is valid
@@ -288,6 +258,7 @@ bool SimulationSupportPythonWrapper::run(Simulation *pSimulation)
     // Reset our internals
 
     mElapsedTime = -1;
+    mDone = false;
     mErrorMessage = QString();
 
     // Try to allocate all the memory we need by adding a run to our simulation
@@ -309,10 +280,21 @@ bool SimulationSupportPythonWrapper::run(Simulation *pSimulation)
                 Qt::UniqueConnection);
 
         // Run our simulation and wait for it to complete
-
-        pSimulation->run();
-
-        mWaitLoop.exec();
+        // Note #1: if we are to block, then our simulation is run in our
+        //          thread, meaning that no event loop is involved and that
+        //          simulationDone() gets called before runSynchronously()
+        //          returns...
+        // Note #2: if we are not to block, then our simulation is run by our
+        //          simulation executor and simulationDone() gets called
+        //          through a queued connection, i.e. it can only be called
+        //          once our wait loop is running, unless our simulation
+        //          couldn't be run in the first place...
+
+        if (pBlocking) {
+            pSimulation->runSynchronously();
+        } else if (!pSimulation->run().isCanceled() && !mDone) {
+            mWaitLoop.exec();
+        }
 
         // Throw any error message that has been generated
 
@@ -334,6 +316,102 @@ bool SimulationSupportPythonWrapper::run(Simulation *pSimulation)
 
 //==============================================================================
 
+bool SimulationSupportPythonWrapper::run_sweep(Simulation *pSimulation,
+                                               const QVariantList &pRuns,
+                                               int pThreadsCount)
+{
+    // Run a sweep of the given simulation, but only if it doesn't have
+    // blocking issues and if it is valid
+
+    if (pSimulation->hasBlockingIssues()) {
+        throw std::runtime_error(tr("The simulation has blocking issues and cannot therefore be run.").toStdString());
+    }
+
+    if (!doValid(pSimulation)) {
+        throw std::runtime_error(tr("The simulation has an invalid runtime and cannot therefore be run.").toStdString());
+    }
+
+    // Retrieve the constants and states to use for each of our runs
+    // Note: each run is a dictionary which keys are the URI of constants and/or
+    //       states, and values the value to use for those constants and/or
+    //       states...
+
+    SimulationSweep sweep(pSimulation);
+    DataStore::DataStoreValues *constantsValues = pSimulation->data()->constantsValues();
+    DataStore::DataStoreValues *statesValues = pSimulation->data()->statesValues();
+
+    for (const auto &run : pRuns) {
+        const QVariantMap runValues = run.toMap();
+        SimulationSweepValues constants;
+        SimulationSweepValues states;
+
+        for (auto runValue = runValues.constBegin(), runValueEnd = runValues.constEnd();
+             runValue != runValueEnd; ++runValue) {
+            int index = valueIndex(constantsValues, runValue.key());
+
+            if (index != -1) {
+                constants.insert(index, runValue.value().toDouble());
+            } else {
+                index = valueIndex(statesValues, runValue.key());
+
+                if (index == -1) {
+                    throw std::runtime_error(tr("The requested constant or state (%1) could not be found.").arg(runValue.key()).toStdString());
+                }
+
+                states.insert(index, runValue.value().toDouble());
+            }
+        }
+
+        sweep.addRun(constants, states);
+    }
+
+    // Reset our internals
+
+    mElapsedTime = -1;
+    mDone = false;
+    mErrorMessage = QString();
+
+    // Keep track of any sweep error and of when the sweep is done
+
+    connect(&sweep, &SimulationSweep::error,
+            this, &SimulationSupportPythonWrapper::simulationError);
+    connect(&sweep, &SimulationSweep::done,
+            this, &SimulationSupportPythonWrapper::simulationDone);
+
+    // Run our sweep and wait for it to complete
+    // Note: we keep track of our focus widget (which might be our Python
+    //       console window), so that we can give the focus back to it once we
+    //       are done running our sweep...
+
+    QWidget *focusWidget = QApplication::focusWidget();
+
+    if (!sweep.run(pThreadsCount)) {
+        throw std::runtime_error(mErrorMessage.isEmpty()?
+                                     tr("The sweep could not be run.").toStdString():
+                                     mErrorMessage.toStdString());
+    }
+
+    if (!mDone) {
+        mWaitLoop.exec();
+    }
+
+    // Throw any error message that has been generated
+
+    if (!mErrorMessage.isEmpty()) {
+        throw std::runtime_error(mErrorMessage.toStdString());
+    }
+
+    // Restore the focus to the previous widget
+
+    if (focusWidget != nullptr) {
+        focusWidget->setFocus();
+    }
+
+    return mElapsedTime >= 0;
+}
+
+//==============================================================================
+
 void SimulationSupportPythonWrapper::reset(Simulation *pSimulation, bool pAll)
 {
     // Reset the given simulation
@@ -559,9 +637,48 @@ PyObject * SimulationSupportPythonWrapper::algebraic(SimulationData *pSimulation
 
 //==============================================================================
 
+bool SimulationSupportPythonWrapper::set_values(SimulationData *pSimulationData,
+                                                const QVariantMap &pValues)
+{
+    // Set the given constants and/or states for the given simulation data, and
+    // this all at once, so that its parameters get updated only once
+    // Note: we retrieve the index of all the given constants and/or states
+    //       before setting any of them, so that either all or none of them get
+    //       set...
+
+    DataStore::DataStoreValues *constantsValues = pSimulationData->constantsValues();
+    DataStore::DataStoreValues *statesValues = pSimulationData->statesValues();
+    QMap<int, double> constants;
+    QMap<int, double> states;
+
+    for (auto value = pValues.constBegin(), valueEnd = pValues.constEnd();
+         value != valueEnd; ++value) {
+        int index = valueIndex(constantsValues, value.key());
+
+        if (index != -1) {
+            constants.insert(index, value.value().toDouble());
+        } else {
+            index = valueIndex(statesValues, value.key());
+
+            if (index == -1) {
+                throw std::runtime_error(tr("The requested constant or state (%1) could not be found.").arg(value.key()).toStdString());
+            }
+
+            states.insert(index, value.value().toDouble());
+        }
+    }
+
+    return pSimulationData->setValues(constants, states);
+}
+
+//==============================================================================
+
 DataStore::DataStore * SimulationSupportPythonWrapper::data_store(SimulationResults *pSimulationResults) const
 {
-    // Return the data store for the given simulation results
+    // Return the data store for the given simulation results, after making
+    // sure that the values of our unrecorded variables have been computed
+
+    pSimulationResults->computeValues();
 
     return pSimulationResults->dataStore();
 }
@@ -588,7 +705,10 @@ PyObject * SimulationSupportPythonWrapper::constants(SimulationResults *pSimulat
 
 PyObject * SimulationSupportPythonWrapper::rates(SimulationResults *pSimulationResults) const
 {
-    // Return the rates variables for the given simulation results
+    // Return the rates variables for the given simulation results, after
+    // making sure that the values of the unrecorded ones have been computed
+
+    pSimulationResults->computeValues();
 
     return DataStore::DataStorePythonWrapper::dataStoreVariablesDict(pSimulationResults->ratesVariables());
 }
@@ -606,13 +726,88 @@ PyObject * SimulationSupportPythonWrapper::states(SimulationResults *pSimulation
 
 PyObject * SimulationSupportPythonWrapper::algebraic(SimulationResults *pSimulationResults) const
 {
-    // Return the algebraic variables for the given simulation results
+    // Return the algebraic variables for the given simulation results, after
+    // making sure that the values of the unrecorded ones have been computed
+
+    pSimulationResults->computeValues();
 
     return DataStore::DataStorePythonWrapper::dataStoreVariablesDict(pSimulationResults->algebraicVariables());
 }
 
 //==============================================================================
 
+bool SimulationSupportPythonWrapper::is_recorded(SimulationResults *pSimulationResults,
+                                                 const QString &pUri) const
+{
+    // Return whether the model parameter with the given URI is recorded for
+    // the given simulation results
+
+    return pSimulationResults->isRecorded(pUri);
+}
+
+//==============================================================================
+
+void SimulationSupportPythonWrapper::set_recorded(SimulationResults *pSimulationResults,
+                                                  const QString &pUri,
+                                                  bool pRecorded)
+{
+    // Set whether the model parameter with the given URI is to be recorded for
+    // the given simulation results
+
+    pSimulationResults->setRecorded(pUri, pRecorded);
+}
+
+//==============================================================================
+
+void SimulationSupportPythonWrapper::set_recorded_variables(SimulationResults *pSimulationResults,
+                                                            const QStringList &pUris)
+{
+    // Only record the model parameters with the given URIs for the given
+    // simulation results
+
+    pSimulationResults->setRecordedVariables(pUris);
+}
+
+//==============================================================================
+
+QString SimulationSupportPythonWrapper::data_interpolation(SimulationResults *pSimulationResults) const
+{
+    // Return the kind of interpolation used for the imported data of the given
+    // simulation results
+
+    switch (pSimulationResults->dataInterpolationKind()) {
+    case SimulationDataInterpolator::Kind::Step:
+        return "step";
+    case SimulationDataInterpolator::Kind::Linear:
+        return "linear";
+    case SimulationDataInterpolator::Kind::Cubic:
+        return "cubic";
+    }
+
+    return {};
+}
+
+//==============================================================================
+
+void SimulationSupportPythonWrapper::set_data_interpolation(SimulationResults *pSimulationResults,
+                                                            const QString &pKind)
+{
+    // Set the kind of interpolation to use for the imported data of the given
+    // simulation results
+
+    if (pKind == "step") {
+        pSimulationResults->setDataInterpolationKind(SimulationDataInterpolator::Kind::Step);
+    } else if (pKind == "linear") {
+        pSimulationResults->setDataInterpolationKind(SimulationDataInterpolator::Kind::Linear);
+    } else if (pKind == "cubic") {
+        pSimulationResults->setDataInterpolationKind(SimulationDataInterpolator::Kind::Cubic);
+    } else {
+        throw std::runtime_error(tr("The requested interpolation (%1) is not supported.").arg(pKind).toStdString());
+    }
+}
+
+//==============================================================================
+
 void SimulationSupportPythonWrapper::set_value(DataStore::DataStoreValue *pDataStoreValue,
                                                double pValue)
 {
@@ -654,20 +849,11 @@ void SimulationSupportPythonWrapper::simulationError(const QString &pErrorMessag
 
 void SimulationSupportPythonWrapper::simulationDone(qint64 pElapsedTime)
 {
-    // The simulation is done, so keep track of the given elapsed time and ask
-    // our wait loop to quit with a delay (so that mWaitLoop.exec() has time to
-    // be called in case the simulation was very quick to run)
+    // The simulation is done, so keep track of the given elapsed time and
+    // quit our wait loop, if it is running
 
     mElapsedTime = pElapsedTime;
-
-    QTimer::singleShot(169, this, &SimulationSupportPythonWrapper::quitWaitLoop);
-}
-
-//==============================================================================
-
-void SimulationSupportPythonWrapper::quitWaitLoop()
-{
-    // Quit our wait loop
+    mDone = true;
 
     mWaitLoop.quit();
 }
@@ -67,6 +67,7 @@ public:
 
 private:
     qint64 mElapsedTime = -1;
+    bool mDone = false;
     QString mErrorMessage;
 
     QEventLoop mWaitLoop;
@@ -76,7 +77,10 @@ private:
 public slots:
     bool valid(OpenCOR::SimulationSupport::Simulation *pSimulation);
 
-    bool run(OpenCOR::SimulationSupport::Simulation *pSimulation);
+    bool run(OpenCOR::SimulationSupport::Simulation *pSimulation,
+             bool pBlocking = false);
+    bool run_sweep(OpenCOR::SimulationSupport::Simulation *pSimulation,
+                   const QVariantList &pRuns, int pThreadsCount = 0);
 
     void reset(OpenCOR::SimulationSupport::Simulation *pSimulation,
                bool pAll = true);
@@ -119,6 +123,9 @@ public slots:
     PyObject * states(OpenCOR::SimulationSupport::SimulationData *pSimulationData) const;
     PyObject * algebraic(OpenCOR::SimulationSupport::SimulationData *pSimulationData) const;
 
+    bool set_values(OpenCOR::SimulationSupport::SimulationData *pSimulationData,
+                    const QVariantMap &pValues);
+
     OpenCOR::DataStore::DataStore * data_store(OpenCOR::SimulationSupport::SimulationResults *pSimulationResults) const;
 
     OpenCOR::DataStore::DataStoreVariable * voi(OpenCOR::SimulationSupport::SimulationResults *pSimulationResults) const;
@@ -128,6 +135,17 @@ public slots:
     PyObject * rates(OpenCOR::SimulationSupport::SimulationResults *pSimulationResults) const;
     PyObject * algebraic(OpenCOR::SimulationSupport::SimulationResults *pSimulationResults) const;
 
+    bool is_recorded(OpenCOR::SimulationSupport::SimulationResults *pSimulationResults,
+                     const QString &pUri) const;
+    void set_recorded(OpenCOR::SimulationSupport::SimulationResults *pSimulationResults,
+                      const QString &pUri, bool pRecorded = true);
+    void set_recorded_variables(OpenCOR::SimulationSupport::SimulationResults *pSimulationResults,
+                                const QStringList &pUris);
+
+    QString data_interpolation(OpenCOR::SimulationSupport::SimulationResults *pSimulationResults) const;
+    void set_data_interpolation(OpenCOR::SimulationSupport::SimulationResults *pSimulationResults,
+                                const QString &pKind);
+
     void set_value(OpenCOR::DataStore::DataStoreValue *pDataStoreValue,
                    double pValue);
 
@@ -138,8 +156,6 @@ public slots:
 private slots:
     void simulationError(const QString &pErrorMessage);
     void simulationDone(qint64 pElapsedTime);
-
-    void quitWaitLoop();
 };
 
 //==============================================================================
@@ -0,0 +1,649 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Simulation sweep
+//==============================================================================
+
+#include "cellmlfileruntime.h"
+#include "simulation.h"
+#include "simulationsweep.h"
+
+//==============================================================================
+
+#include <QMutexLocker>
+#include <QThread>
+
+//==============================================================================
+
+namespace OpenCOR {
+namespace SimulationSupport {
+
+//==============================================================================
+
+SimulationSweepRun::SimulationSweepRun(SimulationSweep *pSweep, int pRun,
+                                       int pRunsCount) :
+    mSweep(pSweep),
+    mRun(pRun),
+    mRunsCount(pRunsCount)
+{
+}
+
+//==============================================================================
+
+bool SimulationSweepRun::compute(Solver::OdeSolver *pOdeSolver, int pRun,
+                                 int pRunsCount)
+{
+    // Create our own copy of the model's arrays for all our runs
+    // Note #1: our runtime is shared between all the runs of our sweep, which
+    //          is fine since its compute methods don't have any state of their
+    //          own. Our arrays, however, must be specific to our runs...
+    // Note #2: our arrays hold the values of all our runs in a
+    //          structure-of-arrays layout, i.e. the value of the i-th entry of
+    //          our k-th run is at position i*pRunsCount+k (see
+    //          Solver::OdeSolver::initializeBatch()). If we have only one run
+    //          then this is the same as a "normal" layout...
+
+    Simulation *simulation = mSweep->mSimulation;
+    SimulationData *data = simulation->data();
+    SimulationResults *results = simulation->results();
+    CellMLSupport::CellmlFileRuntime *runtime = simulation->runtime();
+    int constantsCount = runtime->constantsCount();
+    int ratesCount = runtime->ratesCount();
+    int statesCount = runtime->statesCount();
+    int algebraicCount = runtime->algebraicCount();
+    auto constants = new double[pRunsCount*constantsCount];
+    auto rates = new double[pRunsCount*ratesCount];
+    auto states = new double[pRunsCount*statesCount];
+    auto algebraic = new double[pRunsCount*algebraicCount];
+    auto runConstants = new double[constantsCount];
+    auto runRates = new double[ratesCount];
+    auto runStates = new double[statesCount];
+    auto runAlgebraic = new double[algebraicCount];
+    auto dummyStates = new double[statesCount] {};
+
+    auto copyRunArray = [pRunsCount](double *pRunArray, double *pArray, int pCount,
+                               int pRun, bool pFromRun) {
+        for (int i = 0; i < pCount; ++i) {
+            if (pFromRun) {
+                pArray[i*pRunsCount+pRun] = pRunArray[i];
+            } else {
+                pRunArray[i] = pArray[i*pRunsCount+pRun];
+            }
+        }
+    };
+
+    // Keep track of any error that might be reported by any of our solvers
+
+    bool error = false;
+    auto errorHandler = [&error, this](const QString &pMessage) {
+        error = true;
+
+        mSweep->runError(pMessage);
+    };
+
+    // Set up our NLA solver, if needed
+    // Note #1: SimulationSweep::run() makes sure that we are the only run
+    //          using our runtime at any given time if we need an NLA solver...
+    // Note #2: our NLA solver is reused from one run to another by our sweep,
+    //          so we mustn't delete it...
+
+    Solver::NlaSolver *nlaSolver = nullptr;
+    QMetaObject::Connection nlaErrorConnection;
+
+    if (runtime->needNlaSolver()) {
+        nlaSolver = mSweep->nlaSolver();
+
+        runtime->setNlaSolver(nlaSolver);
+
+        nlaErrorConnection = QObject::connect(nlaSolver, &Solver::NlaSolver::error, errorHandler);
+
+        nlaSolver->setProperties(data->nlaSolverProperties());
+    }
+
+    // For each of our runs, apply its constants, recompute its computed
+    // constants, and then apply its states and recompute its variables
+    // Note: like when updating the parameters of a simulation, we use some
+    //       dummy states when recomputing our computed constants so as not to
+    //       lose the current value of our states...
+
+    double startingPoint = data->startingPoint();
+    double endingPoint = data->endingPoint();
+    double pointInterval = data->pointInterval();
+    quint64 pointCounter = 0;
+    double currentPoint = startingPoint;
+
+    for (int run = 0; run < pRunsCount; ++run) {
+        const SimulationSweepValues &runConstantValues = mSweep->mConstants[pRun+run];
+        const SimulationSweepValues &runStateValues = mSweep->mStates[pRun+run];
+
+        memcpy(runConstants, data->constants(), size_t(constantsCount)*Solver::SizeOfDouble);
+        memcpy(runRates, data->rates(), size_t(ratesCount)*Solver::SizeOfDouble);
+        memcpy(runStates, data->states(), size_t(statesCount)*Solver::SizeOfDouble);
+        memcpy(runAlgebraic, data->algebraic(), size_t(algebraicCount)*Solver::SizeOfDouble);
+
+        for (auto constant = runConstantValues.constBegin(), constantEnd = runConstantValues.constEnd();
+             constant != constantEnd; ++constant) {
+            runConstants[constant.key()] = constant.value();
+        }
+
+        runtime->computeComputedConstants()(currentPoint, runConstants, runRates, dummyStates, runAlgebraic);
+
+        for (auto state = runStateValues.constBegin(), stateEnd = runStateValues.constEnd();
+             state != stateEnd; ++state) {
+            runStates[state.key()] = state.value();
+        }
+
+        runtime->computeRates()(currentPoint, runConstants, runRates, runStates, runAlgebraic);
+        runtime->computeVariables()(currentPoint, runConstants, runRates, runStates, runAlgebraic);
+
+        copyRunArray(runConstants, constants, constantsCount, run, true);
+        copyRunArray(runRates, rates, ratesCount, run, true);
+        copyRunArray(runStates, states, statesCount, run, true);
+        copyRunArray(runAlgebraic, algebraic, algebraicCount, run, true);
+    }
+
+    // Add a point for each of our runs
+    // Note: our states are those computed by our ODE solver, but our rates are
+    //       those of the last evaluation done by our ODE solver, which need not
+    //       be at our current point, so we recompute both our rates and our
+    //       variables (like SimulationData::recomputeVariables() does)...
+
+    auto addPoint = [&]() {
+        for (int run = 0; run < pRunsCount; ++run) {
+            copyRunArray(runConstants, constants, constantsCount, run, false);
+            copyRunArray(runRates, rates, ratesCount, run, false);
+            copyRunArray(runStates, states, statesCount, run, false);
+            copyRunArray(runAlgebraic, algebraic, algebraicCount, run, false);
+
+            runtime->computeRates()(currentPoint, runConstants, runRates, runStates, runAlgebraic);
+            runtime->computeVariables()(currentPoint, runConstants, runRates, runStates, runAlgebraic);
+
+            results->addPoint(currentPoint,
+                              mSweep->mPointOffset+(pRun+run)*endingPoint+currentPoint,
+                              mSweep->mFirstRun+pRun+run,
+                              runConstants, runRates, runStates, runAlgebraic);
+        }
+    };
+
+    // Set up and initialise our ODE solver, for all our runs at once, if
+    // possible
+
+    QMetaObject::Connection errorConnection = QObject::connect(pOdeSolver, &Solver::OdeSolver::error, errorHandler);
+
+    if (pRunsCount == 1) {
+        pOdeSolver->setJacobianSparsityPattern(runtime->jacobianColumnPointers(),
+                                               runtime->jacobianRowIndices());
+        pOdeSolver->setComputeJacobian(runtime->computeJacobian());
+
+        pOdeSolver->initialize(currentPoint, statesCount,
+                               constants, rates, states, algebraic,
+                               runtime->computeRates());
+    } else {
+        pOdeSolver->initializeBatch(currentPoint, pRunsCount, statesCount,
+                                    constants, rates, states, algebraic,
+                                    runtime->computeRatesBatch());
+    }
+
+    // Compute our model, but only if no error has occurred so far
+
+    if (!error) {
+        // Add our first point
+
+        addPoint();
+
+        // Our main work loop
+
+        forever {
+            // Reinitialise our solver, if we have an NLA solver
+
+            if (nlaSolver != nullptr) {
+                pOdeSolver->reinitialize(currentPoint);
+            }
+
+            // Determine our next point and compute our model up to it
+            // Note: our ODE solver may stop before or just short of our next
+            //       point (see SimulationWorker::run())...
+
+            double nextPoint = qMin(endingPoint,
+                                    startingPoint+double(pointCounter+1)*pointInterval);
+
+            pOdeSolver->solve(currentPoint, nextPoint);
+
+            if (qFuzzyCompare(currentPoint, nextPoint)) {
+                currentPoint = nextPoint;
+            }
+
+            if (currentPoint >= nextPoint) {
+                ++pointCounter;
+            }
+
+            // Make sure that no error occurred
+
+            if (error) {
+                break;
+            }
+
+            // Add our new point
+
+            addPoint();
+
+            // Leave our main work loop if we have reached our ending point or
+            // if we have been asked to stop
+
+            if (    qFuzzyCompare(currentPoint, endingPoint)
+                || (mSweep->mStopped.loadAcquire() != 0)) {
+                break;
+            }
+        }
+    }
+
+    // Stop tracking the errors of our solvers and delete our arrays
+
+    QObject::disconnect(errorConnection);
+    QObject::disconnect(nlaErrorConnection);
+
+    delete[] constants;
+    delete[] rates;
+    delete[] states;
+    delete[] algebraic;
+    delete[] runConstants;
+    delete[] runRates;
+    delete[] runStates;
+    delete[] runAlgebraic;
+    delete[] dummyStates;
+
+    return !error;
+}
+
+//==============================================================================
+
+void SimulationSweepRun::run()
+{
+    // Retrieve our ODE solver and compute our runs, all at once if our ODE
+    // solver supports batches, or one after the other otherwise
+    // Note #1: SimulationSweep::run() can't tell whether our ODE solver
+    //          supports batches without creating an instance of it, so it
+    //          gives us a batch of runs as long as our runtime has a batched
+    //          version of computeRates(), and it is up to us to check whether
+    //          we can compute them together...
+    // Note #2: our ODE solver is reused from one run to another by our sweep,
+    //          so we mustn't delete it...
+
+    SimulationData *data = mSweep->mSimulation->data();
+    Solver::OdeSolver *odeSolver = mSweep->odeSolver();
+
+    odeSolver->setProperties(data->odeSolverProperties());
+
+    if ((mRunsCount == 1) || odeSolver->supportsBatch()) {
+        compute(odeSolver, mRun, mRunsCount);
+    } else {
+        for (int run = 0; run < mRunsCount; ++run) {
+            if (   !compute(odeSolver, mRun+run, 1)
+                || (mSweep->mStopped.loadAcquire() != 0)) {
+                break;
+            }
+        }
+    }
+
+    // Let our sweep know that we are done
+
+    mSweep->runDone();
+}
+
+//==============================================================================
+
+static bool validSolverProperties(SolverInterface *pSolverInterface,
+                                  const Solver::Solver::Properties &pProperties,
+                                  QString &pPropertyId)
+{
+    // Make sure that the given properties have a valid value for all the
+    // properties of the given solver
+    // Note: we use our solver interface rather than an instance of our solver
+    //       since the latter only checks its properties when it gets
+    //       initialised, i.e. once a run has started...
+
+    const Solver::Properties solverProperties = pSolverInterface->solverProperties();
+
+    for (const auto &solverProperty : solverProperties) {
+        QVariant value = pProperties.value(solverProperty.id());
+        bool ok = value.isValid();
+
+        if (ok) {
+            switch (solverProperty.type()) {
+            case Solver::Property::Type::Boolean:
+                ok = value.canConvert<bool>();
+
+                break;
+            case Solver::Property::Type::Integer:
+                value.toInt(&ok);
+
+                break;
+            case Solver::Property::Type::IntegerGt0:
+                ok = (value.toInt(&ok) > 0) && ok;
+
+                break;
+            case Solver::Property::Type::IntegerGe0:
+                ok = (value.toInt(&ok) >= 0) && ok;
+
+                break;
+            case Solver::Property::Type::Double:
+                value.toDouble(&ok);
+
+                break;
+            case Solver::Property::Type::DoubleGe0:
+                ok = (value.toDouble(&ok) >= 0.0) && ok;
+
+                break;
+            case Solver::Property::Type::DoubleGt0:
+                ok = (value.toDouble(&ok) > 0.0) && ok;
+
+                break;
+            case Solver::Property::Type::List:
+                ok = solverProperty.listValues().contains(value.toString());
+
+                break;
+            }
+        }
+
+        if (!ok) {
+            pPropertyId = solverProperty.id();
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//==============================================================================
+
+SimulationSweep::SimulationSweep(Simulation *pSimulation) :
+    mSimulation(pSimulation)
+{
+    // Keep track of the default number of threads of our thread pool (see
+    // run() and runDone()) and never let our threads expire, so that their
+    // solvers can be reused from one run to another
+
+    mMaxThreadCount = mThreadPool.maxThreadCount();
+
+    mThreadPool.setExpiryTimeout(-1);
+}
+
+//==============================================================================
+
+SimulationSweep::~SimulationSweep()
+{
+    // Stop our runs, if any, wait for them to be done, and delete our solvers
+
+    stop();
+    wait();
+
+    for (auto odeSolver : qAsConst(mOdeSolvers)) {
+        delete odeSolver;
+    }
+
+    for (auto nlaSolver : qAsConst(mNlaSolvers)) {
+        delete nlaSolver;
+    }
+}
+
+//==============================================================================
+
+void SimulationSweep::addRun(const SimulationSweepValues &pConstants,
+                             const SimulationSweepValues &pStates)
+{
+    // Keep track of the constants and states to use for a new run
+
+    mConstants << pConstants;
+    mStates << pStates;
+}
+
+//==============================================================================
+
+int SimulationSweep::runsCount() const
+{
+    // Return our number of runs
+
+    return mConstants.count();
+}
+
+//==============================================================================
+
+bool SimulationSweep::run(int pThreadsCount)
+{
+    // Make sure that we are not already running, that we have some runs and
+    // that our simulation can be run
+
+    CellMLSupport::CellmlFileRuntime *runtime = mSimulation->runtime();
+
+    if (   isRunning() || mConstants.isEmpty()
+        || (runtime == nullptr) || !runtime->isValid()) {
+        return false;
+    }
+
+    if (mSimulation->size() == 0) {
+        emit error(tr("the simulation settings are not valid"));
+
+        return false;
+    }
+
+    // Determine the offset of our first run's points, so that imported data
+    // can be computed as if our runs were following one another
+    // Note: a run's last point is our ending point, hence we can determine the
+    //       offset of all our runs before actually running them...
+
+    int runsCount = mConstants.count();
+
+    mFirstRun = mSimulation->runsCount();
+    mPointOffset = mSimulation->results()->realPoint(0.0, mFirstRun);
+
+    // Make sure that the properties of our solvers are valid, so that none of
+    // our runs can fail because of them (and leave us with some partial runs)
+
+    SimulationData *data = mSimulation->data();
+    QString propertyId;
+
+    if (!validSolverProperties(data->odeSolverInterface(), data->odeSolverProperties(), propertyId)) {
+        emit error(tr("the value of the \"%1\" property of the ODE solver is not valid").arg(propertyId));
+
+        return false;
+    }
+
+    if (   runtime->needNlaSolver()
+        && !validSolverProperties(data->nlaSolverInterface(), data->nlaSolverProperties(), propertyId)) {
+        emit error(tr("the value of the \"%1\" property of the NLA solver is not valid").arg(propertyId));
+
+        return false;
+    }
+
+    // Try to allocate all the memory we need by adding all our runs to our
+    // simulation at once
+    // Note: our simulation either adds all our runs or none of them, so we
+    //       don't end up with some partial runs if it can't add all of them...
+
+    if (!mSimulation->addRuns(runsCount)) {
+        emit error(tr("the memory required for the sweep could not be allocated"));
+
+        return false;
+    }
+
+    // Determine the number of threads to use
+    // Note: if our runtime needs an NLA solver then we can only use one thread
+    //       since the NLA solver to use is associated with our runtime (see
+    //       CellmlFileRuntime::setNlaSolver())...
+
+    int threadsCount = runtime->needNlaSolver()?
+                           1:
+                           (pThreadsCount > 0)?
+                               pThreadsCount:
+                               QThread::idealThreadCount();
+
+    // Note: our thread pool's number of threads gets restored once all our
+    //       runs are done (see runDone())...
+
+    mThreadPool.setMaxThreadCount(qMax(1, qMin(threadsCount, runsCount)));
+
+    // Determine the number of runs to compute together on a given thread
+    // Note: this is only possible if our runtime has a batched version of
+    //       computeRates() and if our ODE solver supports batches (see
+    //       SimulationSweepRun::run()), in which case we use batches that are
+    //       small enough to keep all our threads busy...
+
+    int batchSize = 1;
+
+    if (runtime->computeRatesBatch() != nullptr) {
+        batchSize = qBound(1, runsCount/mThreadPool.maxThreadCount(),
+                           int(CellMLSupport::CellmlFileRuntime::MaximumBatchCount));
+    }
+
+    // Start our runs
+
+    mRunsLeft.storeRelease((runsCount+batchSize-1)/batchSize);
+    mStopped.storeRelease(0);
+
+    mError = false;
+
+    mTimer.start();
+
+    for (int i = 0; i < runsCount; i += batchSize) {
+        mThreadPool.start(new SimulationSweepRun(this, i,
+                                                 qMin(batchSize, runsCount-i)));
+    }
+
+    return true;
+}
+
+//==============================================================================
+
+void SimulationSweep::stop()
+{
+    // Ask our runs to stop
+
+    mStopped.storeRelease(1);
+}
+
+//==============================================================================
+
+void SimulationSweep::wait()
+{
+    // Wait for all our runs to be done
+
+    mThreadPool.waitForDone();
+}
+
+//==============================================================================
+
+bool SimulationSweep::isRunning() const
+{
+    // Return whether some of our runs are still running
+
+    return mRunsLeft.loadAcquire() != 0;
+}
+
+//==============================================================================
+
+Solver::OdeSolver * SimulationSweep::odeSolver()
+{
+    // Return the instance of our ODE solver for the current thread, creating
+    // it if needed
+    // Note: an ODE solver instance can only be used by one run at a time, but
+    //       our threads only ever compute one batch of runs at a time, hence
+    //       we can reuse the instance from one batch to another rather than
+    //       create and delete it each time...
+
+    QMutexLocker locker(&mSolversMutex);
+
+    SolverInterface *odeSolverInterface = mSimulation->data()->odeSolverInterface();
+    QPair<QThread *, SolverInterface *> key(QThread::currentThread(), odeSolverInterface);
+    Solver::OdeSolver *res = mOdeSolvers.value(key);
+
+    if (res == nullptr) {
+        res = static_cast<Solver::OdeSolver *>(odeSolverInterface->solverInstance());
+
+        mOdeSolvers.insert(key, res);
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+Solver::NlaSolver * SimulationSweep::nlaSolver()
+{
+    // Return the instance of our NLA solver for the current thread, creating
+    // it if needed (see odeSolver())
+
+    QMutexLocker locker(&mSolversMutex);
+
+    SolverInterface *nlaSolverInterface = mSimulation->data()->nlaSolverInterface();
+    QPair<QThread *, SolverInterface *> key(QThread::currentThread(), nlaSolverInterface);
+    Solver::NlaSolver *res = mNlaSolvers.value(key);
+
+    if (res == nullptr) {
+        res = static_cast<Solver::NlaSolver *>(nlaSolverInterface->solverInstance());
+
+        mNlaSolvers.insert(key, res);
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+void SimulationSweep::runError(const QString &pMessage)
+{
+    // A solver error occurred, so keep track of it and let people know about
+    // it, but only if another error hasn't already been received
+
+    QMutexLocker errorLocker(&mErrorMutex);
+
+    if (!mError) {
+        mError = true;
+
+        emit error(pMessage);
+    }
+}
+
+//==============================================================================
+
+void SimulationSweep::runDone()
+{
+    // A run (or batch of runs) is done, so if it was our last one then restore
+    // our thread pool's number of threads (see run()) and let people know that
+    // we are done, giving them the elapsed time
+    // Note: we use -1 as a way to indicate that something went wrong...
+
+    if (!mRunsLeft.deref()) {
+        mThreadPool.setMaxThreadCount(mMaxThreadCount);
+
+        QMutexLocker errorLocker(&mErrorMutex);
+
+        emit done(mError?-1:mTimer.elapsed());
+    }
+}
+
+//==============================================================================
+
+} // namespace SimulationSupport
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -0,0 +1,154 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Simulation sweep
+//==============================================================================
+
+#pragma once
+
+//==============================================================================
+
+#include "simulationsupportglobal.h"
+
+//==============================================================================
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QRunnable>
+#include <QThreadPool>
+
+//==============================================================================
+
+namespace OpenCOR {
+
+//==============================================================================
+
+class SolverInterface;
+
+//==============================================================================
+
+namespace Solver {
+    class NlaSolver;
+    class OdeSolver;
+} // namespace Solver
+
+//==============================================================================
+
+namespace SimulationSupport {
+
+//==============================================================================
+
+class Simulation;
+class SimulationSweep;
+
+//==============================================================================
+
+using SimulationSweepValues = QMap<int, double>;
+
+//==============================================================================
+
+class SimulationSweepRun : public QRunnable
+{
+public:
+    explicit SimulationSweepRun(SimulationSweep *pSweep, int pRun,
+                                int pRunsCount);
+
+    void run() override;
+
+private:
+    SimulationSweep *mSweep;
+
+    int mRun;
+    int mRunsCount;
+
+    bool compute(Solver::OdeSolver *pOdeSolver, int pRun, int pRunsCount);
+};
+
+//==============================================================================
+
+class SIMULATIONSUPPORT_EXPORT SimulationSweep : public QObject
+{
+    Q_OBJECT
+
+    friend class SimulationSweepRun;
+
+public:
+    explicit SimulationSweep(Simulation *pSimulation);
+    ~SimulationSweep() override;
+
+    void addRun(const SimulationSweepValues &pConstants,
+                const SimulationSweepValues &pStates = {});
+
+    int runsCount() const;
+
+    bool run(int pThreadsCount = 0);
+    void stop();
+    void wait();
+
+    bool isRunning() const;
+
+private:
+    Simulation *mSimulation;
+
+    QList<SimulationSweepValues> mConstants;
+    QList<SimulationSweepValues> mStates;
+
+    int mFirstRun = 0;
+    double mPointOffset = 0.0;
+
+    QThreadPool mThreadPool;
+    int mMaxThreadCount;
+
+    QMutex mSolversMutex;
+    QMap<QPair<QThread *, SolverInterface *>, Solver::OdeSolver *> mOdeSolvers;
+    QMap<QPair<QThread *, SolverInterface *>, Solver::NlaSolver *> mNlaSolvers;
+
+    QAtomicInt mRunsLeft;
+    QAtomicInt mStopped;
+
+    QMutex mErrorMutex;
+    bool mError = false;
+
+    QElapsedTimer mTimer;
+
+    Solver::OdeSolver * odeSolver();
+    Solver::NlaSolver * nlaSolver();
+
+    void runError(const QString &pMessage);
+    void runDone();
+
+signals:
+    void done(qint64 pElapsedTime);
+
+    void error(const QString &pMessage);
+};
+
+//==============================================================================
+
+} // namespace SimulationSupport
+} // namespace OpenCOR
+
+//==============================================================================
+// End of file
+//==============================================================================
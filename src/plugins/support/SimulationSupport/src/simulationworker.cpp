@@ -24,14 +24,13 @@ along with this program. If not, see <https://gnu.org/licenses>.
 #include "cellmlfileruntime.h"
 #include "corecliutils.h"
 #include "simulation.h"
+#include "simulationexecutor.h"
 #include "simulationworker.h"
 
 //==============================================================================
 
 #include <QElapsedTimer>
 #include <QMutex>
-#include <QThread>
-#include <QTimer>
 
 //==============================================================================
 
@@ -40,10 +39,9 @@ namespace SimulationSupport {
 
 //==============================================================================
 
-SimulationWorker::SimulationWorker(Simulation *pSimulation, QThread *pThread,
+SimulationWorker::SimulationWorker(Simulation *pSimulation,
                                    SimulationWorker *&pSelf) :
     mSimulation(pSimulation),
-    mThread(pThread),
     mRuntime(pSimulation->runtime()),
     mSelf(pSelf)
 {
@@ -53,18 +51,21 @@ SimulationWorker::SimulationWorker(Simulation *pSimulation, QThread *pThread,
 
 bool SimulationWorker::isRunning() const
 {
-    // Return whether our thread is running
+    // Return whether we are running
+    // Note: we are considered to be running as soon as we have been created,
+    //       even if we are still waiting for a thread of our simulation
+    //       executor to become available...
 
-    return mThread->isRunning() && !mPaused;
+    return mRunning && !mPaused;
 }
 
 //==============================================================================
 
 bool SimulationWorker::isPaused() const
 {
-    // Return whether our thread is paused
+    // Return whether we are paused
 
-    return mThread->isRunning() && mPaused;
+    return mRunning && mPaused;
 }
 
 //==============================================================================
@@ -73,44 +74,48 @@ double SimulationWorker::currentPoint() const
 {
     // Return our current point
 
-    return mThread->isRunning()?
+    return mRunning?
                mCurrentPoint:
                mSimulation->data()->startingPoint();
 }
 
 //==============================================================================
 
-void SimulationWorker::run()
+qint64 SimulationWorker::run()
 {
     // Let people know that we are running
 
     emit running(false);
 
     // Set up our ODE solver
+    // Note: our ODE solver is reused from one run to another by our simulation
+    //       executor, so we mustn't delete it...
 
-    auto odeSolver = static_cast<Solver::OdeSolver *>(mSimulation->data()->odeSolverInterface()->solverInstance());
+    Solver::OdeSolver *odeSolver = SimulationExecutor::instance()->odeSolver(mSimulation->data()->odeSolverInterface());
 
     // Set up our NLA solver, if needed
+    // Note: like our ODE solver, our NLA solver is reused from one run to
+    //       another by our simulation executor...
 
     Solver::NlaSolver *nlaSolver = nullptr;
 
     if (mRuntime->needNlaSolver()) {
-        nlaSolver = static_cast<Solver::NlaSolver *>(mSimulation->data()->nlaSolverInterface()->solverInstance());
+        nlaSolver = SimulationExecutor::instance()->nlaSolver(mSimulation->data()->nlaSolverInterface());
 
-        Solver::setNlaSolver(mRuntime, nlaSolver);
+        mRuntime->setNlaSolver(nlaSolver);
     }
 
     // Keep track of any error that might be reported by any of our solvers
-
-    mStopped = false;
-    mError = false;
+    // Note: our solvers live in the thread in which we are run while we live in
+    //       the thread that created us, hence we need a direct connection for
+    //       us to know straightaway that an error has occurred...
 
     connect(odeSolver, &Solver::OdeSolver::error,
-            this, &SimulationWorker::emitError);
+            this, &SimulationWorker::emitError, Qt::DirectConnection);
 
     if (nlaSolver != nullptr) {
         connect(nlaSolver, &Solver::NlaSolver::error,
-                this, &SimulationWorker::emitError);
+                this, &SimulationWorker::emitError, Qt::DirectConnection);
     }
 
     // Retrieve our simulation properties
@@ -125,6 +130,9 @@ void SimulationWorker::run()
     // Initialise our ODE solver
 
     odeSolver->setProperties(mSimulation->data()->odeSolverProperties());
+    odeSolver->setJacobianSparsityPattern(mRuntime->jacobianColumnPointers(),
+                                          mRuntime->jacobianRowIndices());
+    odeSolver->setComputeJacobian(mRuntime->computeJacobian());
 
     odeSolver->initialize(mCurrentPoint, mRuntime->statesCount(),
                           mSimulation->data()->constants(),
@@ -166,22 +174,43 @@ void SimulationWorker::run()
         QMutex pausedMutex;
 
         forever {
-            // Reinitialise our solver, if we have an NLA solver or if the model
-            // got reset
-            // Note: indeed, with a solver such as CVODE, we need to update our
-            //       internals...
-
-            if ((nlaSolver != nullptr) || mReset) {
+            // Reinitialise our solver, if the model got reset
+            // Note #1: indeed, with a solver such as CVODE, we need to update
+            //          our internals...
+            // Note #2: our NLA systems, if any, are solved as part of computing
+            //          our rates, so nothing changes for our ODE solver in
+            //          between two points and reinitialising it would only
+            //          throw away its history (e.g. its step size and order, in
+            //          the case of CVODE)...
+
+            if (mReset) {
                 odeSolver->reinitialize(mCurrentPoint);
 
                 mReset = false;
             }
 
             // Determine our next point and compute our model up to it
+            // Note #1: our ODE solver may stop before our next point (e.g.
+            //          CVODE when it outputs its own steps), in which case our
+            //          next point remains the same...
+            // Note #2: our ODE solver may also stop just short of our next
+            //          point (e.g. a fixed-step solver which step doesn't
+            //          exactly divide our point interval), in which case we
+            //          consider that we have reached it since our ODE solver
+            //          would otherwise keep returning straightaway...
+
+            double nextPoint = qMin(endingPoint,
+                                    startingPoint+double(pointCounter+1)*pointInterval);
+
+            odeSolver->solve(mCurrentPoint, nextPoint);
+
+            if (qFuzzyCompare(mCurrentPoint, nextPoint)) {
+                mCurrentPoint = nextPoint;
+            }
 
-            odeSolver->solve(mCurrentPoint,
-                             qMin(endingPoint,
-                                  startingPoint+double(++pointCounter)*pointInterval));
+            if (mCurrentPoint >= nextPoint) {
+                ++pointCounter;
+            }
 
             // Make sure that no error occurred
 
@@ -193,6 +222,16 @@ void SimulationWorker::run()
 
             mSimulation->results()->addPoint(mCurrentPoint);
 
+            // Use the optimised version of our model, if it has become
+            // available
+            // Note: this is a safe point to do so since neither our ODE solver
+            //       nor our NLA solver, if any, is currently using our model...
+
+            if (mRuntime->swapFunctions()) {
+                odeSolver->setComputeRates(mRuntime->computeRates());
+                odeSolver->setComputeJacobian(mRuntime->computeJacobian());
+            }
+
             // Some post-processing, if needed
 
             if (qFuzzyCompare(mCurrentPoint, endingPoint) || mStopped) {
@@ -219,12 +258,17 @@ void SimulationWorker::run()
 
                 emit paused();
 
-                // Actually pause ourselves
+                // Actually pause ourselves, letting our simulation executor
+                // use our thread for another worker in the meantime
+
+                SimulationExecutor::instance()->releaseThread();
 
                 pausedMutex.lock();
                     mPausedCondition.wait(&pausedMutex);
                 pausedMutex.unlock();
 
+                SimulationExecutor::instance()->reserveThread();
+
                 // We are not paused anymore
 
                 mPaused = false;
@@ -246,12 +290,12 @@ void SimulationWorker::run()
         }
     }
 
-    // Delete our solver(s)
+    // Stop listening to our solvers
 
-    delete odeSolver;
+    disconnect(odeSolver, nullptr, this, nullptr);
 
     if (nlaSolver != nullptr) {
-        delete nlaSolver;
+        disconnect(nlaSolver, nullptr, this, nullptr);
     }
 
     // Reset our simulation owner's knowledge of us
@@ -259,15 +303,22 @@ void SimulationWorker::run()
     //       slot for our done() signal, but we want our simulation owner to
     //       know as quickly as possible that we are done...
 
+    mRunning = false;
+
     mSelf = nullptr;
 
     // Let people know that we are done and give them the elapsed time
-    // Note: we do this with a bit of a delay to give time to the GUI to update
-    //       itself. This is useful when running several simulations from a
-    //       Python script using the Python Console window...
+    // Note: if we are run by our simulation executor then people will get to
+    //       know about it through a queued connection while, if we are run
+    //       synchronously (see Simulation::runSynchronously()), they will get
+    //       to know about it straightaway. Either way, there is no need for
+    //       any kind of delay...
 
-    QTimer::singleShot(169, this, std::bind(&SimulationWorker::emitDone,
-                                            this, mError?-1:elapsedTime));
+    qint64 res = mError?-1:elapsedTime;
+
+    emit done(res);
+
+    return res;
 }
 
 //==============================================================================
@@ -320,15 +371,6 @@ void SimulationWorker::reset()
 
 //==============================================================================
 
-void SimulationWorker::emitDone(qint64 pElapsedTime)
-{
-    // Let people know that we are done and give them the elapsed time
-
-    emit done(pElapsedTime);
-}
-
-//==============================================================================
-
 void SimulationWorker::emitError(const QString &pMessage)
 {
     // A solver error occurred, so keep track of it and let people know about
@@ -53,9 +53,11 @@ class SimulationWorker : public QObject
     Q_OBJECT
 
 public:
-    explicit SimulationWorker(Simulation *pSimulation, QThread *pThread,
+    explicit SimulationWorker(Simulation *pSimulation,
                               SimulationWorker *&pSelf);
 
+    qint64 run();
+
     bool isRunning() const;
     bool isPaused() const;
 
@@ -70,12 +72,11 @@ public:
 private:
     Simulation *mSimulation;
 
-    QThread *mThread;
-
     CellMLSupport::CellmlFileRuntime *mRuntime;
 
     double mCurrentPoint = 0.0;
 
+    bool mRunning = true;
     bool mPaused = false;
     bool mStopped = false;
 
@@ -95,11 +96,7 @@ signals:
 
     void error(const QString &pMessage);
 
-public slots:
-    void run();
-
 private slots:
-    void emitDone(qint64 pElapsedTime);
     void emitError(const QString &pMessage);
 };
 
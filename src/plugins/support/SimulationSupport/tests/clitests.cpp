@@ -0,0 +1,181 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Simulation support CLI tests
+//==============================================================================
+
+#include "../../../../tests/src/testsutils.h"
+
+//==============================================================================
+
+#include "clitests.h"
+#include "corecliutils.h"
+
+//==============================================================================
+
+#include <QtTest/QtTest>
+
+//==============================================================================
+
+void CliTests::runTests()
+{
+    // Run a SED-ML file which data generators only reference the VOI and one
+    // algebraic variable of the Noble 1962 model, and make sure that only that
+    // algebraic variable and our states (which are always written) are written
+
+    QString outputFileName = OpenCOR::Core::temporaryFileName();
+
+    QVERIFY(!OpenCOR::runCli({ "-c", "SimulationSupport::run",
+                               OpenCOR::fileName("models/tests/sedml/noble_1962_iK_time.sedml"),
+                               "-o", outputFileName }, mOutput));
+
+    QFile outputFile(outputFileName);
+
+    QVERIFY(outputFile.open(QIODevice::ReadOnly));
+
+    QStringList header = QString(outputFile.readLine()).trimmed().split(',');
+    QStringList expectedHeader = { "environment/time",
+                                   "membrane/V",
+                                   "sodium_channel_m_gate/m",
+                                   "sodium_channel_h_gate/h",
+                                   "potassium_channel_n_gate/n",
+                                   "potassium_channel/i_K" };
+
+    outputFile.close();
+
+    QFile::remove(outputFileName);
+
+    std::sort(header.begin()+1, header.end());
+    std::sort(expectedHeader.begin()+1, expectedHeader.end());
+
+    QCOMPARE(header, expectedHeader);
+}
+
+//==============================================================================
+
+void CliTests::fixedStepTests()
+{
+    // Run a SED-ML file that uses a fixed-step solver which step (0.01) doesn't
+    // exactly divide our point interval (0.1) in floating point arithmetic and
+    // make sure that we get all of our points, and only them
+
+    QString outputFileName = OpenCOR::Core::temporaryFileName();
+
+    QVERIFY(!OpenCOR::runCli({ "-c", "SimulationSupport::run",
+                               OpenCOR::fileName("src/plugins/support/SimulationSupport/tests/data/noble_1962_forward_euler.sedml"),
+                               "-o", outputFileName }, mOutput));
+
+    QFile outputFile(outputFileName);
+
+    QVERIFY(outputFile.open(QIODevice::ReadOnly));
+
+    QStringList lines = QString(outputFile.readAll()).trimmed().split('\n');
+
+    outputFile.close();
+
+    QFile::remove(outputFileName);
+
+    QCOMPARE(lines.count(), 1+101);
+
+    for (int i = 1, iMax = lines.count(); i < iMax; ++i) {
+        double point = lines[i].split(',').first().toDouble();
+
+        QVERIFY(qAbs(point-0.1*(i-1)) <= 1.0e-9);
+    }
+
+    QCOMPARE(lines.last().split(',').first().toDouble(), 10.0);
+}
+
+//==============================================================================
+
+void CliTests::sweepTests()
+{
+    // Run a parameter sweep of a SED-ML file that uses a fixed-step solver,
+    // writing the results of each run to a temporary directory, and make sure
+    // that we get the value of the states at the end of each run, as well as
+    // all the points of each run
+
+    QTemporaryDir outputDir;
+
+    QVERIFY(outputDir.isValid());
+    QVERIFY(!OpenCOR::runCli({ "-c", "SimulationSupport::sweep",
+                               OpenCOR::fileName("src/plugins/support/SimulationSupport/tests/data/noble_1962_forward_euler.sedml"),
+                               "membrane/Cm=12,6", "-t", "2",
+                               "-o", outputDir.path() }, mOutput));
+
+    mOutput.removeAll(QString());
+
+    QCOMPARE(mOutput.count(), 1+2);
+    QVERIFY(mOutput[0].startsWith("Run,membrane/Cm,"));
+    QVERIFY(mOutput[1].startsWith("1,12,"));
+    QVERIFY(mOutput[2].startsWith("2,6,"));
+    QVERIFY(mOutput[1].section(',', 2) != mOutput[2].section(',', 2));
+
+    for (int i = 1; i <= 2; ++i) {
+        QFile outputFile(outputDir.filePath(QString("run%1.csv").arg(i)));
+
+        QVERIFY(outputFile.open(QIODevice::ReadOnly));
+
+        QStringList lines = QString(outputFile.readAll()).trimmed().split('\n');
+
+        outputFile.close();
+
+        QCOMPARE(lines.count(), 1+101);
+        QCOMPARE(lines.first().split(',').first(), QString("environment/time"));
+        QCOMPARE(lines.last().split(',').first().toDouble(), 10.0);
+    }
+}
+
+//==============================================================================
+
+void CliTests::failingSweepTests()
+{
+    // Run a parameter sweep of a CellML file which second run cannot be
+    // computed (since a membrane capacitance of zero means that the rate of
+    // the membrane potential is infinite) and make sure that it fails as a
+    // whole, i.e. that we neither output the value of the states at the end of
+    // each run nor write the results of any run
+
+    QTemporaryDir outputDir;
+
+    QVERIFY(outputDir.isValid());
+    QVERIFY(OpenCOR::runCli({ "-c", "SimulationSupport::sweep",
+                              OpenCOR::fileName("models/noble_model_1962.cellml"),
+                              "membrane/Cm=12,0,6", "-t", "1",
+                              "-o", outputDir.path() }, mOutput) != 0);
+
+    mOutput.removeAll(QString());
+
+    QVERIFY(!mOutput.isEmpty());
+
+    for (const auto &output : qAsConst(mOutput)) {
+        QVERIFY(!output.startsWith("Run,"));
+    }
+
+    QVERIFY(QDir(outputDir.path()).entryList(QDir::Files).isEmpty());
+}
+
+//==============================================================================
+
+QTEST_APPLESS_MAIN(CliTests)
+
+//==============================================================================
+// End of file
+//==============================================================================
@@ -43,6 +43,7 @@ along with this program. If not, see <https://gnu.org/licenses>.
 
 //==============================================================================
 
+#include <algorithm>
 #include <cfloat>
 
 //==============================================================================
@@ -187,9 +188,17 @@ QColor GraphPanelPlotGraphProperties::symbolFillColor() const
 
 //==============================================================================
 
+static const QRectF InvalidRect = QRectF(0.0, 0.0, -1.0, -1.0);
+
+//==============================================================================
+
 GraphPanelPlotGraphRun::GraphPanelPlotGraphRun(GraphPanelPlotGraph *pOwner) :
     mOwner(pOwner)
 {
+    // Reset our bounds
+
+    resetBounds();
+
     // Customise ourselves a bit
 
     setLegendAttribute(LegendShowLine);
@@ -209,25 +218,148 @@ GraphPanelPlotGraph * GraphPanelPlotGraphRun::owner() const
 
 //==============================================================================
 
+void GraphPanelPlotGraphRun::resetBounds()
+{
+    // Reset our bounds, both linear and logarithmic
+
+    mMinX = mMinLogX = qInf();
+    mMaxX = mMaxLogX = -qInf();
+    mMinY = mMinLogY = qInf();
+    mMaxY = mMaxLogY = -qInf();
+}
+
+//==============================================================================
+
+static bool isFinite(double pValue)
+{
+    // Return whether the given value is finite, i.e. whether its exponent bits
+    // are not all set (which is the case for both an infinite value and NaN)
+    // Note: we check the bits of the given value rather than use qIsFinite()
+    //       (or qIsInf() and qIsNaN()) since our release builds use
+    //       -ffast-math, which allows the compiler to assume that all values
+    //       are finite and, therefore, to optimise those checks away...
+
+    static const quint64 ExponentMask = 0x7ff0000000000000ULL;
+
+    quint64 bits;
+
+    memcpy(&bits, &pValue, sizeof(quint64));
+
+    return (bits & ExponentMask) != ExponentMask;
+}
+
+//==============================================================================
+
+static void updateBounds(const double *pDataX, const double *pDataY,
+                         int pFrom, int pTo,
+                         double &pMinX, double &pMaxX,
+                         double &pMinY, double &pMaxY,
+                         double &pMinLogX, double &pMaxLogX,
+                         double &pMinLogY, double &pMaxLogY)
+{
+    // Update the given bounds with the given range of samples
+    // Note #1: a sample is only taken into account if both of its coordinates
+    //          are finite (and strictly positive for our logarithmic bounds)...
+    // Note #2: we deliberately avoid branching (hence our use of & rather than
+    //          && and of conditional selects rather than if statements), so
+    //          that the compiler can vectorise our loop...
+
+    double minX = pMinX;
+    double maxX = pMaxX;
+    double minY = pMinY;
+    double maxY = pMaxY;
+    double minLogX = pMinLogX;
+    double maxLogX = pMaxLogX;
+    double minLogY = pMinLogY;
+    double maxLogY = pMaxLogY;
+
+    for (int i = pFrom; i < pTo; ++i) {
+        double x = pDataX[i];
+        double y = pDataY[i];
+        bool valid = isFinite(x) & isFinite(y);
+        bool validLog = valid & (x > 0.0) & (y > 0.0);
+
+        minX = (valid & (x < minX))?x:minX;
+        maxX = (valid & (x > maxX))?x:maxX;
+        minY = (valid & (y < minY))?y:minY;
+        maxY = (valid & (y > maxY))?y:maxY;
+
+        minLogX = (validLog & (x < minLogX))?x:minLogX;
+        maxLogX = (validLog & (x > maxLogX))?x:maxLogX;
+        minLogY = (validLog & (y < minLogY))?y:minLogY;
+        maxLogY = (validLog & (y > maxLogY))?y:maxLogY;
+    }
+
+    pMinX = minX;
+    pMaxX = maxX;
+    pMinY = minY;
+    pMaxY = maxY;
+    pMinLogX = minLogX;
+    pMaxLogX = maxLogX;
+    pMinLogY = minLogY;
+    pMaxLogY = maxLogY;
+}
+
+//==============================================================================
+
 void GraphPanelPlotGraphRun::setRawSamples(const double *pDataX,
                                            const double *pDataY,
                                            int pSize)
 {
-    // Set the given raw samples and keep track of those that are valid
+    // Set the given raw samples and keep track of those that are valid, as
+    // well as of our level-of-detail (LOD) pyramid
+    // Note: our LOD pyramid consists of levels of buckets of consecutive
+    //       samples, with buckets of 2^(LodShift+i) samples at level i, each of
+    //       which keeps track of the index of its smallest and largest valid Y
+    //       values. It can only be used if our X values are finite and never
+    //       decrease (which is the case when plotting against our VOI, for
+    //       example) since we must be able to map an X range to a range of
+    //       indexes and to assume that the samples of a bucket are next to one
+    //       another once plotted...
 
     static const QPair<int, int> EmptyData = QPair<int, int>(-1, -1);
 
     QPair<int, int> validData = EmptyData;
 
+    if (pSize < mSize) {
+        mSize = 0;
+
+        mValidData.clear();
+        mLodLevels.clear();
+
+        mLodEnabled = true;
+
+        resetBounds();
+    }
+
+    mDataX = pDataX;
+    mDataY = pDataY;
+
     if (!mValidData.isEmpty()) {
         validData = mValidData.last();
 
         mValidData.removeLast();
     }
 
+    if (mLodEnabled) {
+        addLodLevels(pSize);
+    }
+
     for (int i = mSize; i < pSize; ++i) {
-        if (   !qIsInf(pDataX[i]) && !qIsNaN(pDataX[i])
-            && !qIsInf(pDataY[i]) && !qIsNaN(pDataY[i])) {
+        bool validX = isFinite(pDataX[i]);
+        bool validY = isFinite(pDataY[i]);
+
+        if (mLodEnabled) {
+            if (!validX || ((i != 0) && (pDataX[i] < pDataX[i-1]))) {
+                mLodEnabled = false;
+
+                mLodLevels.clear();
+            } else {
+                updateLodLevels(i, validY);
+            }
+        }
+
+        if (validX && validY) {
             if (validData == EmptyData) {
                 validData.first = i;
                 validData.second = i;
@@ -246,6 +378,12 @@ void GraphPanelPlotGraphRun::setRawSamples(const double *pDataX,
         mValidData << validData;
     }
 
+    // Update our bounds with our new samples
+
+    updateBounds(pDataX, pDataY, mSize, pSize,
+                 mMinX, mMaxX, mMinY, mMaxY,
+                 mMinLogX, mMaxLogX, mMinLogY, mMaxLogY);
+
     mSize = pSize;
 
     QwtPlotCurve::setRawSamples(pDataX, pDataY, pSize);
@@ -253,13 +391,267 @@ void GraphPanelPlotGraphRun::setRawSamples(const double *pDataX,
 
 //==============================================================================
 
+QRectF GraphPanelPlotGraphRun::boundingRect() const
+{
+    // Return our bounding rectangle, if we have at least one valid sample
+    // Note: our bounds are kept up to date as samples get added to us, so
+    //       there is no need to go through our samples...
+
+    if (mMinX > mMaxX) {
+        return InvalidRect;
+    }
+
+    return QRectF(mMinX, mMinY, mMaxX-mMinX, mMaxY-mMinY);
+}
+
+//==============================================================================
+
+QRectF GraphPanelPlotGraphRun::boundingLogRect() const
+{
+    // Return our bounding log rectangle, if we have at least one valid sample
+    // with strictly positive coordinates
+
+    if (mMinLogX > mMaxLogX) {
+        return InvalidRect;
+    }
+
+    return QRectF(mMinLogX, mMinLogY, mMaxLogX-mMinLogX, mMaxLogY-mMinLogY);
+}
+
+//==============================================================================
+
+QPair<int, int> GraphPanelPlotGraphRun::lodBucket(const QPair<int, int> &pBucket1,
+                                                  const QPair<int, int> &pBucket2) const
+{
+    // Return the bucket that results from merging the two given buckets
+
+    if (pBucket1.first == -1) {
+        return pBucket2;
+    }
+
+    if (pBucket2.first == -1) {
+        return pBucket1;
+    }
+
+    return {
+               (mDataY[pBucket2.first] < mDataY[pBucket1.first])?
+                   pBucket2.first:
+                   pBucket1.first,
+               (mDataY[pBucket2.second] > mDataY[pBucket1.second])?
+                   pBucket2.second:
+                   pBucket1.second
+           };
+}
+
+//==============================================================================
+
+void GraphPanelPlotGraphRun::addLodLevels(int pSize)
+{
+    // Add the LOD levels needed for the given number of samples, i.e. until our
+    // top level has at most two buckets, building each new level from the one
+    // below it
+    // Note: we always have a first level, so that it can be kept up to date
+    //       from our very first sample...
+
+    while (   mLodLevels.isEmpty()
+           || ((pSize >> (LodShift+mLodLevels.count())) > 1)) {
+        LodLevel level;
+
+        if (!mLodLevels.isEmpty()) {
+            const LodLevel &prevLevel = mLodLevels.last();
+
+            level.reserve((prevLevel.count()+1) >> 1);
+
+            for (int i = 0, iMax = prevLevel.count(); i < iMax; i += 2) {
+                level << ((i+1 < iMax)?
+                              lodBucket(prevLevel[i], prevLevel[i+1]):
+                              prevLevel[i]);
+            }
+        }
+
+        mLodLevels << level;
+    }
+}
+
+//==============================================================================
+
+void GraphPanelPlotGraphRun::updateLodLevels(int pIndex, bool pValid)
+{
+    // Add the given sample to our LOD levels
+    // Note: if the given sample doesn't change the bucket it belongs to at a
+    //       given level, then that bucket already has a valid sample which is
+    //       also part of the bucket the given sample belongs to at the next
+    //       level, meaning that the given sample cannot change that bucket
+    //       either, so we can stop there...
+
+    for (int i = 0, iMax = mLodLevels.count(); i < iMax; ++i) {
+        LodLevel &level = mLodLevels[i];
+        int bucketIndex = pIndex >> (LodShift+i);
+
+        if (bucketIndex == level.count()) {
+            level << QPair<int, int>(-1, -1);
+        }
+
+        if (!pValid) {
+            continue;
+        }
+
+        QPair<int, int> &bucket = level[bucketIndex];
+
+        if (bucket.first == -1) {
+            bucket.first = pIndex;
+            bucket.second = pIndex;
+        } else {
+            bool changed = false;
+
+            if (mDataY[pIndex] < mDataY[bucket.first]) {
+                bucket.first = pIndex;
+
+                changed = true;
+            }
+
+            if (mDataY[pIndex] > mDataY[bucket.second]) {
+                bucket.second = pIndex;
+
+                changed = true;
+            }
+
+            if (!changed) {
+                break;
+            }
+        }
+    }
+}
+
+//==============================================================================
+
+int GraphPanelPlotGraphRun::lodLevel(const QwtScaleMap &pMapX,
+                                     const QRectF &pCanvasRect,
+                                     int &pFrom, int &pTo) const
+{
+    // Determine the range of samples that is visible, as well as one sample on
+    // each side of it (so that our lines reach the edges of our canvas), and
+    // return the LOD level to use to render it, i.e. the highest level which
+    // buckets don't span more than a pixel column, or -1 if our samples should
+    // be rendered as is
+
+    if (!mLodEnabled || mLodLevels.isEmpty() || (pFrom > pTo)) {
+        return -1;
+    }
+
+    double minX = qMin(pMapX.s1(), pMapX.s2());
+    double maxX = qMax(pMapX.s1(), pMapX.s2());
+    int first = int(std::lower_bound(mDataX, mDataX+mSize, minX)-mDataX)-1;
+    int last = int(std::upper_bound(mDataX, mDataX+mSize, maxX)-mDataX);
+
+    pFrom = qMax(pFrom, first);
+    pTo = qMin(pTo, last);
+
+    double samplesPerPixel = double(qMin(last, mSize-1)-qMax(first, 0)+1)/qMax(pCanvasRect.width(), 1.0);
+
+    if (samplesPerPixel < (1 << LodShift)) {
+        return -1;
+    }
+
+    int res = 0;
+
+    while (   (res+1 < mLodLevels.count())
+           && (double(1 << (LodShift+res+1)) <= samplesPerPixel)) {
+        ++res;
+    }
+
+    return res;
+}
+
+//==============================================================================
+
+void GraphPanelPlotGraphRun::drawLodLines(QPainter *pPainter,
+                                          const QwtScaleMap &pMapX,
+                                          const QwtScaleMap &pMapY,
+                                          int pLevel, int pFrom, int pTo) const
+{
+    // Draw our lines from the given LOD level, using the largest buckets that
+    // fit within the given range, or the samples themselves at the edges of the
+    // given range
+    // Note: for each bucket, we draw a line to its first sample, to its
+    //       smallest and largest values (in the order in which they appear)
+    //       and to its last sample, which, since a bucket doesn't span more
+    //       than a pixel column, renders the same as drawing all of its
+    //       samples...
+
+    QPolygonF polyline;
+    int i = pFrom;
+
+    polyline.reserve(4*int(pMapX.pDist())+(2 << (LodShift+pLevel)));
+
+    auto addPoint = [&](int pIndex) {
+        polyline << QPointF(pMapX.transform(mDataX[pIndex]),
+                            pMapY.transform(mDataY[pIndex]));
+    };
+
+    while (i <= pTo) {
+        int level = pLevel;
+
+        while (   (level >= 0)
+               && (   ((i & ((1 << (LodShift+level))-1)) != 0)
+                   || (i+(1 << (LodShift+level))-1 > pTo))) {
+            --level;
+        }
+
+        if (level == -1) {
+            addPoint(i);
+
+            ++i;
+        } else {
+            const QPair<int, int> &bucket = mLodLevels[level][i >> (LodShift+level)];
+            int last = i+(1 << (LodShift+level))-1;
+
+            addPoint(i);
+
+            if (bucket.first < bucket.second) {
+                addPoint(bucket.first);
+                addPoint(bucket.second);
+            } else {
+                addPoint(bucket.second);
+                addPoint(bucket.first);
+            }
+
+            addPoint(last);
+
+            i = last+1;
+        }
+    }
+
+    QwtPainter::drawPolyline(pPainter, polyline);
+}
+
+//==============================================================================
+
 void GraphPanelPlotGraphRun::drawLines(QPainter *pPainter,
                                        const QwtScaleMap &pMapX,
                                        const QwtScaleMap &pMapY,
                                        const QRectF &pCanvasRect,
                                        int pFrom, int pTo) const
 {
-    // Draw our lines
+    // Draw our lines, using our LOD pyramid if we have many more samples to
+    // draw than there are pixel columns in our canvas
+
+    int lodFrom = pFrom;
+    int lodTo = pTo;
+    int level = lodLevel(pMapX, pCanvasRect, lodFrom, lodTo);
+
+    if (level != -1) {
+        for (const auto &validData : mValidData) {
+            int validFrom = qMax(lodFrom, validData.first);
+            int validTo = qMin(lodTo, validData.second);
+
+            if (validFrom <= validTo) {
+                drawLodLines(pPainter, pMapX, pMapY, level, validFrom, validTo);
+            }
+        }
+
+        return;
+    }
 
     for (const auto &validData : mValidData) {
         if ((pFrom <= validData.first) || (pTo >= validData.second)) {
@@ -308,16 +700,10 @@ void GraphPanelPlotGraphRun::drawSymbols(QPainter *pPainter,
 
 //==============================================================================
 
-static const QRectF InvalidRect = QRectF(0.0, 0.0, -1.0, -1.0);
-
-//==============================================================================
-
 GraphPanelPlotGraph::GraphPanelPlotGraph(void *pParameterX, void *pParameterY,
                                          GraphPanelWidget *pOwner) :
     mParameterX(pParameterX),
-    mParameterY(pParameterY),
-    mBoundingRect(InvalidRect),
-    mBoundingLogRect(InvalidRect)
+    mParameterY(pParameterY)
 {
     // Determine our default colour
 
@@ -726,176 +1112,67 @@ void GraphPanelPlotGraph::setData(double *pDataX, double *pDataY, quint64 pSize,
     }
 
     run->setRawSamples(pDataX, pDataY, int(pSize));
-
-    // Reset the cached version of our bounding rectangles
-
-    mBoundingRect = InvalidRect;
-    mBoundingLogRect = InvalidRect;
-
-    mBoundingRects.remove(run);
-    mBoundingLogRects.remove(run);
 }
 
 //==============================================================================
 
-QRectF GraphPanelPlotGraph::boundingRect()
+QRectF GraphPanelPlotGraph::boundingRect(int pRun) const
 {
-    // Return the cached version of our bounding rectangle, if we have one, or
-    // compute it and return it
-
-    if ((mBoundingRect == InvalidRect) && !mRuns.isEmpty()) {
-        mBoundingRect = QRectF();
-
-        for (auto run : qAsConst(mRuns)) {
-            if (run->dataSize() != 0) {
-                QRectF boundingRect = mBoundingRects.value(run, InvalidRect);
+    // Return the bounding rectangle of the given run, if it exists
 
-                if (boundingRect == InvalidRect) {
-                    bool needInitMinX = true;
-                    bool needInitMaxX = true;
-                    bool needInitMinY = true;
-                    bool needInitMaxY = true;
-                    double minX = 1.0;
-                    double maxX = 1.0;
-                    double minY = 1.0;
-                    double maxY = 1.0;
-
-                    for (size_t i = 0, iMax = run->dataSize(); i < iMax; ++i) {
-                        QPointF sample = run->data()->sample(i);
-
-                        if (   !qIsInf(sample.x()) && !qIsNaN(sample.x())
-                            && !qIsInf(sample.y()) && !qIsNaN(sample.y())) {
-                            if (needInitMinX) {
-                                minX = sample.x();
-
-                                needInitMinX = false;
-                            } else if (sample.x() < minX) {
-                                minX = sample.x();
-                            }
-
-                            if (needInitMaxX) {
-                                maxX = sample.x();
-
-                                needInitMaxX = false;
-                            } else if (sample.x() > maxX) {
-                                maxX = sample.x();
-                            }
+    if (mRuns.isEmpty()) {
+        return InvalidRect;
+    }
 
-                            if (needInitMinY) {
-                                minY = sample.y();
+    if (pRun == -1) {
+        return mRuns.last()->boundingRect();
+    }
 
-                                needInitMinY = false;
-                            } else if (sample.y() < minY) {
-                                minY = sample.y();
-                            }
+    return ((pRun >= 0) && (pRun < mRuns.count()))?
+               mRuns[pRun]->boundingRect():
+               InvalidRect;
+}
 
-                            if (needInitMaxY) {
-                                maxY = sample.y();
+//==============================================================================
 
-                                needInitMaxY = false;
-                            } else if (sample.y() > maxY) {
-                                maxY = sample.y();
-                            }
-                        }
-                    }
+QRectF GraphPanelPlotGraph::boundingRect() const
+{
+    // Return our bounding rectangle, i.e. the union of the bounding rectangle
+    // of our runs
+    // Note: our runs keep track of their bounding rectangle as data gets
+    //       appended to them, so this is cheap to compute...
 
-                    if (!needInitMinX && !needInitMaxX && !needInitMinY && !needInitMaxY) {
-                        boundingRect = QRectF(minX, minY, maxX-minX, maxY-minY);
+    QRectF res = QRectF();
 
-                        mBoundingRects.insert(run, boundingRect);
-                    }
-                }
+    for (auto run : qAsConst(mRuns)) {
+        QRectF boundingRect = run->boundingRect();
 
-                if (boundingRect != InvalidRect) {
-                    mBoundingRect |= boundingRect;
-                }
-            }
+        if (boundingRect != InvalidRect) {
+            res |= boundingRect;
         }
     }
 
-    return mBoundingRect;
+    return res;
 }
 
 //==============================================================================
 
-QRectF GraphPanelPlotGraph::boundingLogRect()
+QRectF GraphPanelPlotGraph::boundingLogRect() const
 {
-    // Return the cached version of our bounding log rectangle, if we have one,
-    // or compute it and return it
-
-    if ((mBoundingLogRect == InvalidRect) && !mRuns.isEmpty()) {
-        mBoundingLogRect = QRectF();
-
-        for (auto run : qAsConst(mRuns)) {
-            if (run->dataSize() != 0) {
-                QRectF boundingLogRect = mBoundingLogRects.value(run, InvalidRect);
-
-                if (boundingLogRect == InvalidRect) {
-                    bool needInitMinX = true;
-                    bool needInitMaxX = true;
-                    bool needInitMinY = true;
-                    bool needInitMaxY = true;
-                    double minX = 1.0;
-                    double maxX = 1.0;
-                    double minY = 1.0;
-                    double maxY = 1.0;
-
-                    for (size_t i = 0, iMax = run->dataSize(); i < iMax; ++i) {
-                        QPointF sample = run->data()->sample(i);
-
-                        if (   !qIsInf(sample.x()) && !qIsNaN(sample.x())
-                            &&  (sample.x() > 0.0)
-                            && !qIsInf(sample.y()) && !qIsNaN(sample.y())
-                            &&  (sample.y() > 0.0)) {
-                            if (needInitMinX) {
-                                minX = sample.x();
-
-                                needInitMinX = false;
-                            } else if (sample.x() < minX) {
-                                minX = sample.x();
-                            }
-
-                            if (needInitMaxX) {
-                                maxX = sample.x();
+    // Return our bounding log rectangle, i.e. the union of the bounding log
+    // rectangle of our runs
 
-                                needInitMaxX = false;
-                            } else if (sample.x() > maxX) {
-                                maxX = sample.x();
-                            }
+    QRectF res = QRectF();
 
-                            if (needInitMinY) {
-                                minY = sample.y();
-
-                                needInitMinY = false;
-                            } else if (sample.y() < minY) {
-                                minY = sample.y();
-                            }
-
-                            if (needInitMaxY) {
-                                maxY = sample.y();
-
-                                needInitMaxY = false;
-                            } else if (sample.y() > maxY) {
-                                maxY = sample.y();
-                            }
-                        }
-                    }
-
-                    if (!needInitMinX && !needInitMaxX && !needInitMinY && !needInitMaxY) {
-                        boundingLogRect = QRectF(minX, minY, maxX-minX, maxY-minY);
-
-                        mBoundingLogRects.insert(run, boundingLogRect);
-                    }
-                }
+    for (auto run : qAsConst(mRuns)) {
+        QRectF boundingLogRect = run->boundingLogRect();
 
-                if (boundingLogRect != InvalidRect) {
-                    mBoundingLogRect |= boundingLogRect;
-                }
-            }
+        if (boundingLogRect != InvalidRect) {
+            res |= boundingLogRect;
         }
     }
 
-    return mBoundingLogRect;
+    return res;
 }
 
 //==============================================================================
@@ -145,6 +145,9 @@ public:
 
     void setRawSamples(const double *pDataX, const double *pDataY, int pSize);
 
+    QRectF boundingRect() const override;
+    QRectF boundingLogRect() const;
+
 protected:
     void drawLines(QPainter *pPainter, const QwtScaleMap &pMapX,
                    const QwtScaleMap &pMapY, const QRectF &pCanvasRect,
@@ -154,10 +157,47 @@ protected:
                      const QRectF &pCanvasRect, int pFrom, int pTo) const override;
 
 private:
+    enum {
+        LodShift = 4
+    };
+
+    using LodLevel = QVector<QPair<int, int>>;
+
     GraphPanelPlotGraph *mOwner;
 
+    const double *mDataX = nullptr;
+    const double *mDataY = nullptr;
+
     int mSize = 0;
     QList<QPair<int, int>> mValidData;
+
+    double mMinX;
+    double mMaxX;
+    double mMinY;
+    double mMaxY;
+
+    double mMinLogX;
+    double mMaxLogX;
+    double mMinLogY;
+    double mMaxLogY;
+
+    void resetBounds();
+
+    bool mLodEnabled = true;
+    QVector<LodLevel> mLodLevels;
+
+    QPair<int, int> lodBucket(const QPair<int, int> &pBucket1,
+                              const QPair<int, int> &pBucket2) const;
+
+    void addLodLevels(int pSize);
+    void updateLodLevels(int pIndex, bool pValid);
+
+    int lodLevel(const QwtScaleMap &pMapX, const QRectF &pCanvasRect,
+                 int &pFrom, int &pTo) const;
+
+    void drawLodLines(QPainter *pPainter, const QwtScaleMap &pMapX,
+                      const QwtScaleMap &pMapY, int pLevel, int pFrom,
+                      int pTo) const;
 };
 
 //==============================================================================
@@ -224,8 +264,10 @@ public:
     QwtSeriesData<QPointF> *data(int pRun = -1) const;
     void setData(double *pDataX, double *pDataY, quint64 pSize, int pRun = -1);
 
-    QRectF boundingRect();
-    QRectF boundingLogRect();
+    QRectF boundingRect(int pRun) const;
+
+    QRectF boundingRect() const;
+    QRectF boundingLogRect() const;
 
 private:
     bool mSelected = true;
@@ -237,12 +279,6 @@ private:
 
     QColor mColor;
 
-    QRectF mBoundingRect;
-    QHash<GraphPanelPlotGraphRun *, QRectF> mBoundingRects;
-
-    QRectF mBoundingLogRect;
-    QHash<GraphPanelPlotGraphRun *, QRectF> mBoundingLogRects;
-
     GraphPanelPlotWidget *mPlot = nullptr;
 
     GraphPanelPlotGraphRun *mDummyRun = nullptr;
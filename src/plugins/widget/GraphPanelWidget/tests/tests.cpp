@@ -0,0 +1,80 @@
+/*******************************************************************************
+
+Copyright (C) The University of Auckland
+
+OpenCOR is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+OpenCOR is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <https://gnu.org/licenses>.
+
+*******************************************************************************/
+
+//==============================================================================
+// Graph Panel widget tests
+//==============================================================================
+
+#include "graphpanelplotwidget.h"
+#include "graphpanelwidget.h"
+#include "tests.h"
+
+//==============================================================================
+
+#include <QtTest/QtTest>
+
+//==============================================================================
+
+void Tests::boundsTests()
+{
+    // Create a graph run and give it some samples, some of which have an
+    // infinite or NaN coordinate, and make sure that those samples are not
+    // taken into account when computing the bounds of our graph run, including
+    // when samples get added to our graph run
+
+    OpenCOR::GraphPanelWidget::GraphPanelWidget graphPanel({}, nullptr);
+    OpenCOR::GraphPanelWidget::GraphPanelPlotGraph graph(&graphPanel);
+    OpenCOR::GraphPanelWidget::GraphPanelPlotGraphRun run(&graph);
+
+    double dataX[] = { 0.0, 1.0, 2.0, 3.0, 4.0, qInf(), qQNaN(), 5.0 };
+    double dataY[] = { 1.0, qQNaN(), 5.0, -qInf(), -2.0, 9.0, 9.0, 3.0 };
+
+    QVERIFY(run.boundingRect().width() < 0.0);
+    QVERIFY(run.boundingLogRect().width() < 0.0);
+
+    run.setRawSamples(dataX, dataY, 5);
+
+    QCOMPARE(run.boundingRect(), QRectF(0.0, -2.0, 4.0, 7.0));
+    QCOMPARE(run.boundingLogRect(), QRectF(2.0, 5.0, 0.0, 0.0));
+
+    run.setRawSamples(dataX, dataY, 8);
+
+    QCOMPARE(run.boundingRect(), QRectF(0.0, -2.0, 5.0, 7.0));
+    QCOMPARE(run.boundingLogRect(), QRectF(2.0, 3.0, 3.0, 2.0));
+
+    // Only give our graph run invalid samples and make sure that it has no
+    // bounds
+
+    double invalidDataX[] = { qQNaN(), 1.0 };
+    double invalidDataY[] = { 1.0, qInf() };
+
+    run.setRawSamples(invalidDataX, invalidDataY, 0);
+    run.setRawSamples(invalidDataX, invalidDataY, 2);
+
+    QVERIFY(run.boundingRect().width() < 0.0);
+    QVERIFY(run.boundingLogRect().width() < 0.0);
+}
+
+//==============================================================================
+
+QTEST_MAIN(Tests)
+
+//==============================================================================
+// End of file
+//==============================================================================